@@ -90,6 +90,7 @@ enum operacake_switching_mode {
 	MODE_MANUAL = 0,
 	MODE_FREQUENCY = 1,
 	MODE_TIME = 2,
+	MODE_SWEEP = 3,
 };
 
 struct operacake_state {
@@ -394,6 +395,61 @@ uint8_t operacake_set_range(uint32_t freq_mhz)
 	return 0;
 }
 
+/*
+ * sweep mode: ports are stepped through at every sweep step
+ */
+static uint8_t sweep_ports[MAX_OPERACAKE_SWEEP_PORTS];
+static uint8_t num_sweep_ports = 0;
+
+uint8_t operacake_set_sweep_ports(const uint8_t* ports, uint8_t count)
+{
+	if ((count == 0) || (count > MAX_OPERACAKE_SWEEP_PORTS)) {
+		return 1;
+	}
+	for (int i = 0; i < count; i++) {
+		if (ports[i] > OPERACAKE_PB4) {
+			return 1;
+		}
+	}
+	for (int i = 0; i < count; i++) {
+		sweep_ports[i] = ports[i];
+	}
+	num_sweep_ports = count;
+	return 0;
+}
+
+/*
+ * Number of ports to step through at each sweep step, or 0 if no board is in
+ * sweep mode.
+ */
+uint8_t operacake_sweep_port_count(void)
+{
+	for (int i = 0; i < OPERACAKE_MAX_BOARDS; i++) {
+		if (operacake_is_board_present(i) &&
+		    operacake_get_mode(i) == MODE_SWEEP) {
+			return num_sweep_ports;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Activate the sweep port at index on boards in sweep mode and return it.
+ */
+uint8_t operacake_select_sweep_port(uint8_t index)
+{
+	const uint8_t port = sweep_ports[index];
+
+	for (int i = 0; i < OPERACAKE_MAX_BOARDS; i++) {
+		if (operacake_is_board_present(i) &&
+		    operacake_get_mode(i) == MODE_SWEEP) {
+			/* Make the B port mirror the A port. */
+			operacake_activate_ports(i, port, (port + 4) % 8);
+		}
+	}
+	return port;
+}
+
 /*
  * GPIO
  */
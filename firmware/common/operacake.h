@@ -40,6 +40,7 @@ extern "C" {
 #define OPERACAKE_PB4 7
 
 #define MAX_OPERACAKE_RANGES 8
+#define MAX_OPERACAKE_SWEEP_PORTS 8
 
 uint8_t operacake_init(bool allow_gpio);
 void operacake_skip_i2c_address(uint8_t address);
@@ -51,6 +52,9 @@ uint8_t operacake_set_ports(uint8_t address, uint8_t PA, uint8_t PB);
 uint8_t operacake_add_range(uint16_t freq_min, uint16_t freq_max, uint8_t port);
 uint8_t operacake_set_range(uint32_t freq_mhz);
 void operacake_clear_ranges(void);
+uint8_t operacake_set_sweep_ports(const uint8_t* ports, uint8_t count);
+uint8_t operacake_sweep_port_count(void);
+uint8_t operacake_select_sweep_port(uint8_t index);
 uint16_t gpio_test(uint8_t address);
 
 #ifdef __cplusplus
@@ -361,9 +361,22 @@ static const tune_config_t* select_tune_config(uint64_t opmode, fp_40_24_t freq_
 }
 #endif
 
-static uint32_t radio_update_frequency(radio_t* const radio, uint64_t* bank)
+/*
+ * Resolve the requested frequency settings into the IF, LO, image reject
+ * path and rotation to apply. This does not touch the hardware, so the
+ * results can be computed ahead of time. Each of the outputs must be
+ * initialized to its applied value.
+ */
+static void resolve_frequency(
+	radio_t* const radio,
+	uint64_t* bank,
+	uint64_t opmode,
+	uint64_t* const out_rf,
+	uint64_t* const out_if,
+	uint64_t* const out_lo,
+	uint64_t* const out_img_reject,
+	uint64_t* const out_rotation)
 {
-	uint32_t changed = 0;
 	bool high_lo = false;
 
 	const uint64_t requested_rf = bank[RADIO_FREQUENCY_RF];
@@ -374,25 +387,15 @@ static uint32_t radio_update_frequency(radio_t* const radio, uint64_t* bank)
 	const uint64_t requested_rotation = bank[RADIO_ROTATION];
 #endif
 
-	const uint64_t applied_rf = radio->config[RADIO_BANK_APPLIED][RADIO_FREQUENCY_RF];
-	const uint64_t applied_if = radio->config[RADIO_BANK_APPLIED][RADIO_FREQUENCY_IF];
-	const uint64_t applied_lo = radio->config[RADIO_BANK_APPLIED][RADIO_FREQUENCY_LO];
-	const uint64_t applied_img_reject =
-		radio->config[RADIO_BANK_APPLIED][RADIO_IMAGE_REJECT];
-	const uint64_t applied_rotation =
-		radio->config[RADIO_BANK_APPLIED][RADIO_ROTATION];
-
-	uint64_t freq_rf = applied_rf;
-	uint64_t analog_rf = applied_rf;
-	uint64_t freq_if = applied_if;
-	uint64_t freq_lo = applied_lo;
-	uint64_t img_reject = applied_img_reject;
-	uint64_t rotation = applied_rotation;
+	uint64_t freq_rf = *out_rf;
+	uint64_t analog_rf = *out_rf;
+	uint64_t freq_if = *out_if;
+	uint64_t freq_lo = *out_lo;
+	uint64_t img_reject = *out_img_reject;
+	uint64_t rotation = *out_rotation;
 
-	uint64_t opmode = bank[RADIO_OPMODE];
-	if (opmode == RADIO_UNSET) {
-		opmode = radio->config[RADIO_BANK_APPLIED][RADIO_OPMODE];
-	}
+	(void) radio;
+	(void) opmode;
 
 	/* Restrict requested settings to valid ranges. */
 	if (requested_img_reject != RADIO_UNSET) {
@@ -511,6 +514,37 @@ static uint32_t radio_update_frequency(radio_t* const radio, uint64_t* bank)
 		}
 	}
 
+	*out_rf = freq_rf;
+	*out_if = freq_if;
+	*out_lo = freq_lo;
+	*out_img_reject = img_reject;
+	*out_rotation = rotation;
+}
+
+/*
+ * Apply resolved frequency settings, writing only those that differ from the
+ * applied settings, and compute the precise RF they result in.
+ */
+static uint32_t apply_frequency(
+	radio_t* const radio,
+	uint64_t opmode,
+	uint64_t freq_rf,
+	uint64_t freq_if,
+	uint64_t freq_lo,
+	uint64_t img_reject,
+	uint64_t rotation)
+{
+	uint32_t changed = 0;
+	uint64_t analog_rf;
+
+	const uint64_t applied_rf = radio->config[RADIO_BANK_APPLIED][RADIO_FREQUENCY_RF];
+	const uint64_t applied_if = radio->config[RADIO_BANK_APPLIED][RADIO_FREQUENCY_IF];
+	const uint64_t applied_lo = radio->config[RADIO_BANK_APPLIED][RADIO_FREQUENCY_LO];
+	const uint64_t applied_img_reject =
+		radio->config[RADIO_BANK_APPLIED][RADIO_IMAGE_REJECT];
+	const uint64_t applied_rotation =
+		radio->config[RADIO_BANK_APPLIED][RADIO_ROTATION];
+
 	/* Apply settings. */
 	if ((freq_if != applied_if) && (freq_if != RADIO_UNSET)) {
 		freq_if = max283x_set_frequency(&max283x, freq_if, true);
@@ -565,6 +599,38 @@ static uint32_t radio_update_frequency(radio_t* const radio, uint64_t* bank)
 	return changed;
 }
 
+static uint32_t radio_update_frequency(radio_t* const radio, uint64_t* bank)
+{
+	uint64_t freq_rf = radio->config[RADIO_BANK_APPLIED][RADIO_FREQUENCY_RF];
+	uint64_t freq_if = radio->config[RADIO_BANK_APPLIED][RADIO_FREQUENCY_IF];
+	uint64_t freq_lo = radio->config[RADIO_BANK_APPLIED][RADIO_FREQUENCY_LO];
+	uint64_t img_reject = radio->config[RADIO_BANK_APPLIED][RADIO_IMAGE_REJECT];
+	uint64_t rotation = radio->config[RADIO_BANK_APPLIED][RADIO_ROTATION];
+
+	uint64_t opmode = bank[RADIO_OPMODE];
+	if (opmode == RADIO_UNSET) {
+		opmode = radio->config[RADIO_BANK_APPLIED][RADIO_OPMODE];
+	}
+
+	resolve_frequency(
+		radio,
+		bank,
+		opmode,
+		&freq_rf,
+		&freq_if,
+		&freq_lo,
+		&img_reject,
+		&rotation);
+	return apply_frequency(
+		radio,
+		opmode,
+		freq_rf,
+		freq_if,
+		freq_lo,
+		img_reject,
+		rotation);
+}
+
 static uint32_t auto_bandwidth(radio_t* const radio, uint64_t opmode)
 {
 	uint32_t offset_hz = 0;
@@ -895,6 +961,89 @@ bool radio_update(radio_t* const radio)
 	return (changed != 0);
 }
 
+void radio_tuning_compute(
+	radio_t* const radio,
+	const fp_40_24_t freq_rf,
+	radio_tuning_t* const tuning)
+{
+	uint64_t tmp_bank[RADIO_NUM_REGS];
+	nvic_disable_irq(NVIC_USB0_IRQ);
+	memcpy(&tmp_bank[0], &(radio->config[RADIO_BANK_ACTIVE][0]), sizeof(tmp_bank));
+	nvic_enable_irq(NVIC_USB0_IRQ);
+	tmp_bank[RADIO_FREQUENCY_RF] = freq_rf;
+
+	uint64_t rf = radio->config[RADIO_BANK_APPLIED][RADIO_FREQUENCY_RF];
+	uint64_t freq_if = radio->config[RADIO_BANK_APPLIED][RADIO_FREQUENCY_IF];
+	uint64_t freq_lo = radio->config[RADIO_BANK_APPLIED][RADIO_FREQUENCY_LO];
+	uint64_t img_reject = radio->config[RADIO_BANK_APPLIED][RADIO_IMAGE_REJECT];
+	uint64_t rotation = radio->config[RADIO_BANK_APPLIED][RADIO_ROTATION];
+
+	uint64_t opmode = tmp_bank[RADIO_OPMODE];
+	if (opmode == RADIO_UNSET) {
+		opmode = radio->config[RADIO_BANK_APPLIED][RADIO_OPMODE];
+	}
+
+	resolve_frequency(
+		radio,
+		&tmp_bank[0],
+		opmode,
+		&rf,
+		&freq_if,
+		&freq_lo,
+		&img_reject,
+		&rotation);
+	tuning->freq_if = freq_if;
+	tuning->freq_lo = freq_lo;
+	tuning->img_reject = img_reject;
+	tuning->rotation = rotation >> 30;
+}
+
+bool radio_tuning_apply(
+	radio_t* const radio,
+	const fp_40_24_t freq_rf,
+	const radio_tuning_t* const tuning)
+{
+	uint64_t tmp_bank[RADIO_NUM_REGS];
+	uint32_t changed;
+
+	/*
+	 * Pending changes to the sample rate or frequency settings may change
+	 * the result, so those must go through radio_update() instead.
+	 */
+	nvic_disable_irq(NVIC_USB0_IRQ);
+	if (radio->regs_dirty &
+	    (RADIO_REG_GROUP_RATE | RADIO_REG_GROUP_FREQ | (1 << RADIO_OPMODE))) {
+		nvic_enable_irq(NVIC_USB0_IRQ);
+		return false;
+	}
+	radio->config[RADIO_BANK_ACTIVE][RADIO_FREQUENCY_RF] = freq_rf;
+	memcpy(&tmp_bank[0], &(radio->config[RADIO_BANK_ACTIVE][0]), sizeof(tmp_bank));
+	nvic_enable_irq(NVIC_USB0_IRQ);
+
+	uint64_t opmode = tmp_bank[RADIO_OPMODE];
+	if (opmode == RADIO_UNSET) {
+		opmode = radio->config[RADIO_BANK_APPLIED][RADIO_OPMODE];
+	}
+
+	changed = apply_frequency(
+		radio,
+		opmode,
+		freq_rf,
+		tuning->freq_if,
+		tuning->freq_lo,
+		tuning->img_reject,
+		(uint64_t) tuning->rotation << 30);
+	if ((detected_platform() == BOARD_ID_PRALINE) &&
+	    (changed & RADIO_REG_GROUP_FREQ)) {
+		changed |= radio_update_bandwidth(radio, &tmp_bank[0]);
+	}
+
+	if (radio->update_cb) {
+		radio->update_cb(changed);
+	}
+	return true;
+}
+
 void radio_switch_opmode(radio_t* const radio, const transceiver_mode_t mode)
 {
 	radio_register_bank_t source_bank;
@@ -254,6 +254,38 @@ uint64_t radio_reg_read(
  */
 bool radio_update(radio_t* const radio);
 
+/**
+ * Frequency settings resolved for one RF frequency by radio_tuning_compute().
+ */
+typedef struct {
+	fp_40_24_t freq_if;
+	fp_40_24_t freq_lo;
+	uint8_t img_reject;
+	/* Rotation in quarter turns. */
+	uint8_t rotation;
+} radio_tuning_t;
+
+/**
+ * Resolve the IF, LO, image reject path and rotation for tuning to an RF
+ * frequency (as seen by MCU/host) in 1/(2**24) Hz, given the other settings
+ * currently requested and applied. The hardware is not touched.
+ */
+void radio_tuning_compute(
+	radio_t* const radio,
+	const fp_40_24_t freq_rf,
+	radio_tuning_t* const tuning);
+
+/**
+ * Tune to an RF frequency using settings from radio_tuning_compute(), as if
+ * freq_rf had been written to RADIO_BANK_ACTIVE and applied by radio_update().
+ * Return false without changing anything if sample rate, frequency or
+ * operating mode changes are pending, as the settings may no longer be valid.
+ */
+bool radio_tuning_apply(
+	radio_t* const radio,
+	const fp_40_24_t freq_rf,
+	const radio_tuning_t* const tuning);
+
 /**
  * Switch to a new operating mode and apply complete configuration stored in
  * the request bank for the new mode.
@@ -0,0 +1,293 @@
+/*
+ * Copyright 2026 Great Scott Gadgets <info@greatscottgadgets.com>
+ *
+ * This file is part of HackRF.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "spectrum.h"
+
+#if defined(__ARM_FEATURE_SIMD32) && __ARM_FEATURE_SIMD32
+	#include <arm_acle.h>
+#endif
+
+/*
+ * Complex values are packed into 32-bit words, the real part in the lower
+ * half and the imaginary part in the upper half, so that the Cortex-M4 DSP
+ * instructions can work on both parts at once. Samples enter the FFT as Q14
+ * so that no component can overflow, even for a full-scale input at 45
+ * degrees, and every stage of the FFT halves its outputs.
+ */
+typedef int32_t complex_q15_t;
+
+/* Power of a full-scale input: (2^14)^2. */
+#define FULL_SCALE_LOG2 28
+/* 100 * 10 * log10(2), scaled by 256 for Q8 logarithms. */
+#define CENTI_DB_PER_LOG2_NUM 30103
+#define CENTI_DB_PER_LOG2_DEN 25600
+
+#define QUARTER_WAVE (SPECTRUM_MAX_FFT_SIZE / 4)
+
+/* sin(2 * pi * k / SPECTRUM_MAX_FFT_SIZE) in Q15, for the first quarter wave. */
+static const int16_t sine_table[QUARTER_WAVE + 1] = {
+	0,     804,   1608,  2411,  3212,  4011,  4808,  5602,  6393,  7180,  7962,
+	8740,  9512,  10279, 11039, 11793, 12540, 13279, 14010, 14733, 15447, 16151,
+	16846, 17531, 18205, 18868, 19520, 20160, 20788, 21403, 22006, 22595, 23170,
+	23732, 24279, 24812, 25330, 25833, 26320, 26791, 27246, 27684, 28106, 28511,
+	28899, 29269, 29622, 29957, 30274, 30572, 30853, 31114, 31357, 31581, 31786,
+	31972, 32138, 32286, 32413, 32522, 32610, 32679, 32729, 32758, 32767,
+};
+
+static uint32_t fft_size = 0;
+static uint32_t averaged = 0;
+static int16_t window[SPECTRUM_MAX_FFT_SIZE];
+static complex_q15_t twiddle[SPECTRUM_MAX_FFT_SIZE / 2];
+static uint8_t bit_reverse[SPECTRUM_MAX_FFT_SIZE];
+static complex_q15_t fft_buffer[SPECTRUM_MAX_FFT_SIZE];
+static uint64_t power[SPECTRUM_MAX_FFT_SIZE];
+
+static inline complex_q15_t pack(const int32_t re, const int32_t im)
+{
+	return (complex_q15_t) (((uint32_t) im << 16) | ((uint32_t) re & 0xffff));
+}
+
+#if defined(__ARM_FEATURE_SIMD32) && __ARM_FEATURE_SIMD32
+static inline complex_q15_t halving_add(const complex_q15_t a, const complex_q15_t b)
+{
+	return __shadd16(a, b);
+}
+
+static inline complex_q15_t halving_sub(const complex_q15_t a, const complex_q15_t b)
+{
+	return __shsub16(a, b);
+}
+
+/* Real part of a * b. */
+static inline int32_t mul_real(const complex_q15_t a, const complex_q15_t b)
+{
+	return __smusd(a, b);
+}
+
+/* Imaginary part of a * b. */
+static inline int32_t mul_imag(const complex_q15_t a, const complex_q15_t b)
+{
+	return __smuadx(a, b);
+}
+
+static inline uint32_t magnitude_squared(const complex_q15_t a)
+{
+	return __smuad(a, a);
+}
+#else
+static inline int32_t real(const complex_q15_t a)
+{
+	return (int16_t) (a & 0xffff);
+}
+
+static inline int32_t imag(const complex_q15_t a)
+{
+	return (int16_t) ((uint32_t) a >> 16);
+}
+
+static inline complex_q15_t halving_add(const complex_q15_t a, const complex_q15_t b)
+{
+	return pack((real(a) + real(b)) >> 1, (imag(a) + imag(b)) >> 1);
+}
+
+static inline complex_q15_t halving_sub(const complex_q15_t a, const complex_q15_t b)
+{
+	return pack((real(a) - real(b)) >> 1, (imag(a) - imag(b)) >> 1);
+}
+
+static inline int32_t mul_real(const complex_q15_t a, const complex_q15_t b)
+{
+	return real(a) * real(b) - imag(a) * imag(b);
+}
+
+static inline int32_t mul_imag(const complex_q15_t a, const complex_q15_t b)
+{
+	return real(a) * imag(b) + imag(a) * real(b);
+}
+
+static inline uint32_t magnitude_squared(const complex_q15_t a)
+{
+	return real(a) * real(a) + imag(a) * imag(a);
+}
+#endif
+
+/* a * b, for b in Q15. */
+static inline complex_q15_t multiply(const complex_q15_t a, const complex_q15_t b)
+{
+	return pack(mul_real(a, b) >> 15, mul_imag(a, b) >> 15);
+}
+
+/* sin(2 * pi * k / SPECTRUM_MAX_FFT_SIZE) in Q15. */
+static int32_t sine(uint32_t k)
+{
+	k &= SPECTRUM_MAX_FFT_SIZE - 1;
+	if (k <= QUARTER_WAVE) {
+		return sine_table[k];
+	} else if (k <= 2 * QUARTER_WAVE) {
+		return sine_table[2 * QUARTER_WAVE - k];
+	} else if (k <= 3 * QUARTER_WAVE) {
+		return -sine_table[k - 2 * QUARTER_WAVE];
+	} else {
+		return -sine_table[4 * QUARTER_WAVE - k];
+	}
+}
+
+/* log2(x) in Q8, for x > 0. */
+static int32_t log2_q8(const uint64_t x)
+{
+	const int32_t exponent = 63 - __builtin_clzll(x);
+	uint32_t mantissa; // [1, 2) in Q30
+	int32_t result = exponent << 8;
+	int bit;
+
+	if (exponent >= 30) {
+		mantissa = x >> (exponent - 30);
+	} else {
+		mantissa = x << (30 - exponent);
+	}
+	// Each squaring of the mantissa yields the next fractional bit.
+	for (bit = 7; bit >= 0; bit--) {
+		mantissa = ((uint64_t) mantissa * mantissa) >> 30;
+		if (mantissa >= (1UL << 31)) {
+			mantissa >>= 1;
+			result |= 1 << bit;
+		}
+	}
+	return result;
+}
+
+bool spectrum_init(const uint32_t new_fft_size)
+{
+	uint32_t step, i, bits, reversed;
+
+	if ((new_fft_size < SPECTRUM_MIN_FFT_SIZE) ||
+	    (new_fft_size > SPECTRUM_MAX_FFT_SIZE) ||
+	    (new_fft_size & (new_fft_size - 1))) {
+		return false;
+	}
+	fft_size = new_fft_size;
+	step = SPECTRUM_MAX_FFT_SIZE / fft_size;
+
+	for (i = 0; i < fft_size; i++) {
+		// Hann window, (1 - cos(2 * pi * i / fft_size)) / 2.
+		window[i] = (32768 - sine(i * step + QUARTER_WAVE)) >> 1;
+
+		reversed = 0;
+		for (bits = 1; bits < fft_size; bits <<= 1) {
+			reversed = (reversed << 1) | ((i & bits) ? 1 : 0);
+		}
+		bit_reverse[i] = reversed;
+	}
+	for (i = 0; i < fft_size / 2; i++) {
+		// exp(-2j * pi * i / fft_size)
+		twiddle[i] = pack(sine(i * step + QUARTER_WAVE), -sine(i * step));
+	}
+
+	spectrum_clear();
+	return true;
+}
+
+void spectrum_clear(void)
+{
+	uint32_t i;
+
+	if (fft_size == 0) {
+		spectrum_init(SPECTRUM_MAX_FFT_SIZE);
+		return;
+	}
+	for (i = 0; i < fft_size; i++) {
+		power[i] = 0;
+	}
+	averaged = 0;
+}
+
+uint32_t spectrum_fft_size(void)
+{
+	return fft_size;
+}
+
+/* Radix-2 decimation in time FFT of fft_buffer, in bit-reversed order. */
+static void fft(void)
+{
+	uint32_t half, stride, start, i;
+	complex_q15_t a, b, t;
+
+	for (half = 1, stride = fft_size / 2; half < fft_size; half <<= 1, stride >>= 1) {
+		for (start = 0; start < fft_size; start += 2 * half) {
+			for (i = 0; i < half; i++) {
+				a = fft_buffer[start + i];
+				b = fft_buffer[start + i + half];
+				t = multiply(b, twiddle[i * stride]);
+				fft_buffer[start + i] = halving_add(a, t);
+				fft_buffer[start + i + half] = halving_sub(a, t);
+			}
+		}
+	}
+}
+
+void spectrum_add(const int8_t* const samples, const uint32_t sample_count)
+{
+	const int8_t* segment;
+	int32_t re, im;
+	uint32_t i;
+
+	for (segment = samples; segment + fft_size * 2 <= samples + sample_count * 2;
+	     segment += fft_size * 2) {
+		// Window 8-bit samples into Q14.
+		for (i = 0; i < fft_size; i++) {
+			re = (segment[i * 2] * window[i]) >> 8;
+			im = (segment[i * 2 + 1] * window[i]) >> 8;
+			fft_buffer[bit_reverse[i]] = pack(re, im);
+		}
+		fft();
+		for (i = 0; i < fft_size; i++) {
+			power[i] += magnitude_squared(fft_buffer[i]);
+		}
+		averaged++;
+	}
+}
+
+uint32_t spectrum_result(int16_t* const bins)
+{
+	const uint32_t count = averaged;
+	int32_t reference = 0;
+	int32_t level;
+	uint32_t i, bin;
+
+	if (count > 0) {
+		// The FFT scales its outputs by 1 / fft_size, so a full-scale
+		// tone in a bin has the power of a full-scale input.
+		reference = log2_q8(count) + (FULL_SCALE_LOG2 << 8);
+	}
+	for (i = 0; i < fft_size; i++) {
+		// Negative frequencies first.
+		bin = (i + fft_size / 2) & (fft_size - 1);
+		if ((count == 0) || (power[bin] == 0)) {
+			bins[i] = SPECTRUM_NO_POWER;
+		} else {
+			level = log2_q8(power[bin]) - reference;
+			bins[i] = level * CENTI_DB_PER_LOG2_NUM / CENTI_DB_PER_LOG2_DEN;
+		}
+		power[bin] = 0;
+	}
+	averaged = 0;
+	return count;
+}
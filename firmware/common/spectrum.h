@@ -0,0 +1,58 @@
+/*
+ * Copyright 2026 Great Scott Gadgets <info@greatscottgadgets.com>
+ *
+ * This file is part of HackRF.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SPECTRUM_MIN_FFT_SIZE 16
+#define SPECTRUM_MAX_FFT_SIZE 256
+/* Reported for bins that received no power at all. */
+#define SPECTRUM_NO_POWER INT16_MIN
+
+/*
+ * Averaged power spectra of 8-bit IQ samples, using a Hann windowed
+ * fixed-point FFT.
+ */
+
+/* Select the FFT size, a power of two, and clear the average. */
+bool spectrum_init(const uint32_t fft_size);
+
+uint32_t spectrum_fft_size(void);
+
+/* Clear the average, first selecting the largest FFT if none was. */
+void spectrum_clear(void);
+
+/*
+ * Add the spectra of consecutive FFT-sized segments of interleaved I/Q
+ * samples to the average. Samples left over after the last whole segment
+ * are ignored.
+ */
+void spectrum_add(const int8_t* const samples, const uint32_t sample_count);
+
+/*
+ * Write the average as fft_size bins of power in hundredths of a dB relative
+ * to full scale, from the lowest frequency to the highest, and clear it. The
+ * window puts a full-scale tone centred on a bin at about -6 dB. Returns the
+ * number of FFTs averaged.
+ */
+uint32_t spectrum_result(int16_t* const bins);
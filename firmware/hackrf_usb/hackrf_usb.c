@@ -182,6 +182,11 @@ static usb_request_handler_fn vendor_request_handler[] = {
 	usb_vendor_request_write_radio_reg,
 	usb_vendor_request_read_radio_reg,
 	usb_vendor_request_get_buffer_size,
+	usb_vendor_request_init_sweep_timed,
+	usb_vendor_request_set_hop_table,
+	usb_vendor_request_init_hop_sweep,
+	usb_vendor_request_init_spectrum,
+	usb_vendor_request_operacake_set_sweep_ports,
 };
 
 static const uint32_t vendor_request_handler_count =
@@ -631,6 +636,9 @@ int main(void)
 		case TRANSCEIVER_MODE_RX_SWEEP:
 			sweep_mode(request.seq);
 			break;
+		case TRANSCEIVER_MODE_RX_SPECTRUM:
+			spectrum_mode(request.seq);
+			break;
 		case TRANSCEIVER_MODE_CPLD_UPDATE:
 #ifdef IS_NOT_PRALINE
 			if (IS_NOT_PRALINE) {
@@ -182,3 +182,27 @@ usb_request_status_t usb_vendor_request_operacake_set_dwell_times(
 	}
 	return USB_REQUEST_STATUS_OK;
 }
+
+usb_request_status_t usb_vendor_request_operacake_set_sweep_ports(
+	usb_endpoint_t* const endpoint,
+	const usb_transfer_stage_t stage)
+{
+	if (stage == USB_TRANSFER_STAGE_SETUP) {
+		if ((endpoint->setup.length == 0) ||
+		    (endpoint->setup.length > MAX_OPERACAKE_SWEEP_PORTS)) {
+			return USB_REQUEST_STATUS_STALL;
+		}
+		usb_transfer_schedule_block(
+			endpoint->out,
+			&data,
+			endpoint->setup.length,
+			NULL,
+			NULL);
+	} else if (stage == USB_TRANSFER_STAGE_DATA) {
+		if (operacake_set_sweep_ports(data, endpoint->setup.length)) {
+			return USB_REQUEST_STATUS_STALL;
+		}
+		usb_transfer_schedule_ack(endpoint->in);
+	}
+	return USB_REQUEST_STATUS_OK;
+}
@@ -52,3 +52,7 @@ usb_request_status_t usb_vendor_request_operacake_get_mode(
 usb_request_status_t usb_vendor_request_operacake_set_dwell_times(
 	usb_endpoint_t* const endpoint,
 	const usb_transfer_stage_t stage);
+
+usb_request_status_t usb_vendor_request_operacake_set_sweep_ports(
+	usb_endpoint_t* const endpoint,
+	const usb_transfer_stage_t stage);
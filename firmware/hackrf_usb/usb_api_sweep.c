@@ -28,10 +28,12 @@
 #include <fixed_point.h>
 #include <hackrf_ui.h>
 #include <m0_state.h>
+#include <operacake.h>
 #include <platform_detect.h>
 #include <radio.h>
 #include <rf_path.h>
 #include <sgpio.h>
+#include <spectrum.h>
 #include <streaming.h>
 #include <transceiver_mode.h>
 #include <usb_queue.h>
@@ -48,18 +50,48 @@
 #define FREQ_GRANULARITY 1000000
 #define MAX_RANGES       10
 
+#define DEFAULT_BLOCK_SIZE 0x4000
+#define MIN_BLOCK_SIZE     0x400
+#define TIMING_LENGTH      8 /* block size and settle time before the sweep plan */
+#define MAX_SETTLE_SAMPLES 0x1000000
+/* The M0 counts bytes 32 at a time, so thresholds must be multiples of 32. */
+#define M0_COUNT_STEP 32
+/* Lead on the M0 when setting a threshold, for the M4 to store it in time. */
+#define MIN_LEAD 0x200
+/* Sweep steps with tuning resolved before the sweep starts. */
+#define TUNING_CACHE_SIZE 256
+/* Hop table entries: a little-endian 64-bit frequency in Hz and 16-bit dwell. */
+#define MAX_HOPS           512
+#define HOP_ENTRY_LENGTH   10
+#define MAX_HOP_CHUNK      24 /* entries per SET_HOP_TABLE request */
+#define HOP_FREQ_LIMIT     (1ULL << 48)
+/* Spectrum records: the sweep block header, an FFT count, then the bins. */
+#define SPECTRUM_HEADER_LENGTH 16
+#define SPECTRUM_RECORD_SLOT   0x400
+
 static uint64_t sweep_freq;
 static uint16_t frequencies[MAX_RANGES * 2];
-static unsigned char data[9 + MAX_RANGES * 2 * sizeof(frequencies[0])];
+static unsigned char data[TIMING_LENGTH + 9 + MAX_RANGES * 2 * sizeof(frequencies[0])];
 static uint16_t num_ranges = 0;
 static uint32_t dwell_blocks = 0;
 static uint32_t step_width = 0;
 static uint32_t offset = 0;
-static uint32_t throwaway_buffers = 0;
+static uint32_t block_size = DEFAULT_BLOCK_SIZE;
+static uint32_t settle_bytes = 0;
 static enum sweep_style style = LINEAR;
 static bool freq_ui_dirty = false;
 static bool img_reject_ui_dirty = false;
 static rf_path_filter_t img_reject;
+static radio_tuning_t tuning_cache[TUNING_CACHE_SIZE];
+static uint32_t tuning_cache_length = 0;
+static uint64_t hop_freqs[MAX_HOPS];
+static uint16_t hop_dwell[MAX_HOPS];
+static unsigned char hop_data[MAX_HOP_CHUNK * HOP_ENTRY_LENGTH];
+static uint16_t hops_loaded = 0;
+/* Number of hops walked in place of the sweep plan, or 0 for the plan. */
+static uint16_t num_hops = 0;
+static uint16_t hop = 0;
+static uint32_t spectrum_records = 0;
 
 /*
  * Opportunistic UI updates are made when time is available. Updates are
@@ -83,26 +115,56 @@ void update_ui(void)
 	}
 }
 
-/* Do this before starting sweep mode with request_transceiver_mode(). */
-usb_request_status_t usb_vendor_request_init_sweep(
-	usb_endpoint_t* const endpoint,
-	const usb_transfer_stage_t stage)
+static uint32_t get_le32(const unsigned char* p)
 {
-	if (detected_platform() == BOARD_ID_PRALINE) {
-		throwaway_buffers = 1;
-	} else {
-		throwaway_buffers = 2;
+	return ((uint32_t) (p[3]) << 24) | ((uint32_t) (p[2]) << 16) |
+		((uint32_t) (p[1]) << 8) | p[0];
+}
+
+static uint64_t get_le64(const unsigned char* p)
+{
+	return ((uint64_t) get_le32(&p[4]) << 32) | get_le32(&p[0]);
+}
+
+/* Set the block size and the settle time in samples, false if invalid. */
+static bool set_timing(const unsigned char* const timing)
+{
+	const uint32_t new_block_size = get_le32(&timing[0]);
+	const uint32_t settle_samples = get_le32(&timing[4]);
+
+	// Blocks must not wrap around the end of the sample buffer.
+	if ((new_block_size < MIN_BLOCK_SIZE) || (new_block_size > DEFAULT_BLOCK_SIZE) ||
+	    (new_block_size & (new_block_size - 1)) ||
+	    (settle_samples > MAX_SETTLE_SAMPLES) ||
+	    ((settle_samples * 2) % M0_COUNT_STEP)) {
+		return false;
 	}
+	block_size = new_block_size;
+	settle_bytes = settle_samples * 2;
+	return true;
+}
 
+/*
+ * The sweep plan is preceded by the block size and the settle time in
+ * samples with timing_length set, otherwise the defaults are used: 16K blocks,
+ * with two blocks (one on Praline) discarded after each block.
+ */
+static usb_request_status_t init_sweep(
+	usb_endpoint_t* const endpoint,
+	const usb_transfer_stage_t stage,
+	const uint32_t timing_length)
+{
+	const unsigned char* const plan = &data[timing_length];
 	uint32_t num_bytes;
 	int i;
+
 	if (stage == USB_TRANSFER_STAGE_SETUP) {
-		num_bytes = (endpoint->setup.index << 16) | endpoint->setup.value;
-		dwell_blocks = num_bytes / 0x4000;
-		if (1 > dwell_blocks) {
+		if ((endpoint->setup.length < timing_length + 9) ||
+		    (endpoint->setup.length > sizeof(data))) {
 			return USB_REQUEST_STATUS_STALL;
 		}
-		num_ranges = (endpoint->setup.length - 9) / (2 * sizeof(frequencies[0]));
+		num_ranges = (endpoint->setup.length - timing_length - 9) /
+			(2 * sizeof(frequencies[0]));
 		if ((1 > num_ranges) || (MAX_RANGES < num_ranges)) {
 			return USB_REQUEST_STATUS_STALL;
 		}
@@ -113,22 +175,37 @@ usb_request_status_t usb_vendor_request_init_sweep(
 			NULL,
 			NULL);
 	} else if (stage == USB_TRANSFER_STAGE_DATA) {
-		step_width = ((uint32_t) (data[3]) << 24) | ((uint32_t) (data[2]) << 16) |
-			((uint32_t) (data[1]) << 8) | data[0];
+		if (timing_length > 0) {
+			if (!set_timing(&data[0])) {
+				return USB_REQUEST_STATUS_STALL;
+			}
+		} else if (detected_platform() == BOARD_ID_PRALINE) {
+			block_size = DEFAULT_BLOCK_SIZE;
+			settle_bytes = DEFAULT_BLOCK_SIZE;
+		} else {
+			block_size = DEFAULT_BLOCK_SIZE;
+			settle_bytes = 2 * DEFAULT_BLOCK_SIZE;
+		}
+		num_bytes = (endpoint->setup.index << 16) | endpoint->setup.value;
+		dwell_blocks = num_bytes / block_size;
+		if (1 > dwell_blocks) {
+			return USB_REQUEST_STATUS_STALL;
+		}
+		step_width = get_le32(&plan[0]);
 		if (1 > step_width) {
 			return USB_REQUEST_STATUS_STALL;
 		}
-		offset = ((uint32_t) (data[7]) << 24) | ((uint32_t) (data[6]) << 16) |
-			((uint32_t) (data[5]) << 8) | data[4];
-		style = data[8];
+		offset = get_le32(&plan[4]);
+		style = plan[8];
 		if (INTERLEAVED < style) {
 			return USB_REQUEST_STATUS_STALL;
 		}
 		for (i = 0; i < (num_ranges * 2); i++) {
 			frequencies[i] =
-				((uint16_t) (data[10 + i * 2]) << 8) + data[9 + i * 2];
+				((uint16_t) (plan[10 + i * 2]) << 8) + plan[9 + i * 2];
 		}
 		sweep_freq = (uint64_t) frequencies[0] * FREQ_GRANULARITY;
+		num_hops = 0;
 
 		radio_reg_write(
 			&radio,
@@ -140,55 +217,413 @@ usb_request_status_t usb_vendor_request_init_sweep(
 	return USB_REQUEST_STATUS_OK;
 }
 
+/* Do this before starting sweep mode with request_transceiver_mode(). */
+usb_request_status_t usb_vendor_request_init_sweep(
+	usb_endpoint_t* const endpoint,
+	const usb_transfer_stage_t stage)
+{
+	return init_sweep(endpoint, stage, 0);
+}
+
+/* As usb_vendor_request_init_sweep(), with the block size and settle time. */
+usb_request_status_t usb_vendor_request_init_sweep_timed(
+	usb_endpoint_t* const endpoint,
+	const usb_transfer_stage_t stage)
+{
+	return init_sweep(endpoint, stage, TIMING_LENGTH);
+}
+
+/*
+ * Load up to MAX_HOP_CHUNK hop table entries, starting at the index in
+ * wValue. Chunks must be loaded in order, starting from index 0.
+ */
+usb_request_status_t usb_vendor_request_set_hop_table(
+	usb_endpoint_t* const endpoint,
+	const usb_transfer_stage_t stage)
+{
+	const uint16_t first = endpoint->setup.value;
+	const uint16_t count = endpoint->setup.length / HOP_ENTRY_LENGTH;
+	const unsigned char* entry;
+	int i;
+
+	if (stage == USB_TRANSFER_STAGE_SETUP) {
+		if ((count < 1) || (count > MAX_HOP_CHUNK) ||
+		    (endpoint->setup.length % HOP_ENTRY_LENGTH) || (first > hops_loaded) ||
+		    (first + count > MAX_HOPS)) {
+			return USB_REQUEST_STATUS_STALL;
+		}
+		usb_transfer_schedule_block(
+			endpoint->out,
+			&hop_data,
+			endpoint->setup.length,
+			NULL,
+			NULL);
+	} else if (stage == USB_TRANSFER_STAGE_DATA) {
+		for (i = 0; i < count; i++) {
+			entry = &hop_data[i * HOP_ENTRY_LENGTH];
+			// The upper bytes of the block header carry the hop index.
+			if ((get_le64(&entry[0]) >= HOP_FREQ_LIMIT) ||
+			    ((entry[8] | entry[9]) == 0)) {
+				return USB_REQUEST_STATUS_STALL;
+			}
+		}
+		// A new table starts at index 0.
+		if (first == 0) {
+			hops_loaded = 0;
+		}
+		for (i = 0; i < count; i++) {
+			entry = &hop_data[i * HOP_ENTRY_LENGTH];
+			hop_freqs[first + i] = get_le64(&entry[0]);
+			hop_dwell[first + i] = ((uint16_t) (entry[9]) << 8) | entry[8];
+		}
+		hops_loaded = MAX(hops_loaded, first + count);
+		usb_transfer_schedule_ack(endpoint->in);
+	}
+	return USB_REQUEST_STATUS_OK;
+}
+
+/*
+ * Walk the first wValue entries of the hop table in sweep mode, instead of a
+ * sweep plan. The data is the block size and settle time, as for
+ * usb_vendor_request_init_sweep_timed(), followed by a 32-bit offset in Hz
+ * added to every frequency when tuning. Do this before starting sweep mode
+ * with request_transceiver_mode().
+ */
+usb_request_status_t usb_vendor_request_init_hop_sweep(
+	usb_endpoint_t* const endpoint,
+	const usb_transfer_stage_t stage)
+{
+	if (stage == USB_TRANSFER_STAGE_SETUP) {
+		if ((endpoint->setup.value < 1) || (endpoint->setup.value > hops_loaded) ||
+		    (endpoint->setup.length != TIMING_LENGTH + 4)) {
+			return USB_REQUEST_STATUS_STALL;
+		}
+		usb_transfer_schedule_block(
+			endpoint->out,
+			&data,
+			endpoint->setup.length,
+			NULL,
+			NULL);
+	} else if (stage == USB_TRANSFER_STAGE_DATA) {
+		if (!set_timing(&data[0])) {
+			return USB_REQUEST_STATUS_STALL;
+		}
+		offset = get_le32(&data[TIMING_LENGTH]);
+		num_hops = endpoint->setup.value;
+		hop = 0;
+		sweep_freq = hop_freqs[0];
+
+		radio_reg_write(
+			&radio,
+			RADIO_BANK_ACTIVE,
+			RADIO_FREQUENCY_RF,
+			(sweep_freq + offset) * FP_ONE_HZ);
+		usb_transfer_schedule_ack(endpoint->in);
+	}
+	return USB_REQUEST_STATUS_OK;
+}
+
+/*
+ * Set the FFT size for spectrum mode in wValue. Spectrum mode follows the
+ * sweep plan or hop table, so set that up first too.
+ */
+usb_request_status_t usb_vendor_request_init_spectrum(
+	usb_endpoint_t* const endpoint,
+	const usb_transfer_stage_t stage)
+{
+	if (stage == USB_TRANSFER_STAGE_SETUP) {
+		if (!spectrum_init(endpoint->setup.value)) {
+			return USB_REQUEST_STATUS_STALL;
+		}
+		usb_transfer_schedule_ack(endpoint->in);
+	}
+	return USB_REQUEST_STATUS_OK;
+}
+
 void sweep_bulk_transfer_complete(void* user_data, unsigned int bytes_transferred)
 {
-	(void) user_data;
 	(void) bytes_transferred;
 
-	// For each buffer transferred, we need to bump the count to allow
-	// for the buffer(s) that are to be discarded.
-	m0_state.m4_count += (throwaway_buffers + 1) * 0x4000;
+	// Once a block is transferred, the M0 may fill the buffer up to the
+	// earliest start of the block after it, passed as user_data.
+	m0_state.m4_count = (uint32_t) (uintptr_t) user_data;
 }
 
-void sweep_mode(uint32_t seq)
+/*
+ * The m0_count at which to start a block, at or after the given count, such
+ * that the block doesn't wrap around the end of the sample buffer.
+ */
+static uint32_t block_start(uint32_t count)
+{
+	const uint32_t position = count & USB_SAMP_BUFFER_MASK;
+
+	if (position + block_size > USB_SAMP_BUFFER_SIZE) {
+		count += USB_SAMP_BUFFER_SIZE - position;
+	}
+	return count;
+}
+
+/*
+ * The frequency of the tuning step after the one at freq, updating the range
+ * and, for interleaved sweeps, whether the step is an odd one.
+ */
+static uint64_t next_sweep_freq(uint64_t freq, uint16_t* const range, bool* const odd)
+{
+	const uint64_t range_end =
+		(uint64_t) frequencies[1 + *range * 2] * FREQ_GRANULARITY;
+
+	if (INTERLEAVED == style) {
+		if (!*odd && ((freq + step_width) >= range_end)) {
+			*range = (*range + 1) % num_ranges;
+			freq = (uint64_t) frequencies[*range * 2] * FREQ_GRANULARITY;
+		} else {
+			if (*odd) {
+				freq += step_width / 4;
+			} else {
+				freq += 3 * step_width / 4;
+			}
+		}
+		*odd = !*odd;
+	} else {
+		if ((freq + step_width) >= range_end) {
+			*range = (*range + 1) % num_ranges;
+			freq = (uint64_t) frequencies[*range * 2] * FREQ_GRANULARITY;
+		} else {
+			freq += step_width;
+		}
+	}
+	return freq;
+}
+
+/* True if the tuning step is the first of a sweep. */
+static bool sweep_restarted(const uint64_t freq, const uint16_t range, const bool odd)
+{
+	return (range == 0) && odd &&
+		(freq == (uint64_t) frequencies[0] * FREQ_GRANULARITY);
+}
+
+/*
+ * Resolve the tuning of the first steps of the sweep in advance, so that
+ * retuning only has to program the results. Later steps are tuned the usual
+ * way, as are all steps once other frequency or sample rate changes arrive.
+ */
+static void build_tuning_cache(void)
+{
+	uint64_t freq = (uint64_t) frequencies[0] * FREQ_GRANULARITY;
+	uint16_t range = 0;
+	bool odd = true;
+
+	tuning_cache_length = 0;
+	if (num_hops > 0) {
+		while ((tuning_cache_length < TUNING_CACHE_SIZE) &&
+		       (tuning_cache_length < num_hops)) {
+			radio_tuning_compute(
+				&radio,
+				(hop_freqs[tuning_cache_length] + offset) * FP_ONE_HZ,
+				&tuning_cache[tuning_cache_length]);
+			tuning_cache_length++;
+		}
+		return;
+	}
+	do {
+		radio_tuning_compute(
+			&radio,
+			(freq + offset) * FP_ONE_HZ,
+			&tuning_cache[tuning_cache_length++]);
+		freq = next_sweep_freq(freq, &range, &odd);
+	} while ((tuning_cache_length < TUNING_CACHE_SIZE) &&
+		 !sweep_restarted(freq, range, odd));
+}
+
+/*
+ * Move on to the next tuning step of the hop table or sweep plan and retune,
+ * from the tuning cache if possible.
+ */
+static void next_step(
+	uint32_t* const step,
+	uint32_t* const step_dwell,
+	uint16_t* const range,
+	bool* const odd)
+{
+	if (num_hops > 0) {
+		hop = (hop + 1) % num_hops;
+		sweep_freq = hop_freqs[hop];
+		*step = hop;
+		*step_dwell = hop_dwell[hop];
+	} else {
+		sweep_freq = next_sweep_freq(sweep_freq, range, odd);
+		if (sweep_restarted(sweep_freq, *range, *odd)) {
+			*step = 0;
+		} else if (*step < TUNING_CACHE_SIZE) {
+			(*step)++;
+		}
+	}
+	if ((*step >= tuning_cache_length) ||
+	    !radio_tuning_apply(
+		    &radio,
+		    (sweep_freq + offset) * FP_ONE_HZ,
+		    &tuning_cache[*step])) {
+		// Pending radio changes may invalidate the cache.
+		if (*step < tuning_cache_length) {
+			tuning_cache_length = 0;
+		}
+		nvic_disable_irq(NVIC_USB0_IRQ);
+		radio_reg_write(
+			&radio,
+			RADIO_BANK_ACTIVE,
+			RADIO_FREQUENCY_RF,
+			(sweep_freq + offset) * FP_ONE_HZ);
+		nvic_enable_irq(NVIC_USB0_IRQ);
+	}
+	radio_update(&radio);
+	freq_ui_dirty = true;
+	img_reject_ui_dirty = true;
+}
+
+/* Switch Opera Cake sweep ports, keeping USB requests off the I2C bus. */
+static uint8_t select_sweep_port(const uint8_t index)
+{
+	uint8_t port;
+
+	nvic_disable_irq(NVIC_USB0_IRQ);
+	port = operacake_select_sweep_port(index);
+	nvic_enable_irq(NVIC_USB0_IRQ);
+	return port;
+}
+
+/* Write the sweep block header: magic, frequency and m0_count. */
+static void write_header(uint8_t* const buffer, const uint64_t freq, const uint32_t count)
+{
+	buffer[0] = 0x7f;
+	buffer[1] = 0x7f;
+	buffer[2] = freq & 0xff;
+	buffer[3] = (freq >> 8) & 0xff;
+	buffer[4] = (freq >> 16) & 0xff;
+	buffer[5] = (freq >> 24) & 0xff;
+	buffer[6] = (freq >> 32) & 0xff;
+	buffer[7] = (freq >> 40) & 0xff;
+	buffer[8] = (freq >> 48) & 0xff;
+	buffer[9] = (freq >> 56) & 0xff;
+	buffer[10] = count & 0xff;
+	buffer[11] = (count >> 8) & 0xff;
+	buffer[12] = (count >> 16) & 0xff;
+	buffer[13] = (count >> 24) & 0xff;
+}
+
+/*
+ * Send the averaged spectrum of a dwell from the bulk buffer. The bulk IN
+ * queue holds a single transfer, so scheduling a record waits for the one
+ * before it, and two slots are enough.
+ */
+static void send_spectrum(const uint64_t freq, const uint32_t count)
+{
+	uint8_t* const record =
+		&usb_bulk_buffer[(spectrum_records++ & 1) * SPECTRUM_RECORD_SLOT];
+	int16_t* const bins = (int16_t*) &record[SPECTRUM_HEADER_LENGTH];
+	const uint32_t averaged = MIN(spectrum_result(bins), UINT16_MAX);
+
+	write_header(record, freq, count);
+	record[14] = averaged & 0xff;
+	record[15] = (averaged >> 8) & 0xff;
+	// Records are never a multiple of the packet size, so each one ends
+	// with a short packet and completes a transfer on the host.
+	usb_transfer_schedule_block(
+		&usb_endpoint_bulk_in,
+		record,
+		SPECTRUM_HEADER_LENGTH + spectrum_fft_size() * sizeof(int16_t),
+		NULL,
+		NULL);
+}
+
+/*
+ * With spectrum set, each dwell is reduced to its averaged power spectrum on
+ * the M4, and only that is sent to the host.
+ */
+static void sweep(const uint32_t seq, const bool spectrum)
 {
 	// Sweep mode is implemented using timed M0 operations, as follows:
 	//
 	// 0. M4 initially puts the M0 into RX mode, with an m0_count threshold
-	//    of 16K and a next mode of WAIT.
+	//    of one block and a next mode of WAIT.
 	//
 	// 1. M4 spins until the M0 switches to WAIT mode.
 	//
-	// 2. M0 captures one 16K block of samples, and switches to WAIT mode.
+	// 2. M0 captures one block of samples, and switches to WAIT mode.
 	//
-	// 3. M4 sees the mode change, advances the m0_count target by 32K, and
-	//    sets next mode to RX.
+	// 3. M4 sees the mode change and adds the sweep metadata at the start
+	//    of the block. The metadata is the tuned frequency and the
+	//    m0_count at the start of the block, which lets the host timestamp
+	//    the block to the sample.
 	//
-	// 4. M4 adds the sweep metadata at the start of the block and
-	//    schedules a bulk transfer for the block.
+	// 4. M4 retunes - this takes about 760us worst-case (300us on praline).
+	//    The tuning of the first TUNING_CACHE_SIZE steps is resolved
+	//    before the sweep starts, so only the radio has to be programmed.
 	//
-	// 5. M4 retunes - this takes about 760us worst-case (300us on praline),
-	//    so should be complete before the M0 goes back to RX.
+	// 5. M4 sets the m0_count threshold to the end of the settle time
+	//    after the block, and the next mode to RX. If retuning took longer
+	//    than the settle time, the threshold is set to just ahead of the
+	//    M0 instead, so the next block is never captured while retuning.
+	//    The start of a block is also delayed if the block would otherwise
+	//    wrap around the end of the sample buffer. M4 then schedules a bulk
+	//    transfer for the block, whose completion lets the M0 fill the
+	//    buffer up to the start of the next block.
 	//
 	// 6. M4 spins until the M0 mode changes to RX, then advances the
-	//    m0_count limit by 16K and sets the next mode to WAIT.
+	//    m0_count limit by one block and sets the next mode to WAIT.
 	//
 	// 7. Process repeats from step 1.
+	//
+	// With Opera Cake boards in sweep mode, each tuning step dwells on
+	// every sweep port in turn. At the end of a dwell on any port but the
+	// last, step 4 switches to the next port instead of retuning, so the
+	// switch also happens while the M0 discards the settle time.
+	//
+	// In spectrum mode, step 3 only notes the metadata of the first block
+	// of each dwell. Instead, once the M4 has retuned in step 4, it adds
+	// the spectra of the block to the average, while the radio settles,
+	// and sends the average at the end of the dwell. The M0 may then fill
+	// the buffer up to the start of the next block, as nothing is queued.
+	// The FFTs take roughly 30-50 cycles per sample, several times the
+	// time the block took to capture, and usually more than the settle
+	// time. Step 5 then starts the next block just ahead of the M0 once
+	// they are done, so each block lengthens its dwell by the excess.
 
 	unsigned int blocks_queued = 0;
-	unsigned int phase = 0;
 	bool odd = true;
 	uint16_t range = 0;
+	uint32_t block_end, block_count, next_start;
+	uint32_t step, step_dwell;
+	uint64_t header_freq;
+	uint64_t record_freq = 0;
+	uint32_t record_count = 0;
+	bool dwell_done;
+	uint8_t num_ports, port_index = 0, port = 0;
 
 	uint8_t* buffer;
 
 	transceiver_startup(TRANSCEIVER_MODE_RX_SWEEP);
+	build_tuning_cache();
+	num_ports = operacake_sweep_port_count();
+	if (num_ports > 0) {
+		port = select_sweep_port(0);
+	}
+	if (spectrum) {
+		spectrum_clear();
+	}
+	// A restarted sweep mode may resume partway through a sweep.
+	if (num_hops > 0) {
+		step = hop;
+		step_dwell = hop_dwell[hop];
+	} else {
+		step = sweep_restarted(sweep_freq, range, odd) ? 0 : TUNING_CACHE_SIZE;
+		step_dwell = dwell_blocks;
+	}
 	hackrf_ui()->set_frequency(sweep_freq + offset);
 	img_reject = radio_reg_read(&radio, RADIO_BANK_APPLIED, RADIO_IMAGE_REJECT);
 	hackrf_ui()->set_filter(img_reject);
 
 	// Set M0 to RX first buffer, then wait.
-	m0_state.threshold = 0x4000;
+	m0_state.threshold = block_size;
 	m0_state.next_mode = M0_MODE_WAIT;
 
 	baseband_streaming_enable(&sgpio_config);
@@ -201,78 +636,75 @@ void sweep_mode(uint32_t seq)
 			}
 		}
 
-		// Set M0 to switch back to RX after we have received our
-		// discard buffers.
-		m0_state.threshold += (0x4000 * throwaway_buffers);
-		m0_state.next_mode = M0_MODE_RX;
+		// The block just received ended at the current threshold. The
+		// M0 stays in WAIT mode until a new threshold is set.
+		block_end = m0_state.threshold;
+		block_count = block_end - block_size;
 
-		// Write metadata to buffer.
-		buffer = &usb_samp_buffer[phase * 0x4000];
-		*buffer = 0x7f;
-		*(buffer + 1) = 0x7f;
-		*(buffer + 2) = sweep_freq & 0xff;
-		*(buffer + 3) = (sweep_freq >> 8) & 0xff;
-		*(buffer + 4) = (sweep_freq >> 16) & 0xff;
-		*(buffer + 5) = (sweep_freq >> 24) & 0xff;
-		*(buffer + 6) = (sweep_freq >> 32) & 0xff;
-		*(buffer + 7) = (sweep_freq >> 40) & 0xff;
-		*(buffer + 8) = (sweep_freq >> 48) & 0xff;
-		*(buffer + 9) = (sweep_freq >> 56) & 0xff;
-
-		// Set up IN transfer of buffer.
-		usb_transfer_schedule_block(
-			&usb_endpoint_bulk_in,
-			buffer,
-			0x4000,
-			sweep_bulk_transfer_complete,
-			NULL);
+		// Write metadata to buffer. With a hop table, the hop index
+		// is in bits 48-59 of the frequency, and with sweep ports,
+		// the port plus one is in bits 60-63.
+		header_freq = sweep_freq;
+		if (num_hops > 0) {
+			header_freq |= (uint64_t) hop << 48;
+		}
+		if (num_ports > 0) {
+			header_freq |= (uint64_t) (port + 1) << 60;
+		}
+		buffer = &usb_samp_buffer[block_count & USB_SAMP_BUFFER_MASK];
+		if (spectrum) {
+			if (blocks_queued == 0) {
+				record_freq = header_freq;
+				record_count = block_count;
+			}
+		} else {
+			write_header(buffer, header_freq, block_count);
+		}
 
-		// Use other buffer next time.
-		phase = (phase + 1) % throwaway_buffers;
-
-		if (++blocks_queued == dwell_blocks) {
-			// Calculate next sweep frequency.
-			if (INTERLEAVED == style) {
-				if (!odd &&
-				    ((sweep_freq + step_width) >=
-				     ((uint64_t) frequencies[1 + range * 2] *
-				      FREQ_GRANULARITY))) {
-					range = (range + 1) % num_ranges;
-					sweep_freq = (uint64_t) frequencies[range * 2] *
-						FREQ_GRANULARITY;
-				} else {
-					if (odd) {
-						sweep_freq += step_width / 4;
-					} else {
-						sweep_freq += 3 * step_width / 4;
-					}
-				}
-				odd = !odd;
+		dwell_done = (++blocks_queued == step_dwell);
+		if (dwell_done) {
+			blocks_queued = 0;
+			// Dwell on every sweep port before the next step.
+			if (++port_index < num_ports) {
+				port = select_sweep_port(port_index);
 			} else {
-				if ((sweep_freq + step_width) >=
-				    ((uint64_t) frequencies[1 + range * 2] *
-				     FREQ_GRANULARITY)) {
-					range = (range + 1) % num_ranges;
-					sweep_freq = (uint64_t) frequencies[range * 2] *
-						FREQ_GRANULARITY;
-				} else {
-					sweep_freq += step_width;
+				port_index = 0;
+				if (num_ports > 1) {
+					port = select_sweep_port(0);
 				}
+				next_step(&step, &step_dwell, &range, &odd);
 			}
-			// Retune to new frequency.
-			nvic_disable_irq(NVIC_USB0_IRQ);
-			radio_reg_write(
-				&radio,
-				RADIO_BANK_ACTIVE,
-				RADIO_FREQUENCY_RF,
-				(sweep_freq + offset) * FP_ONE_HZ);
-			nvic_enable_irq(NVIC_USB0_IRQ);
-			radio_update(&radio);
-			freq_ui_dirty = true;
-			img_reject_ui_dirty = true;
-			blocks_queued = 0;
 		}
 
+		if (spectrum) {
+			spectrum_add((const int8_t*) buffer, block_size / 2);
+			if (dwell_done) {
+				send_spectrum(record_freq, record_count);
+			}
+		}
+
+		// Set M0 to switch back to RX once the radio has settled.
+		next_start = block_end + settle_bytes;
+		if ((int32_t) (m0_state.m0_count + MIN_LEAD - next_start) > 0) {
+			next_start = m0_state.m0_count + MIN_LEAD;
+		}
+		next_start = block_start(next_start);
+		if (spectrum) {
+			m0_state.m4_count = next_start;
+		} else {
+			// Set up IN transfer of buffer. Only now is the start of
+			// the next block, up to which the M0 may then fill the
+			// buffer, known.
+			usb_transfer_schedule_block(
+				&usb_endpoint_bulk_in,
+				buffer,
+				block_size,
+				sweep_bulk_transfer_complete,
+				(void*) (uintptr_t) next_start);
+		}
+		m0_state.next_mode = M0_MODE_RX;
+		m0_state.threshold = next_start;
+
 		// Wait for M0 to resume RX.
 		while (m0_state.active_mode != M0_MODE_RX) {
 			if (transceiver_request.seq != seq) {
@@ -282,9 +714,19 @@ void sweep_mode(uint32_t seq)
 		}
 
 		// Set M0 to switch back to WAIT after filling next buffer.
-		m0_state.threshold += 0x4000;
+		m0_state.threshold += block_size;
 		m0_state.next_mode = M0_MODE_WAIT;
 	}
 end:
 	transceiver_shutdown();
 }
+
+void sweep_mode(uint32_t seq)
+{
+	sweep(seq, false);
+}
+
+void spectrum_mode(uint32_t seq)
+{
+	sweep(seq, true);
+}
@@ -36,4 +36,21 @@ usb_request_status_t usb_vendor_request_init_sweep(
 	usb_endpoint_t* const endpoint,
 	const usb_transfer_stage_t stage);
 
+usb_request_status_t usb_vendor_request_init_sweep_timed(
+	usb_endpoint_t* const endpoint,
+	const usb_transfer_stage_t stage);
+
+usb_request_status_t usb_vendor_request_set_hop_table(
+	usb_endpoint_t* const endpoint,
+	const usb_transfer_stage_t stage);
+
+usb_request_status_t usb_vendor_request_init_hop_sweep(
+	usb_endpoint_t* const endpoint,
+	const usb_transfer_stage_t stage);
+
+usb_request_status_t usb_vendor_request_init_spectrum(
+	usb_endpoint_t* const endpoint,
+	const usb_transfer_stage_t stage);
+
 void sweep_mode(uint32_t seq);
+void spectrum_mode(uint32_t seq);
@@ -408,6 +408,7 @@ usb_request_status_t usb_vendor_request_set_transceiver_mode(
 		case TRANSCEIVER_MODE_RX:
 		case TRANSCEIVER_MODE_TX:
 		case TRANSCEIVER_MODE_RX_SWEEP:
+		case TRANSCEIVER_MODE_RX_SPECTRUM:
 		case TRANSCEIVER_MODE_CPLD_UPDATE:
 			request_transceiver_mode(endpoint->setup.value);
 			usb_transfer_schedule_ack(endpoint->in);
@@ -28,7 +28,7 @@
 
 #define USB_VENDOR_ID (0x1D50)
 
-#define USB_API_VERSION (0x0112)
+#define USB_API_VERSION (0x0117)
 
 #define USB_WORD(x) (x & 0xFF), ((x >> 8) & 0xFF)
 
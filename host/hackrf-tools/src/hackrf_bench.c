@@ -0,0 +1,1407 @@
+/*
+ * Copyright 2026 Great Scott Gadgets <info@greatscottgadgets.com>
+ *
+ * This file is part of HackRF.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <hackrf.h>
+#ifdef HACKRF_BENCH_FFTW
+	#include <hackrf_sweep_engine.h>
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <math.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+	#define _USE_MATH_DEFINES
+	#include <windows.h>
+	#ifdef _MSC_VER
+		#define strtoull _strtoui64
+	#endif
+#else
+	#include <unistd.h>
+#endif
+
+#define FREQ_ONE_MHZ (1000000ull)
+
+#define DEFAULT_SECONDS         2.0
+#define DEFAULT_SAMPLE_RATE_HZ  20000000
+#define DEFAULT_FREQ_HZ         2450000000ull
+#define DEFAULT_TUNE_ITERATIONS 100
+#define DEFAULT_NUM_SAMPLES     131072 /* one 256 KiB transfer */
+#define DEFAULT_STRESS_CYCLES   240
+
+/* Stress test settings. */
+#define STRESS_TIMEOUT_S        10 /* a step taking longer than this has hung */
+#define STRESS_CALLBACK_STOP    16 /* transfers before a callback ends the stream */
+#define STRESS_CALLBACK_BUFFERS 4  /* pool size when using the callback thread */
+#define STRESS_SETTLE_MS        20 /* time to watch for late callbacks after a stop */
+
+/* Sweep settings used by hackrf_sweep. */
+#define SWEEP_SAMPLE_RATE_HZ     20000000
+#define SWEEP_BASEBAND_FILTER_HZ 15000000
+#define DEFAULT_SWEEP_MIN_MHZ    0
+#define DEFAULT_SWEEP_MAX_MHZ    6000
+#define DEFAULT_BIN_WIDTH_HZ     1000000
+
+#define MAX_INTERVALS (1 << 20)
+
+enum {
+	BENCH_RX = (1 << 0),
+	BENCH_TX = (1 << 1),
+	BENCH_TUNE = (1 << 2),
+	BENCH_SWEEP = (1 << 3),
+	BENCH_CONVERT = (1 << 4),
+	BENCH_ALL = 0x1f,
+	BENCH_STRESS = (1 << 5), /* not part of all, as it tests rather than measures */
+};
+
+static const char* bench_names[] = {"rx", "tx", "tune", "sweep", "convert", "stress"};
+
+/* Summary of a set of durations, in microseconds. */
+typedef struct {
+	uint32_t count;
+	double mean;
+	double stddev;
+	uint32_t min;
+	uint32_t p50;
+	uint32_t p99;
+	uint32_t max;
+} duration_stats_t;
+
+typedef struct {
+	int result;
+	double seconds;
+	uint64_t bytes;
+	uint64_t transfers;
+	uint32_t shortfalls;
+	duration_stats_t interval;
+	hackrf_stream_stats stream;
+} stream_result_t;
+
+typedef struct {
+	int result;
+	duration_stats_t latency;
+} tune_result_t;
+
+typedef struct {
+	int result;
+	double seconds;
+	uint64_t blocks;
+	uint64_t rows;
+	uint64_t sweeps;
+	int fft_size;
+	int num_threads;
+	hackrf_stream_stats stream;
+} sweep_result_t;
+
+/* Ways of starting and stopping a stream, cycled through by the stress test. */
+typedef enum {
+	STRESS_RX,               /* stop once transfers arrive */
+	STRESS_RX_IMMEDIATE,     /* stop straight after starting */
+	STRESS_RX_CALLBACK_STOP, /* the callback ends the stream */
+	STRESS_TX,
+	STRESS_TX_IMMEDIATE,
+	STRESS_TX_CALLBACK_STOP, /* the callback ends the stream, then flushes */
+	STRESS_RX_CLOSE,         /* close while streaming, on a shared event thread */
+	STRESS_TX_CLOSE,
+	NUM_STRESS_CASES,
+} stress_case_t;
+
+static const char* stress_case_names[NUM_STRESS_CASES] = {
+	"rx",
+	"rx_immediate",
+	"rx_callback_stop",
+	"tx",
+	"tx_immediate",
+	"tx_callback_stop",
+	"rx_close",
+	"tx_close",
+};
+
+typedef struct {
+	int result;
+	uint32_t cycles;
+	uint32_t failed_cycle;
+	stress_case_t failed_case;
+	const char* failure;
+	uint64_t transfers;
+	duration_stats_t stop;
+} stress_result_t;
+
+/* Callback timing shared with the streaming benchmarks. */
+static uint32_t* intervals = NULL;
+static uint32_t num_intervals = 0;
+static uint64_t last_callback_us = 0;
+static uint64_t stream_bytes = 0;
+
+static uint64_t now_us(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return (uint64_t) (count.QuadPart * 1000000.0 / frequency.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static void sleep_ms(unsigned int ms)
+{
+#ifdef _WIN32
+	Sleep(ms);
+#else
+	usleep(ms * 1000);
+#endif
+}
+
+static int compare_u32(const void* a, const void* b)
+{
+	const uint32_t x = *(const uint32_t*) a;
+	const uint32_t y = *(const uint32_t*) b;
+	return (x > y) - (x < y);
+}
+
+/* Summarise durations, sorting them in place. */
+static void summarise(uint32_t* durations, uint32_t count, duration_stats_t* stats)
+{
+	double sum = 0, sum_sq = 0;
+	uint32_t i;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->count = count;
+	if (count == 0) {
+		return;
+	}
+
+	qsort(durations, count, sizeof(durations[0]), compare_u32);
+	for (i = 0; i < count; i++) {
+		sum += durations[i];
+		sum_sq += (double) durations[i] * durations[i];
+	}
+	stats->mean = sum / count;
+	stats->stddev = sqrt(fmax(sum_sq / count - stats->mean * stats->mean, 0));
+	stats->min = durations[0];
+	stats->p50 = durations[count / 2];
+	stats->p99 = durations[(uint32_t) (count * 0.99)];
+	stats->max = durations[count - 1];
+}
+
+/* Record the time since the previous callback. */
+static void record_interval(void)
+{
+	const uint64_t now = now_us();
+
+	if ((last_callback_us != 0) && (num_intervals < MAX_INTERVALS)) {
+		intervals[num_intervals++] = (uint32_t) (now - last_callback_us);
+	}
+	last_callback_us = now;
+}
+
+static int rx_callback(hackrf_transfer* transfer)
+{
+	record_interval();
+	stream_bytes += transfer->valid_length;
+	return 0;
+}
+
+static int tx_callback(hackrf_transfer* transfer)
+{
+	record_interval();
+	memset(transfer->buffer, 0, transfer->buffer_length);
+	transfer->valid_length = transfer->buffer_length;
+	stream_bytes += transfer->valid_length;
+	return 0;
+}
+
+static int bench_stream(
+	hackrf_device* device,
+	bool tx,
+	double seconds,
+	uint32_t sample_rate,
+	uint64_t freq_hz,
+	stream_result_t* r)
+{
+	hackrf_m0_state state;
+	uint64_t start;
+	int result;
+
+	memset(r, 0, sizeof(*r));
+	num_intervals = 0;
+	last_callback_us = 0;
+	stream_bytes = 0;
+
+	result = hackrf_set_sample_rate(device, sample_rate);
+	if (result == HACKRF_SUCCESS) {
+		result = hackrf_set_freq(device, freq_hz);
+	}
+	if (result != HACKRF_SUCCESS) {
+		return result;
+	}
+
+	start = now_us();
+	if (tx) {
+		result = hackrf_start_tx(device, tx_callback, NULL);
+	} else {
+		result = hackrf_start_rx(device, rx_callback, NULL);
+	}
+	if (result != HACKRF_SUCCESS) {
+		return result;
+	}
+
+	while ((now_us() - start) < (uint64_t) (seconds * 1e6) &&
+	       (hackrf_is_streaming(device) == HACKRF_TRUE)) {
+		sleep_ms(10);
+	}
+
+	/* Read the shortfall count while the M0 is still streaming. */
+	result = hackrf_get_m0_state(device, &state);
+	if (result == HACKRF_SUCCESS) {
+		r->shortfalls = state.num_shortfalls;
+	}
+
+	r->seconds = (now_us() - start) / 1e6;
+	if (tx) {
+		result = hackrf_stop_tx(device);
+	} else {
+		result = hackrf_stop_rx(device);
+	}
+	if (result != HACKRF_SUCCESS) {
+		return result;
+	}
+
+	result = hackrf_get_stream_stats(device, &r->stream);
+	if (result != HACKRF_SUCCESS) {
+		return result;
+	}
+
+	r->bytes = stream_bytes;
+	r->transfers = r->stream.transfers;
+	summarise(intervals, num_intervals, &r->interval);
+
+	return HACKRF_SUCCESS;
+}
+
+static int bench_tune(
+	hackrf_device* device,
+	uint64_t freq_hz,
+	uint32_t iterations,
+	tune_result_t* r)
+{
+	uint32_t* latencies;
+	uint64_t start;
+	uint32_t i;
+	int result = HACKRF_SUCCESS;
+
+	memset(r, 0, sizeof(*r));
+	latencies = (uint32_t*) calloc(iterations, sizeof(uint32_t));
+	if (latencies == NULL) {
+		return HACKRF_ERROR_NO_MEM;
+	}
+
+	/* Alternate between two frequencies so that every call retunes. */
+	for (i = 0; i < iterations; i++) {
+		start = now_us();
+		result = hackrf_set_freq(device, freq_hz + (i & 1) * FREQ_ONE_MHZ);
+		latencies[i] = (uint32_t) (now_us() - start);
+		if (result != HACKRF_SUCCESS) {
+			break;
+		}
+	}
+
+	summarise(latencies, i, &r->latency);
+	free(latencies);
+
+	return result;
+}
+
+/*
+ * Stress test state. The watchdog fails the test if a step of a cycle never
+ * finishes, such as a stop waiting for transfers that never drain.
+ */
+static pthread_mutex_t watchdog_lock = PTHREAD_MUTEX_INITIALIZER;
+static const char* watchdog_step = NULL;
+static uint32_t watchdog_cycle = 0;
+static uint64_t watchdog_start_us = 0;
+static bool watchdog_exit = false;
+
+static pthread_mutex_t stress_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t stress_callbacks = 0;
+static bool stress_callback_stop = false;
+static bool stress_flushed = false;
+
+/* Time a step of a cycle, or stop timing with a NULL step. */
+static void watchdog_set(const char* step, uint32_t cycle)
+{
+	pthread_mutex_lock(&watchdog_lock);
+	watchdog_step = step;
+	watchdog_cycle = cycle;
+	watchdog_start_us = now_us();
+	pthread_mutex_unlock(&watchdog_lock);
+}
+
+static void* watchdog_thread(void* arg)
+{
+	bool hung = false;
+
+	(void) arg;
+	while (!hung) {
+		sleep_ms(100);
+		pthread_mutex_lock(&watchdog_lock);
+		if (watchdog_exit) {
+			pthread_mutex_unlock(&watchdog_lock);
+			return NULL;
+		}
+		hung = (watchdog_step != NULL) &&
+			((now_us() - watchdog_start_us) > STRESS_TIMEOUT_S * 1000000ull);
+		if (hung) {
+			fprintf(stderr,
+				"stress test failed: %s did not finish within %d s"
+				" in cycle %u\n",
+				watchdog_step,
+				STRESS_TIMEOUT_S,
+				watchdog_cycle);
+		}
+		pthread_mutex_unlock(&watchdog_lock);
+	}
+
+	// The main thread is stuck in libhackrf, so there's no recovering.
+	exit(EXIT_FAILURE);
+	return NULL;
+}
+
+static uint32_t stress_callback_count(void)
+{
+	uint32_t count;
+
+	pthread_mutex_lock(&stress_lock);
+	count = stress_callbacks;
+	pthread_mutex_unlock(&stress_lock);
+	return count;
+}
+
+/* Count a callback, returning nonzero if it should end the stream. */
+static int stress_count_callback(void)
+{
+	int stop;
+
+	pthread_mutex_lock(&stress_lock);
+	stress_callbacks++;
+	stop = stress_callback_stop && (stress_callbacks >= STRESS_CALLBACK_STOP);
+	pthread_mutex_unlock(&stress_lock);
+	return stop;
+}
+
+static int stress_rx_callback(hackrf_transfer* transfer)
+{
+	(void) transfer;
+	return stress_count_callback();
+}
+
+static int stress_tx_callback(hackrf_transfer* transfer)
+{
+	memset(transfer->buffer, 0, transfer->buffer_length);
+	transfer->valid_length = transfer->buffer_length;
+	return stress_count_callback();
+}
+
+static void stress_flush_callback(void* flush_ctx, int success)
+{
+	(void) flush_ctx;
+	(void) success;
+	pthread_mutex_lock(&stress_lock);
+	stress_flushed = true;
+	pthread_mutex_unlock(&stress_lock);
+}
+
+static bool stress_flush_done(void)
+{
+	bool flushed;
+
+	pthread_mutex_lock(&stress_lock);
+	flushed = stress_flushed;
+	pthread_mutex_unlock(&stress_lock);
+	return flushed;
+}
+
+static void stress_reset(stress_case_t stress_case)
+{
+	pthread_mutex_lock(&stress_lock);
+	stress_callbacks = 0;
+	stress_callback_stop = (stress_case == STRESS_RX_CALLBACK_STOP) ||
+		(stress_case == STRESS_TX_CALLBACK_STOP);
+	stress_flushed = false;
+	pthread_mutex_unlock(&stress_lock);
+}
+
+/* Fail if a callback comes after a stream was stopped. */
+static int stress_check_settled(const char** failure)
+{
+	uint32_t callbacks = stress_callback_count();
+
+	sleep_ms(STRESS_SETTLE_MS);
+	if (stress_callback_count() != callbacks) {
+		*failure = "callback after stop";
+		return HACKRF_ERROR_OTHER;
+	}
+	return HACKRF_SUCCESS;
+}
+
+static int stress_open(
+	const char* serial_number,
+	uint32_t sample_rate,
+	uint64_t freq_hz,
+	hackrf_device** device)
+{
+	int result = hackrf_open_by_serial(serial_number, device);
+
+	if (result != HACKRF_SUCCESS) {
+		*device = NULL;
+		return result;
+	}
+	result = hackrf_set_sample_rate(*device, sample_rate);
+	if (result == HACKRF_SUCCESS) {
+		result = hackrf_set_freq(*device, freq_hz);
+	}
+	return result;
+}
+
+/* Start and stop a stream once, failing if any callback comes after the stop. */
+static int stress_cycle(
+	hackrf_device* device,
+	stress_case_t stress_case,
+	bool callback_thread,
+	uint32_t cycle,
+	uint32_t* stop_us,
+	const char** failure)
+{
+	const bool tx = (stress_case >= STRESS_TX);
+	uint64_t start;
+	int result;
+
+	stress_reset(stress_case);
+	if (callback_thread) {
+		result = hackrf_enable_callback_thread(device, STRESS_CALLBACK_BUFFERS);
+	} else {
+		result = hackrf_disable_callback_thread(device);
+	}
+	// The flush stays enabled for later TX cycles, where it may also run on a stop.
+	if ((result == HACKRF_SUCCESS) && (stress_case == STRESS_TX_CALLBACK_STOP)) {
+		result = hackrf_enable_tx_flush(device, stress_flush_callback, NULL);
+	}
+	if (result != HACKRF_SUCCESS) {
+		*failure = "setup";
+		return result;
+	}
+
+	watchdog_set("start", cycle);
+	if (tx) {
+		result = hackrf_start_tx(device, stress_tx_callback, NULL);
+	} else {
+		result = hackrf_start_rx(device, stress_rx_callback, NULL);
+	}
+	if (result != HACKRF_SUCCESS) {
+		watchdog_set(NULL, cycle);
+		*failure = "start";
+		return result;
+	}
+
+	switch (stress_case) {
+	case STRESS_RX:
+	case STRESS_TX:
+		watchdog_set("first transfer", cycle);
+		while (stress_callback_count() == 0) {
+			sleep_ms(1);
+		}
+		break;
+	case STRESS_RX_CALLBACK_STOP:
+	case STRESS_TX_CALLBACK_STOP:
+		watchdog_set("stop from callback", cycle);
+		while (hackrf_is_streaming(device) == HACKRF_TRUE) {
+			sleep_ms(1);
+		}
+		if (stress_case == STRESS_TX_CALLBACK_STOP) {
+			watchdog_set("flush", cycle);
+			while (!stress_flush_done()) {
+				sleep_ms(1);
+			}
+		}
+		break;
+	default:
+		break;
+	}
+
+	watchdog_set("stop", cycle);
+	start = now_us();
+	if (tx) {
+		result = hackrf_stop_tx(device);
+	} else {
+		result = hackrf_stop_rx(device);
+	}
+	*stop_us = (uint32_t) (now_us() - start);
+	watchdog_set(NULL, cycle);
+	if (result != HACKRF_SUCCESS) {
+		*failure = "stop";
+		return result;
+	}
+
+	// Once stopped, no transfer may be left to call back.
+	return stress_check_settled(failure);
+}
+
+/*
+ * Close the device while it streams, with a shared event thread handling
+ * its transfers, then reopen it. Closing must wait for the last transfer
+ * callback to finish with the device before freeing it.
+ */
+static int stress_close_cycle(
+	hackrf_device** device,
+	const char* serial_number,
+	uint32_t sample_rate,
+	uint64_t freq_hz,
+	stress_case_t stress_case,
+	uint32_t cycle,
+	uint32_t* stop_us,
+	const char** failure)
+{
+	uint64_t start;
+	int reopen_result;
+	int result;
+
+	stress_reset(stress_case);
+
+	watchdog_set("open", cycle);
+	hackrf_close(*device);
+	result = hackrf_set_event_threads(1);
+	if (result == HACKRF_SUCCESS) {
+		result = stress_open(serial_number, sample_rate, freq_hz, device);
+	}
+	if (result != HACKRF_SUCCESS) {
+		*failure = "open";
+		goto reopen;
+	}
+
+	watchdog_set("start", cycle);
+	if (stress_case == STRESS_TX_CLOSE) {
+		result = hackrf_start_tx(*device, stress_tx_callback, NULL);
+	} else {
+		result = hackrf_start_rx(*device, stress_rx_callback, NULL);
+	}
+	if (result != HACKRF_SUCCESS) {
+		*failure = "start";
+		goto reopen;
+	}
+
+	watchdog_set("first transfer", cycle);
+	while (stress_callback_count() == 0) {
+		sleep_ms(1);
+	}
+
+	watchdog_set("close", cycle);
+	start = now_us();
+	result = hackrf_close(*device);
+	*stop_us = (uint32_t) (now_us() - start);
+	*device = NULL;
+	if (result != HACKRF_SUCCESS) {
+		*failure = "close";
+		goto reopen;
+	}
+	result = stress_check_settled(failure);
+
+reopen:
+	// Go back to a transfer thread per device for the other cases.
+	watchdog_set("reopen", cycle);
+	if (*device != NULL) {
+		hackrf_close(*device);
+	}
+	hackrf_set_event_threads(0);
+	reopen_result = stress_open(serial_number, sample_rate, freq_hz, device);
+	if ((result == HACKRF_SUCCESS) && (reopen_result != HACKRF_SUCCESS)) {
+		*failure = "reopen";
+		result = reopen_result;
+	}
+	watchdog_set(NULL, cycle);
+	return result;
+}
+
+static int bench_stress(
+	hackrf_device** device,
+	const char* serial_number,
+	uint32_t cycles,
+	uint32_t sample_rate,
+	uint64_t freq_hz,
+	stress_result_t* r)
+{
+	pthread_t watchdog;
+	uint32_t* stop_us;
+	uint32_t i;
+	stress_case_t stress_case;
+	int result;
+
+	memset(r, 0, sizeof(*r));
+	stop_us = (uint32_t*) calloc(cycles, sizeof(uint32_t));
+	if (stop_us == NULL) {
+		return HACKRF_ERROR_NO_MEM;
+	}
+
+	result = hackrf_set_sample_rate(*device, sample_rate);
+	if (result == HACKRF_SUCCESS) {
+		result = hackrf_set_freq(*device, freq_hz);
+	}
+	if (result != HACKRF_SUCCESS) {
+		free(stop_us);
+		return result;
+	}
+
+	watchdog_exit = false;
+	if (pthread_create(&watchdog, NULL, watchdog_thread, NULL) != 0) {
+		free(stop_us);
+		return HACKRF_ERROR_THREAD;
+	}
+
+	// Every other round of cases runs the RX callbacks on the callback thread.
+	for (i = 0; i < cycles; i++) {
+		stress_case = (stress_case_t) (i % NUM_STRESS_CASES);
+		if (stress_case >= STRESS_RX_CLOSE) {
+			result = stress_close_cycle(
+				device,
+				serial_number,
+				sample_rate,
+				freq_hz,
+				stress_case,
+				i,
+				&stop_us[i],
+				&r->failure);
+		} else {
+			result = stress_cycle(
+				*device,
+				stress_case,
+				(stress_case < STRESS_TX) && ((i / NUM_STRESS_CASES) & 1),
+				i,
+				&stop_us[i],
+				&r->failure);
+		}
+		r->transfers += stress_callback_count();
+		if (result != HACKRF_SUCCESS) {
+			r->failed_cycle = i;
+			r->failed_case = stress_case;
+			break;
+		}
+	}
+	r->cycles = i;
+	summarise(stop_us, i, &r->stop);
+	if (*device != NULL) {
+		hackrf_disable_callback_thread(*device);
+	}
+
+	pthread_mutex_lock(&watchdog_lock);
+	watchdog_exit = true;
+	pthread_mutex_unlock(&watchdog_lock);
+	pthread_join(watchdog, NULL);
+	free(stop_us);
+
+	return result;
+}
+
+#ifdef HACKRF_BENCH_FFTW
+static uint64_t sweep_rows;
+
+static void sweep_row_callback(const hackrf_sweep_row* row, void* ctx)
+{
+	(void) row;
+	(void) ctx;
+	sweep_rows++;
+}
+
+/* Run the sweep engine that hackrf_sweep is built on, without output formatting. */
+static int bench_sweep(
+	hackrf_device* device,
+	double seconds,
+	const hackrf_sweep_config* config,
+	sweep_result_t* r)
+{
+	hackrf_sweep_engine* engine = NULL;
+	hackrf_sweep_config engine_config = *config;
+	uint64_t start;
+	int result;
+
+	memset(r, 0, sizeof(*r));
+	sweep_rows = 0;
+	engine_config.row_callback = sweep_row_callback;
+
+	result = hackrf_set_sample_rate_manual(device, SWEEP_SAMPLE_RATE_HZ, 1);
+	if (result == HACKRF_SUCCESS) {
+		result = hackrf_set_baseband_filter_bandwidth(
+			device,
+			SWEEP_BASEBAND_FILTER_HZ);
+	}
+	if (result == HACKRF_SUCCESS) {
+		result = hackrf_sweep_engine_create(device, &engine_config, &engine);
+	}
+	if (result != HACKRF_SUCCESS) {
+		return result;
+	}
+	r->fft_size = hackrf_sweep_engine_get_config(engine)->fft_size;
+	r->num_threads = hackrf_sweep_engine_get_config(engine)->num_threads;
+
+	start = now_us();
+	result = hackrf_sweep_engine_start(engine);
+	if (result != HACKRF_SUCCESS) {
+		hackrf_sweep_engine_destroy(engine);
+		return result;
+	}
+	while ((now_us() - start) < (uint64_t) (seconds * 1e6) &&
+	       (hackrf_is_streaming(device) == HACKRF_TRUE)) {
+		sleep_ms(10);
+	}
+
+	// Stopping delivers the rows still queued, which count towards the run time.
+	result = hackrf_sweep_engine_stop(engine);
+	r->seconds = (now_us() - start) / 1e6;
+	if (result == HACKRF_SUCCESS) {
+		result = hackrf_get_stream_stats(device, &r->stream);
+	}
+	r->blocks = hackrf_sweep_engine_get_byte_count(engine) / config->block_size;
+	r->rows = sweep_rows;
+	r->sweeps = hackrf_sweep_engine_get_sweep_count(engine);
+	hackrf_sweep_engine_destroy(engine);
+
+	return result;
+}
+#endif
+
+typedef enum {
+	KERNEL_S8_TO_CF32,
+	KERNEL_S8_TO_CF32_WINDOW,
+	KERNEL_S8_TO_CS16,
+	KERNEL_CF32_TO_S8,
+	KERNEL_CS16_TO_S8,
+	KERNEL_CF32_TO_DB,
+	KERNEL_CF32_TO_DB_EXACT,
+	NUM_KERNELS,
+} kernel_t;
+
+static const char* kernel_names[NUM_KERNELS] = {
+	"s8_to_cf32",
+	"s8_to_cf32_window",
+	"s8_to_cs16",
+	"cf32_to_s8",
+	"cs16_to_s8",
+	"cf32_to_db",
+	"cf32_to_db_exact",
+};
+
+static const enum hackrf_simd simds[] = {
+	HACKRF_SIMD_GENERIC,
+	HACKRF_SIMD_SSE2,
+	HACKRF_SIMD_AVX2,
+	HACKRF_SIMD_NEON,
+};
+
+static int8_t* conv_s8;
+static int16_t* conv_cs16;
+static float* conv_cf32;
+static float* conv_window;
+static float* conv_db;
+
+static void run_kernel(kernel_t kernel, size_t num_samples)
+{
+	switch (kernel) {
+	case KERNEL_S8_TO_CF32:
+		hackrf_convert_s8_to_cf32(conv_s8, conv_cf32, num_samples, 1.0f / 128.0f);
+		break;
+	case KERNEL_S8_TO_CF32_WINDOW:
+		hackrf_convert_s8_to_cf32_window(
+			conv_s8,
+			conv_cf32,
+			conv_window,
+			num_samples,
+			1.0f / 128.0f);
+		break;
+	case KERNEL_S8_TO_CS16:
+		hackrf_convert_s8_to_cs16(conv_s8, conv_cs16, num_samples);
+		break;
+	case KERNEL_CF32_TO_S8:
+		hackrf_convert_cf32_to_s8(conv_cf32, conv_s8, num_samples, 127.0f);
+		break;
+	case KERNEL_CS16_TO_S8:
+		hackrf_convert_cs16_to_s8(conv_cs16, conv_s8, num_samples);
+		break;
+	case KERNEL_CF32_TO_DB:
+		hackrf_convert_cf32_to_db(
+			conv_cf32,
+			conv_db,
+			num_samples,
+			1.0f,
+			HACKRF_DB_FAST);
+		break;
+	case KERNEL_CF32_TO_DB_EXACT:
+		hackrf_convert_cf32_to_db(
+			conv_cf32,
+			conv_db,
+			num_samples,
+			1.0f,
+			HACKRF_DB_EXACT);
+		break;
+	default:
+		break;
+	}
+}
+
+/* Bytes read and written per sample, used to report memory throughput. */
+static size_t bytes_per_sample(kernel_t kernel)
+{
+	switch (kernel) {
+	case KERNEL_S8_TO_CF32:
+	case KERNEL_CF32_TO_S8:
+		return 2 + 2 * sizeof(float);
+	case KERNEL_S8_TO_CF32_WINDOW:
+		return 2 + 3 * sizeof(float);
+	case KERNEL_S8_TO_CS16:
+	case KERNEL_CS16_TO_S8:
+		return 2 + 2 * sizeof(int16_t);
+	case KERNEL_CF32_TO_DB:
+	case KERNEL_CF32_TO_DB_EXACT:
+		return 3 * sizeof(float);
+	default:
+		return 0;
+	}
+}
+
+/* Returns throughput in GB/s, counting bytes both read and written. */
+static double bench_kernel(kernel_t kernel, size_t num_samples, double seconds)
+{
+	uint64_t start, elapsed;
+	uint64_t iterations = 0;
+	uint64_t batch = 1;
+	uint64_t i;
+
+	// Warm up caches and let the CPU reach its working clock speed.
+	run_kernel(kernel, num_samples);
+
+	start = now_us();
+	do {
+		for (i = 0; i < batch; i++) {
+			run_kernel(kernel, num_samples);
+		}
+		iterations += batch;
+		batch *= 2;
+		elapsed = now_us() - start;
+	} while (elapsed < (uint64_t) (seconds * 1e6));
+
+	return (double) iterations * num_samples * bytes_per_sample(kernel) /
+		(elapsed / 1e6) / 1e9;
+}
+
+/* Print a JSON string, escaping characters that need it. */
+static void json_string(FILE* out, const char* s)
+{
+	fputc('"', out);
+	for (; *s; s++) {
+		if ((*s == '"') || (*s == '\\')) {
+			fprintf(out, "\\%c", *s);
+		} else if ((unsigned char) *s < 0x20) {
+			fprintf(out, "\\u%04x", (unsigned char) *s);
+		} else {
+			fputc(*s, out);
+		}
+	}
+	fputc('"', out);
+}
+
+static void json_error(FILE* out, int result)
+{
+	fprintf(out, "{\"error\": ");
+	json_string(out, hackrf_error_name(result));
+	fprintf(out, ", \"code\": %d}", result);
+}
+
+static void json_durations(FILE* out, const char* name, const duration_stats_t* d)
+{
+	fprintf(out,
+		"\"%s\": {\"count\": %u, \"mean\": %.1f, \"stddev\": %.1f, "
+		"\"min\": %u, \"p50\": %u, \"p99\": %u, \"max\": %u}",
+		name,
+		d->count,
+		d->mean,
+		d->stddev,
+		d->min,
+		d->p50,
+		d->p99,
+		d->max);
+}
+
+static void json_stream(FILE* out, const stream_result_t* r)
+{
+	if (r->result != HACKRF_SUCCESS) {
+		json_error(out, r->result);
+		return;
+	}
+	fprintf(out,
+		"{\n\t\t\"seconds\": %.3f,\n"
+		"\t\t\"bytes\": %" PRIu64 ",\n"
+		"\t\t\"mb_per_s\": %.3f,\n"
+		"\t\t\"transfers\": %" PRIu64 ",\n"
+		"\t\t\"transfer_errors\": %" PRIu64 ",\n"
+		"\t\t\"shortfalls\": %u,\n"
+		"\t\t\"callback_max_us\": %u,\n"
+		"\t\t\"turnaround_max_us\": %u,\n\t\t",
+		r->seconds,
+		r->bytes,
+		r->seconds > 0 ? r->bytes / r->seconds / 1e6 : 0,
+		r->transfers,
+		r->stream.transfer_errors,
+		r->shortfalls,
+		r->stream.callback_max_us,
+		r->stream.turnaround_max_us);
+	json_durations(out, "callback_interval_us", &r->interval);
+	fprintf(out, "\n\t}");
+}
+
+static int parse_benchmarks(char* s, unsigned int* benchmarks)
+{
+	char* name;
+	unsigned int i;
+
+	*benchmarks = 0;
+	for (name = strtok(s, ","); name != NULL; name = strtok(NULL, ",")) {
+		if (strcmp(name, "all") == 0) {
+			*benchmarks |= BENCH_ALL;
+			continue;
+		}
+		for (i = 0; i < sizeof(bench_names) / sizeof(bench_names[0]); i++) {
+			if (strcmp(name, bench_names[i]) == 0) {
+				break;
+			}
+		}
+		if (i == sizeof(bench_names) / sizeof(bench_names[0])) {
+			return HACKRF_ERROR_INVALID_PARAM;
+		}
+		*benchmarks |= 1 << i;
+	}
+
+	return *benchmarks ? HACKRF_SUCCESS : HACKRF_ERROR_INVALID_PARAM;
+}
+
+static void usage()
+{
+	printf("hackrf_bench - measure libhackrf throughput and latency\n");
+	printf("Usage:\n");
+	printf("\t-h, --help: this help\n");
+	printf("\t-d, --device <serial_number>: serial number of desired HackRF\n");
+	printf("\t-b, --bench <list>: comma-separated benchmarks to run from\n"
+	       "\t\trx, tx, tune, sweep, convert, stress or all (default: all)\n");
+	printf("\t-t, --time <seconds>: run time per benchmark (default: %.1f)\n",
+	       DEFAULT_SECONDS);
+	printf("\t-s, --sample-rate <hz>: RX/TX sample rate (default: %d)\n",
+	       DEFAULT_SAMPLE_RATE_HZ);
+	printf("\t-f, --freq <hz>: RX/TX and tuning frequency (default: %" PRIu64 ")\n",
+	       (uint64_t) DEFAULT_FREQ_HZ);
+	printf("\t-n, --tune-count <count>: hackrf_set_freq calls to time (default: %d)\n",
+	       DEFAULT_TUNE_ITERATIONS);
+	printf("\t-r, --range <freq_min:freq_max>: sweep range in MHz (default: %d:%d)\n",
+	       DEFAULT_SWEEP_MIN_MHZ,
+	       DEFAULT_SWEEP_MAX_MHZ);
+	printf("\t-w, --bin-width <hz>: sweep FFT bin width (default: %d)\n",
+	       DEFAULT_BIN_WIDTH_HZ);
+	printf("\t-k, --block-size <bytes>: sweep block size (default: %d)\n",
+	       BYTES_PER_BLOCK);
+	printf("\t-A, --average <avg|max>: sweep Welch averaging (default: off)\n");
+	printf("\t-D, --dwell <blocks>: sweep blocks per tuning step with -A"
+	       " (default: 1)\n");
+	printf("\t-c, --cycles <count>: start/stop cycles for the stress test"
+	       " (default: %d)\n",
+	       DEFAULT_STRESS_CYCLES);
+	printf("\t-o, --output <file>: write JSON results to a file (default: stdout)\n");
+	printf("\nThe TX benchmark transmits zeros. Set HACKRF_EMULATOR to run without"
+	       " hardware.\n");
+	printf("The stress test, which all doesn't include, starts and stops RX and TX"
+	       " streams\nrepeatedly, also from within callbacks and by closing the"
+	       " device on a shared\nevent thread, and fails if a stop doesn't finish"
+	       " within %d s or a callback\nfollows it.\n",
+	       STRESS_TIMEOUT_S);
+}
+
+static struct option long_options[] = {
+	{"help", no_argument, 0, 'h'},
+	{"device", required_argument, 0, 'd'},
+	{"bench", required_argument, 0, 'b'},
+	{"time", required_argument, 0, 't'},
+	{"sample-rate", required_argument, 0, 's'},
+	{"freq", required_argument, 0, 'f'},
+	{"tune-count", required_argument, 0, 'n'},
+	{"range", required_argument, 0, 'r'},
+	{"bin-width", required_argument, 0, 'w'},
+	{"block-size", required_argument, 0, 'k'},
+	{"average", required_argument, 0, 'A'},
+	{"dwell", required_argument, 0, 'D'},
+	{"cycles", required_argument, 0, 'c'},
+	{"output", required_argument, 0, 'o'},
+	{0, 0, 0, 0},
+};
+
+int main(int argc, char** argv)
+{
+	int opt, result = HACKRF_SUCCESS;
+	int exit_code = EXIT_SUCCESS;
+	const char* serial_number = NULL;
+	const char* output_path = NULL;
+	unsigned int benchmarks = BENCH_ALL;
+	double seconds = DEFAULT_SECONDS;
+	uint32_t sample_rate = DEFAULT_SAMPLE_RATE_HZ;
+	uint64_t freq_hz = DEFAULT_FREQ_HZ;
+	uint32_t tune_iterations = DEFAULT_TUNE_ITERATIONS;
+	unsigned int sweep_min = DEFAULT_SWEEP_MIN_MHZ;
+	unsigned int sweep_max = DEFAULT_SWEEP_MAX_MHZ;
+	uint32_t bin_width = DEFAULT_BIN_WIDTH_HZ;
+	uint32_t block_size = BYTES_PER_BLOCK;
+	uint32_t dwell_blocks = 1;
+	const char* average = NULL;
+	uint32_t stress_cycles = DEFAULT_STRESS_CYCLES;
+	hackrf_device* device = NULL;
+	uint8_t board_id = BOARD_ID_UNDETECTED;
+	char version[255 + 1] = "";
+	uint16_t usb_version = 0;
+	stream_result_t rx, tx;
+	tune_result_t tune;
+	stress_result_t stress;
+#ifdef HACKRF_BENCH_FFTW
+	hackrf_sweep_config sweep_config;
+	sweep_result_t sweep;
+#endif
+	FILE* out = stdout;
+	size_t i, s;
+	int k;
+	bool first;
+
+	while ((opt = getopt_long(
+			argc,
+			argv,
+			"hd:b:t:s:f:n:r:w:k:A:D:c:o:",
+			long_options,
+			NULL)) != EOF) {
+		switch (opt) {
+		case 'd':
+			serial_number = optarg;
+			break;
+		case 'b':
+			result = parse_benchmarks(optarg, &benchmarks);
+			break;
+		case 't':
+			seconds = atof(optarg);
+			break;
+		case 's':
+			sample_rate = strtoul(optarg, NULL, 10);
+			break;
+		case 'f':
+			freq_hz = strtoull(optarg, NULL, 10);
+			break;
+		case 'n':
+			tune_iterations = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			if (sscanf(optarg, "%u:%u", &sweep_min, &sweep_max) != 2) {
+				result = HACKRF_ERROR_INVALID_PARAM;
+			}
+			break;
+		case 'w':
+			bin_width = strtoul(optarg, NULL, 10);
+			break;
+		case 'k':
+			block_size = strtoul(optarg, NULL, 10);
+			break;
+		case 'A':
+			average = optarg;
+			if ((strcmp("avg", average) != 0) &&
+			    (strcmp("max", average) != 0)) {
+				result = HACKRF_ERROR_INVALID_PARAM;
+			}
+			break;
+		case 'D':
+			dwell_blocks = strtoul(optarg, NULL, 10);
+			break;
+		case 'c':
+			stress_cycles = strtoul(optarg, NULL, 10);
+			break;
+		case 'o':
+			output_path = optarg;
+			break;
+		case 'h':
+			usage();
+			return EXIT_SUCCESS;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+		if (result != HACKRF_SUCCESS) {
+			fprintf(stderr, "argument error: '-%c %s'\n", opt, optarg);
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	// The sweep engine checks the sweep settings, failing only that benchmark.
+	if ((seconds <= 0) || (sample_rate == 0) || (tune_iterations == 0) ||
+	    (stress_cycles == 0) || (sweep_max > UINT16_MAX) || (bin_width == 0)) {
+		fprintf(stderr, "argument error: value out of range\n");
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	intervals = (uint32_t*) malloc(MAX_INTERVALS * sizeof(uint32_t));
+	conv_s8 = (int8_t*) malloc(DEFAULT_NUM_SAMPLES * 2 * sizeof(int8_t));
+	conv_cs16 = (int16_t*) malloc(DEFAULT_NUM_SAMPLES * 2 * sizeof(int16_t));
+	conv_cf32 = (float*) malloc(DEFAULT_NUM_SAMPLES * 2 * sizeof(float));
+	conv_window = (float*) malloc(DEFAULT_NUM_SAMPLES * sizeof(float));
+	conv_db = (float*) malloc(DEFAULT_NUM_SAMPLES * sizeof(float));
+	if ((intervals == NULL) || (conv_s8 == NULL) || (conv_cs16 == NULL) ||
+	    (conv_cf32 == NULL) || (conv_window == NULL) || (conv_db == NULL)) {
+		fprintf(stderr, "Failed to allocate buffers\n");
+		return EXIT_FAILURE;
+	}
+
+	if (benchmarks & (BENCH_RX | BENCH_TX | BENCH_TUNE | BENCH_SWEEP | BENCH_STRESS)) {
+		result = hackrf_init();
+		if (result != HACKRF_SUCCESS) {
+			fprintf(stderr,
+				"hackrf_init() failed: %s (%d)\n",
+				hackrf_error_name(result),
+				result);
+			return EXIT_FAILURE;
+		}
+		result = hackrf_open_by_serial(serial_number, &device);
+		if (result != HACKRF_SUCCESS) {
+			fprintf(stderr,
+				"hackrf_open() failed: %s (%d)\n",
+				hackrf_error_name(result),
+				result);
+			return EXIT_FAILURE;
+		}
+		hackrf_board_id_read(device, &board_id);
+		hackrf_version_string_read(device, &version[0], 255);
+		hackrf_usb_api_version_read(device, &usb_version);
+	}
+
+	if (output_path != NULL) {
+		out = fopen(output_path, "w");
+		if (out == NULL) {
+			fprintf(stderr, "Failed to open file: %s\n", output_path);
+			return EXIT_FAILURE;
+		}
+	}
+
+	fprintf(out, "{\n\t\"tool\": \"hackrf_bench\",\n\t\"tool_version\": ");
+	json_string(out, TOOL_RELEASE);
+	fprintf(out, ",\n\t\"library_version\": ");
+	json_string(out, hackrf_library_version());
+	fprintf(out, ",\n\t\"library_release\": ");
+	json_string(out, hackrf_library_release());
+	fprintf(out, ",\n\t\"timestamp\": %lld", (long long) time(NULL));
+	if (device != NULL) {
+		fprintf(out, ",\n\t\"device\": {\"board\": ");
+		json_string(out, hackrf_board_id_name((enum hackrf_board_id) board_id));
+		fprintf(out, ", \"firmware\": ");
+		json_string(out, version);
+		fprintf(out,
+			", \"usb_api\": \"%x.%02x\", \"emulated\": %s}",
+			(usb_version >> 8) & 0xFF,
+			usb_version & 0xFF,
+			hackrf_is_emulated(device) == HACKRF_TRUE ? "true" : "false");
+	}
+	fflush(out);
+
+	if (benchmarks & BENCH_RX) {
+		fprintf(stderr, "Running RX benchmark\n");
+		rx.result = bench_stream(device, false, seconds, sample_rate, freq_hz, &rx);
+		fprintf(out, ",\n\t\"rx\": ");
+		json_stream(out, &rx);
+		exit_code |= rx.result != HACKRF_SUCCESS;
+	}
+
+	if (benchmarks & BENCH_TX) {
+		fprintf(stderr, "Running TX benchmark\n");
+		tx.result = bench_stream(device, true, seconds, sample_rate, freq_hz, &tx);
+		fprintf(out, ",\n\t\"tx\": ");
+		json_stream(out, &tx);
+		exit_code |= tx.result != HACKRF_SUCCESS;
+	}
+
+	if (benchmarks & BENCH_TUNE) {
+		fprintf(stderr, "Running tuning benchmark\n");
+		tune.result = bench_tune(device, freq_hz, tune_iterations, &tune);
+		fprintf(out, ",\n\t\"tune\": ");
+		if (tune.result == HACKRF_SUCCESS) {
+			fprintf(out, "{");
+			json_durations(out, "set_freq_us", &tune.latency);
+			fprintf(out, "}");
+		} else {
+			json_error(out, tune.result);
+		}
+		exit_code |= tune.result != HACKRF_SUCCESS;
+	}
+
+	if (benchmarks & BENCH_SWEEP) {
+		fprintf(out, ",\n\t\"sweep\": ");
+#ifdef HACKRF_BENCH_FFTW
+		fprintf(stderr, "Running sweep benchmark\n");
+		hackrf_sweep_config_init(&sweep_config);
+		sweep_config.frequencies[0] = (uint16_t) sweep_min;
+		sweep_config.frequencies[1] = (uint16_t) sweep_max;
+		// Pad to an odd multiple of four bins, as hackrf_sweep does.
+		sweep_config.fft_size = SWEEP_SAMPLE_RATE_HZ / bin_width;
+		while ((sweep_config.fft_size + 4) % 8) {
+			sweep_config.fft_size++;
+		}
+		if (average != NULL) {
+			sweep_config.average = (strcmp("max", average) == 0) ?
+				HACKRF_SWEEP_AVERAGE_MAX :
+				HACKRF_SWEEP_AVERAGE_MEAN;
+		}
+		sweep_config.dwell_blocks = dwell_blocks;
+		sweep_config.block_size = block_size;
+		sweep.result = bench_sweep(device, seconds, &sweep_config, &sweep);
+		if (sweep.result == HACKRF_SUCCESS) {
+			fprintf(out,
+				"{\n\t\t\"seconds\": %.3f,\n"
+				"\t\t\"fft_size\": %d,\n"
+				"\t\t\"block_size\": %u,\n"
+				"\t\t\"threads\": %d,\n"
+				"\t\t\"blocks\": %" PRIu64 ",\n"
+				"\t\t\"rows\": %" PRIu64 ",\n"
+				"\t\t\"rows_per_s\": %.1f,\n"
+				"\t\t\"sweeps_per_s\": %.3f,\n"
+				"\t\t\"callback_max_us\": %u\n\t}",
+				sweep.seconds,
+				sweep.fft_size,
+				block_size,
+				sweep.num_threads,
+				sweep.blocks,
+				sweep.rows,
+				sweep.rows / sweep.seconds,
+				sweep.sweeps / sweep.seconds,
+				sweep.stream.callback_max_us);
+		} else {
+			json_error(out, sweep.result);
+		}
+		exit_code |= sweep.result != HACKRF_SUCCESS;
+#else
+		(void) block_size;
+		(void) dwell_blocks;
+		fprintf(out, "{\"error\": \"built without FFTW\"}");
+#endif
+	}
+
+	if (benchmarks & BENCH_CONVERT) {
+		fprintf(stderr, "Running conversion benchmark\n");
+		for (i = 0; i < DEFAULT_NUM_SAMPLES * 2; i++) {
+			conv_s8[i] = (int8_t) rand();
+			conv_cs16[i] = (int16_t) rand();
+			conv_cf32[i] = (float) rand() / RAND_MAX - 0.5f;
+		}
+		for (i = 0; i < DEFAULT_NUM_SAMPLES; i++) {
+			conv_window[i] = (float) rand() / RAND_MAX;
+		}
+
+		fprintf(out, ",\n\t\"convert\": {\n\t\t\"simd\": ");
+		json_string(out, hackrf_simd_name(hackrf_convert_get_simd()));
+		fprintf(out,
+			",\n\t\t\"samples_per_call\": %d,\n\t\t\"gb_per_s\": {",
+			DEFAULT_NUM_SAMPLES);
+		for (k = 0; k < NUM_KERNELS; k++) {
+			fprintf(out, "%s\n\t\t\t\"%s\": {", k ? "," : "", kernel_names[k]);
+			first = true;
+			for (s = 0; s < sizeof(simds) / sizeof(simds[0]); s++) {
+				if (hackrf_convert_set_simd(simds[s]) != HACKRF_SUCCESS) {
+					continue;
+				}
+				fprintf(out,
+					"%s\"%s\": %.2f",
+					first ? "" : ", ",
+					hackrf_simd_name(simds[s]),
+					bench_kernel((kernel_t) k,
+						     DEFAULT_NUM_SAMPLES,
+						     seconds / 4));
+				first = false;
+			}
+			fprintf(out, "}");
+		}
+		fprintf(out, "\n\t\t}\n\t}");
+		hackrf_convert_set_simd(HACKRF_SIMD_AUTO);
+	}
+
+	if (benchmarks & BENCH_STRESS) {
+		fprintf(stderr, "Running stress test\n");
+		stress.result = bench_stress(
+			&device,
+			serial_number,
+			stress_cycles,
+			sample_rate,
+			freq_hz,
+			&stress);
+		fprintf(out, ",\n\t\"stress\": ");
+		if (stress.result == HACKRF_SUCCESS) {
+			fprintf(out,
+				"{\n\t\t\"cycles\": %u,\n"
+				"\t\t\"transfers\": %" PRIu64 ",\n\t\t",
+				stress.cycles,
+				stress.transfers);
+			json_durations(out, "stop_us", &stress.stop);
+			fprintf(out, "\n\t}");
+		} else {
+			fprintf(out, "{\"error\": ");
+			json_string(out, hackrf_error_name(stress.result));
+			fprintf(out, ", \"code\": %d, \"failure\": ", stress.result);
+			json_string(out, stress.failure);
+			fprintf(out, ", \"cycle\": %u, \"case\": ", stress.failed_cycle);
+			json_string(out, stress_case_names[stress.failed_case]);
+			fprintf(out, "}");
+		}
+		exit_code |= stress.result != HACKRF_SUCCESS;
+	}
+
+	fprintf(out, "\n}\n");
+
+	if (out != stdout) {
+		fclose(out);
+	}
+	if (device != NULL) {
+		hackrf_close(device);
+	}
+	if (benchmarks & (BENCH_RX | BENCH_TX | BENCH_TUNE | BENCH_SWEEP | BENCH_STRESS)) {
+		hackrf_exit();
+	}
+
+	free(intervals);
+	free(conv_s8);
+	free(conv_cs16);
+	free(conv_cf32);
+	free(conv_window);
+	free(conv_db);
+
+	return exit_code ? EXIT_FAILURE : EXIT_SUCCESS;
+}
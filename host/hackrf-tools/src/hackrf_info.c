@@ -104,6 +104,7 @@ int main(void)
 	uint16_t usb_version;
 	read_partid_serialno_t read_partid_serialno;
 	uint8_t operacakes[8];
+	enum hackrf_buffer_mode buffer_mode;
 	hackrf_device_list_t* list;
 	hackrf_device* device;
 	int i, j;
@@ -275,6 +276,11 @@ int main(void)
 			}
 		}
 
+		result = hackrf_get_buffer_mode(device, &buffer_mode);
+		if (result == HACKRF_SUCCESS) {
+			printf("Transfer buffers: %s\n", hackrf_buffer_mode_name(buffer_mode));
+		}
+
 		result = hackrf_close(device);
 		if (result != HACKRF_SUCCESS) {
 			fprintf(stderr,
@@ -43,12 +43,13 @@ static void usage()
 	printf("\t-h, --help: this help\n");
 	printf("\t-d, --device <n>: specify a particular device by serial number\n");
 	printf("\t-o, --address <n>: specify a particular Opera Cake by address [default: 0]\n");
-	printf("\t-m, --mode <mode>: specify switching mode [options: manual, frequency, time]\n");
+	printf("\t-m, --mode <mode>: specify switching mode [options: manual, frequency, time, sweep]\n");
 	printf("\t-a <port>: set port connected to port A0\n");
 	printf("\t-b <port>: set port connected to port B0\n");
 	printf("\t-f <port:min:max>: automatically assign <port> for range <min:max> in MHz. This argument can be repeated to specify a list of ports.\n");
 	printf("\t-t <port:dwell>: in time mode, dwell on <port> for <dwell> samples. Specify only <port> to use the default dwell time (with -w). This argument can be repeated to specify a list of ports.\n");
 	printf("\t-w <n>: set default dwell time in samples for time mode\n");
+	printf("\t-s <port>: in sweep mode, capture each sweep step on <port>. This argument can be repeated to specify a list of ports.\n");
 	printf("\t-l, --list: list available Opera Cake boards\n");
 	printf("\t-g, --gpio_test: test GPIO functionality of an Opera Cake\n");
 }
@@ -198,6 +199,8 @@ int main(int argc, char** argv)
 	hackrf_operacake_dwell_time dwell_times[HACKRF_OPERACAKE_MAX_DWELL_TIMES];
 	uint8_t range_idx = 0;
 	uint8_t dwell_idx = 0;
+	uint8_t sweep_ports[HACKRF_OPERACAKE_MAX_SWEEP_PORTS];
+	uint8_t sweep_port_idx = 0;
 	uint32_t default_dwell = 0;
 
 	int result = hackrf_init();
@@ -211,7 +214,7 @@ int main(int argc, char** argv)
 	while ((opt = getopt_long(
 			argc,
 			argv,
-			"d:o:a:m:b:lf:t:w:hg?",
+			"d:o:a:m:b:lf:t:w:s:hg?",
 			long_options,
 			&option_index)) != EOF) {
 		switch (opt) {
@@ -233,9 +236,12 @@ int main(int argc, char** argv)
 			} else if (strcmp(optarg, "time") == 0) {
 				mode = OPERACAKE_MODE_TIME;
 				set_mode = true;
+			} else if (strcmp(optarg, "sweep") == 0) {
+				mode = OPERACAKE_MODE_SWEEP;
+				set_mode = true;
 			} else {
 				fprintf(stderr,
-					"argument error: mode must be one of [manual, frequency, time].\n");
+					"argument error: mode must be one of [manual, frequency, time, sweep].\n");
 				usage();
 				return EXIT_FAILURE;
 			}
@@ -290,6 +296,22 @@ int main(int argc, char** argv)
 			default_dwell = atof(optarg);
 			break;
 
+		case 's':
+			if (HACKRF_OPERACAKE_MAX_SWEEP_PORTS == sweep_port_idx) {
+				fprintf(stderr,
+					"argument error: specify a maximum of %u sweep ports.\n",
+					HACKRF_OPERACAKE_MAX_SWEEP_PORTS);
+				usage();
+				return EXIT_FAILURE;
+			}
+			result = parse_port(optarg, &sweep_ports[sweep_port_idx]);
+			if (result != HACKRF_SUCCESS) {
+				fprintf(stderr, "failed to parse port\n");
+				return EXIT_FAILURE;
+			}
+			sweep_port_idx++;
+			break;
+
 		case 'a':
 			result = parse_port(optarg, &port_a);
 			if (result != HACKRF_SUCCESS) {
@@ -329,7 +351,8 @@ int main(int argc, char** argv)
 	}
 
 	// Any operations that set a parameter on an Opera Cake board.
-	bool set_params = set_mode || set_ports || range_idx || dwell_idx;
+	bool set_params =
+		set_mode || set_ports || range_idx || dwell_idx || sweep_port_idx;
 
 	// Error out unless exactly one option is selected.
 	if (list + set_params + gpio_test != 1) {
@@ -380,6 +403,8 @@ int main(int argc, char** argv)
 					printf("frequency\n");
 				} else if (mode == OPERACAKE_MODE_TIME) {
 					printf("time\n");
+				} else if (mode == OPERACAKE_MODE_SWEEP) {
+					printf("sweep\n");
 				} else {
 					printf("unknown\n");
 				}
@@ -518,6 +543,19 @@ int main(int argc, char** argv)
 		}
 	}
 
+	if (sweep_port_idx) {
+		result = hackrf_set_operacake_sweep_ports(
+			device,
+			sweep_ports,
+			sweep_port_idx);
+		if (result) {
+			printf("hackrf_set_operacake_sweep_ports() failed: %s (%d)\n",
+			       hackrf_error_name(result),
+			       result);
+			return -1;
+		}
+	}
+
 	result = hackrf_close(device);
 	if (result) {
 		printf("hackrf_close() failed: %s (%d)\n",
@@ -22,6 +22,7 @@
  */
 
 #include <hackrf.h>
+#include <hackrf_sweep_engine.h>
 
 #include <stdbool.h>
 #include <stdio.h>
@@ -36,6 +37,7 @@
 #include <errno.h>
 #include <fftw3.h>
 #include <inttypes.h>
+#include <pthread.h>
 
 #define _FILE_OFFSET_BITS 64
 
@@ -79,6 +81,10 @@ int gettimeofday(struct timeval* tv, void* ignored)
 	#include <sys/time.h>
 #endif
 
+#ifndef _WIN32
+	#include <sys/mman.h>
+#endif
+
 #include <signal.h>
 #include <math.h>
 
@@ -93,9 +99,8 @@ int gettimeofday(struct timeval* tv, void* ignored)
 #define DEFAULT_BASEBAND_FILTER_BANDWIDTH (15000000) /* 15MHz default */
 
 #define TUNE_STEP (DEFAULT_SAMPLE_RATE_HZ / FREQ_ONE_MHZ)
-#define OFFSET    7500000
 
-#define BLOCKS_PER_TRANSFER 16
+#define MAX_DWELL_BLOCKS 1024
 
 #if defined _WIN32
 	#define m_sleep(a) Sleep((a))
@@ -167,8 +172,7 @@ int parse_u32_range(char* s, uint32_t* const value_min, uint32_t* const value_ma
 volatile bool do_exit = false;
 
 FILE* outfile = NULL;
-volatile uint32_t byte_count = 0;
-volatile uint64_t sweep_count = 0;
+uint64_t sweep_count = 0;
 
 struct timeval time_start;
 struct timeval t_start;
@@ -182,206 +186,886 @@ uint32_t antenna_enable;
 bool timestamp_normalized = false;
 bool binary_output = false;
 bool ifft_output = false;
+enum hackrf_db_mode db_mode = HACKRF_DB_FAST;
+int num_threads = 0;
+
+/*
+ * Welch averaging splits every block into windowed segments of num_fft_bins
+ * samples, overlapping by half, and combines the power spectra of all the
+ * segments of the dwell_blocks blocks captured at each tuning step.
+ */
+enum hackrf_sweep_average welch_mode = HACKRF_SWEEP_AVERAGE_OFF;
+uint32_t dwell_blocks = 1;
+
+/*
+ * In spectrum mode the HackRF averages the spectra of each dwell itself, with
+ * power of two FFT sizes, and only sends those.
+ */
+bool device_spectrum = false;
+
+/*
+ * Smaller blocks and a settle time shorter than the firmware's default of
+ * two whole blocks after each retune make for faster sweeps with small FFTs.
+ */
+uint32_t block_size = BYTES_PER_BLOCK;
+uint32_t settle_us = 0;
+bool settle_set = false;
+
+/*
+ * Binary format version 2, all fields little-endian. Each sweep starts with a
+ * sweep record, followed by a step record for each tuning step:
+ *
+ * sweep record
+ *    0 uint16  type, SWEEP_V2_SWEEP
+ *    2 uint16  record length in bytes, including the range table
+ *    4 char[4] magic, "HRSW"
+ *    8 uint8   version, 2
+ *    9 uint8   value format, sweep_v2_format_t
+ *   10 uint16  number of values per band, num_fft_bins / 4
+ *   12 uint32  sweep index, counted from 0
+ *   16 int64   host time at the start of the sweep, in us since the Unix epoch
+ *   24 uint64  device time at the start of the sweep, 0 if unknown
+ *   32 double  bin width in Hz
+ *   40 uint32  sample rate in Hz
+ *   44 uint16  number of ranges
+ *   46 uint16  reserved, 0
+ *   48 uint16  minimum and maximum frequency in MHz of each range
+ *
+ * step record
+ *    0 uint16  type, SWEEP_V2_STEP
+ *    2 uint16  record length in bytes
+ *    4 uint32  number of samples analyzed
+ *    8 uint64  tuned frequency f in Hz
+ *   16         values for f to f + rate / 4, then f + rate / 2 to f + 3 * rate / 4
+ */
+#define SWEEP_V2_VERSION      2
+#define SWEEP_V2_SWEEP        1
+#define SWEEP_V2_STEP         2
+#define SWEEP_V2_SWEEP_LENGTH 48
+#define SWEEP_V2_STEP_LENGTH  16
+
+typedef enum {
+	SWEEP_V2_F32 = 0, /* float32 dB */
+	SWEEP_V2_I16 = 1, /* int16 hundredths of a dB, INT16_MIN if out of range */
+	SWEEP_V2_F16 = 2, /* IEEE 754 float16 dB */
+} sweep_v2_format_t;
+
+int binary_version = 1;
+sweep_v2_format_t v2_format = SWEEP_V2_F32;
+
+/*
+ * Waterfall output (-M) writes one row of float32 dB values per sweep into a
+ * memory-mapped file, so that readers can map it and index any sweep and
+ * frequency directly while the sweep runs. The file starts with
+ * waterfall_header_t, padded to WATERFALL_HEADER_LENGTH bytes, followed by
+ * rows_allocated rows of row_length values. Values of a row that weren't
+ * received are NaN. Rows become visible once rows_complete is incremented.
+ *
+ * A time index is written to the file name with ".idx" appended, holding a
+ * waterfall_index_t for each complete row. Both use host byte order.
+ */
+#define WATERFALL_VERSION       1
+#define WATERFALL_HEADER_LENGTH 4096
+#define WATERFALL_INITIAL_ROWS  64
+
+typedef struct {
+	uint64_t frequency;    /* low edge of the range in Hz */
+	uint32_t first_column; /* first value of the range in a row */
+	uint32_t num_columns;  /* number of values in the range */
+} waterfall_range_t;
+
+typedef struct {
+	char magic[8]; /* "HRFWFALL" */
+	uint32_t version;
+	uint32_t header_length; /* offset of the first row in bytes */
+	uint32_t row_length;    /* values per row */
+	uint32_t num_ranges;
+	uint64_t rows_allocated;
+	uint64_t rows_complete;
+	double bin_width; /* in Hz */
+	uint32_t sample_rate;
+	uint32_t reserved;
+	waterfall_range_t ranges[MAX_SWEEP_RANGES];
+} waterfall_header_t;
+
+typedef struct {
+	int64_t time; /* time at the start of the sweep, in us since the Unix epoch */
+	uint64_t device_time; /* the same by the device's clock in ns, 0 if unknown */
+} waterfall_index_t;
+
+bool waterfall_output = false;
+
+/*
+ * Shared memory output (-S) publishes each completed sweep as a row, laid out
+ * like a waterfall row, into a ring of num_slots slots in a POSIX shared
+ * memory object, for any number of local readers. The object starts with
+ * ring_header_t, padded to RING_HEADER_LENGTH bytes, followed by the slots.
+ * Each slot is a ring_slot_t followed by row_length float32 dB values, padded
+ * to slot_length bytes.
+ *
+ * Row n goes into slot n % num_slots. While the row is written, the slot's
+ * sequence is RING_SLOT_BUSY, then it becomes n and rows_published becomes
+ * n + 1. A reader of row n checks that the slot's sequence is n before and
+ * after reading the values; if it isn't, the writer has lapped the reader.
+ */
+#define RING_VERSION       1
+#define RING_HEADER_LENGTH 4096
+#define RING_DEFAULT_SLOTS 16
+#define RING_SLOT_BUSY     UINT64_MAX
+
+typedef struct {
+	char magic[8]; /* "HRFSRING", set last */
+	uint32_t version;
+	uint32_t header_length; /* offset of the first slot in bytes */
+	uint32_t row_length;    /* values per row */
+	uint32_t num_ranges;
+	uint32_t num_slots;
+	uint32_t slot_length; /* bytes per slot */
+	volatile uint64_t rows_published;
+	double bin_width; /* in Hz */
+	uint32_t sample_rate;
+	volatile uint32_t closed; /* nonzero once the writer has exited */
+	waterfall_range_t ranges[MAX_SWEEP_RANGES];
+} ring_header_t;
+
+typedef struct {
+	volatile uint64_t sequence; /* row in the slot, or RING_SLOT_BUSY */
+	int64_t time; /* time at the start of the sweep, in us since the Unix epoch */
+	uint64_t device_time; /* the same by the device's clock in ns, 0 if unknown */
+	uint64_t reserved;
+} ring_slot_t;
+
+bool ring_output = false;
+char ring_name[256];
+uint32_t ring_slots = RING_DEFAULT_SLOTS;
 bool one_shot = false;
 bool finite_mode = false;
-volatile bool sweep_started = false;
 
 int num_fft_bins = 20;
 double fft_bin_width;
-fftwf_complex* fftwIn = NULL;
-fftwf_complex* fftwOut = NULL;
-fftwf_plan fftwPlan = NULL;
-fftwf_complex* ifftwIn = NULL;
-fftwf_complex* ifftwOut = NULL;
-fftwf_plan ifftwPlan = NULL;
 uint32_t ifft_idx = 0;
-float* pwr;
-float* window;
 
-struct timeval usb_transfer_time;
-
-float logPower(fftwf_complex in, float scale)
+/*
+ * The inverse FFT of each sweep (-I) runs on its own thread, so that the rows
+ * of the next sweep can be stitched while it runs. Rows are stitched into one
+ * of two buffers, and at the end of a sweep the buffers are swapped and the
+ * thread transforms and writes the full one. Only if the thread is still busy
+ * with the previous sweep by then does the end of the sweep wait for it.
+ */
+typedef struct {
+	fftwf_complex* in[2];
+	fftwf_complex* out;
+	fftwf_plan plan;
+	int fill;     /* buffer rows are stitched into */
+	bool pending; /* the other buffer is waiting to be transformed */
+	bool stopping;
+	bool started;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cv;
+} ifft_stage_t;
+
+static ifft_stage_t ifft;
+
+static void* ifft_thread(void* arg)
 {
-	float re = in[0] * scale;
-	float im = in[1] * scale;
-	float magsq = re * re + im * im;
-	return (float) (log2(magsq) * 10.0f / log2(10.0f));
+	const int ifft_bins = num_fft_bins * step_count;
+	fftwf_complex* in;
+	int i;
+	(void) arg;
+
+	pthread_mutex_lock(&ifft.lock);
+	while (true) {
+		while (!ifft.pending && !ifft.stopping) {
+			pthread_cond_wait(&ifft.cv, &ifft.lock);
+		}
+		if (!ifft.pending) {
+			break;
+		}
+		in = ifft.in[!ifft.fill];
+		pthread_mutex_unlock(&ifft.lock);
+
+		fftwf_execute_dft(ifft.plan, in, ifft.out);
+		for (i = 0; i < ifft_bins; i++) {
+			ifft.out[i][0] *= 1.0f / ifft_bins;
+			ifft.out[i][1] *= 1.0f / ifft_bins;
+		}
+		fwrite(ifft.out, sizeof(fftwf_complex), ifft_bins, outfile);
+
+		pthread_mutex_lock(&ifft.lock);
+		ifft.pending = false;
+		pthread_cond_signal(&ifft.cv);
+	}
+	pthread_mutex_unlock(&ifft.lock);
+
+	return NULL;
 }
 
-int rx_callback(hackrf_transfer* transfer)
+static int open_ifft(int fftw_plan_type)
 {
-	int8_t* buf;
-	uint8_t* ubuf;
-	uint64_t frequency; /* in Hz */
-	uint64_t band_edge;
-	uint32_t record_length;
-	int i, j, ifft_bins;
-	struct tm* fft_time;
-	char time_str[50];
+	const int ifft_bins = num_fft_bins * step_count;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		ifft.in[i] =
+			(fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex) * ifft_bins);
+		if (ifft.in[i] == NULL) {
+			return -1;
+		}
+		memset(ifft.in[i], 0, sizeof(fftwf_complex) * ifft_bins);
+	}
+	ifft.out = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex) * ifft_bins);
+	if (ifft.out == NULL) {
+		return -1;
+	}
+	ifft.plan = fftwf_plan_dft_1d(
+		ifft_bins,
+		ifft.in[0],
+		ifft.out,
+		FFTW_BACKWARD,
+		fftw_plan_type);
 
-	if (NULL == outfile) {
+	/* Execute the plan once to make sure it's ready to go when real
+	 * data starts to flow.  See issue #1366
+	 */
+	fftwf_execute(ifft.plan);
+
+	ifft.fill = 0;
+	ifft.pending = false;
+	ifft.stopping = false;
+	pthread_mutex_init(&ifft.lock, NULL);
+	pthread_cond_init(&ifft.cv, NULL);
+	if (pthread_create(&ifft.thread, NULL, ifft_thread, NULL) != 0) {
 		return -1;
 	}
+	ifft.started = true;
+	return 0;
+}
 
-	if (do_exit) {
-		return 0;
+/* Hand the sweep stitched so far to the IFFT thread and start the next. */
+static void write_ifft(void)
+{
+	pthread_mutex_lock(&ifft.lock);
+	while (ifft.pending) {
+		pthread_cond_wait(&ifft.cv, &ifft.lock);
+	}
+	ifft.fill = !ifft.fill;
+	ifft.pending = true;
+	pthread_cond_signal(&ifft.cv);
+	pthread_mutex_unlock(&ifft.lock);
+}
+
+/* Wait for the last sweep to be written. */
+static void close_ifft(void)
+{
+	if (ifft.started) {
+		pthread_mutex_lock(&ifft.lock);
+		ifft.stopping = true;
+		pthread_cond_signal(&ifft.cv);
+		pthread_mutex_unlock(&ifft.lock);
+		pthread_join(ifft.thread, NULL);
+		pthread_mutex_destroy(&ifft.lock);
+		pthread_cond_destroy(&ifft.cv);
+		ifft.started = false;
 	}
+	if (ifft.plan != NULL) {
+		fftwf_destroy_plan(ifft.plan);
+		ifft.plan = NULL;
+	}
+	fftwf_free(ifft.in[0]);
+	fftwf_free(ifft.in[1]);
+	fftwf_free(ifft.out);
+	ifft.in[0] = NULL;
+	ifft.in[1] = NULL;
+	ifft.out = NULL;
+}
+
+/* Binary output of each job is staged here and written with a single fwrite. */
+static uint8_t* stage = NULL;
+static size_t stage_size;
+static size_t stage_used = 0;
 
-	// happens only once with timestamp_normalized == true
-	if ((usb_transfer_time.tv_sec == 0 && usb_transfer_time.tv_usec == 0) ||
-	    timestamp_normalized == false) {
-		// set the timestamp for the first sweep
-		gettimeofday(&usb_transfer_time, NULL);
-	}
-
-	byte_count += transfer->valid_length;
-	buf = (int8_t*) transfer->buffer;
-	ifft_bins = num_fft_bins * step_count;
-	for (j = 0; j < BLOCKS_PER_TRANSFER; j++) {
-		ubuf = (uint8_t*) buf;
-		if (ubuf[0] == 0x7F && ubuf[1] == 0x7F) {
-			frequency = ((uint64_t) (ubuf[9]) << 56) |
-				((uint64_t) (ubuf[8]) << 48) |
-				((uint64_t) (ubuf[7]) << 40) |
-				((uint64_t) (ubuf[6]) << 32) |
-				((uint64_t) (ubuf[5]) << 24) |
-				((uint64_t) (ubuf[4]) << 16) |
-				((uint64_t) (ubuf[3]) << 8) | ubuf[2];
+static bool v2_new_sweep = true;
+static uint32_t v2_sweep_index = 0;
+
+static void flush_stage(void)
+{
+	if (stage_used > 0) {
+		fwrite(stage, 1, stage_used, outfile);
+		stage_used = 0;
+	}
+}
+
+/* Returns space for length bytes at the end of the staging buffer. */
+static uint8_t* reserve_stage(size_t length)
+{
+	uint8_t* p;
+
+	if (stage_used + length > stage_size) {
+		flush_stage();
+	}
+	p = stage + stage_used;
+	stage_used += length;
+	return p;
+}
+
+static uint8_t* put(uint8_t* p, const void* value, size_t length)
+{
+	memcpy(p, value, length);
+	return p + length;
+}
+
+static void write_v1_record(uint64_t band_low, uint64_t band_high, const float* pwr)
+{
+	const uint32_t record_length =
+		2 * sizeof(uint64_t) + (num_fft_bins / 4) * sizeof(float);
+	uint8_t* p = reserve_stage(sizeof(record_length) + record_length);
+
+	p = put(p, &record_length, sizeof(record_length));
+	p = put(p, &band_low, sizeof(band_low));
+	p = put(p, &band_high, sizeof(band_high));
+	put(p, pwr, (num_fft_bins / 4) * sizeof(float));
+}
+
+/* Small values are flushed to zero, they are far below the resolution. */
+static uint16_t float_to_half(float value)
+{
+	uint32_t bits;
+	uint16_t sign;
+
+	memcpy(&bits, &value, sizeof(bits));
+	sign = (bits >> 16) & 0x8000;
+	bits &= 0x7fffffff;
+	if (bits > 0x7f800000) {
+		return sign | 0x7e00; /* NaN */
+	} else if (bits >= 0x477ff000) {
+		return sign | 0x7c00; /* infinity, or too large */
+	} else if (bits < 0x38800000) {
+		return sign;
+	}
+	// Round to nearest even.
+	bits += 0xfff + ((bits >> 13) & 1);
+	return sign | ((bits - 0x38000000) >> 13);
+}
+
+static size_t v2_value_size(void)
+{
+	return (v2_format == SWEEP_V2_F32) ? sizeof(float) : sizeof(uint16_t);
+}
+
+static uint8_t* put_v2_values(uint8_t* p, const float* pwr)
+{
+	int16_t q;
+	uint16_t h;
+	float v;
+	int i;
+
+	if (v2_format == SWEEP_V2_F32) {
+		return put(p, pwr, (num_fft_bins / 4) * sizeof(float));
+	}
+	for (i = 0; i < num_fft_bins / 4; i++) {
+		if (v2_format == SWEEP_V2_I16) {
+			v = pwr[i] * 100.0f;
+			if (!(v > INT16_MIN)) {
+				q = INT16_MIN;
+			} else if (v > INT16_MAX) {
+				q = INT16_MAX;
+			} else {
+				q = (int16_t) lrintf(v);
+			}
+			p = put(p, &q, sizeof(q));
 		} else {
-			buf += BYTES_PER_BLOCK;
-			continue;
+			h = float_to_half(pwr[i]);
+			p = put(p, &h, sizeof(h));
 		}
-		if (frequency == (uint64_t) (FREQ_ONE_MHZ * frequencies[0])) {
-			if (sweep_started) {
-				if (ifft_output) {
-					fftwf_execute(ifftwPlan);
-					for (i = 0; i < ifft_bins; i++) {
-						ifftwOut[i][0] *= 1.0f / ifft_bins;
-						ifftwOut[i][1] *= 1.0f / ifft_bins;
-						fwrite(&ifftwOut[i][0],
-						       sizeof(float),
-						       1,
-						       outfile);
-						fwrite(&ifftwOut[i][1],
-						       sizeof(float),
-						       1,
-						       outfile);
-					}
-				}
-				sweep_count++;
-
-				if (timestamp_normalized == true) {
-					// set the timestamp of the next sweep
-					gettimeofday(&usb_transfer_time, NULL);
-				}
-
-				if (one_shot) {
-					do_exit = true;
-				} else if (finite_mode && sweep_count == num_sweeps) {
-					do_exit = true;
-				}
+	}
+	return p;
+}
+
+static void write_v2_sweep(const hackrf_sweep_row* row)
+{
+	const uint16_t type = SWEEP_V2_SWEEP;
+	const uint16_t length = SWEEP_V2_SWEEP_LENGTH + num_ranges * 2 * sizeof(uint16_t);
+	const uint8_t version = SWEEP_V2_VERSION;
+	const uint8_t format = (uint8_t) v2_format;
+	const uint16_t bins = num_fft_bins / 4;
+	const uint32_t sample_rate = DEFAULT_SAMPLE_RATE_HZ;
+	const uint16_t ranges = num_ranges;
+	const uint16_t reserved = 0;
+	uint8_t* p = reserve_stage(length);
+
+	p = put(p, &type, sizeof(type));
+	p = put(p, &length, sizeof(length));
+	p = put(p, "HRSW", 4);
+	p = put(p, &version, sizeof(version));
+	p = put(p, &format, sizeof(format));
+	p = put(p, &bins, sizeof(bins));
+	p = put(p, &v2_sweep_index, sizeof(v2_sweep_index));
+	p = put(p, &row->time, sizeof(row->time));
+	p = put(p, &row->device_time, sizeof(row->device_time));
+	p = put(p, &fft_bin_width, sizeof(fft_bin_width));
+	p = put(p, &sample_rate, sizeof(sample_rate));
+	p = put(p, &ranges, sizeof(ranges));
+	p = put(p, &reserved, sizeof(reserved));
+	put(p, frequencies, num_ranges * 2 * sizeof(uint16_t));
+	v2_sweep_index++;
+}
+
+static void write_v2_step(const hackrf_sweep_row* row)
+{
+	const uint16_t type = SWEEP_V2_STEP;
+	const uint16_t length =
+		SWEEP_V2_STEP_LENGTH + (num_fft_bins / 2) * v2_value_size();
+	uint8_t* p;
+
+	if (v2_new_sweep) {
+		write_v2_sweep(row);
+		v2_new_sweep = false;
+	}
+
+	p = reserve_stage(length);
+	p = put(p, &type, sizeof(type));
+	p = put(p, &length, sizeof(length));
+	p = put(p, &row->num_samples, sizeof(row->num_samples));
+	p = put(p, &row->frequency, sizeof(row->frequency));
+	p = put_v2_values(p, row->pwr[0]);
+	put_v2_values(p, row->pwr[1]);
+}
+
+/* Lay the ranges out side by side in a row, returns the row length. */
+static uint32_t layout_row(waterfall_range_t* ranges)
+{
+	uint32_t row_length = 0;
+	uint32_t columns;
+	int i;
+
+	for (i = 0; i < num_ranges; i++) {
+		columns = (frequencies[2 * i + 1] - frequencies[2 * i]) / TUNE_STEP *
+			num_fft_bins;
+		ranges[i].frequency = FREQ_ONE_MHZ * frequencies[2 * i];
+		ranges[i].first_column = row_length;
+		ranges[i].num_columns = columns;
+		row_length += columns;
+	}
+	return row_length;
+}
+
+/* Copy the bands of a tuning step to their columns of a row. */
+static void copy_step_to_row(
+	const waterfall_range_t* ranges,
+	uint32_t ranges_count,
+	float* row_values,
+	const hackrf_sweep_row* step)
+{
+	const uint64_t band_width = DEFAULT_SAMPLE_RATE_HZ / 4;
+	const int bins = step->num_bins;
+	const uint64_t bands[2] = {step->frequency, step->frequency + band_width * 2};
+	const waterfall_range_t* range;
+	uint64_t band;
+	uint32_t i, j;
+
+	for (i = 0; i < ranges_count; i++) {
+		range = &ranges[i];
+		for (j = 0; j < 2; j++) {
+			if (bands[j] < range->frequency) {
+				continue;
 			}
-			sweep_started = true;
-		}
-		if (do_exit) {
-			return 0;
-		}
-		if (!sweep_started) {
-			buf += BYTES_PER_BLOCK;
-			continue;
+			band = (bands[j] - range->frequency) / band_width;
+			if ((band + 1) * bins > range->num_columns) {
+				continue;
+			}
+			memcpy(&row_values[range->first_column + band * bins],
+			       step->pwr[j],
+			       bins * sizeof(float));
 		}
-		if ((FREQ_MAX_MHZ * FREQ_ONE_MHZ) < frequency) {
-			buf += BYTES_PER_BLOCK;
-			continue;
+	}
+}
+
+#ifndef _WIN32
+static int waterfall_fd = -1;
+static FILE* waterfall_index = NULL;
+static waterfall_header_t* waterfall = NULL; /* the whole mapped file */
+static size_t waterfall_size;
+static bool waterfall_row_started = false;
+static waterfall_index_t waterfall_row_time;
+
+static size_t waterfall_file_size(uint64_t rows)
+{
+	return WATERFALL_HEADER_LENGTH +
+		(size_t) rows * waterfall->row_length * sizeof(float);
+}
+
+/* Resize the file to hold rows rows and map it again. */
+static int map_waterfall(uint64_t rows)
+{
+	waterfall_header_t header = *waterfall;
+	size_t size = WATERFALL_HEADER_LENGTH +
+		(size_t) rows * header.row_length * sizeof(float);
+
+	if (munmap(waterfall, waterfall_size) != 0) {
+		return -1;
+	}
+	waterfall = NULL;
+	if (ftruncate(waterfall_fd, size) != 0) {
+		return -1;
+	}
+	waterfall = (waterfall_header_t*)
+		mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, waterfall_fd, 0);
+	if (waterfall == MAP_FAILED) {
+		waterfall = NULL;
+		return -1;
+	}
+	waterfall_size = size;
+	waterfall->rows_allocated = rows;
+	return 0;
+}
+
+static int open_waterfall(const char* path, uint64_t rows)
+{
+	waterfall_header_t header;
+	char* index_path;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "HRFWFALL", sizeof(header.magic));
+	header.version = WATERFALL_VERSION;
+	header.header_length = WATERFALL_HEADER_LENGTH;
+	header.num_ranges = num_ranges;
+	header.bin_width = fft_bin_width;
+	header.sample_rate = DEFAULT_SAMPLE_RATE_HZ;
+	header.row_length = layout_row(header.ranges);
+
+	waterfall_fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (waterfall_fd < 0) {
+		return -1;
+	}
+	waterfall_size = WATERFALL_HEADER_LENGTH;
+	if (ftruncate(waterfall_fd, waterfall_size) != 0) {
+		return -1;
+	}
+	waterfall = (waterfall_header_t*) mmap(
+		NULL,
+		waterfall_size,
+		PROT_READ | PROT_WRITE,
+		MAP_SHARED,
+		waterfall_fd,
+		0);
+	if (waterfall == MAP_FAILED) {
+		waterfall = NULL;
+		return -1;
+	}
+	*waterfall = header;
+	if (map_waterfall(rows) != 0) {
+		return -1;
+	}
+
+	index_path = (char*) malloc(strlen(path) + 5);
+	if (index_path == NULL) {
+		return -1;
+	}
+	sprintf(index_path, "%s.idx", path);
+	waterfall_index = fopen(index_path, "wb");
+	free(index_path);
+	return (waterfall_index == NULL) ? -1 : 0;
+}
+
+static void write_waterfall(const hackrf_sweep_row* step)
+{
+	uint64_t row = waterfall->rows_complete;
+	float* row_values;
+	uint32_t i;
+
+	if (!waterfall_row_started) {
+		if ((row == waterfall->rows_allocated) &&
+		    (map_waterfall(row * 2) != 0)) {
+			fprintf(stderr,
+				"Failed to grow waterfall file: %s\n",
+				strerror(errno));
+			do_exit = true;
+			return;
 		}
-		/* copy to fftwIn as floats */
-		buf += BYTES_PER_BLOCK - (num_fft_bins * 2);
-		for (i = 0; i < num_fft_bins; i++) {
-			fftwIn[i][0] = buf[i * 2] * window[i] * 1.0f / 128.0f;
-			fftwIn[i][1] = buf[i * 2 + 1] * window[i] * 1.0f / 128.0f;
+		row_values = (float*) ((uint8_t*) waterfall + waterfall_file_size(row));
+		for (i = 0; i < waterfall->row_length; i++) {
+			row_values[i] = NAN;
 		}
-		buf += num_fft_bins * 2;
-		fftwf_execute(fftwPlan);
-		for (i = 0; i < num_fft_bins; i++) {
-			pwr[i] = logPower(fftwOut[i], 1.0f / num_fft_bins);
+		waterfall_row_time.time = step->time;
+		waterfall_row_time.device_time = step->device_time;
+		waterfall_row_started = true;
+	}
+
+	row_values = (float*) ((uint8_t*) waterfall + waterfall_file_size(row));
+	copy_step_to_row(waterfall->ranges, waterfall->num_ranges, row_values, step);
+}
+
+/* Called at the end of each sweep to publish its row. */
+static void finish_waterfall_row(void)
+{
+	if (!waterfall_row_started) {
+		return;
+	}
+	fwrite(&waterfall_row_time, sizeof(waterfall_row_time), 1, waterfall_index);
+	fflush(waterfall_index);
+	// Make sure readers see the whole row before the new count.
+	__sync_synchronize();
+	waterfall->rows_complete++;
+	waterfall_row_started = false;
+}
+
+static void close_waterfall(void)
+{
+	if (waterfall != NULL) {
+		// Drop unused rows, and any incomplete one.
+		map_waterfall(waterfall->rows_complete);
+		munmap(waterfall, waterfall_size);
+		waterfall = NULL;
+	}
+	if (waterfall_fd >= 0) {
+		close(waterfall_fd);
+		waterfall_fd = -1;
+	}
+	if (waterfall_index != NULL) {
+		fclose(waterfall_index);
+		waterfall_index = NULL;
+	}
+}
+
+static int ring_fd = -1;
+static ring_header_t* ring = NULL; /* the whole shared memory object */
+static size_t ring_size;
+static ring_slot_t* ring_slot = NULL; /* slot of the row being written */
+
+static int open_ring(void)
+{
+	ring_header_t header;
+	size_t slot_length;
+
+	memset(&header, 0, sizeof(header));
+	header.version = RING_VERSION;
+	header.header_length = RING_HEADER_LENGTH;
+	header.num_ranges = num_ranges;
+	header.num_slots = ring_slots;
+	header.bin_width = fft_bin_width;
+	header.sample_rate = DEFAULT_SAMPLE_RATE_HZ;
+	header.row_length = layout_row(header.ranges);
+	// Keep slots cache line aligned.
+	slot_length = (sizeof(ring_slot_t) + header.row_length * sizeof(float) + 63) &
+		~(size_t) 63;
+	header.slot_length = (uint32_t) slot_length;
+	ring_size = RING_HEADER_LENGTH + slot_length * ring_slots;
+
+	// Readers of a previous ring keep their mapping of the old object.
+	shm_unlink(ring_name);
+	ring_fd = shm_open(ring_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (ring_fd < 0) {
+		return -1;
+	}
+	if (ftruncate(ring_fd, ring_size) != 0) {
+		return -1;
+	}
+	ring = (ring_header_t*)
+		mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
+	if (ring == MAP_FAILED) {
+		ring = NULL;
+		return -1;
+	}
+	*ring = header;
+	// Readers wait for the magic before they look at the rest of the header.
+	__sync_synchronize();
+	memcpy(ring->magic, "HRFSRING", sizeof(ring->magic));
+	return 0;
+}
+
+static void write_ring(const hackrf_sweep_row* step)
+{
+	const uint64_t row = ring->rows_published;
+	float* row_values;
+	uint32_t i;
+
+	if (ring_slot == NULL) {
+		ring_slot = (ring_slot_t*) ((uint8_t*) ring + RING_HEADER_LENGTH +
+					    (row % ring->num_slots) * ring->slot_length);
+		ring_slot->sequence = RING_SLOT_BUSY;
+		__sync_synchronize();
+		row_values = (float*) (ring_slot + 1);
+		for (i = 0; i < ring->row_length; i++) {
+			row_values[i] = NAN;
 		}
-		if (binary_output) {
-			record_length = 2 * sizeof(band_edge) +
-				(num_fft_bins / 4) * sizeof(float);
-
-			fwrite(&record_length, sizeof(record_length), 1, outfile);
-			band_edge = frequency;
-			fwrite(&band_edge, sizeof(band_edge), 1, outfile);
-			band_edge = frequency + DEFAULT_SAMPLE_RATE_HZ / 4;
-			fwrite(&band_edge, sizeof(band_edge), 1, outfile);
-			fwrite(&pwr[1 + (num_fft_bins * 5) / 8],
-			       sizeof(float),
-			       num_fft_bins / 4,
-			       outfile);
-
-			fwrite(&record_length, sizeof(record_length), 1, outfile);
-			band_edge = frequency + DEFAULT_SAMPLE_RATE_HZ / 2;
-			fwrite(&band_edge, sizeof(band_edge), 1, outfile);
-			band_edge = frequency + (DEFAULT_SAMPLE_RATE_HZ * 3) / 4;
-			fwrite(&band_edge, sizeof(band_edge), 1, outfile);
-			fwrite(&pwr[1 + num_fft_bins / 8],
-			       sizeof(float),
-			       num_fft_bins / 4,
-			       outfile);
-		} else if (ifft_output) {
-			ifft_idx = (uint32_t) round(
-				(frequency - (uint64_t) (FREQ_ONE_MHZ * frequencies[0])) /
-				fft_bin_width);
-			ifft_idx = (ifft_idx + ifft_bins / 2) % ifft_bins;
-			for (i = 0; (num_fft_bins / 4) > i; i++) {
-				ifftwIn[ifft_idx + i][0] =
-					fftwOut[i + 1 + (num_fft_bins * 5) / 8][0];
-				ifftwIn[ifft_idx + i][1] =
-					fftwOut[i + 1 + (num_fft_bins * 5) / 8][1];
-			}
+		ring_slot->time = step->time;
+		ring_slot->device_time = step->device_time;
+	}
+
+	row_values = (float*) (ring_slot + 1);
+	copy_step_to_row(ring->ranges, ring->num_ranges, row_values, step);
+}
+
+/* Called at the end of each sweep to publish its row. */
+static void finish_ring_row(void)
+{
+	const uint64_t row = ring->rows_published;
+
+	if (ring_slot == NULL) {
+		return;
+	}
+	__sync_synchronize();
+	ring_slot->sequence = row;
+	__sync_synchronize();
+	ring->rows_published = row + 1;
+	ring_slot = NULL;
+}
+
+static void close_ring(void)
+{
+	if (ring != NULL) {
+		ring->closed = 1;
+		munmap(ring, ring_size);
+		ring = NULL;
+		shm_unlink(ring_name);
+	}
+	if (ring_fd >= 0) {
+		close(ring_fd);
+		ring_fd = -1;
+	}
+}
+#else
+static int open_waterfall(const char* path, uint64_t rows)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+static void write_waterfall(const hackrf_sweep_row* step)
+{
+}
+
+static void finish_waterfall_row(void)
+{
+}
+
+static void close_waterfall(void)
+{
+}
+
+static int open_ring(void)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+static void write_ring(const hackrf_sweep_row* step)
+{
+}
+
+static void finish_ring_row(void)
+{
+}
+
+static void close_ring(void)
+{
+}
+#endif
+
+static void write_block(const hackrf_sweep_row* row, void* ctx)
+{
+	const uint64_t frequency = row->frequency;
+	const time_t time_stamp_seconds = (time_t) (row->time / 1000000);
+	const long int time_stamp_usec = (long int) (row->time % 1000000);
+	int i, j, ifft_bins = num_fft_bins * step_count;
+	struct tm* fft_time;
+	char time_str[50];
+
+	if (waterfall_output) {
+		write_waterfall(row);
+	} else if (ring_output) {
+		write_ring(row);
+	} else if (binary_output && (binary_version == 1)) {
+		write_v1_record(
+			frequency,
+			frequency + DEFAULT_SAMPLE_RATE_HZ / 4,
+			row->pwr[0]);
+		write_v1_record(
+			frequency + DEFAULT_SAMPLE_RATE_HZ / 2,
+			frequency + (DEFAULT_SAMPLE_RATE_HZ * 3) / 4,
+			row->pwr[1]);
+	} else if (binary_output) {
+		write_v2_step(row);
+	} else if (ifft_output) {
+		ifft_idx = (uint32_t) round(
+			(frequency - (uint64_t) (FREQ_ONE_MHZ * frequencies[0])) /
+			fft_bin_width);
+		ifft_idx = (ifft_idx + ifft_bins / 2) % ifft_bins;
+		for (j = 0; j < 2; j++) {
+			memcpy(ifft.in[ifft.fill][ifft_idx],
+			       row->spectrum[j],
+			       sizeof(fftwf_complex) * row->num_bins);
 			ifft_idx += num_fft_bins / 2;
 			ifft_idx %= ifft_bins;
-			for (i = 0; (num_fft_bins / 4) > i; i++) {
-				ifftwIn[ifft_idx + i][0] =
-					fftwOut[i + 1 + (num_fft_bins / 8)][0];
-				ifftwIn[ifft_idx + i][1] =
-					fftwOut[i + 1 + (num_fft_bins / 8)][1];
-			}
-		} else {
-			time_t time_stamp_seconds = usb_transfer_time.tv_sec;
-			fft_time = localtime(&time_stamp_seconds);
-			strftime(time_str, 50, "%Y-%m-%d, %H:%M:%S", fft_time);
-			fprintf(outfile,
-				"%s.%06ld, %" PRIu64 ", %" PRIu64 ", %.2f, %u",
-				time_str,
-				(long int) usb_transfer_time.tv_usec,
-				(uint64_t) (frequency),
-				(uint64_t) (frequency + DEFAULT_SAMPLE_RATE_HZ / 4),
-				fft_bin_width,
-				num_fft_bins);
-			for (i = 0; (num_fft_bins / 4) > i; i++) {
-				fprintf(outfile,
-					", %.2f",
-					pwr[i + 1 + (num_fft_bins * 5) / 8]);
-			}
-			fprintf(outfile, "\n");
-			fprintf(outfile,
-				"%s.%06ld, %" PRIu64 ", %" PRIu64 ", %.2f, %u",
-				time_str,
-				(long int) usb_transfer_time.tv_usec,
-				(uint64_t) (frequency + (DEFAULT_SAMPLE_RATE_HZ / 2)),
-				(uint64_t) (frequency + ((DEFAULT_SAMPLE_RATE_HZ * 3) / 4)),
-				fft_bin_width,
-				num_fft_bins);
-			for (i = 0; (num_fft_bins / 4) > i; i++) {
-				fprintf(outfile,
-					", %.2f",
-					pwr[i + 1 + (num_fft_bins / 8)]);
-			}
-			fprintf(outfile, "\n");
 		}
+	} else {
+		fft_time = localtime(&time_stamp_seconds);
+		strftime(time_str, 50, "%Y-%m-%d, %H:%M:%S", fft_time);
+		fprintf(outfile,
+			"%s.%06ld, %" PRIu64 ", %" PRIu64 ", %.2f, %u",
+			time_str,
+			time_stamp_usec,
+			(uint64_t) (frequency),
+			(uint64_t) (frequency + DEFAULT_SAMPLE_RATE_HZ / 4),
+			fft_bin_width,
+			row->num_samples);
+		for (i = 0; row->num_bins > i; i++) {
+			fprintf(outfile, ", %.2f", row->pwr[0][i]);
+		}
+		fprintf(outfile, "\n");
+		fprintf(outfile,
+			"%s.%06ld, %" PRIu64 ", %" PRIu64 ", %.2f, %u",
+			time_str,
+			time_stamp_usec,
+			(uint64_t) (frequency + (DEFAULT_SAMPLE_RATE_HZ / 2)),
+			(uint64_t) (frequency + ((DEFAULT_SAMPLE_RATE_HZ * 3) / 4)),
+			fft_bin_width,
+			row->num_samples);
+		for (i = 0; row->num_bins > i; i++) {
+			fprintf(outfile, ", %.2f", row->pwr[1][i]);
+		}
+		fprintf(outfile, "\n");
 	}
-	return 0;
+}
+
+static void end_sweep(uint64_t sweep, void* ctx)
+{
+	if (ifft_output) {
+		write_ifft();
+	}
+	v2_new_sweep = true;
+	if (waterfall_output) {
+		finish_waterfall_row();
+	}
+	if (ring_output) {
+		finish_ring_row();
+	}
+}
+
+static void end_transfer(void* ctx)
+{
+	flush_stage();
+}
+
+/* Parse name[:slots] of the shared memory ring, adding a leading '/' to the name. */
+int parse_ring(char* s)
+{
+	int result = HACKRF_SUCCESS;
+	char* sep = strchr(s, ':');
+
+	if (sep) {
+		*sep = 0;
+		result = parse_u32(sep + 1, &ring_slots);
+		if ((result == HACKRF_SUCCESS) && (ring_slots < 2)) {
+			result = HACKRF_ERROR_INVALID_PARAM;
+		}
+	}
+	if ((*s == 0) || (strlen(s) + 2 > sizeof(ring_name))) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+	snprintf(ring_name, sizeof(ring_name), "%s%s", (*s == '/') ? "" : "/", s);
+	return result;
 }
 
 static void usage()
@@ -398,10 +1082,20 @@ static void usage()
 		"\t[-w bin_width] # FFT bin width (frequency resolution) in Hz, 2445-5000000\n"
 		"\t[-W wisdom_file] # Use FFTW wisdom file (will be created if necessary)\n"
 		"\t[-P estimate|measure|patient|exhaustive] # FFTW plan type, default is 'measure'\n"
+		"\t[-t num_threads] # FFT worker threads, default is the number of CPUs\n"
+		"\t[-e exact|fast] # power calculation, default is 'fast'\n"
+		"\t[-A avg|max] # Welch mode, average or max-hold spectra of all samples\n"
+		"\t[-D dwell_blocks] # blocks per tuning step in Welch or -O mode, default 1\n"
+		"\t[-O] # compute spectra on the HackRF, 16-256 bins, bin width 78125-1250000\n"
+		"\t[-k block_size] # bytes per block, power of two 1024-16384, default 16384\n"
+		"\t[-s settle_us] # settle time after each retune in microseconds\n"
 		"\t[-1] # one shot mode\n"
 		"\t[-N num_sweeps] # Number of sweeps to perform\n"
 		"\t[-B] # binary output\n"
+		"\t[-F f32|i16|f16] # binary output format v2 with float32, int16 or float16 dB\n"
 		"\t[-I] # binary inverse FFT output\n"
+		"\t[-M] # memory-mapped waterfall output with time index, requires -r\n"
+		"\t[-S name[:slots]] # publish sweeps to a shared memory ring, default 16 slots\n"
 		"\t[-n] # keep the same timestamp within a sweep\n"
 		"\t-r filename # output file\n"
 		"\n"
@@ -473,10 +1167,22 @@ int main(int argc, char** argv)
 	uint32_t freq_min = 0;
 	uint32_t freq_max = 6000;
 	uint32_t requested_fft_bin_width;
+	uint32_t requested_threads;
+	int max_fft_bins;
+	int requested_fft_bins;
+	uint64_t waterfall_rows;
 	const char* fftwWisdomPath = NULL;
 	int fftw_plan_type = FFTW_MEASURE;
-
-	while ((opt = getopt(argc, argv, "a:f:p:l:g:d:N:w:W:P:n1BIr:h?")) != EOF) {
+	enum hackrf_sweep_plan sweep_plan = HACKRF_SWEEP_PLAN_MEASURE;
+	hackrf_sweep_config config;
+	const hackrf_sweep_config* engine_config;
+	hackrf_sweep_engine* engine = NULL;
+	uint64_t byte_count, prev_byte_count = 0;
+
+	while ((opt = getopt(
+			argc,
+			argv,
+			"a:f:p:l:g:d:N:w:W:P:t:e:A:D:Ok:s:n1BF:IMS:r:h?")) != EOF) {
 		result = HACKRF_SUCCESS;
 		switch (opt) {
 		case 'd':
@@ -545,18 +1251,71 @@ int main(int argc, char** argv)
 		case 'P':
 			if (strcmp("estimate", optarg) == 0) {
 				fftw_plan_type = FFTW_ESTIMATE;
+				sweep_plan = HACKRF_SWEEP_PLAN_ESTIMATE;
 			} else if (strcmp("measure", optarg) == 0) {
 				fftw_plan_type = FFTW_MEASURE;
+				sweep_plan = HACKRF_SWEEP_PLAN_MEASURE;
 			} else if (strcmp("patient", optarg) == 0) {
 				fftw_plan_type = FFTW_PATIENT;
+				sweep_plan = HACKRF_SWEEP_PLAN_PATIENT;
 			} else if (strcmp("exhaustive", optarg) == 0) {
 				fftw_plan_type = FFTW_EXHAUSTIVE;
+				sweep_plan = HACKRF_SWEEP_PLAN_EXHAUSTIVE;
 			} else {
 				fprintf(stderr, "Unknown FFTW plan type '%s'\n", optarg);
 				return EXIT_FAILURE;
 			}
 			break;
 
+		case 't':
+			result = parse_u32(optarg, &requested_threads);
+			if ((result == HACKRF_SUCCESS) && (requested_threads == 0)) {
+				result = HACKRF_ERROR_INVALID_PARAM;
+			}
+			num_threads = (int) requested_threads;
+			break;
+
+		case 'e':
+			if (strcmp("exact", optarg) == 0) {
+				db_mode = HACKRF_DB_EXACT;
+			} else if (strcmp("fast", optarg) == 0) {
+				db_mode = HACKRF_DB_FAST;
+			} else {
+				fprintf(stderr,
+					"Unknown power calculation '%s'\n",
+					optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+
+		case 'A':
+			if (strcmp("avg", optarg) == 0) {
+				welch_mode = HACKRF_SWEEP_AVERAGE_MEAN;
+			} else if (strcmp("max", optarg) == 0) {
+				welch_mode = HACKRF_SWEEP_AVERAGE_MAX;
+			} else {
+				fprintf(stderr, "Unknown Welch mode '%s'\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+
+		case 'D':
+			result = parse_u32(optarg, &dwell_blocks);
+			break;
+
+		case 'O':
+			device_spectrum = true;
+			break;
+
+		case 'k':
+			result = parse_u32(optarg, &block_size);
+			break;
+
+		case 's':
+			result = parse_u32(optarg, &settle_us);
+			settle_set = true;
+			break;
+
 		case 'n':
 			timestamp_normalized = true;
 			break;
@@ -569,10 +1328,36 @@ int main(int argc, char** argv)
 			binary_output = true;
 			break;
 
+		case 'F':
+			binary_output = true;
+			binary_version = 2;
+			if (strcmp("f32", optarg) == 0) {
+				v2_format = SWEEP_V2_F32;
+			} else if (strcmp("i16", optarg) == 0) {
+				v2_format = SWEEP_V2_I16;
+			} else if (strcmp("f16", optarg) == 0) {
+				v2_format = SWEEP_V2_F16;
+			} else {
+				fprintf(stderr,
+					"Unknown binary value format '%s'\n",
+					optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+
 		case 'I':
 			ifft_output = true;
 			break;
 
+		case 'M':
+			waterfall_output = true;
+			break;
+
+		case 'S':
+			ring_output = true;
+			result = parse_ring(optarg);
+			break;
+
 		case 'r':
 			path = optarg;
 			break;
@@ -645,6 +1430,69 @@ int main(int argc, char** argv)
 		return EXIT_FAILURE;
 	}
 
+	if (waterfall_output && (binary_output || ifft_output)) {
+		fprintf(stderr,
+			"argument error: waterfall output (-M) can't be combined with binary (-B, -F) or IFFT output (-I).\n");
+		return EXIT_FAILURE;
+	}
+
+	if (waterfall_output && ((NULL == path) || (strcmp(path, "-") == 0))) {
+		fprintf(stderr,
+			"argument error: waterfall output (-M) requires a file (-r).\n");
+		return EXIT_FAILURE;
+	}
+
+	if (ring_output &&
+	    (binary_output || ifft_output || waterfall_output || (NULL != path))) {
+		fprintf(stderr,
+			"argument error: shared memory output (-S) can't be combined with other outputs (-B, -F, -I, -M, -r).\n");
+		return EXIT_FAILURE;
+	}
+
+	if (ifft_output && (welch_mode != HACKRF_SWEEP_AVERAGE_OFF)) {
+		fprintf(stderr,
+			"argument error: Welch mode (-A) is not supported in IFFT output (-I) mode.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (device_spectrum && (ifft_output || (welch_mode != HACKRF_SWEEP_AVERAGE_OFF))) {
+		fprintf(stderr,
+			"argument error: device spectra (-O) can't be combined with Welch mode (-A) or IFFT output (-I).\n");
+		return EXIT_FAILURE;
+	}
+
+	if ((1 != dwell_blocks) && (welch_mode == HACKRF_SWEEP_AVERAGE_OFF) &&
+	    !device_spectrum) {
+		fprintf(stderr,
+			"argument error: dwell blocks (-D) require Welch mode (-A) or device spectra (-O).\n");
+		return EXIT_FAILURE;
+	}
+
+	if ((1 > dwell_blocks) || (MAX_DWELL_BLOCKS < dwell_blocks)) {
+		fprintf(stderr,
+			"argument error: dwell blocks (-D) must be between 1 and %d.\n",
+			MAX_DWELL_BLOCKS);
+		return EXIT_FAILURE;
+	}
+
+	if ((HACKRF_SWEEP_MIN_BLOCK_SIZE > block_size) ||
+	    (BYTES_PER_BLOCK < block_size) || (block_size & (block_size - 1))) {
+		fprintf(stderr,
+			"argument error: block size (-k) must be a power of two from %d to %d.\n",
+			HACKRF_SWEEP_MIN_BLOCK_SIZE,
+			BYTES_PER_BLOCK);
+		return EXIT_FAILURE;
+	}
+
+	if ((uint64_t) settle_us * DEFAULT_SAMPLE_RATE_HZ / 1000000 >
+	    HACKRF_SWEEP_MAX_SETTLE_SAMPLES) {
+		fprintf(stderr,
+			"argument error: settle time (-s) must be no more than %d us.\n",
+			(int) ((uint64_t) HACKRF_SWEEP_MAX_SETTLE_SAMPLES * 1000000 /
+			       DEFAULT_SAMPLE_RATE_HZ));
+		return EXIT_FAILURE;
+	}
+
 	if (ifft_output && (1 < num_ranges)) {
 		fprintf(stderr,
 			"argument error: only one frequency range is supported in IFFT output (-I) mode.\n");
@@ -664,11 +1512,12 @@ int main(int argc, char** argv)
 
 	/*
 	 * The maximum number of FFT bins we support is equal to the number of
-	 * samples in a block. Each block consists of 16384 bytes minus 10
-	 * bytes for the frequency header, leaving room for 8187 two-byte
-	 * samples. As we pad num_fft_bins up to the next odd multiple of four, this
-	 * makes our maximum supported num_fft_bins 8180.  With our fixed sample
-	 * rate of 20 Msps, that results in a minimum bin width of 2445 Hz.
+	 * samples in a block. Each block consists of 16384 bytes minus 14
+	 * bytes for the frequency and sample count header, leaving 16370 bytes,
+	 * room for 8185 two-byte samples. As we pad num_fft_bins up to the next
+	 * odd multiple of four, this makes our maximum supported num_fft_bins
+	 * 8180.  With our fixed sample rate of 20 Msps, that results in a minimum
+	 * bin width of 2445 Hz.
 	 */
 	if (8180 < num_fft_bins) {
 		fprintf(stderr,
@@ -676,37 +1525,74 @@ int main(int argc, char** argv)
 		return EXIT_FAILURE;
 	}
 
+	/*
+	 * The HackRF only computes power of two FFT sizes from 16 to 256, so
+	 * round the number of bins up to one of those.
+	 */
+	if (device_spectrum) {
+		requested_fft_bins = num_fft_bins;
+		num_fft_bins = HACKRF_SPECTRUM_MIN_FFT_SIZE;
+		while (num_fft_bins < requested_fft_bins) {
+			num_fft_bins *= 2;
+		}
+		if (HACKRF_SPECTRUM_MAX_FFT_SIZE < num_fft_bins) {
+			fprintf(stderr,
+				"argument error: FFT bin width (-w) must be no less than %d with device spectra (-O)\n",
+				DEFAULT_SAMPLE_RATE_HZ / HACKRF_SPECTRUM_MAX_FFT_SIZE);
+			return EXIT_FAILURE;
+		}
+	}
+
 	/* In interleaved mode, the FFT bin selection works best if the total
 	 * number of FFT bins is equal to an odd multiple of four.
 	 * (e.g. 4, 12, 20, 28, 36, . . .)
 	 */
-	while ((num_fft_bins + 4) % 8) {
+	while (!device_spectrum && ((num_fft_bins + 4) % 8)) {
 		num_fft_bins++;
 	}
 
-	fft_bin_width = (double) DEFAULT_SAMPLE_RATE_HZ / num_fft_bins;
-	fftwIn = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex) * num_fft_bins);
-	fftwOut = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex) * num_fft_bins);
-	fftwPlan = fftwf_plan_dft_1d(
-		num_fft_bins,
-		fftwIn,
-		fftwOut,
-		FFTW_FORWARD,
-		fftw_plan_type);
-	pwr = (float*) fftwf_malloc(sizeof(float) * num_fft_bins);
-	window = (float*) fftwf_malloc(sizeof(float) * num_fft_bins);
-	for (i = 0; i < num_fft_bins; i++) {
-		window[i] =
-			(float) (0.5f * (1.0f - cos(2 * M_PI * i / (num_fft_bins - 1))));
+	/*
+	 * Smaller blocks (-k) hold fewer samples after the 14 byte header, so
+	 * they have a lower maximum num_fft_bins than 8180.
+	 */
+	max_fft_bins = (block_size - 14) / 2;
+	while ((max_fft_bins + 4) % 8) {
+		max_fft_bins--;
+	}
+	if (max_fft_bins < num_fft_bins) {
+		fprintf(stderr,
+			"argument error: FFT bin width (-w) must be no less than %d with block size (-k) %u\n",
+			(DEFAULT_SAMPLE_RATE_HZ + max_fft_bins - 1) / max_fft_bins,
+			block_size);
+		return EXIT_FAILURE;
 	}
 
-	/* Execute the plan once to make sure it's ready to go when real
-	 * data starts to flow.  See issue #1366
-	*/
-	fftwf_execute(fftwPlan);
+	fft_bin_width = (double) DEFAULT_SAMPLE_RATE_HZ / num_fft_bins;
 
-	// reset the timestamp
-	memset(&usb_transfer_time, 0, sizeof(usb_transfer_time));
+	hackrf_sweep_config_init(&config);
+	memcpy(config.frequencies, frequencies, sizeof(frequencies));
+	config.num_ranges = num_ranges;
+	config.fft_size = num_fft_bins;
+	config.num_threads = num_threads;
+	config.plan = sweep_plan;
+	config.db_mode = db_mode;
+	config.average = welch_mode;
+	config.dwell_blocks = dwell_blocks;
+	config.block_size = block_size;
+	config.settle_samples =
+		(uint32_t) ((uint64_t) settle_us * DEFAULT_SAMPLE_RATE_HZ / 1000000);
+	config.settle_set = settle_set;
+	if (one_shot) {
+		config.num_sweeps = 1;
+	} else if (finite_mode) {
+		config.num_sweeps = num_sweeps;
+	}
+	config.spectrum = ifft_output;
+	config.device_spectrum = device_spectrum;
+	config.normalize_timestamps = timestamp_normalized;
+	config.row_callback = write_block;
+	config.sweep_callback = end_sweep;
+	config.transfer_callback = end_transfer;
 
 #ifdef _MSC_VER
 	if (binary_output) {
@@ -734,18 +1620,20 @@ int main(int argc, char** argv)
 		return EXIT_FAILURE;
 	}
 
-	if ((NULL == path) || (strcmp(path, "-") == 0)) {
+	if (waterfall_output || ring_output) {
+		// Opened once the frequency ranges are final.
+	} else if ((NULL == path) || (strcmp(path, "-") == 0)) {
 		outfile = stdout;
 	} else {
 		outfile = fopen(path, "wb");
 	}
 
-	if (NULL == outfile) {
+	if ((NULL == outfile) && !waterfall_output && !ring_output) {
 		fprintf(stderr, "Failed to open file: %s\n", path);
 		return EXIT_FAILURE;
 	}
 	/* Change outfile buffer to have bigger one to store or read data on/to HDD */
-	result = setvbuf(outfile, NULL, _IOFBF, FD_BUFFER_SIZE);
+	result = outfile ? setvbuf(outfile, NULL, _IOFBF, FD_BUFFER_SIZE) : 0;
 	if (result != 0) {
 		fprintf(stderr, "setvbuf() failed: %d\n", result);
 		usage();
@@ -793,60 +1681,79 @@ int main(int argc, char** argv)
 	result = hackrf_set_vga_gain(device, vga_gain);
 	result |= hackrf_set_lna_gain(device, lna_gain);
 
-	/*
-	 * For each range, plan a whole number of tuning steps of a certain
-	 * bandwidth. Increase high end of range if necessary to accommodate a
-	 * whole number of steps, minimum 1.
-	 */
+	result = hackrf_sweep_engine_create(device, &config, &engine);
+	if (result != HACKRF_SUCCESS) {
+		fprintf(stderr,
+			"hackrf_sweep_engine_create() failed: %s (%d)\n",
+			hackrf_error_name(result),
+			result);
+		return EXIT_FAILURE;
+	}
+	engine_config = hackrf_sweep_engine_get_config(engine);
+	fprintf(stderr, "Using %d FFT worker threads\n", engine_config->num_threads);
+
+	// The engine raises each range to a whole number of tuning steps.
+	memcpy(frequencies, engine_config->frequencies, sizeof(frequencies));
 	for (i = 0; i < num_ranges; i++) {
-		step_count =
-			1 + (frequencies[2 * i + 1] - frequencies[2 * i] - 1) / TUNE_STEP;
-		frequencies[2 * i + 1] =
-			(uint16_t) (frequencies[2 * i] + step_count * TUNE_STEP);
+		step_count = (frequencies[2 * i + 1] - frequencies[2 * i]) / TUNE_STEP;
 		fprintf(stderr,
 			"Sweeping from %u MHz to %u MHz\n",
 			frequencies[2 * i],
 			frequencies[2 * i + 1]);
 	}
 
-	if (ifft_output) {
-		ifftwIn = (fftwf_complex*) fftwf_malloc(
-			sizeof(fftwf_complex) * num_fft_bins * step_count);
-		ifftwOut = (fftwf_complex*) fftwf_malloc(
-			sizeof(fftwf_complex) * num_fft_bins * step_count);
-		ifftwPlan = fftwf_plan_dft_1d(
-			num_fft_bins * step_count,
-			ifftwIn,
-			ifftwOut,
-			FFTW_BACKWARD,
-			fftw_plan_type);
-
-		/* Execute the plan once to make sure it's ready to go when real
-	 	 * data starts to flow.  See issue #1366
-		*/
-		fftwf_execute(ifftwPlan);
-	}
-
-	result = hackrf_init_sweep(
-		device,
-		frequencies,
-		num_ranges,
-		BYTES_PER_BLOCK,
-		TUNE_STEP * FREQ_ONE_MHZ,
-		OFFSET,
-		INTERLEAVED);
-	if (result != HACKRF_SUCCESS) {
+	if (waterfall_output) {
+		// Preallocate all rows if we know how many sweeps there will be.
+		waterfall_rows = WATERFALL_INITIAL_ROWS;
+		if (one_shot) {
+			waterfall_rows = 1;
+		} else if (finite_mode && (num_sweeps > 0)) {
+			waterfall_rows = num_sweeps;
+		}
+		result = open_waterfall(path, waterfall_rows);
+		if (result != 0) {
+			fprintf(stderr,
+				"Failed to open waterfall file %s: %s\n",
+				path,
+				strerror(errno));
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (ring_output) {
+		result = open_ring();
+		if (result != 0) {
+			fprintf(stderr,
+				"Failed to create shared memory ring %s: %s\n",
+				ring_name,
+				strerror(errno));
+			return EXIT_FAILURE;
+		}
 		fprintf(stderr,
-			"hackrf_init_sweep() failed: %s (%d)\n",
-			hackrf_error_name(result),
-			result);
+			"Publishing sweeps to shared memory ring %s\n",
+			ring_name);
+	}
+
+	if (ifft_output && (open_ifft(fftw_plan_type) != 0)) {
+		fprintf(stderr, "Failed to set up inverse FFT\n");
+		return EXIT_FAILURE;
+	}
+
+	// Room for a transfer's worth of blocks, the largest record is a v1 pair.
+	stage_size = (hackrf_get_transfer_buffer_size(device) / block_size + 1) *
+		(SWEEP_V2_SWEEP_LENGTH + MAX_SWEEP_RANGES * 2 * sizeof(uint16_t) +
+		 2 * (sizeof(uint32_t) + 2 * sizeof(uint64_t)) +
+		 (num_fft_bins / 2) * sizeof(float));
+	stage = (uint8_t*) malloc(stage_size);
+	if (stage == NULL) {
+		fprintf(stderr, "Failed to allocate output buffer\n");
 		return EXIT_FAILURE;
 	}
 
-	result |= hackrf_start_rx_sweep(device, rx_callback, NULL);
+	result = hackrf_sweep_engine_start(engine);
 	if (result != HACKRF_SUCCESS) {
 		fprintf(stderr,
-			"hackrf_start_rx_sweep() failed: %s (%d)\n",
+			"hackrf_sweep_engine_start() failed: %s (%d)\n",
 			hackrf_error_name(result),
 			result);
 		usage();
@@ -883,13 +1790,16 @@ int main(int argc, char** argv)
 	time_prev = t_start;
 
 	fprintf(stderr, "Stop with Ctrl-C\n");
-	while ((hackrf_is_streaming(device) == HACKRF_TRUE) && (do_exit == false)) {
+	while ((hackrf_is_streaming(device) == HACKRF_TRUE) && (do_exit == false) &&
+	       !hackrf_sweep_engine_is_done(engine)) {
 		float time_difference;
 		m_sleep(50);
 
 		gettimeofday(&time_now, NULL);
 		if (TimevalDiff(&time_now, &time_prev) >= 1.0f) {
 			time_difference = TimevalDiff(&time_now, &t_start);
+			sweep_count = hackrf_sweep_engine_get_sweep_count(engine);
+			byte_count = hackrf_sweep_engine_get_byte_count(engine);
 			sweep_rate = (float) sweep_count / time_difference;
 			fprintf(stderr,
 				"%" PRIu64
@@ -897,20 +1807,19 @@ int main(int argc, char** argv)
 				sweep_count,
 				sweep_rate);
 
-			if (byte_count == 0) {
+			if (byte_count == prev_byte_count) {
 				exit_code = EXIT_FAILURE;
 				fprintf(stderr,
 					"\nCouldn't transfer any data for one second.\n");
 				break;
 			}
-			byte_count = 0;
+			prev_byte_count = byte_count;
 			time_prev = time_now;
 		}
 	}
 
-	fflush(outfile);
 	result = hackrf_is_streaming(device);
-	if (do_exit) {
+	if (do_exit || hackrf_sweep_engine_is_done(engine)) {
 		fprintf(stderr, "\nExiting...\n");
 	} else {
 		fprintf(stderr,
@@ -919,8 +1828,16 @@ int main(int argc, char** argv)
 			result);
 	}
 
+	// Output the rows of all sweep steps received so far.
+	hackrf_sweep_engine_stop(engine);
+	close_ifft();
+	if (outfile != NULL) {
+		fflush(outfile);
+	}
+
 	gettimeofday(&time_now, NULL);
 	time_diff = TimevalDiff(&time_now, &t_start);
+	sweep_count = hackrf_sweep_engine_get_sweep_count(engine);
 	if ((sweep_rate == 0) && (time_diff > 0)) {
 		sweep_rate = sweep_count / time_diff;
 	}
@@ -930,6 +1847,8 @@ int main(int argc, char** argv)
 		time_diff,
 		sweep_rate);
 
+	hackrf_sweep_engine_destroy(engine);
+
 	if (device != NULL) {
 		result = hackrf_close(device);
 		if (result != HACKRF_SUCCESS) {
@@ -945,18 +1864,18 @@ int main(int argc, char** argv)
 		fprintf(stderr, "hackrf_exit() done\n");
 	}
 
-	fflush(outfile);
+	close_waterfall();
+	close_ring();
+
+	if (outfile != NULL) {
+		fflush(outfile);
+	}
 	if ((outfile != NULL) && (outfile != stdout)) {
 		fclose(outfile);
 		outfile = NULL;
 		fprintf(stderr, "fclose() done\n");
 	}
-	fftwf_free(fftwIn);
-	fftwf_free(fftwOut);
-	fftwf_free(pwr);
-	fftwf_free(window);
-	fftwf_free(ifftwIn);
-	fftwf_free(ifftwOut);
+	free(stage);
 	export_wisdom(fftwWisdomPath);
 	fprintf(stderr, "exit\n");
 	return exit_code;
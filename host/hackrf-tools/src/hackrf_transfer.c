@@ -742,6 +742,7 @@ int main(int argc, char** argv)
 	float time_diff;
 	unsigned int lna_gain = 8, vga_gain = 20, txvga_gain = 0;
 	hackrf_m0_state state;
+	hackrf_stream_stats stream_stats;
 	stats_t stats = {0, 0};
 
 	while ((opt = getopt(argc, argv, "Hwr:t:f:i:o:m:a:p:s:Fn:b:l:g:x:c:d:C:RS:Bh?")) !=
@@ -1510,6 +1511,19 @@ int main(int argc, char** argv)
 								     "overruns",
 					state.longest_shortfall);
 			}
+
+			result = hackrf_get_stream_stats(device, &stream_stats);
+			if (result == HACKRF_SUCCESS) {
+				fprintf(stderr,
+					"%" PRIu64 " USB transfers, %" PRIu64
+					" errors, %" PRIu64 " host drops\n"
+					"longest callback %u us, longest turnaround %u us\n",
+					stream_stats.transfers,
+					stream_stats.transfer_errors,
+					stream_stats.host_drops,
+					stream_stats.callback_max_us,
+					stream_stats.turnaround_max_us);
+			}
 		}
 
 		result = hackrf_close(device);
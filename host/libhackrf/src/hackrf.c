@@ -26,6 +26,8 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 #ifndef _WIN32
 	#include <unistd.h>
 	#include <signal.h>
@@ -40,6 +42,105 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 #endif
 #include <pthread.h>
 
+#include "hackrf_usb.h"
+#include "hackrf_emulator.h"
+
+/*
+ * Sequentially consistent access to 32-bit state shared between threads
+ * without holding a lock.
+ */
+static uint32_t atomic_load_u32(volatile uint32_t* ptr)
+{
+#ifdef _MSC_VER
+	uint32_t value;
+	MemoryBarrier();
+	value = *ptr;
+	MemoryBarrier();
+	return value;
+#else
+	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static void atomic_store_u32(volatile uint32_t* ptr, uint32_t value)
+{
+#ifdef _MSC_VER
+	InterlockedExchange((volatile LONG*) ptr, (LONG) value);
+#else
+	__atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static uint32_t atomic_exchange_u32(volatile uint32_t* ptr, uint32_t value)
+{
+#ifdef _MSC_VER
+	return (uint32_t) InterlockedExchange((volatile LONG*) ptr, (LONG) value);
+#else
+	return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/* Keep plain loads before the fence from moving after later loads. */
+static void atomic_acquire_fence(void)
+{
+#ifdef _MSC_VER
+	MemoryBarrier();
+#else
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+#endif
+}
+
+/* Add delta to *ptr, returning the new value. */
+static uint32_t atomic_add_u32(volatile uint32_t* ptr, uint32_t delta)
+{
+#ifdef _MSC_VER
+	return (uint32_t) InterlockedExchangeAdd((volatile LONG*) ptr, (LONG) delta) +
+		delta;
+#else
+	return __atomic_add_fetch(ptr, delta, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/* Set *ptr to desired if it equals *expected, otherwise update *expected. */
+static bool atomic_cas_u32(volatile uint32_t* ptr, uint32_t* expected, uint32_t desired)
+{
+#ifdef _MSC_VER
+	uint32_t previous = (uint32_t) InterlockedCompareExchange(
+		(volatile LONG*) ptr,
+		(LONG) desired,
+		(LONG) *expected);
+	if (previous == *expected) {
+		return true;
+	}
+	*expected = previous;
+	return false;
+#else
+	return __atomic_compare_exchange_n(
+		ptr,
+		expected,
+		desired,
+		false,
+		__ATOMIC_SEQ_CST,
+		__ATOMIC_SEQ_CST);
+#endif
+}
+
+static uint64_t monotonic_us(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return (uint64_t) (count.QuadPart / frequency.QuadPart) * 1000000 +
+		(uint64_t) (count.QuadPart % frequency.QuadPart) * 1000000 /
+		frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
 #ifdef HACKRF_BIG_ENDIAN
 	#define TO_LE(x)     __builtin_bswap32(x)
 	#define TO_LE64(x)   __builtin_bswap64(x)
@@ -58,116 +159,95 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 #define CPLD_WRITE_TIMEOUT      10000
 #define SPIFLASH_WRITE_TIMEOUT  50000 // W25Q32JV max chip erase time
 
-// TODO: Factor this into a shared #include so that firmware can use
-// the same values.
-typedef enum {
-	HACKRF_VENDOR_REQUEST_SET_TRANSCEIVER_MODE = 1,
-	HACKRF_VENDOR_REQUEST_MAX283X_WRITE = 2,
-	HACKRF_VENDOR_REQUEST_MAX283X_READ = 3,
-	HACKRF_VENDOR_REQUEST_SI5351C_WRITE = 4,
-	HACKRF_VENDOR_REQUEST_SI5351C_READ = 5,
-	HACKRF_VENDOR_REQUEST_SAMPLE_RATE_SET = 6,
-	HACKRF_VENDOR_REQUEST_BASEBAND_FILTER_BANDWIDTH_SET = 7,
-	HACKRF_VENDOR_REQUEST_RFFC5071_WRITE = 8,
-	HACKRF_VENDOR_REQUEST_RFFC5071_READ = 9,
-	HACKRF_VENDOR_REQUEST_SPIFLASH_ERASE = 10,
-	HACKRF_VENDOR_REQUEST_SPIFLASH_WRITE = 11,
-	HACKRF_VENDOR_REQUEST_SPIFLASH_READ = 12,
-	HACKRF_VENDOR_REQUEST_BOARD_ID_READ = 14,
-	HACKRF_VENDOR_REQUEST_VERSION_STRING_READ = 15,
-	HACKRF_VENDOR_REQUEST_SET_FREQ = 16,
-	HACKRF_VENDOR_REQUEST_AMP_ENABLE = 17,
-	HACKRF_VENDOR_REQUEST_BOARD_PARTID_SERIALNO_READ = 18,
-	HACKRF_VENDOR_REQUEST_SET_LNA_GAIN = 19,
-	HACKRF_VENDOR_REQUEST_SET_VGA_GAIN = 20,
-	HACKRF_VENDOR_REQUEST_SET_TXVGA_GAIN = 21,
-	HACKRF_VENDOR_REQUEST_ANTENNA_ENABLE = 23,
-	HACKRF_VENDOR_REQUEST_SET_FREQ_EXPLICIT = 24,
-	HACKRF_VENDOR_REQUEST_USB_WCID_VENDOR_REQ = 25,
-	HACKRF_VENDOR_REQUEST_INIT_SWEEP = 26,
-	HACKRF_VENDOR_REQUEST_OPERACAKE_GET_BOARDS = 27,
-	HACKRF_VENDOR_REQUEST_OPERACAKE_SET_PORTS = 28,
-	HACKRF_VENDOR_REQUEST_SET_HW_SYNC_MODE = 29,
-	HACKRF_VENDOR_REQUEST_RESET = 30,
-	HACKRF_VENDOR_REQUEST_OPERACAKE_SET_RANGES = 31,
-	HACKRF_VENDOR_REQUEST_CLKOUT_ENABLE = 32,
-	HACKRF_VENDOR_REQUEST_SPIFLASH_STATUS = 33,
-	HACKRF_VENDOR_REQUEST_SPIFLASH_CLEAR_STATUS = 34,
-	HACKRF_VENDOR_REQUEST_OPERACAKE_GPIO_TEST = 35,
-	HACKRF_VENDOR_REQUEST_CPLD_CHECKSUM = 36,
-	HACKRF_VENDOR_REQUEST_UI_ENABLE = 37,
-	HACKRF_VENDOR_REQUEST_OPERACAKE_SET_MODE = 38,
-	HACKRF_VENDOR_REQUEST_OPERACAKE_GET_MODE = 39,
-	HACKRF_VENDOR_REQUEST_OPERACAKE_SET_DWELL_TIMES = 40,
-	HACKRF_VENDOR_REQUEST_GET_M0_STATE = 41,
-	HACKRF_VENDOR_REQUEST_SET_TX_UNDERRUN_LIMIT = 42,
-	HACKRF_VENDOR_REQUEST_SET_RX_OVERRUN_LIMIT = 43,
-	HACKRF_VENDOR_REQUEST_GET_CLKIN_STATUS = 44,
-	HACKRF_VENDOR_REQUEST_BOARD_REV_READ = 45,
-	HACKRF_VENDOR_REQUEST_SUPPORTED_PLATFORM_READ = 46,
-	HACKRF_VENDOR_REQUEST_SET_LEDS = 47,
-	HACKRF_VENDOR_REQUEST_SET_USER_BIAS_T_OPTS = 48,
-	HACKRF_VENDOR_REQUEST_FPGA_WRITE_REG = 49,
-	HACKRF_VENDOR_REQUEST_FPGA_READ_REG = 50,
-	HACKRF_VENDOR_REQUEST_P2_CTRL = 51,
-	HACKRF_VENDOR_REQUEST_P1_CTRL = 52,
-	HACKRF_VENDOR_REQUEST_SET_NARROWBAND_FILTER = 53,
-	HACKRF_VENDOR_REQUEST_SET_FPGA_BITSTREAM = 54,
-	HACKRF_VENDOR_REQUEST_CLKIN_CTRL = 55,
-	HACKRF_VENDOR_REQUEST_READ_SELFTEST = 56,
-	HACKRF_VENDOR_REQUEST_READ_ADC = 57,
-	HACKRF_VENDOR_REQUEST_TEST_RTC_OSC = 58,
-	HACKRF_VENDOR_REQUEST_RADIO_WRITE_REG = 59,
-	HACKRF_VENDOR_REQUEST_RADIO_READ_REG = 60,
-	HACKRF_VENDOR_REQUEST_GET_BUFFER_SIZE = 61,
-} hackrf_vendor_request;
-
-#define USB_CONFIG_STANDARD 0x1
-
-#define RX_ENDPOINT_ADDRESS (LIBUSB_ENDPOINT_IN | 1)
-#define TX_ENDPOINT_ADDRESS (LIBUSB_ENDPOINT_OUT | 2)
+#define DEFAULT_TRANSFER_COUNT       4
+#define DEFAULT_TRANSFER_BUFFER_SIZE 262144
+#define TRANSFER_BUFFER_ALIGNMENT    512
+#define USB_MAX_SERIAL_LENGTH        32
+#define EMULATED_DEVICE_INDEX        -1 /* usb_device_index of the emulator in a list */
 
-typedef enum {
-	HACKRF_TRANSCEIVER_MODE_OFF = 0,
-	HACKRF_TRANSCEIVER_MODE_RECEIVE = 1,
-	HACKRF_TRANSCEIVER_MODE_TRANSMIT = 2,
-	HACKRF_TRANSCEIVER_MODE_SS = 3,
-	TRANSCEIVER_MODE_CPLD_UPDATE = 4,
-	TRANSCEIVER_MODE_RX_SWEEP = 5,
-} hackrf_transceiver_mode;
+/*
+ * Single-producer, single-consumer ring of transfer buffers. The producer
+ * only writes head and the consumer only writes tail, so no lock is needed.
+ */
+struct block_ring {
+	unsigned char** buffers;
+	int* lengths;
+	uint32_t capacity;
+	volatile uint32_t head; /* next slot to write, advanced by producer */
+	volatile uint32_t tail; /* next slot to read, advanced by consumer */
+};
 
 typedef enum {
-	HACKRF_HW_SYNC_MODE_OFF = 0,
-	HACKRF_HW_SYNC_MODE_ON = 1,
-} hackrf_hw_sync_mode;
+	BLOCK_QUEUE_OFF = 0,             /* transfer callback runs on the event thread */
+	BLOCK_QUEUE_CALLBACK_THREAD = 1, /* RX blocks are passed to the callback thread */
+	BLOCK_QUEUE_SYNC_RX = 2,         /* RX blocks are read with hackrf_read_samples() */
+	BLOCK_QUEUE_SYNC_TX = 3,         /* TX blocks are written with hackrf_write_samples() */
+} block_queue_mode;
 
-#define TRANSFER_COUNT        4
-#define TRANSFER_BUFFER_SIZE  262144
-#define USB_MAX_SERIAL_LENGTH 32
+/*
+ * Streaming statistics written by a single thread. Readers take a
+ * consistent snapshot by retrying while seq is odd or changes.
+ */
+struct stream_counters {
+	volatile uint32_t seq;
+	uint64_t transfers;
+	uint64_t bytes;
+	uint64_t transfer_errors;
+	uint64_t resubmit_failures;
+	uint64_t host_drops; /* RX blocks dropped or TX blocks zero-filled */
+	uint32_t callback_max_us;
+	uint32_t turnaround_max_us;
+	uint64_t callback_histogram[HACKRF_STREAM_STATS_BINS];
+	uint64_t turnaround_histogram[HACKRF_STREAM_STATS_BINS];
+};
 
 struct hackrf_device {
 	libusb_device_handle* usb_device;
+	hackrf_emulator* emulator; /* stands in for usb_device on an emulated device */
 	uint16_t usb_api_version;
 	struct libusb_transfer** transfers;
 	hackrf_sample_block_cb_fn callback;
 	volatile bool
 		transfer_thread_started; /* volatile shared between threads (read only) */
 	pthread_t transfer_thread;
+	bool shared_event_threads; /* events handled by the shared pool, not transfer_thread */
 	volatile bool streaming; /* volatile shared between threads (read only) */
 	void* rx_ctx;
 	void* tx_ctx;
 	volatile bool do_exit;
-	unsigned char buffer[TRANSFER_COUNT * TRANSFER_BUFFER_SIZE];
+	unsigned char* buffer;         /* transfer_count * transfer_buffer_size bytes */
+	bool buffer_dev_mem;           /* buffer was allocated with libusb_dev_mem_alloc */
+	uint32_t transfer_count;       /* number of libusb transfers in flight */
+	uint32_t transfer_buffer_size; /* size of each transfer buffer in bytes */
 	bool transfers_setup;           /* true if the USB transfers have been setup */
-	pthread_mutex_t transfer_lock;  /* must be held to cancel or restart transfers */
-	volatile int active_transfers;  /* number of active transfers */
-	pthread_cond_t all_finished_cv; /* signalled when all transfers have finished */
-	bool flush;
+	pthread_mutex_t transfer_lock;  /* only taken to cancel transfers or wait on them */
+	volatile uint32_t transfer_state; /* TRANSFER_STATE_* flags and resubmit count */
+	volatile uint32_t active_transfers; /* number of active transfers, including flush */
+	pthread_cond_t all_finished_cv; /* signalled when resubmits or transfers finish */
+	volatile uint32_t flush;        /* nonzero if a flush transfer should follow TX */
 	struct libusb_transfer* flush_transfer;
 	hackrf_flush_cb_fn flush_callback;
 	hackrf_tx_block_complete_cb_fn tx_completion_callback;
 	void* flush_ctx;
 	uint32_t buffer_size;
+	uint32_t callback_thread_buffers; /* pool size for the callback thread, 0 if disabled */
+	block_queue_mode queue_mode;     /* how blocks pass between libusb and the application */
+	uint32_t block_pool_count;       /* number of spare buffers in block_pool */
+	unsigned char* block_pool;       /* block_pool_count * transfer_buffer_size bytes */
+	bool block_pool_dev_mem;         /* block_pool was allocated with libusb_dev_mem_alloc */
+	struct block_ring filled_ring;   /* blocks holding data, awaiting their consumer */
+	struct block_ring free_ring;     /* empty buffers, awaiting their producer */
+	pthread_t callback_thread;
+	bool callback_thread_started;
+	volatile bool queue_exit;        /* set when the block queue is being stopped */
+	volatile uint32_t consumer_waiting; /* nonzero while sleeping on queue_cv */
+	pthread_mutex_t queue_lock;      /* only taken to sleep on or signal queue_cv */
+	pthread_cond_t queue_cv;         /* signalled when a buffer is queued or on stop */
+	struct stream_counters event_stats;    /* written by the libusb event thread */
+	struct stream_counters callback_stats; /* written by the callback thread */
+	unsigned char* sync_block;       /* block partly read or written by the application */
+	int sync_block_length;
+	int sync_block_offset;
 };
 
 typedef struct {
@@ -204,10 +284,114 @@ static const uint16_t rad1o_usb_pid = 0xcc15;
 static uint16_t open_devices = 0;
 
 static int create_transfer_thread(hackrf_device* device);
+static int stop_event_threads(void);
+
+/*
+ * Shared event threads, used instead of a transfer thread per device when
+ * event_thread_count is nonzero. They run while any device is open.
+ */
+#define MAX_EVENT_THREADS 16
+static unsigned int event_thread_count = 0;
+static unsigned int event_threads_started = 0;
+static pthread_t event_threads[MAX_EVENT_THREADS];
+static volatile int event_threads_exit = 0;
 
 static libusb_context* g_libusb_context = NULL;
 int last_libusb_error = LIBUSB_SUCCESS;
 
+/*
+ * Transfer state, updated atomically so that completion callbacks don't
+ * need to take transfer_lock.
+ *
+ * The low bits count completion callbacks that are in the middle of
+ * resubmitting a transfer. Once cancel_transfers() sets
+ * TRANSFER_STATE_CANCELLING, no new resubmissions may begin, and when the
+ * count drops to zero every transfer is either finished or in flight, where
+ * it can be cancelled.
+ */
+#define TRANSFER_STATE_CANCELLING  0x80000000
+#define TRANSFER_STATE_RESUBMITTING 0x7FFFFFFF
+
+/*
+ * USB requests go to the device emulator instead of libusb if the device
+ * is emulated.
+ */
+static int usb_control_transfer(
+	hackrf_device* device,
+	uint8_t request_type,
+	uint8_t request,
+	uint16_t value,
+	uint16_t index,
+	unsigned char* data,
+	uint16_t length,
+	unsigned int timeout)
+{
+	if (device->emulator != NULL) {
+		return hackrf_emulator_control_transfer(
+			device->emulator,
+			request_type,
+			request,
+			value,
+			index,
+			data,
+			length);
+	}
+
+	return libusb_control_transfer(
+		device->usb_device,
+		request_type,
+		request,
+		value,
+		index,
+		data,
+		length,
+		timeout);
+}
+
+static int usb_bulk_transfer(
+	hackrf_device* device,
+	unsigned char endpoint,
+	unsigned char* data,
+	int length,
+	int* transferred,
+	unsigned int timeout)
+{
+	if (device->emulator != NULL) {
+		return hackrf_emulator_bulk_transfer(
+			device->emulator,
+			endpoint,
+			data,
+			length,
+			transferred);
+	}
+
+	return libusb_bulk_transfer(
+		device->usb_device,
+		endpoint,
+		data,
+		length,
+		transferred,
+		timeout);
+}
+
+static int usb_submit_transfer(hackrf_device* device, struct libusb_transfer* transfer)
+{
+	if (device->emulator != NULL) {
+		return hackrf_emulator_submit_transfer(device->emulator, transfer);
+	}
+
+	return libusb_submit_transfer(transfer);
+}
+
+static int usb_cancel_transfer(hackrf_device* device, struct libusb_transfer* transfer)
+{
+	if (device->emulator != NULL) {
+		return hackrf_emulator_cancel_transfer(device->emulator, transfer);
+	}
+
+	return libusb_cancel_transfer(transfer);
+}
+
 /*
  * Check if the transfers are setup and owned by libusb.
  *
@@ -221,6 +405,535 @@ static int transfers_check_setup(hackrf_device* device)
 	return false;
 }
 
+/*
+ * Block all signals on a library thread.
+ *
+ * hackrf_transfer uses pause() and SIGALRM to print statistics and
+ * POSIX doesn't specify which thread must recieve the signal, block all
+ * signals here, so we don't interrupt their reception by
+ * hackrf_transfer or any other app which uses the library (#1323)
+ */
+static int block_thread_signals(void)
+{
+#ifndef _WIN32
+	sigset_t signal_mask;
+	sigfillset(&signal_mask);
+	if (pthread_sigmask(SIG_BLOCK, &signal_mask, NULL) != 0) {
+		return HACKRF_ERROR_THREAD;
+	}
+#endif
+	return HACKRF_SUCCESS;
+}
+
+static int block_ring_init(struct block_ring* ring, uint32_t capacity)
+{
+	// Round up to a power of two so that indices stay valid across
+	// wraparound of the 32-bit head and tail counters.
+	uint32_t size = 1;
+	while (size < capacity) {
+		size <<= 1;
+	}
+
+	ring->buffers = (unsigned char**) calloc(size, sizeof(unsigned char*));
+	ring->lengths = (int*) calloc(size, sizeof(int));
+	if ((ring->buffers == NULL) || (ring->lengths == NULL)) {
+		return HACKRF_ERROR_NO_MEM;
+	}
+	ring->capacity = size;
+	ring->head = 0;
+	ring->tail = 0;
+
+	return HACKRF_SUCCESS;
+}
+
+static void block_ring_free(struct block_ring* ring)
+{
+	free(ring->buffers);
+	free(ring->lengths);
+	ring->buffers = NULL;
+	ring->lengths = NULL;
+	ring->capacity = 0;
+}
+
+/*
+ * Add a buffer to the ring. Must only be called from the producer thread.
+ *
+ * Returns false if the ring is full.
+ */
+static bool block_ring_push(struct block_ring* ring, unsigned char* buffer, int length)
+{
+	uint32_t head = ring->head;
+	uint32_t index = head & (ring->capacity - 1);
+
+	if (head - atomic_load_u32(&ring->tail) == ring->capacity) {
+		return false;
+	}
+
+	ring->buffers[index] = buffer;
+	ring->lengths[index] = length;
+	atomic_store_u32(&ring->head, head + 1);
+
+	return true;
+}
+
+/*
+ * Remove a buffer from the ring. Must only be called from the consumer thread.
+ *
+ * Returns false if the ring is empty.
+ */
+static bool block_ring_pop(struct block_ring* ring, unsigned char** buffer, int* length)
+{
+	uint32_t tail = ring->tail;
+	uint32_t index = tail & (ring->capacity - 1);
+
+	if (atomic_load_u32(&ring->head) == tail) {
+		return false;
+	}
+
+	*buffer = ring->buffers[index];
+	*length = ring->lengths[index];
+	atomic_store_u32(&ring->tail, tail + 1);
+
+	return true;
+}
+
+static bool block_ring_empty(struct block_ring* ring)
+{
+	return atomic_load_u32(&ring->head) == atomic_load_u32(&ring->tail);
+}
+
+static void stats_write_begin(struct stream_counters* counters)
+{
+	atomic_add_u32(&counters->seq, 1);
+}
+
+static void stats_write_end(struct stream_counters* counters)
+{
+	atomic_add_u32(&counters->seq, 1);
+}
+
+static void stats_reset(struct stream_counters* counters)
+{
+	stats_write_begin(counters);
+	counters->transfers = 0;
+	counters->bytes = 0;
+	counters->transfer_errors = 0;
+	counters->resubmit_failures = 0;
+	counters->host_drops = 0;
+	counters->callback_max_us = 0;
+	counters->turnaround_max_us = 0;
+	memset(counters->callback_histogram, 0, sizeof(counters->callback_histogram));
+	memset(counters->turnaround_histogram, 0, sizeof(counters->turnaround_histogram));
+	stats_write_end(counters);
+}
+
+/*
+ * Add a duration to a histogram with power-of-two microsecond bins: bin 0
+ * counts durations under 1 us, and bin n durations from 2^(n-1) us up to
+ * 2^n us. The last bin also counts anything longer.
+ */
+static void stats_record_duration(uint64_t* histogram, uint32_t* max_us, uint64_t us)
+{
+	unsigned int bin = 0;
+	uint64_t remaining = us;
+
+	while ((remaining > 0) && (bin < HACKRF_STREAM_STATS_BINS - 1)) {
+		remaining >>= 1;
+		bin++;
+	}
+	histogram[bin]++;
+
+	if (us > *max_us) {
+		*max_us = (us > UINT32_MAX) ? UINT32_MAX : (uint32_t) us;
+	}
+}
+
+static void stats_snapshot(struct stream_counters* counters, struct stream_counters* copy)
+{
+	uint32_t seq;
+
+	do {
+		seq = atomic_load_u32(&counters->seq);
+		memcpy(copy, counters, sizeof(*copy));
+		// The copy must be complete before seq is checked again.
+		atomic_acquire_fence();
+	} while ((seq & 1) || (atomic_load_u32(&counters->seq) != seq));
+}
+
+/*
+ * Allocate zeroed memory for transfer buffers.
+ *
+ * Where libusb supports it, this is memory mapped from the kernel (usbfs on
+ * Linux) that transfers can use for DMA directly, saving a copy of every
+ * block between kernel and user space. Otherwise, or if the kernel refuses,
+ * the memory comes from the heap.
+ */
+static unsigned char* alloc_transfer_memory(
+	hackrf_device* device,
+	const size_t length,
+	bool* dev_mem)
+{
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+	unsigned char* memory;
+
+	// An emulated device has no kernel memory to offer.
+	memory = NULL;
+	if (device->usb_device != NULL) {
+		memory = libusb_dev_mem_alloc(device->usb_device, length);
+	}
+	if (memory != NULL) {
+		memset(memory, 0, length);
+		*dev_mem = true;
+		return memory;
+	}
+#else
+	(void) device;
+#endif
+
+	*dev_mem = false;
+	return (unsigned char*) calloc(1, length);
+}
+
+static void free_transfer_memory(
+	hackrf_device* device,
+	unsigned char* memory,
+	const size_t length,
+	const bool dev_mem)
+{
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+	if (dev_mem && (memory != NULL)) {
+		libusb_dev_mem_free(device->usb_device, memory, length);
+		return;
+	}
+#else
+	(void) device;
+	(void) length;
+	(void) dev_mem;
+#endif
+
+	free(memory);
+}
+
+static void free_block_pool(hackrf_device* device)
+{
+	free_transfer_memory(
+		device,
+		device->block_pool,
+		(size_t) device->block_pool_count * device->transfer_buffer_size,
+		device->block_pool_dev_mem);
+	device->block_pool = NULL;
+	device->block_pool_count = 0;
+	block_ring_free(&device->filled_ring);
+	block_ring_free(&device->free_ring);
+}
+
+/*
+ * Set up a pool of spare transfer buffers for passing blocks between the
+ * libusb event thread and the application, with every pool buffer in the
+ * free ring and the filled ring empty.
+ */
+static int setup_block_pool(hackrf_device* device, uint32_t num_buffers)
+{
+	uint32_t i, capacity;
+	int result;
+
+	if (device->block_pool_count != num_buffers) {
+		free_block_pool(device);
+
+		device->block_pool = alloc_transfer_memory(
+			device,
+			(size_t) num_buffers * device->transfer_buffer_size,
+			&device->block_pool_dev_mem);
+		if (device->block_pool == NULL) {
+			return HACKRF_ERROR_NO_MEM;
+		}
+		device->block_pool_count = num_buffers;
+
+		// Buffers are exchanged with the transfers, so any buffer
+		// may end up in either ring.
+		capacity = num_buffers + device->transfer_count;
+		result = block_ring_init(&device->filled_ring, capacity);
+		if (result == HACKRF_SUCCESS) {
+			result = block_ring_init(&device->free_ring, capacity);
+		}
+		if (result != HACKRF_SUCCESS) {
+			free_block_pool(device);
+			return result;
+		}
+	}
+
+	device->filled_ring.head = 0;
+	device->filled_ring.tail = 0;
+	device->free_ring.head = 0;
+	device->free_ring.tail = 0;
+	for (i = 0; i < device->block_pool_count; i++) {
+		block_ring_push(
+			&device->free_ring,
+			device->block_pool + (size_t) i * device->transfer_buffer_size,
+			0);
+	}
+
+	device->sync_block = NULL;
+	device->sync_block_length = 0;
+	device->sync_block_offset = 0;
+
+	return HACKRF_SUCCESS;
+}
+
+static bool queue_running(hackrf_device* device)
+{
+	if (device->queue_exit) {
+		return false;
+	}
+
+	// The callback thread keeps running until the queue is stopped, while
+	// the application stops waiting for blocks as soon as streaming ends.
+	return (device->queue_mode == BLOCK_QUEUE_CALLBACK_THREAD) || device->streaming;
+}
+
+/*
+ * Wake the thread consuming blocks from the application side of the queue.
+ */
+static void wake_consumer(hackrf_device* device)
+{
+	// Only take the lock if the consumer may be asleep.
+	if (atomic_load_u32(&device->consumer_waiting)) {
+		pthread_mutex_lock(&device->queue_lock);
+		pthread_cond_broadcast(&device->queue_cv);
+		pthread_mutex_unlock(&device->queue_lock);
+	}
+}
+
+static void deadline_after_ms(struct timespec* deadline, uint32_t timeout_ms)
+{
+#ifdef _WIN32
+	timespec_get(deadline, TIME_UTC);
+#else
+	clock_gettime(CLOCK_REALTIME, deadline);
+#endif
+	deadline->tv_sec += timeout_ms / 1000;
+	deadline->tv_nsec += (long) (timeout_ms % 1000) * 1000000;
+	if (deadline->tv_nsec >= 1000000000) {
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000;
+	}
+}
+
+/*
+ * Wait until the given ring has a buffer available, the queue stops or,
+ * if deadline is not NULL, the deadline passes.
+ *
+ * Called from the application side of the queue only.
+ */
+static int wait_for_block(
+	hackrf_device* device,
+	struct block_ring* ring,
+	const struct timespec* deadline)
+{
+	int result = HACKRF_SUCCESS;
+
+	pthread_mutex_lock(&device->queue_lock);
+	atomic_store_u32(&device->consumer_waiting, 1);
+	while (block_ring_empty(ring)) {
+		if (!queue_running(device)) {
+			result = HACKRF_ERROR_STREAMING_STOPPED;
+			break;
+		}
+		if (deadline == NULL) {
+			pthread_cond_wait(&device->queue_cv, &device->queue_lock);
+		} else if (
+			pthread_cond_timedwait(
+				&device->queue_cv,
+				&device->queue_lock,
+				deadline) == ETIMEDOUT) {
+			if (block_ring_empty(ring)) {
+				result = HACKRF_ERROR_TIMEOUT;
+			}
+			break;
+		}
+	}
+	atomic_store_u32(&device->consumer_waiting, 0);
+	pthread_mutex_unlock(&device->queue_lock);
+
+	return result;
+}
+
+static int acquire_block(
+	hackrf_device* device,
+	struct block_ring* ring,
+	const struct timespec* deadline,
+	unsigned char** buffer,
+	int* length)
+{
+	int result;
+
+	while (!block_ring_pop(ring, buffer, length)) {
+		result = wait_for_block(device, ring, deadline);
+		if (result != HACKRF_SUCCESS) {
+			return result;
+		}
+	}
+
+	return HACKRF_SUCCESS;
+}
+
+/*
+ * Hand a completed RX transfer over to the application side of the queue.
+ *
+ * The transfer's buffer is queued and replaced with a free buffer from the
+ * pool, so that the transfer can be resubmitted straight away. If the
+ * application has fallen behind and no buffer is free, the block is
+ * dropped and its buffer reused.
+ *
+ * Called from the libusb event thread only.
+ */
+static void queue_rx_block(hackrf_device* device, struct libusb_transfer* usb_transfer)
+{
+	unsigned char* buffer;
+	int length;
+
+	if (!block_ring_pop(&device->free_ring, &buffer, &length)) {
+		stats_write_begin(&device->event_stats);
+		device->event_stats.host_drops++;
+		stats_write_end(&device->event_stats);
+		return;
+	}
+
+	block_ring_push(
+		&device->filled_ring,
+		usb_transfer->buffer,
+		usb_transfer->actual_length);
+	usb_transfer->buffer = buffer;
+
+	wake_consumer(device);
+}
+
+/*
+ * Swap the buffer of a completed TX transfer for the next block written by
+ * the application. If no block is ready, the transfer is resent filled
+ * with zeros so that streaming continues.
+ *
+ * Returns nonzero at the end of the stream.
+ *
+ * Called from the libusb event thread only.
+ */
+static int refill_tx_block(
+	hackrf_device* device,
+	struct libusb_transfer* usb_transfer,
+	hackrf_transfer* transfer)
+{
+	unsigned char* buffer;
+	int length;
+
+	if (!block_ring_pop(&device->filled_ring, &buffer, &length)) {
+		stats_write_begin(&device->event_stats);
+		device->event_stats.host_drops++;
+		stats_write_end(&device->event_stats);
+		memset(usb_transfer->buffer, 0, device->transfer_buffer_size);
+		transfer->valid_length = device->transfer_buffer_size;
+		return 0;
+	}
+
+	block_ring_push(&device->free_ring, usb_transfer->buffer, 0);
+	wake_consumer(device);
+
+	// A zero-length block marks the end of the stream.
+	if (length == 0) {
+		if (buffer != NULL) {
+			block_ring_push(&device->free_ring, buffer, 0);
+		}
+		return 1;
+	}
+
+	usb_transfer->buffer = buffer;
+	transfer->buffer = buffer;
+	transfer->valid_length = length;
+
+	return 0;
+}
+
+/*
+ * TX transfer callback used to fill the initial transfers in sync mode,
+ * before the application has written any samples.
+ */
+static int sync_tx_prefill(hackrf_transfer* transfer)
+{
+	memset(transfer->buffer, 0, transfer->buffer_length);
+	return 0;
+}
+
+static void* callback_threadproc(void* arg)
+{
+	hackrf_device* device = (hackrf_device*) arg;
+	unsigned char* buffer;
+	int length;
+
+	if (block_thread_signals() != HACKRF_SUCCESS) {
+		return NULL;
+	}
+
+	while (acquire_block(device, &device->filled_ring, NULL, &buffer, &length) ==
+	       HACKRF_SUCCESS) {
+		if (device->streaming) {
+			hackrf_transfer transfer = {
+				.device = device,
+				.buffer = buffer,
+				.buffer_length = device->transfer_buffer_size,
+				.valid_length = length,
+				.rx_ctx = device->rx_ctx,
+				.tx_ctx = device->tx_ctx,
+			};
+			uint64_t start_us = monotonic_us();
+			if (device->callback(&transfer) != 0) {
+				device->streaming = false;
+			}
+
+			stats_write_begin(&device->callback_stats);
+			stats_record_duration(
+				device->callback_stats.callback_histogram,
+				&device->callback_stats.callback_max_us,
+				monotonic_us() - start_us);
+			stats_write_end(&device->callback_stats);
+		}
+
+		block_ring_push(&device->free_ring, buffer, 0);
+	}
+
+	return NULL;
+}
+
+/*
+ * Stop passing blocks between libusb and the application, stopping the
+ * callback thread if there is one. Blocks still queued are discarded.
+ *
+ * Must not be called while transfers are still active.
+ */
+static int stop_block_queue(hackrf_device* device)
+{
+	void* value;
+	int result = HACKRF_SUCCESS;
+
+	if (device->queue_mode == BLOCK_QUEUE_OFF) {
+		return HACKRF_SUCCESS;
+	}
+
+	pthread_mutex_lock(&device->queue_lock);
+	device->queue_exit = true;
+	pthread_cond_broadcast(&device->queue_cv);
+	pthread_mutex_unlock(&device->queue_lock);
+
+	if (device->callback_thread_started) {
+		value = NULL;
+		if (pthread_join(device->callback_thread, &value) != 0) {
+			result = HACKRF_ERROR_THREAD;
+		}
+		device->callback_thread_started = false;
+	}
+	device->queue_mode = BLOCK_QUEUE_OFF;
+
+	return result;
+}
+
 /*
  * Cancel any transfers that are in-flight.
  *
@@ -243,34 +956,41 @@ static int cancel_transfers(hackrf_device* device)
 	device->streaming = false;
 
 	if (transfers_check_setup(device) == true) {
-		// Take lock while cancelling transfers. This blocks the
-		// transfer completion callback from restarting a transfer
-		// while we're in the middle of trying to cancel them all.
 		pthread_mutex_lock(&device->transfer_lock);
 
-		for (transfer_index = 0; transfer_index < TRANSFER_COUNT;
+		// Stop completion callbacks from resubmitting transfers, and wait
+		// for any that already are, so that we can't miss cancelling a
+		// transfer that is restarted while we're cancelling the others.
+		atomic_add_u32(&device->transfer_state, TRANSFER_STATE_CANCELLING);
+		while ((atomic_load_u32(&device->transfer_state) &
+			TRANSFER_STATE_RESUBMITTING) != 0) {
+			pthread_cond_wait(&device->all_finished_cv, &device->transfer_lock);
+		}
+		atomic_store_u32(&device->flush, false);
+
+		for (transfer_index = 0; transfer_index < device->transfer_count;
 		     transfer_index++) {
 			if (device->transfers[transfer_index] != NULL) {
-				libusb_cancel_transfer(device->transfers[transfer_index]);
+				usb_cancel_transfer(device, device->transfers[transfer_index]);
 			}
 		}
 
 		if (device->flush_transfer != NULL)
-			libusb_cancel_transfer(device->flush_transfer);
+			usb_cancel_transfer(device, device->flush_transfer);
 
 		device->transfers_setup = false;
-		device->flush = false;
 
 		// Now wait for the transfer thread to signal that all transfers
 		// have finished, either by completing or being fully cancelled.
-		while (device->active_transfers > 0) {
+		while (atomic_load_u32(&device->active_transfers) > 0) {
 			pthread_cond_wait(
 				&device->all_finished_cv,
 				&device->transfer_lock);
 		}
 		pthread_mutex_unlock(&device->transfer_lock);
 
-		return HACKRF_SUCCESS;
+		// No more blocks can be queued, so the block queue can go.
+		return stop_block_queue(device);
 	} else {
 		return HACKRF_ERROR_OTHER;
 	}
@@ -282,7 +1002,7 @@ static int free_transfers(hackrf_device* device)
 
 	if (device->transfers != NULL) {
 		// libusb_close() should free all transfers referenced from this array.
-		for (transfer_index = 0; transfer_index < TRANSFER_COUNT;
+		for (transfer_index = 0; transfer_index < device->transfer_count;
 		     transfer_index++) {
 			if (device->transfers[transfer_index] != NULL) {
 				libusb_free_transfer(device->transfers[transfer_index]);
@@ -293,7 +1013,12 @@ static int free_transfers(hackrf_device* device)
 		device->transfers = NULL;
 	}
 
-	libusb_free_transfer(device->flush_transfer);
+	free_transfer_memory(
+		device,
+		device->buffer,
+		(size_t) device->transfer_count * device->transfer_buffer_size,
+		device->buffer_dev_mem);
+	device->buffer = NULL;
 
 	return HACKRF_SUCCESS;
 }
@@ -303,15 +1028,21 @@ static int allocate_transfers(hackrf_device* const device)
 	if (device->transfers == NULL) {
 		uint32_t transfer_index;
 		device->transfers = (struct libusb_transfer**) calloc(
-			TRANSFER_COUNT,
+			device->transfer_count,
 			sizeof(struct libusb_transfer*));
 		if (device->transfers == NULL) {
 			return HACKRF_ERROR_NO_MEM;
 		}
 
-		memset(device->buffer, 0, TRANSFER_COUNT * TRANSFER_BUFFER_SIZE);
+		device->buffer = alloc_transfer_memory(
+			device,
+			(size_t) device->transfer_count * device->transfer_buffer_size,
+			&device->buffer_dev_mem);
+		if (device->buffer == NULL) {
+			return HACKRF_ERROR_NO_MEM;
+		}
 
-		for (transfer_index = 0; transfer_index < TRANSFER_COUNT;
+		for (transfer_index = 0; transfer_index < device->transfer_count;
 		     transfer_index++) {
 			device->transfers[transfer_index] = libusb_alloc_transfer(0);
 			if (device->transfers[transfer_index] == NULL) {
@@ -322,19 +1053,117 @@ static int allocate_transfers(hackrf_device* const device)
 				device->transfers[transfer_index],
 				device->usb_device,
 				0,
-				&device->buffer[transfer_index * TRANSFER_BUFFER_SIZE],
-				TRANSFER_BUFFER_SIZE,
+				device->buffer +
+					(size_t) transfer_index *
+						device->transfer_buffer_size,
+				device->transfer_buffer_size,
 				NULL,
 				device,
 				0);
 
-			if (device->transfers[transfer_index]->buffer == NULL) {
-				return HACKRF_ERROR_NO_MEM;
-			}
+			if (device->transfers[transfer_index]->buffer == NULL) {
+				return HACKRF_ERROR_NO_MEM;
+			}
+		}
+		return HACKRF_SUCCESS;
+	} else {
+		return HACKRF_ERROR_BUSY;
+	}
+}
+
+/*
+ * Wake cancel_transfers() if it is waiting for transfers to finish.
+ */
+static void signal_transfer_waiters(hackrf_device* device)
+{
+	pthread_mutex_lock(&device->transfer_lock);
+	pthread_cond_broadcast(&device->all_finished_cv);
+	pthread_mutex_unlock(&device->transfer_lock);
+}
+
+/*
+ * Begin resubmitting a transfer, unless cancel_transfers() has started.
+ * Must be followed by end_resubmit() if successful.
+ */
+static bool begin_resubmit(hackrf_device* device)
+{
+	uint32_t state = atomic_load_u32(&device->transfer_state);
+
+	do {
+		if (state & TRANSFER_STATE_CANCELLING) {
+			return false;
+		}
+	} while (!atomic_cas_u32(&device->transfer_state, &state, state + 1));
+
+	return true;
+}
+
+static void end_resubmit(hackrf_device* device)
+{
+	if (atomic_add_u32(&device->transfer_state, (uint32_t) -1) ==
+	    TRANSFER_STATE_CANCELLING) {
+		// cancel_transfers() is waiting for us.
+		signal_transfer_waiters(device);
+	}
+}
+
+/*
+ * Count a transfer as finished. The device must not be used after the last
+ * transfer finishes, as cancel_transfers() may then return and the device
+ * be closed.
+ *
+ * The last transfer is counted down under transfer_lock, so that
+ * cancel_transfers() can't see the count reach zero and return while the
+ * condition variable is still to be signalled.
+ */
+static void finish_transfer(hackrf_device* device)
+{
+	uint32_t active = atomic_load_u32(&device->active_transfers);
+
+	do {
+		if (active == 1) {
+			pthread_mutex_lock(&device->transfer_lock);
+			if (atomic_add_u32(&device->active_transfers, (uint32_t) -1) ==
+			    0) {
+				pthread_cond_broadcast(&device->all_finished_cv);
+			}
+			pthread_mutex_unlock(&device->transfer_lock);
+			return;
+		}
+	} while (!atomic_cas_u32(&device->active_transfers, &active, active - 1));
+}
+
+/*
+ * Submit the flush transfer if one is pending. Only the first caller
+ * submits it. If it can't be submitted, the flush callback is told that
+ * the flush failed, as it will never complete.
+ *
+ * Must be called while the caller's own transfer is still counted as
+ * active, so that the count can't reach zero in between.
+ */
+static void submit_flush_transfer(hackrf_device* device)
+{
+	hackrf_flush_cb_fn flush_callback = device->flush_callback;
+	void* flush_ctx = device->flush_ctx;
+	int result = LIBUSB_SUCCESS;
+
+	if (!begin_resubmit(device)) {
+		return;
+	}
+
+	if (atomic_exchange_u32(&device->flush, false)) {
+		atomic_add_u32(&device->active_transfers, 1);
+		result = usb_submit_transfer(device, device->flush_transfer);
+		if (result != LIBUSB_SUCCESS) {
+			last_libusb_error = result;
+			atomic_add_u32(&device->active_transfers, (uint32_t) -1);
 		}
-		return HACKRF_SUCCESS;
-	} else {
-		return HACKRF_ERROR_BUSY;
+	}
+
+	end_resubmit(device);
+
+	if ((result != LIBUSB_SUCCESS) && flush_callback) {
+		flush_callback(flush_ctx, 0);
 	}
 }
 
@@ -352,6 +1181,14 @@ static int prepare_transfers(
 		return HACKRF_ERROR_OTHER;
 	}
 
+	// Buffers may have been exchanged with the callback pool during a
+	// previous run, so point each transfer back at its own buffer.
+	for (transfer_index = 0; transfer_index < device->transfer_count;
+	     transfer_index++) {
+		device->transfers[transfer_index]->buffer = device->buffer +
+			(size_t) transfer_index * device->transfer_buffer_size;
+	}
+
 	// If setting up for TX, call the TX callback to fill each
 	// transfer buffer.
 
@@ -365,13 +1202,13 @@ static int prepare_transfers(
 	// transfers were made ready to submit at this stage.
 
 	if (endpoint_address == TX_ENDPOINT_ADDRESS) {
-		for (transfer_index = 0; transfer_index < TRANSFER_COUNT;
+		for (transfer_index = 0; transfer_index < device->transfer_count;
 		     transfer_index++) {
 			hackrf_transfer transfer = {
 				.device = device,
 				.buffer = device->transfers[transfer_index]->buffer,
-				.buffer_length = TRANSFER_BUFFER_SIZE,
-				.valid_length = TRANSFER_BUFFER_SIZE,
+				.buffer_length = device->transfer_buffer_size,
+				.valid_length = device->transfer_buffer_size,
 				.rx_ctx = device->rx_ctx,
 				.tx_ctx = device->tx_ctx,
 			};
@@ -387,13 +1224,18 @@ static int prepare_transfers(
 
 	} else {
 		// For RX, all transfers are already ready for use.
-		ready_transfers = TRANSFER_COUNT;
+		ready_transfers = device->transfer_count;
 	}
 
-	// Now everything is ready, go ahead and submit the ready transfers. We must hold
-	// the transfer lock whilst doing this, so that completion callbacks cannot resubmit
-	// any transfers until all transfers have been initially submitted.
-	pthread_mutex_lock(&device->transfer_lock);
+	// Now everything is ready. We should only continue streaming if all transfers
+	// were made ready. Otherwise, set streaming to false so that the libusb
+	// completion callback won't submit further transfers. This is decided before
+	// submitting, as transfers may complete before the rest have been submitted.
+	atomic_store_u32(&device->transfer_state, 0);
+	stats_reset(&device->event_stats);
+	stats_reset(&device->callback_stats);
+	device->streaming = (ready_transfers == device->transfer_count);
+	device->transfers_setup = true;
 
 	for (transfer_index = 0; transfer_index < ready_transfers; transfer_index++) {
 		struct libusb_transfer* transfer = device->transfers[transfer_index];
@@ -406,33 +1248,24 @@ static int prepare_transfers(
 				transfer->buffer[transfer->length++] = 0;
 		}
 
-		error = libusb_submit_transfer(transfer);
+		// Count the transfer first, in case it completes straight away.
+		atomic_add_u32(&device->active_transfers, 1);
+		error = usb_submit_transfer(device, transfer);
 		if (error != 0) {
 			last_libusb_error = error;
+			device->streaming = false;
+			finish_transfer(device);
 			break;
 		}
-		device->active_transfers++;
 	}
 
 	if (error == 0) {
-		// We should only continue streaming if all transfers were made ready
-		// and submitted above. Otherwise, set streaming to false so that the
-		// libusb completion callback won't submit further transfers.
-		device->streaming = (ready_transfers == TRANSFER_COUNT);
-		device->transfers_setup = true;
-
 		// If we're not continuing streaming, follow up with a flush if needed.
-		if (!device->streaming && device->flush) {
-			error = libusb_submit_transfer(device->flush_transfer);
-			if (error != 0) {
-				last_libusb_error = error;
-			}
+		if (!device->streaming) {
+			submit_flush_transfer(device);
 		}
 	}
 
-	// Now we can release the transfer lock.
-	pthread_mutex_unlock(&device->transfer_lock);
-
 	if (error == 0) {
 		return HACKRF_SUCCESS;
 	} else {
@@ -517,12 +1350,32 @@ int ADDCALL hackrf_init(void)
 	libusb_error = libusb_init(&g_libusb_context);
 	if (libusb_error != 0) {
 		last_libusb_error = libusb_error;
+		g_libusb_context = NULL;
+		// The emulator works without libusb, for hosts without USB.
+		if (hackrf_emulator_enabled()) {
+			return HACKRF_SUCCESS;
+		}
 		return HACKRF_ERROR_LIBUSB;
 	} else {
 		return HACKRF_SUCCESS;
 	}
 }
 
+int ADDCALL hackrf_set_event_threads(const unsigned int num_threads)
+{
+	if (num_threads > MAX_EVENT_THREADS) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	if (open_devices > 0) {
+		return HACKRF_ERROR_BUSY;
+	}
+
+	event_thread_count = num_threads;
+
+	return HACKRF_SUCCESS;
+}
+
 int ADDCALL hackrf_exit(void)
 {
 	if (open_devices == 0) {
@@ -565,6 +1418,24 @@ hackrf_device_list_t* ADDCALL hackrf_device_list()
 	if (list == NULL)
 		return NULL;
 
+	// The emulator, when enabled, stands in for all USB devices.
+	if (hackrf_emulator_enabled()) {
+		list->serial_numbers = calloc(1, sizeof(void*));
+		list->usb_board_ids = calloc(1, sizeof(enum hackrf_usb_board_id));
+		list->usb_device_index = calloc(1, sizeof(int));
+		if (list->serial_numbers == NULL || list->usb_board_ids == NULL ||
+		    list->usb_device_index == NULL) {
+			hackrf_device_list_free(list);
+			return NULL;
+		}
+
+		list->serial_numbers[0] = strdup(HACKRF_EMULATOR_SERIAL);
+		list->usb_board_ids[0] = USB_BOARD_ID_HACKRF_ONE;
+		list->usb_device_index[0] = EMULATED_DEVICE_INDEX;
+		list->devicecount = 1;
+		return list;
+	}
+
 	list->usb_devicecount = (int) libusb_get_device_list(
 		g_libusb_context,
 		(libusb_device***) &list->usb_devices);
@@ -713,68 +1584,106 @@ libusb_device_handle* hackrf_open_usb(const char* const desired_serial_number)
 	return usb_device;
 }
 
-static int hackrf_open_setup(libusb_device_handle* usb_device, hackrf_device** device)
+/*
+ * Release a device that failed to open: the claimed USB device, or the
+ * emulator standing in for it.
+ */
+static void release_usb_device(libusb_device_handle* usb_device, hackrf_emulator* emulator)
+{
+	if (emulator != NULL) {
+		hackrf_emulator_close(emulator);
+	} else {
+		libusb_release_interface(usb_device, 0);
+		libusb_close(usb_device);
+	}
+}
+
+/* Set up a device opened with libusb, or, if usb_device is NULL, emulated. */
+static int hackrf_open_setup(
+	libusb_device_handle* usb_device,
+	hackrf_emulator* emulator,
+	hackrf_device** device)
 {
 	int result;
 	hackrf_device* lib_device;
 	uint32_t buffer_size;
+	uint16_t usb_api_version;
 	struct libusb_device_descriptor device_descriptor;
-	libusb_device* dev = libusb_get_device(usb_device);
-	result = libusb_get_device_descriptor(dev, &device_descriptor);
-	if (result < 0) {
-		last_libusb_error = result;
-		return HACKRF_ERROR_LIBUSB;
-	}
 
-	//int speed = libusb_get_device_speed(usb_device);
-	// TODO: Error or warning if not high speed USB?
+	if (emulator != NULL) {
+		usb_api_version = hackrf_emulator_usb_api_version();
+	} else {
+		libusb_device* dev = libusb_get_device(usb_device);
+		result = libusb_get_device_descriptor(dev, &device_descriptor);
+		if (result < 0) {
+			last_libusb_error = result;
+			return HACKRF_ERROR_LIBUSB;
+		}
 
-	result = set_hackrf_configuration(usb_device, USB_CONFIG_STANDARD);
-	if (result != LIBUSB_SUCCESS) {
-		libusb_close(usb_device);
-		return result;
-	}
+		//int speed = libusb_get_device_speed(usb_device);
+		// TODO: Error or warning if not high speed USB?
 
-	result = libusb_claim_interface(usb_device, 0);
-	if (result != LIBUSB_SUCCESS) {
-		last_libusb_error = result;
-		libusb_close(usb_device);
-		return HACKRF_ERROR_LIBUSB;
+		result = set_hackrf_configuration(usb_device, USB_CONFIG_STANDARD);
+		if (result != LIBUSB_SUCCESS) {
+			libusb_close(usb_device);
+			return result;
+		}
+
+		result = libusb_claim_interface(usb_device, 0);
+		if (result != LIBUSB_SUCCESS) {
+			last_libusb_error = result;
+			libusb_close(usb_device);
+			return HACKRF_ERROR_LIBUSB;
+		}
+		usb_api_version = device_descriptor.bcdDevice;
 	}
 
 	lib_device = NULL;
 	lib_device = (hackrf_device*) calloc(1, sizeof(*lib_device));
 	if (lib_device == NULL) {
-		libusb_release_interface(usb_device, 0);
-		libusb_close(usb_device);
+		release_usb_device(usb_device, emulator);
 		return HACKRF_ERROR_NO_MEM;
 	}
 
 #if LIBUSB_API_VERSION >= 0x0100010C
 	// WinUSB: Use RAW_IO to improve throughput on RX
-	if (libusb_endpoint_supports_raw_io(usb_device, RX_ENDPOINT_ADDRESS) == 1) {
+	if ((usb_device != NULL) &&
+	    (libusb_endpoint_supports_raw_io(usb_device, RX_ENDPOINT_ADDRESS) == 1)) {
 		libusb_endpoint_set_raw_io(usb_device, RX_ENDPOINT_ADDRESS, 1);
 	}
 #endif
 
 	lib_device->usb_device = usb_device;
-	lib_device->usb_api_version = device_descriptor.bcdDevice;
+	lib_device->emulator = emulator;
+	lib_device->usb_api_version = usb_api_version;
 	lib_device->transfers = NULL;
+	lib_device->buffer = NULL;
+	lib_device->buffer_dev_mem = false;
+	lib_device->transfer_count = DEFAULT_TRANSFER_COUNT;
+	lib_device->transfer_buffer_size = DEFAULT_TRANSFER_BUFFER_SIZE;
 	lib_device->callback = NULL;
 	lib_device->transfer_thread_started = false;
+	lib_device->shared_event_threads = false;
 	lib_device->streaming = false;
 	lib_device->do_exit = false;
+	lib_device->transfer_state = 0;
 	lib_device->active_transfers = 0;
 	lib_device->flush = false;
 	lib_device->flush_transfer = NULL;
 	lib_device->flush_callback = NULL;
 	lib_device->flush_ctx = NULL;
 	lib_device->tx_completion_callback = NULL;
+	lib_device->callback_thread_buffers = 0;
+	lib_device->queue_mode = BLOCK_QUEUE_OFF;
+	lib_device->block_pool_count = 0;
+	lib_device->block_pool = NULL;
+	lib_device->block_pool_dev_mem = false;
+	lib_device->callback_thread_started = false;
 
 	if (lib_device->usb_api_version >= 0x0112) {
 		// Fetch buffer size from device so we know how many bytes to flush TX with.
-		result = libusb_control_transfer(
-			lib_device->usb_device,
+		result = usb_control_transfer(
+			lib_device,
 			LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR |
 				LIBUSB_RECIPIENT_DEVICE,
 			HACKRF_VENDOR_REQUEST_GET_BUFFER_SIZE,
@@ -798,32 +1707,42 @@ static int hackrf_open_setup(libusb_device_handle* usb_device, hackrf_device** d
 	result = pthread_mutex_init(&lib_device->transfer_lock, NULL);
 	if (result != 0) {
 		free(lib_device);
-		libusb_release_interface(usb_device, 0);
-		libusb_close(usb_device);
+		release_usb_device(usb_device, emulator);
 		return HACKRF_ERROR_THREAD;
 	}
 
 	result = pthread_cond_init(&lib_device->all_finished_cv, NULL);
 	if (result != 0) {
 		free(lib_device);
-		libusb_release_interface(usb_device, 0);
-		libusb_close(usb_device);
+		release_usb_device(usb_device, emulator);
+		return HACKRF_ERROR_THREAD;
+	}
+
+	result = pthread_mutex_init(&lib_device->queue_lock, NULL);
+	if (result != 0) {
+		free(lib_device);
+		release_usb_device(usb_device, emulator);
+		return HACKRF_ERROR_THREAD;
+	}
+
+	result = pthread_cond_init(&lib_device->queue_cv, NULL);
+	if (result != 0) {
+		free(lib_device);
+		release_usb_device(usb_device, emulator);
 		return HACKRF_ERROR_THREAD;
 	}
 
 	result = allocate_transfers(lib_device);
 	if (result != 0) {
 		free(lib_device);
-		libusb_release_interface(usb_device, 0);
-		libusb_close(usb_device);
+		release_usb_device(usb_device, emulator);
 		return HACKRF_ERROR_NO_MEM;
 	}
 
 	result = create_transfer_thread(lib_device);
 	if (result != 0) {
 		free(lib_device);
-		libusb_release_interface(usb_device, 0);
-		libusb_close(usb_device);
+		release_usb_device(usb_device, emulator);
 		return result;
 	}
 
@@ -833,6 +1752,19 @@ static int hackrf_open_setup(libusb_device_handle* usb_device, hackrf_device** d
 	return HACKRF_SUCCESS;
 }
 
+static int hackrf_open_emulator(hackrf_device** device)
+{
+	hackrf_emulator* emulator;
+	int result;
+
+	result = hackrf_emulator_open(&emulator);
+	if (result != HACKRF_SUCCESS) {
+		return result;
+	}
+
+	return hackrf_open_setup(NULL, emulator, device);
+}
+
 int ADDCALL hackrf_open(hackrf_device** device)
 {
 	libusb_device_handle* usb_device;
@@ -841,6 +1773,10 @@ int ADDCALL hackrf_open(hackrf_device** device)
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
+	if (hackrf_emulator_enabled()) {
+		return hackrf_open_emulator(device);
+	}
+
 	usb_device = libusb_open_device_with_vid_pid(
 		g_libusb_context,
 		hackrf_usb_vid,
@@ -864,7 +1800,7 @@ int ADDCALL hackrf_open(hackrf_device** device)
 		return HACKRF_ERROR_NOT_FOUND;
 	}
 
-	return hackrf_open_setup(usb_device, device);
+	return hackrf_open_setup(usb_device, NULL, device);
 }
 
 int ADDCALL hackrf_open_by_serial(
@@ -881,13 +1817,27 @@ int ADDCALL hackrf_open_by_serial(
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
+	if (hackrf_emulator_enabled() ||
+	    (strcmp(desired_serial_number, HACKRF_EMULATOR_SERIAL) == 0)) {
+		return hackrf_open_emulator(device);
+	}
+
 	usb_device = hackrf_open_usb(desired_serial_number);
 
 	if (usb_device == NULL) {
 		return HACKRF_ERROR_NOT_FOUND;
 	}
 
-	return hackrf_open_setup(usb_device, device);
+	return hackrf_open_setup(usb_device, NULL, device);
+}
+
+int ADDCALL hackrf_is_emulated(hackrf_device* device)
+{
+	if (device == NULL) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	return (device->emulator != NULL) ? HACKRF_TRUE : HACKRF_SUCCESS;
 }
 
 int ADDCALL hackrf_device_list_open(
@@ -903,6 +1853,9 @@ int ADDCALL hackrf_device_list_open(
 	}
 
 	i = list->usb_device_index[idx];
+	if (i == EMULATED_DEVICE_INDEX) {
+		return hackrf_open_emulator(device);
+	}
 
 	result = libusb_open(list->usb_devices[i], &usb_device);
 	if (result != 0) {
@@ -911,7 +1864,7 @@ int ADDCALL hackrf_device_list_open(
 		return HACKRF_ERROR_LIBUSB;
 	}
 
-	return hackrf_open_setup(usb_device, device);
+	return hackrf_open_setup(usb_device, NULL, device);
 }
 
 int ADDCALL hackrf_device_list_bus_sharing(hackrf_device_list_t* list, int idx)
@@ -920,8 +1873,15 @@ int ADDCALL hackrf_device_list_bus_sharing(hackrf_device_list_t* list, int idx)
 	uint8_t hackrf_bus;
 	int other_device_count = 0;
 	int i;
-	if (list == NULL || list->usb_devices == NULL || list->usb_device_index == NULL ||
-	    idx < 0 || idx > list->devicecount) {
+	if (list == NULL || list->usb_device_index == NULL || idx < 0 ||
+	    idx > list->devicecount) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+	if (list->usb_device_index[idx] == EMULATED_DEVICE_INDEX) {
+		// The emulator has no bus to share.
+		return 0;
+	}
+	if (list->usb_devices == NULL) {
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 	hackrf_dev = list->usb_devices[list->usb_device_index[idx]];
@@ -943,8 +1903,8 @@ int ADDCALL hackrf_set_transceiver_mode(
 	hackrf_transceiver_mode value)
 {
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SET_TRANSCEIVER_MODE,
@@ -973,8 +1933,8 @@ int ADDCALL hackrf_max2837_read(
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_MAX283X_READ,
 		0,
@@ -1002,8 +1962,8 @@ int ADDCALL hackrf_max2831_read(
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_MAX283X_READ,
 		0,
@@ -1034,8 +1994,8 @@ int ADDCALL hackrf_max2837_write(
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_MAX283X_WRITE,
@@ -1067,8 +2027,8 @@ int ADDCALL hackrf_max2831_write(
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_MAX283X_WRITE,
@@ -1099,8 +2059,8 @@ int ADDCALL hackrf_si5351c_read(
 	}
 
 	temp_value = 0;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SI5351C_READ,
 		0,
@@ -1132,8 +2092,8 @@ int ADDCALL hackrf_si5351c_write(
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SI5351C_WRITE,
@@ -1156,8 +2116,8 @@ int ADDCALL hackrf_set_baseband_filter_bandwidth(
 	const uint32_t bandwidth_hz)
 {
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_BASEBAND_FILTER_BANDWIDTH_SET,
@@ -1186,8 +2146,8 @@ int ADDCALL hackrf_rffc5071_read(
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_RFFC5071_READ,
 		0,
@@ -1215,8 +2175,8 @@ int ADDCALL hackrf_rffc5071_write(
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_RFFC5071_WRITE,
@@ -1242,8 +2202,8 @@ int ADDCALL hackrf_fpga_read_register(
 	USB_API_REQUIRED(device, 0x0109);
 	int result;
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_FPGA_READ_REG,
 		0,
@@ -1268,8 +2228,8 @@ int ADDCALL hackrf_fpga_write_register(
 	USB_API_REQUIRED(device, 0x0109);
 	int result;
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_FPGA_WRITE_REG,
@@ -1293,8 +2253,8 @@ int ADDCALL hackrf_read_selftest(hackrf_device* device, hackrf_selftest* selftes
 
 	int result;
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_READ_SELFTEST,
 		0,
@@ -1325,8 +2285,8 @@ int ADDCALL hackrf_test_rtc_osc(hackrf_device* device, bool* pass)
 	} step;
 
 	// Enable 32kHz oscillator
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_TEST_RTC_OSC,
@@ -1349,8 +2309,8 @@ int ADDCALL hackrf_test_rtc_osc(hackrf_device* device, bool* pass)
 #endif
 
 	// Start frequency monitor
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_TEST_RTC_OSC,
@@ -1374,8 +2334,8 @@ int ADDCALL hackrf_test_rtc_osc(hackrf_device* device, bool* pass)
 
 	// Read frequency monitor result
 	uint16_t count = 0;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_TEST_RTC_OSC,
 		0,
@@ -1391,8 +2351,8 @@ int ADDCALL hackrf_test_rtc_osc(hackrf_device* device, bool* pass)
 
 	if (count == 1) {
 		// Disable 32kHz oscillator
-		result = libusb_control_transfer(
-			device->usb_device,
+		result = usb_control_transfer(
+			device,
 			LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 				LIBUSB_RECIPIENT_DEVICE,
 			HACKRF_VENDOR_REQUEST_TEST_RTC_OSC,
@@ -1425,8 +2385,8 @@ int ADDCALL hackrf_read_adc(hackrf_device* device, uint8_t adc_channel, uint16_t
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_READ_ADC,
 		0,
@@ -1449,8 +2409,8 @@ int ADDCALL hackrf_get_m0_state(hackrf_device* device, hackrf_m0_state* state)
 	USB_API_REQUIRED(device, 0x0106)
 	int result;
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_GET_M0_STATE,
 		0,
@@ -1483,8 +2443,8 @@ int ADDCALL hackrf_set_tx_underrun_limit(hackrf_device* device, uint32_t value)
 	USB_API_REQUIRED(device, 0x0106)
 	int result;
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SET_TX_UNDERRUN_LIMIT,
@@ -1507,8 +2467,8 @@ int ADDCALL hackrf_set_rx_overrun_limit(hackrf_device* device, uint32_t value)
 	USB_API_REQUIRED(device, 0x0106)
 	int result;
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SET_RX_OVERRUN_LIMIT,
@@ -1529,8 +2489,8 @@ int ADDCALL hackrf_set_rx_overrun_limit(hackrf_device* device, uint32_t value)
 int ADDCALL hackrf_spiflash_erase(hackrf_device* device)
 {
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SPIFLASH_ERASE,
@@ -1560,8 +2520,8 @@ int ADDCALL hackrf_spiflash_write(
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SPIFLASH_WRITE,
@@ -1591,8 +2551,8 @@ int ADDCALL hackrf_spiflash_read(
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SPIFLASH_READ,
 		address >> 16,
@@ -1614,8 +2574,8 @@ int ADDCALL hackrf_spiflash_status(hackrf_device* device, uint8_t* data)
 	USB_API_REQUIRED(device, 0x0103)
 	int result;
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SPIFLASH_STATUS,
 		0,
@@ -1636,8 +2596,8 @@ int ADDCALL hackrf_spiflash_clear_status(hackrf_device* device)
 {
 	USB_API_REQUIRED(device, 0x0103)
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SPIFLASH_CLEAR_STATUS,
@@ -1669,8 +2629,8 @@ int ADDCALL hackrf_cpld_write(
 		return result;
 
 	for (i = 0; i < total_length; i += chunk_size) {
-		result = libusb_bulk_transfer(
-			device->usb_device,
+		result = usb_bulk_transfer(
+			device,
 			TX_ENDPOINT_ADDRESS,
 			&data[i],
 			chunk_size,
@@ -1689,8 +2649,8 @@ int ADDCALL hackrf_cpld_write(
 int ADDCALL hackrf_board_id_read(hackrf_device* device, uint8_t* value)
 {
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_BOARD_ID_READ,
 		0,
@@ -1713,8 +2673,8 @@ int ADDCALL hackrf_version_string_read(
 	uint8_t length)
 {
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_VERSION_STRING_READ,
 		0,
@@ -1763,8 +2723,8 @@ int ADDCALL hackrf_set_freq(hackrf_device* device, const uint64_t freq_hz)
 	set_freq_params.freq_hz = TO_LE(l_freq_hz);
 	length = sizeof(set_freq_params_t);
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SET_FREQ,
@@ -1823,8 +2783,8 @@ int ADDCALL hackrf_set_freq_explicit(
 	params.path = (uint8_t) path;
 	length = sizeof(struct set_freq_explicit_params);
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SET_FREQ_EXPLICIT,
@@ -1865,8 +2825,8 @@ int ADDCALL hackrf_set_sample_rate_manual(
 	set_fracrate_params.divider = TO_LE(divider);
 	length = sizeof(set_fracrate_params_t);
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SAMPLE_RATE_SET,
@@ -1937,8 +2897,8 @@ int ADDCALL hackrf_set_sample_rate(hackrf_device* device, const double freq)
 int ADDCALL hackrf_set_amp_enable(hackrf_device* device, const uint8_t value)
 {
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_AMP_ENABLE,
@@ -1964,8 +2924,8 @@ int ADDCALL hackrf_board_partid_serialno_read(
 	int result;
 
 	length = sizeof(read_partid_serialno_t);
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_BOARD_PARTID_SERIALNO_READ,
 		0,
@@ -2005,8 +2965,8 @@ int ADDCALL hackrf_set_lna_gain(hackrf_device* device, uint32_t value)
 	}
 
 	value &= ~0x07;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SET_LNA_GAIN,
 		0,
@@ -2032,8 +2992,8 @@ int ADDCALL hackrf_set_vga_gain(hackrf_device* device, uint32_t value)
 	}
 
 	value &= ~0x01;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SET_VGA_GAIN,
 		0,
@@ -2058,8 +3018,8 @@ int ADDCALL hackrf_set_txvga_gain(hackrf_device* device, uint32_t value)
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SET_TXVGA_GAIN,
 		0,
@@ -2075,85 +3035,176 @@ int ADDCALL hackrf_set_txvga_gain(hackrf_device* device, uint32_t value)
 	}
 }
 
-int ADDCALL hackrf_set_antenna_enable(hackrf_device* device, const uint8_t value)
+int ADDCALL hackrf_set_antenna_enable(hackrf_device* device, const uint8_t value)
+{
+	int result;
+	result = usb_control_transfer(
+		device,
+		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
+			LIBUSB_RECIPIENT_DEVICE,
+		HACKRF_VENDOR_REQUEST_ANTENNA_ENABLE,
+		value,
+		0,
+		NULL,
+		0,
+		DEFAULT_REQUEST_TIMEOUT);
+
+	if (result != 0) {
+		last_libusb_error = result;
+		return HACKRF_ERROR_LIBUSB;
+	} else {
+		return HACKRF_SUCCESS;
+	}
+}
+
+static void* transfer_threadproc(void* arg)
+{
+	hackrf_device* device = (hackrf_device*) arg;
+	int error;
+	struct timeval timeout = {0, 500000};
+
+	if (block_thread_signals() != HACKRF_SUCCESS) {
+		return NULL;
+	}
+
+	while (device->do_exit == false) {
+		error = libusb_handle_events_timeout(g_libusb_context, &timeout);
+		if ((error != 0) && (error != LIBUSB_ERROR_INTERRUPTED)) {
+			device->streaming = false;
+		}
+	}
+
+	return NULL;
+}
+
+static void* event_threadproc(void* arg)
+{
+	struct timeval timeout = {0, 500000};
+
+	(void) arg;
+
+	if (block_thread_signals() != HACKRF_SUCCESS) {
+		return NULL;
+	}
+
+	/*
+	 * Completion callbacks find their device through the transfer's
+	 * user_data, so any thread can handle events for every device. Errors
+	 * here aren't specific to one device; failed transfers are reported
+	 * through their own callbacks.
+	 */
+	while (event_threads_exit == 0) {
+		libusb_handle_events_timeout_completed(
+			g_libusb_context,
+			&timeout,
+			(int*) &event_threads_exit);
+	}
+
+	return NULL;
+}
+
+static int start_event_threads(void)
+{
+	int result;
+
+	if (event_threads_started > 0) {
+		return HACKRF_SUCCESS;
+	}
+
+	event_threads_exit = 0;
+	while (event_threads_started < event_thread_count) {
+		result = pthread_create(
+			&event_threads[event_threads_started],
+			0,
+			event_threadproc,
+			NULL);
+		if (result != 0) {
+			stop_event_threads();
+			return HACKRF_ERROR_THREAD;
+		}
+		event_threads_started++;
+	}
+
+	return HACKRF_SUCCESS;
+}
+
+static int stop_event_threads(void)
 {
-	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
-		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
-			LIBUSB_RECIPIENT_DEVICE,
-		HACKRF_VENDOR_REQUEST_ANTENNA_ENABLE,
-		value,
-		0,
-		NULL,
-		0,
-		DEFAULT_REQUEST_TIMEOUT);
+	void* value;
+	int result = HACKRF_SUCCESS;
 
-	if (result != 0) {
-		last_libusb_error = result;
-		return HACKRF_ERROR_LIBUSB;
-	} else {
+	if (event_threads_started == 0) {
 		return HACKRF_SUCCESS;
 	}
-}
-
-static void* transfer_threadproc(void* arg)
-{
-	hackrf_device* device = (hackrf_device*) arg;
-	int error;
-	struct timeval timeout = {0, 500000};
 
 	/*
-	 * hackrf_transfer uses pause() and SIGALRM to print statistics and
-	 * POSIX doesn't specify which thread must recieve the signal, block all
-	 * signals here, so we don't interrupt their reception by
-	 * hackrf_transfer or any other app which uses the library (#1323)
+	 * Interrupt the thread handling events. Releasing the event lock then
+	 * wakes any threads waiting for it, which see the exit flag.
 	 */
-#ifndef _WIN32
-	sigset_t signal_mask;
-	sigfillset(&signal_mask);
-	if (pthread_sigmask(SIG_BLOCK, &signal_mask, NULL) != 0) {
-		return NULL;
-	}
-#endif
+	event_threads_exit = 1;
+	libusb_interrupt_event_handler(g_libusb_context);
 
-	while (device->do_exit == false) {
-		error = libusb_handle_events_timeout(g_libusb_context, &timeout);
-		if ((error != 0) && (error != LIBUSB_ERROR_INTERRUPTED)) {
-			device->streaming = false;
+	while (event_threads_started > 0) {
+		event_threads_started--;
+		value = NULL;
+		if (pthread_join(event_threads[event_threads_started], &value) != 0) {
+			result = HACKRF_ERROR_THREAD;
 		}
 	}
 
-	return NULL;
+	return result;
 }
 
 static void LIBUSB_CALL hackrf_libusb_flush_callback(struct libusb_transfer* usb_transfer)
 {
 	bool success = usb_transfer->status == LIBUSB_TRANSFER_COMPLETED;
 
-	// All transfers have now ended, so proceed with signalling completion.
 	hackrf_device* device = (hackrf_device*) usb_transfer->user_data;
-	pthread_mutex_lock(&device->transfer_lock);
-	device->flush = false;
-	device->active_transfers = 0;
-	pthread_cond_broadcast(&device->all_finished_cv);
-	pthread_mutex_unlock(&device->transfer_lock);
+	hackrf_flush_cb_fn flush_callback = device->flush_callback;
+	void* flush_ctx = device->flush_ctx;
+
+	// All transfers have now ended, so proceed with signalling completion.
+	finish_transfer(device);
+
+	if (flush_callback)
+		flush_callback(flush_ctx, success);
+}
+
+/*
+ * Pass a completed transfer to the user callback, or to the application
+ * side of the block queue if one is in use.
+ */
+static int dispatch_transfer(
+	hackrf_device* device,
+	struct libusb_transfer* usb_transfer,
+	hackrf_transfer* transfer)
+{
+	switch (device->queue_mode) {
+	case BLOCK_QUEUE_CALLBACK_THREAD:
+	case BLOCK_QUEUE_SYNC_RX:
+		queue_rx_block(device, usb_transfer);
+		return 0;
+
+	case BLOCK_QUEUE_SYNC_TX:
+		return refill_tx_block(device, usb_transfer, transfer);
 
-	if (device->flush_callback)
-		device->flush_callback(device->flush_ctx, success);
+	default:
+		return device->callback(transfer);
+	}
 }
 
 static void LIBUSB_CALL
 hackrf_libusb_transfer_callback(struct libusb_transfer* usb_transfer)
 {
 	hackrf_device* device = (hackrf_device*) usb_transfer->user_data;
-	bool success, resubmit = false;
-	int result;
+	bool success, next = false, resubmitted = false, resubmit_failed = false;
+	uint64_t start_us = monotonic_us();
+	uint64_t dispatched_us = 0;
 
 	hackrf_transfer transfer = {
 		.device = device,
 		.buffer = usb_transfer->buffer,
-		.buffer_length = TRANSFER_BUFFER_SIZE,
+		.buffer_length = device->transfer_buffer_size,
 		.valid_length = usb_transfer->actual_length,
 		.rx_ctx = device->rx_ctx,
 		.tx_ctx = device->tx_ctx};
@@ -2164,14 +3215,17 @@ hackrf_libusb_transfer_callback(struct libusb_transfer* usb_transfer)
 		device->tx_completion_callback(&transfer, success);
 	}
 
-	// Take lock to make sure that we don't restart a
-	// transfer whilst cancel_transfers() is in the middle
-	// of stopping them.
-	pthread_mutex_lock(&device->transfer_lock);
 	if (success) {
-		if (device->streaming && (device->callback(&transfer) == 0) &&
-		    (transfer.valid_length > 0)) {
-			if ((resubmit = device->transfers_setup)) {
+		if (device->streaming) {
+			next = (dispatch_transfer(device, usb_transfer, &transfer) == 0) &&
+				(transfer.valid_length > 0);
+			dispatched_us = monotonic_us();
+		}
+
+		if (next) {
+			// If cancel_transfers() has started, it will wait for us to
+			// finish resubmitting, then cancel this transfer too.
+			if (begin_resubmit(device)) {
 				if (usb_transfer->endpoint == TX_ENDPOINT_ADDRESS) {
 					usb_transfer->length = transfer.valid_length;
 					// Pad to the next 512-byte boundary.
@@ -2179,39 +3233,56 @@ hackrf_libusb_transfer_callback(struct libusb_transfer* usb_transfer)
 					while (usb_transfer->length % 512 != 0)
 						buffer[usb_transfer->length++] = 0;
 				}
-				result = libusb_submit_transfer(usb_transfer);
-			}
-		} else if (device->flush) {
-			result = libusb_submit_transfer(device->flush_transfer);
-			if (result != LIBUSB_SUCCESS) {
-				device->streaming = false;
-				device->flush = false;
+				resubmitted = (usb_submit_transfer(device, usb_transfer) ==
+					       LIBUSB_SUCCESS);
+				end_resubmit(device);
+				resubmit_failed = !resubmitted;
 			}
+		} else {
+			submit_flush_transfer(device);
 		}
 	} else {
-		device->streaming = false;
-		device->flush = false;
+		atomic_store_u32(&device->flush, false);
 	}
 
+	stats_write_begin(&device->event_stats);
+	if (success) {
+		device->event_stats.transfers++;
+		device->event_stats.bytes += usb_transfer->actual_length;
+	} else if (usb_transfer->status != LIBUSB_TRANSFER_CANCELLED) {
+		device->event_stats.transfer_errors++;
+	}
+	if (resubmit_failed) {
+		device->event_stats.resubmit_failures++;
+	}
+	if ((dispatched_us != 0) && (device->queue_mode == BLOCK_QUEUE_OFF)) {
+		stats_record_duration(
+			device->event_stats.callback_histogram,
+			&device->event_stats.callback_max_us,
+			dispatched_us - start_us);
+	}
+	if (resubmitted) {
+		stats_record_duration(
+			device->event_stats.turnaround_histogram,
+			&device->event_stats.turnaround_max_us,
+			monotonic_us() - start_us);
+	}
+	stats_write_end(&device->event_stats);
+
 	// If a data transfer was resubmitted successfully, we're done.
-	if (!resubmit || result != LIBUSB_SUCCESS) {
+	if (!resubmitted) {
 		// No further calls should be made to the TX callback.
 		device->streaming = false;
 
-		// If this is the last transfer, signal that all are now finished.
-		if (device->active_transfers == 1) {
-			if (!device->flush) {
-				device->active_transfers = 0;
-				pthread_cond_broadcast(&device->all_finished_cv);
-			}
-		} else {
-			device->active_transfers--;
+		// Wake the application if it is waiting on the block queue.
+		if (device->queue_mode != BLOCK_QUEUE_OFF) {
+			pthread_mutex_lock(&device->queue_lock);
+			pthread_cond_broadcast(&device->queue_cv);
+			pthread_mutex_unlock(&device->queue_lock);
 		}
-	}
 
-	// Now we can release the lock. Our transfer was either
-	// cancelled or restarted, not both.
-	pthread_mutex_unlock(&device->transfer_lock);
+		finish_transfer(device);
+	}
 }
 
 static int kill_transfer_thread(hackrf_device* device)
@@ -2226,6 +3297,13 @@ static int kill_transfer_thread(hackrf_device* device)
 		 */
 		cancel_transfers(device);
 
+		// The shared event threads keep running for other devices, and
+		// the emulator thread until the device is closed.
+		if (device->shared_event_threads || (device->emulator != NULL)) {
+			device->transfer_thread_started = false;
+			return HACKRF_SUCCESS;
+		}
+
 		// Set flag to tell the thread to exit.
 		device->do_exit = true;
 
@@ -2252,20 +3330,77 @@ static int kill_transfer_thread(hackrf_device* device)
 	return HACKRF_SUCCESS;
 }
 
-static int prepare_setup_transfers(
+static int prepare_setup_queued_transfers(
 	hackrf_device* device,
 	const uint8_t endpoint_address,
-	hackrf_sample_block_cb_fn callback)
+	hackrf_sample_block_cb_fn callback,
+	const block_queue_mode queue_mode,
+	const uint32_t num_buffers)
 {
-	if (device->transfers_setup == true) {
+	int result;
+
+	if ((device->transfers_setup == true) ||
+	    (device->queue_mode != BLOCK_QUEUE_OFF)) {
 		return HACKRF_ERROR_BUSY;
 	}
 
 	device->callback = callback;
-	return prepare_transfers(
+
+	if (queue_mode != BLOCK_QUEUE_OFF) {
+		result = setup_block_pool(device, num_buffers);
+		if (result != HACKRF_SUCCESS) {
+			return result;
+		}
+		device->queue_exit = false;
+		device->consumer_waiting = 0;
+		device->queue_mode = queue_mode;
+	}
+
+	if (queue_mode == BLOCK_QUEUE_CALLBACK_THREAD) {
+		result = pthread_create(
+			&device->callback_thread,
+			0,
+			callback_threadproc,
+			device);
+		if (result != 0) {
+			device->queue_mode = BLOCK_QUEUE_OFF;
+			return HACKRF_ERROR_THREAD;
+		}
+		device->callback_thread_started = true;
+	}
+
+	result = prepare_transfers(
 		device,
 		endpoint_address,
 		hackrf_libusb_transfer_callback);
+	if (result != HACKRF_SUCCESS) {
+		stop_block_queue(device);
+	}
+
+	return result;
+}
+
+static int prepare_setup_transfers(
+	hackrf_device* device,
+	const uint8_t endpoint_address,
+	hackrf_sample_block_cb_fn callback)
+{
+	if ((endpoint_address == RX_ENDPOINT_ADDRESS) &&
+	    (device->callback_thread_buffers > 0)) {
+		return prepare_setup_queued_transfers(
+			device,
+			endpoint_address,
+			callback,
+			BLOCK_QUEUE_CALLBACK_THREAD,
+			device->callback_thread_buffers);
+	}
+
+	return prepare_setup_queued_transfers(
+		device,
+		endpoint_address,
+		callback,
+		BLOCK_QUEUE_OFF,
+		0);
 }
 
 static int create_transfer_thread(hackrf_device* device)
@@ -2275,6 +3410,24 @@ static int create_transfer_thread(hackrf_device* device)
 	if (device->transfer_thread_started == false) {
 		device->streaming = false;
 		device->do_exit = false;
+
+		// The emulator completes transfers from its own thread.
+		if (device->emulator != NULL) {
+			device->shared_event_threads = false;
+			device->transfer_thread_started = true;
+			return HACKRF_SUCCESS;
+		}
+
+		if (event_thread_count > 0) {
+			result = start_event_threads();
+			if (result == HACKRF_SUCCESS) {
+				device->shared_event_threads = true;
+				device->transfer_thread_started = true;
+			}
+			return result;
+		}
+
+		device->shared_event_threads = false;
 		result = pthread_create(
 			&device->transfer_thread,
 			0,
@@ -2380,43 +3533,352 @@ ADDAPI int ADDCALL hackrf_set_tx_block_complete_callback(
 	return HACKRF_SUCCESS;
 }
 
-ADDAPI int ADDCALL hackrf_enable_tx_flush(
+ADDAPI int ADDCALL hackrf_enable_tx_flush(
+	hackrf_device* device,
+	hackrf_flush_cb_fn callback,
+	void* flush_ctx)
+{
+	device->flush_callback = callback;
+	device->flush_ctx = flush_ctx;
+
+	if (device->flush_transfer) {
+		return HACKRF_SUCCESS;
+	}
+
+	if ((device->flush_transfer = libusb_alloc_transfer(0)) == NULL) {
+		return HACKRF_ERROR_LIBUSB;
+	}
+
+	libusb_fill_bulk_transfer(
+		device->flush_transfer,
+		device->usb_device,
+		TX_ENDPOINT_ADDRESS,
+		calloc(1, device->buffer_size),
+		device->buffer_size,
+		hackrf_libusb_flush_callback,
+		device,
+		DEFAULT_REQUEST_TIMEOUT);
+
+	device->flush_transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER;
+
+	return HACKRF_SUCCESS;
+}
+
+ADDAPI int ADDCALL hackrf_disable_tx_flush(hackrf_device* device)
+{
+	libusb_free_transfer(device->flush_transfer);
+	device->flush_transfer = NULL;
+	device->flush_callback = NULL;
+	device->flush_ctx = NULL;
+
+	return HACKRF_SUCCESS;
+}
+
+ADDAPI int ADDCALL hackrf_enable_callback_thread(
+	hackrf_device* device,
+	const uint32_t num_buffers)
+{
+	if (num_buffers == 0) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	if (device->transfers_setup || (device->queue_mode != BLOCK_QUEUE_OFF)) {
+		return HACKRF_ERROR_BUSY;
+	}
+
+	device->callback_thread_buffers = num_buffers;
+
+	return HACKRF_SUCCESS;
+}
+
+ADDAPI int ADDCALL hackrf_disable_callback_thread(hackrf_device* device)
+{
+	if (device->transfers_setup || (device->queue_mode != BLOCK_QUEUE_OFF)) {
+		return HACKRF_ERROR_BUSY;
+	}
+
+	device->callback_thread_buffers = 0;
+
+	return HACKRF_SUCCESS;
+}
+
+ADDAPI int ADDCALL hackrf_get_host_drops(hackrf_device* device, uint64_t* drops)
+{
+	struct stream_counters event_stats;
+
+	stats_snapshot(&device->event_stats, &event_stats);
+	*drops = event_stats.host_drops;
+	return HACKRF_SUCCESS;
+}
+
+int ADDCALL hackrf_get_stream_stats(hackrf_device* device, hackrf_stream_stats* stats)
+{
+	struct stream_counters event_stats, callback_stats;
+	int i;
+
+	stats_snapshot(&device->event_stats, &event_stats);
+	stats_snapshot(&device->callback_stats, &callback_stats);
+
+	stats->transfers = event_stats.transfers;
+	stats->bytes = event_stats.bytes;
+	stats->transfer_errors = event_stats.transfer_errors;
+	stats->resubmit_failures = event_stats.resubmit_failures;
+	stats->host_drops = event_stats.host_drops;
+
+	// Only one of these measures the callback, depending on where it runs.
+	stats->callback_max_us = event_stats.callback_max_us;
+	if (callback_stats.callback_max_us > stats->callback_max_us) {
+		stats->callback_max_us = callback_stats.callback_max_us;
+	}
+	stats->turnaround_max_us = event_stats.turnaround_max_us;
+	for (i = 0; i < HACKRF_STREAM_STATS_BINS; i++) {
+		stats->callback_histogram[i] = event_stats.callback_histogram[i] +
+			callback_stats.callback_histogram[i];
+		stats->turnaround_histogram[i] = event_stats.turnaround_histogram[i];
+	}
+
+	return HACKRF_SUCCESS;
+}
+
+int ADDCALL hackrf_start_rx_sync(hackrf_device* device, const uint32_t num_buffers)
+{
+	int result;
+
+	if (num_buffers == 0) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	result = hackrf_set_transceiver_mode(device, HACKRF_TRANSCEIVER_MODE_RECEIVE);
+	if (result == HACKRF_SUCCESS) {
+		device->rx_ctx = NULL;
+		result = prepare_setup_queued_transfers(
+			device,
+			RX_ENDPOINT_ADDRESS,
+			NULL,
+			BLOCK_QUEUE_SYNC_RX,
+			num_buffers);
+	}
+	return result;
+}
+
+int ADDCALL hackrf_start_tx_sync(hackrf_device* device, const uint32_t num_buffers)
+{
+	int result;
+
+	if (num_buffers == 0) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	if (device->flush_transfer != NULL) {
+		device->flush = true;
+	}
+	result = hackrf_set_transceiver_mode(device, HACKRF_TRANSCEIVER_MODE_TRANSMIT);
+	if (result == HACKRF_SUCCESS) {
+		device->tx_ctx = NULL;
+		result = prepare_setup_queued_transfers(
+			device,
+			TX_ENDPOINT_ADDRESS,
+			sync_tx_prefill,
+			BLOCK_QUEUE_SYNC_TX,
+			num_buffers);
+	}
+	return result;
+}
+
+static int check_sync_mode(hackrf_device* device, const block_queue_mode mode)
+{
+	if (device->queue_mode == mode) {
+		return HACKRF_SUCCESS;
+	} else if (device->queue_mode == BLOCK_QUEUE_OFF) {
+		return HACKRF_ERROR_STREAMING_STOPPED;
+	} else {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+}
+
+int ADDCALL hackrf_read_samples(
+	hackrf_device* device,
+	void* buffer,
+	const uint32_t length,
+	uint32_t* bytes_read,
+	const uint32_t timeout_ms)
+{
+	uint8_t* dest = (uint8_t*) buffer;
+	uint32_t done = 0, chunk;
+	struct timespec deadline;
+	int result;
+
+	*bytes_read = 0;
+	result = check_sync_mode(device, BLOCK_QUEUE_SYNC_RX);
+	if (result != HACKRF_SUCCESS) {
+		return result;
+	}
+
+	deadline_after_ms(&deadline, timeout_ms);
+	while (done < length) {
+		if (device->sync_block == NULL) {
+			result = acquire_block(
+				device,
+				&device->filled_ring,
+				&deadline,
+				&device->sync_block,
+				&device->sync_block_length);
+			if (result != HACKRF_SUCCESS) {
+				device->sync_block = NULL;
+				break;
+			}
+			device->sync_block_offset = 0;
+		}
+
+		chunk = device->sync_block_length - device->sync_block_offset;
+		if (chunk > length - done) {
+			chunk = length - done;
+		}
+		memcpy(&dest[done], &device->sync_block[device->sync_block_offset], chunk);
+		done += chunk;
+		device->sync_block_offset += chunk;
+
+		if (device->sync_block_offset == device->sync_block_length) {
+			block_ring_push(&device->free_ring, device->sync_block, 0);
+			device->sync_block = NULL;
+		}
+	}
+
+	*bytes_read = done;
+	return result;
+}
+
+int ADDCALL hackrf_write_samples(
 	hackrf_device* device,
-	hackrf_flush_cb_fn callback,
-	void* flush_ctx)
+	const void* buffer,
+	const uint32_t length,
+	uint32_t* bytes_written,
+	const uint32_t timeout_ms)
 {
-	device->flush_callback = callback;
-	device->flush_ctx = flush_ctx;
+	const uint8_t* src = (const uint8_t*) buffer;
+	uint32_t done = 0, chunk;
+	struct timespec deadline;
+	int unused;
+	int result;
 
-	if (device->flush_transfer) {
+	*bytes_written = 0;
+	result = check_sync_mode(device, BLOCK_QUEUE_SYNC_TX);
+	if (result != HACKRF_SUCCESS) {
+		return result;
+	}
+
+	if (length == 0) {
+		// Send any partly written block, then mark the end of the stream.
+		if (device->sync_block != NULL) {
+			block_ring_push(
+				&device->filled_ring,
+				device->sync_block,
+				device->sync_block_offset);
+			device->sync_block = NULL;
+		}
+		block_ring_push(&device->filled_ring, NULL, 0);
 		return HACKRF_SUCCESS;
 	}
 
-	if ((device->flush_transfer = libusb_alloc_transfer(0)) == NULL) {
-		return HACKRF_ERROR_LIBUSB;
+	deadline_after_ms(&deadline, timeout_ms);
+	while (done < length) {
+		if (device->sync_block == NULL) {
+			result = acquire_block(
+				device,
+				&device->free_ring,
+				&deadline,
+				&device->sync_block,
+				&unused);
+			if (result != HACKRF_SUCCESS) {
+				device->sync_block = NULL;
+				break;
+			}
+			device->sync_block_offset = 0;
+		}
+
+		chunk = device->transfer_buffer_size - device->sync_block_offset;
+		if (chunk > length - done) {
+			chunk = length - done;
+		}
+		memcpy(&device->sync_block[device->sync_block_offset], &src[done], chunk);
+		done += chunk;
+		device->sync_block_offset += chunk;
+
+		if (device->sync_block_offset == (int) device->transfer_buffer_size) {
+			block_ring_push(
+				&device->filled_ring,
+				device->sync_block,
+				device->sync_block_offset);
+			device->sync_block = NULL;
+		}
 	}
 
-	libusb_fill_bulk_transfer(
-		device->flush_transfer,
-		device->usb_device,
-		TX_ENDPOINT_ADDRESS,
-		calloc(1, device->buffer_size),
-		device->buffer_size,
-		hackrf_libusb_flush_callback,
-		device,
-		DEFAULT_REQUEST_TIMEOUT);
+	*bytes_written = done;
+	return result;
+}
 
-	device->flush_transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER;
+int ADDCALL hackrf_acquire_buffer(
+	hackrf_device* device,
+	hackrf_transfer* transfer,
+	const uint32_t timeout_ms)
+{
+	struct timespec deadline;
+	unsigned char* buffer;
+	int length;
+	int result;
+
+	if (device->queue_mode == BLOCK_QUEUE_SYNC_RX) {
+		deadline_after_ms(&deadline, timeout_ms);
+		result = acquire_block(
+			device,
+			&device->filled_ring,
+			&deadline,
+			&buffer,
+			&length);
+	} else if (device->queue_mode == BLOCK_QUEUE_SYNC_TX) {
+		deadline_after_ms(&deadline, timeout_ms);
+		result = acquire_block(
+			device,
+			&device->free_ring,
+			&deadline,
+			&buffer,
+			&length);
+		length = device->transfer_buffer_size;
+	} else {
+		result = check_sync_mode(device, BLOCK_QUEUE_SYNC_RX);
+	}
+
+	if (result != HACKRF_SUCCESS) {
+		return result;
+	}
+
+	transfer->device = device;
+	transfer->buffer = buffer;
+	transfer->buffer_length = device->transfer_buffer_size;
+	transfer->valid_length = length;
+	transfer->rx_ctx = device->rx_ctx;
+	transfer->tx_ctx = device->tx_ctx;
 
 	return HACKRF_SUCCESS;
 }
 
-ADDAPI int ADDCALL hackrf_disable_tx_flush(hackrf_device* device)
+int ADDCALL hackrf_release_buffer(hackrf_device* device, hackrf_transfer* transfer)
 {
-	libusb_free_transfer(device->flush_transfer);
-	device->flush_transfer = NULL;
-	device->flush_callback = NULL;
-	device->flush_ctx = NULL;
+	if ((transfer->valid_length < 0) ||
+	    (transfer->valid_length > (int) device->transfer_buffer_size)) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	if (device->queue_mode == BLOCK_QUEUE_SYNC_RX) {
+		block_ring_push(&device->free_ring, transfer->buffer, 0);
+	} else if (device->queue_mode == BLOCK_QUEUE_SYNC_TX) {
+		block_ring_push(
+			&device->filled_ring,
+			transfer->buffer,
+			transfer->valid_length);
+	} else {
+		return check_sync_mode(device, BLOCK_QUEUE_SYNC_RX);
+	}
 
 	return HACKRF_SUCCESS;
 }
@@ -2442,10 +3904,11 @@ int ADDCALL hackrf_stop_tx(hackrf_device* device)
 
 int ADDCALL hackrf_close(hackrf_device* device)
 {
-	int result1, result2;
+	int result1, result2, result3;
 
 	result1 = HACKRF_SUCCESS;
 	result2 = HACKRF_SUCCESS;
+	result3 = HACKRF_SUCCESS;
 
 	if (device != NULL) {
 		result1 = hackrf_stop_cmd(device);
@@ -2455,24 +3918,43 @@ int ADDCALL hackrf_close(hackrf_device* device)
 		 * also cancel any pending transmit/receive transfers.
 		 */
 		result2 = kill_transfer_thread(device);
+
+		// Transfers can't be freed until the emulator is done with them.
+		if (device->emulator != NULL) {
+			hackrf_emulator_close(device->emulator);
+			device->emulator = NULL;
+		}
+
+		// Device memory must be released before the device is closed.
+		free_transfers(device);
+		free_block_pool(device);
+		libusb_free_transfer(device->flush_transfer);
+
 		if (device->usb_device != NULL) {
 			libusb_release_interface(device->usb_device, 0);
 			libusb_close(device->usb_device);
 			device->usb_device = NULL;
 		}
 
-		free_transfers(device);
-
 		pthread_mutex_destroy(&device->transfer_lock);
 		pthread_cond_destroy(&device->all_finished_cv);
+		pthread_mutex_destroy(&device->queue_lock);
+		pthread_cond_destroy(&device->queue_cv);
 
 		free(device);
 	}
 	open_devices--;
 
+	if (open_devices == 0) {
+		result3 = stop_event_threads();
+	}
+
 	if (result2 != HACKRF_SUCCESS) {
 		return result2;
 	}
+	if (result3 != HACKRF_SUCCESS) {
+		return result3;
+	}
 	return result1;
 }
 
@@ -2491,6 +3973,9 @@ const char* ADDCALL hackrf_error_name(enum hackrf_error errcode)
 	case HACKRF_ERROR_NOT_FOUND:
 		return "HackRF not found";
 
+	case HACKRF_ERROR_TIMEOUT:
+		return "operation timed out";
+
 	case HACKRF_ERROR_BUSY:
 		return "HackRF busy";
 
@@ -2635,46 +4120,326 @@ uint32_t ADDCALL hackrf_compute_baseband_filter_bw_round_down_lt(
 	if (p != max2837_ft) {
 		p--;
 	}
-	return p->bandwidth_hz;
-}
+	return p->bandwidth_hz;
+}
+
+/* Return final bw. */
+uint32_t ADDCALL hackrf_compute_baseband_filter_bw(const uint32_t bandwidth_hz)
+{
+	const max2837_ft_t* p = max2837_ft;
+	while (p->bandwidth_hz != 0) {
+		if (p->bandwidth_hz >= bandwidth_hz) {
+			break;
+		}
+		p++;
+	}
+
+	/* Round down (if no equal to first entry) and if > bandwidth_hz */
+	if (p != max2837_ft) {
+		if (p->bandwidth_hz > bandwidth_hz)
+			p--;
+	}
+
+	return p->bandwidth_hz;
+}
+
+/* All features below require USB API version 0x0102 or higher) */
+
+int ADDCALL hackrf_set_hw_sync_mode(hackrf_device* device, const uint8_t value)
+{
+	USB_API_REQUIRED(device, 0x0102)
+	int result = usb_control_transfer(
+		device,
+		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
+			LIBUSB_RECIPIENT_DEVICE,
+		HACKRF_VENDOR_REQUEST_SET_HW_SYNC_MODE,
+		value,
+		0,
+		NULL,
+		0,
+		DEFAULT_REQUEST_TIMEOUT);
+
+	if (result != 0) {
+		last_libusb_error = result;
+		return HACKRF_ERROR_LIBUSB;
+	} else {
+		return HACKRF_SUCCESS;
+	}
+}
+
+/*
+ * Initialize sweep mode:
+ * frequency_list is a list of start/stop pairs of frequencies in MHz.
+ * num_ranges is the number of pairs in frequency_list (1 to 10)
+ * num_bytes is the number of sample bytes to capture after each tuning.
+ * step_width is the width in Hz of the tuning step.
+ * offset is a number of Hz added to every tuning frequency.
+ *     Use to select center frequency based on the expected usable bandwidth.
+ * sweep_mode
+ *     LINEAR means step_width is added to the current frequency at each step.
+ *     INTERLEAVED invokes a scheme in which each step is divided into two
+ *         interleaved sub-steps, allowing the host to select the best portions
+ *         of the FFT of each sub-step and discard the rest.
+ */
+/*
+ * Validate a sweep plan and pack it into data in the INIT_SWEEP format.
+ * Returns the number of bytes packed, or a negative hackrf_error.
+ */
+static int pack_sweep_plan(
+	unsigned char* data,
+	const uint16_t* frequency_list,
+	const int num_ranges,
+	const uint32_t step_width,
+	const uint32_t offset,
+	const enum sweep_style style)
+{
+	int i;
+
+	if ((num_ranges < 1) || (num_ranges > MAX_SWEEP_RANGES)) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	if (1 > step_width) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	if (INTERLEAVED < style) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	data[0] = step_width & 0xff;
+	data[1] = (step_width >> 8) & 0xff;
+	data[2] = (step_width >> 16) & 0xff;
+	data[3] = (step_width >> 24) & 0xff;
+	data[4] = offset & 0xff;
+	data[5] = (offset >> 8) & 0xff;
+	data[6] = (offset >> 16) & 0xff;
+	data[7] = (offset >> 24) & 0xff;
+	data[8] = style;
+	for (i = 0; i < (num_ranges * 2); i++) {
+		data[9 + i * 2] = frequency_list[i] & 0xff;
+		data[10 + i * 2] = (frequency_list[i] >> 8) & 0xff;
+	}
+	return 9 + num_ranges * 2 * sizeof(frequency_list[0]);
+}
+
+int ADDCALL hackrf_init_sweep(
+	hackrf_device* device,
+	const uint16_t* frequency_list,
+	const int num_ranges,
+	const uint32_t num_bytes,
+	const uint32_t step_width,
+	const uint32_t offset,
+	const enum sweep_style style)
+{
+	USB_API_REQUIRED(device, 0x0102)
+	int result;
+	unsigned char data[9 + MAX_SWEEP_RANGES * 2 * sizeof(frequency_list[0])];
+	int size;
+
+	if (num_bytes % BYTES_PER_BLOCK) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	if (BYTES_PER_BLOCK > num_bytes) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	size = pack_sweep_plan(
+		data,
+		frequency_list,
+		num_ranges,
+		step_width,
+		offset,
+		style);
+	if (size < 0) {
+		return size;
+	}
+
+	result = usb_control_transfer(
+		device,
+		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
+			LIBUSB_RECIPIENT_DEVICE,
+		HACKRF_VENDOR_REQUEST_INIT_SWEEP,
+		num_bytes & 0xffff,
+		(num_bytes >> 16) & 0xffff,
+		data,
+		size,
+		DEFAULT_REQUEST_TIMEOUT);
+
+	if (result < size) {
+		last_libusb_error = result;
+		return HACKRF_ERROR_LIBUSB;
+	} else {
+		return HACKRF_SUCCESS;
+	}
+}
+
+int ADDCALL hackrf_init_sweep_timed(
+	hackrf_device* device,
+	const uint16_t* frequency_list,
+	const int num_ranges,
+	const uint32_t num_bytes,
+	const uint32_t step_width,
+	const uint32_t offset,
+	const enum sweep_style style,
+	const uint32_t block_size,
+	const uint32_t settle_samples)
+{
+	USB_API_REQUIRED(device, 0x0114)
+	int result;
+	unsigned char data[8 + 9 + MAX_SWEEP_RANGES * 2 * sizeof(frequency_list[0])];
+	// The device counts samples 16 at a time.
+	const uint32_t settle = (settle_samples + 15) & ~(uint32_t) 15;
+	int size;
+
+	if ((block_size < HACKRF_SWEEP_MIN_BLOCK_SIZE) || (block_size > BYTES_PER_BLOCK) ||
+	    (block_size & (block_size - 1))) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	if ((num_bytes % block_size) || (block_size > num_bytes)) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	if (settle_samples > HACKRF_SWEEP_MAX_SETTLE_SAMPLES) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	data[0] = block_size & 0xff;
+	data[1] = (block_size >> 8) & 0xff;
+	data[2] = (block_size >> 16) & 0xff;
+	data[3] = (block_size >> 24) & 0xff;
+	data[4] = settle & 0xff;
+	data[5] = (settle >> 8) & 0xff;
+	data[6] = (settle >> 16) & 0xff;
+	data[7] = (settle >> 24) & 0xff;
+	size = pack_sweep_plan(
+		&data[8],
+		frequency_list,
+		num_ranges,
+		step_width,
+		offset,
+		style);
+	if (size < 0) {
+		return size;
+	}
+	size += 8;
+
+	result = usb_control_transfer(
+		device,
+		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
+			LIBUSB_RECIPIENT_DEVICE,
+		HACKRF_VENDOR_REQUEST_INIT_SWEEP_TIMED,
+		num_bytes & 0xffff,
+		(num_bytes >> 16) & 0xffff,
+		data,
+		size,
+		DEFAULT_REQUEST_TIMEOUT);
+
+	if (result < size) {
+		last_libusb_error = result;
+		return HACKRF_ERROR_LIBUSB;
+	} else {
+		return HACKRF_SUCCESS;
+	}
+}
+
+/* Hop table entries sent per SET_HOP_TABLE request, as many as the device takes. */
+#define HOP_CHUNK_ENTRIES 24
+#define HOP_ENTRY_LENGTH  10
+
+int ADDCALL hackrf_init_hop_sweep(
+	hackrf_device* device,
+	const hackrf_hop* hops,
+	const int num_hops,
+	const uint32_t offset,
+	const uint32_t block_size,
+	const uint32_t settle_samples)
+{
+	USB_API_REQUIRED(device, 0x0115)
+	int result;
+	unsigned char data[HOP_CHUNK_ENTRIES * HOP_ENTRY_LENGTH];
+	// The device counts samples 16 at a time.
+	const uint32_t settle = (settle_samples + 15) & ~(uint32_t) 15;
+	int first, count, size, i, j;
+
+	if ((num_hops < 1) || (num_hops > HACKRF_MAX_HOPS)) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	if ((block_size < HACKRF_SWEEP_MIN_BLOCK_SIZE) || (block_size > BYTES_PER_BLOCK) ||
+	    (block_size & (block_size - 1))) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	if (settle_samples > HACKRF_SWEEP_MAX_SETTLE_SAMPLES) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
 
-/* Return final bw. */
-uint32_t ADDCALL hackrf_compute_baseband_filter_bw(const uint32_t bandwidth_hz)
-{
-	const max2837_ft_t* p = max2837_ft;
-	while (p->bandwidth_hz != 0) {
-		if (p->bandwidth_hz >= bandwidth_hz) {
-			break;
+	for (i = 0; i < num_hops; i++) {
+		if ((hops[i].frequency >> 48) || (hops[i].dwell_blocks < 1)) {
+			return HACKRF_ERROR_INVALID_PARAM;
 		}
-		p++;
 	}
 
-	/* Round down (if no equal to first entry) and if > bandwidth_hz */
-	if (p != max2837_ft) {
-		if (p->bandwidth_hz > bandwidth_hz)
-			p--;
+	for (first = 0; first < num_hops; first += count) {
+		count = num_hops - first;
+		if (count > HOP_CHUNK_ENTRIES) {
+			count = HOP_CHUNK_ENTRIES;
+		}
+		for (i = 0; i < count; i++) {
+			for (j = 0; j < 8; j++) {
+				data[i * HOP_ENTRY_LENGTH + j] =
+					(hops[first + i].frequency >> (8 * j)) & 0xff;
+			}
+			data[i * HOP_ENTRY_LENGTH + 8] = hops[first + i].dwell_blocks & 0xff;
+			data[i * HOP_ENTRY_LENGTH + 9] =
+				(hops[first + i].dwell_blocks >> 8) & 0xff;
+		}
+		size = count * HOP_ENTRY_LENGTH;
+		result = usb_control_transfer(
+			device,
+			LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
+				LIBUSB_RECIPIENT_DEVICE,
+			HACKRF_VENDOR_REQUEST_SET_HOP_TABLE,
+			first,
+			0,
+			data,
+			size,
+			DEFAULT_REQUEST_TIMEOUT);
+		if (result < size) {
+			last_libusb_error = result;
+			return HACKRF_ERROR_LIBUSB;
+		}
 	}
 
-	return p->bandwidth_hz;
-}
-
-/* All features below require USB API version 0x0102 or higher) */
-
-int ADDCALL hackrf_set_hw_sync_mode(hackrf_device* device, const uint8_t value)
-{
-	USB_API_REQUIRED(device, 0x0102)
-	int result = libusb_control_transfer(
-		device->usb_device,
+	data[0] = block_size & 0xff;
+	data[1] = (block_size >> 8) & 0xff;
+	data[2] = (block_size >> 16) & 0xff;
+	data[3] = (block_size >> 24) & 0xff;
+	data[4] = settle & 0xff;
+	data[5] = (settle >> 8) & 0xff;
+	data[6] = (settle >> 16) & 0xff;
+	data[7] = (settle >> 24) & 0xff;
+	data[8] = offset & 0xff;
+	data[9] = (offset >> 8) & 0xff;
+	data[10] = (offset >> 16) & 0xff;
+	data[11] = (offset >> 24) & 0xff;
+	size = 12;
+
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
-		HACKRF_VENDOR_REQUEST_SET_HW_SYNC_MODE,
-		value,
-		0,
-		NULL,
+		HACKRF_VENDOR_REQUEST_INIT_HOP_SWEEP,
+		num_hops,
 		0,
+		data,
+		size,
 		DEFAULT_REQUEST_TIMEOUT);
 
-	if (result != 0) {
+	if (result < size) {
 		last_libusb_error = result;
 		return HACKRF_ERROR_LIBUSB;
 	} else {
@@ -2682,80 +4447,76 @@ int ADDCALL hackrf_set_hw_sync_mode(hackrf_device* device, const uint8_t value)
 	}
 }
 
-/*
- * Initialize sweep mode:
- * frequency_list is a list of start/stop pairs of frequencies in MHz.
- * num_ranges is the number of pairs in frequency_list (1 to 10)
- * num_bytes is the number of sample bytes to capture after each tuning.
- * step_width is the width in Hz of the tuning step.
- * offset is a number of Hz added to every tuning frequency.
- *     Use to select center frequency based on the expected usable bandwidth.
- * sweep_mode
- *     LINEAR means step_width is added to the current frequency at each step.
- *     INTERLEAVED invokes a scheme in which each step is divided into two
- *         interleaved sub-steps, allowing the host to select the best portions
- *         of the FFT of each sub-step and discard the rest.
- */
-int ADDCALL hackrf_init_sweep(
-	hackrf_device* device,
-	const uint16_t* frequency_list,
-	const int num_ranges,
-	const uint32_t num_bytes,
-	const uint32_t step_width,
-	const uint32_t offset,
-	const enum sweep_style style)
+int ADDCALL hackrf_parse_sweep_header(const uint8_t* block, hackrf_sweep_header* header)
 {
-	USB_API_REQUIRED(device, 0x0102)
-	int result, i;
-	unsigned char data[9 + MAX_SWEEP_RANGES * 2 * sizeof(frequency_list[0])];
-	int size = 9 + num_ranges * 2 * sizeof(frequency_list[0]);
+	uint64_t field = 0;
+	int i;
 
-	if ((num_ranges < 1) || (num_ranges > MAX_SWEEP_RANGES)) {
+	if ((block[0] != 0x7F) || (block[1] != 0x7F)) {
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
-	if (num_bytes % BYTES_PER_BLOCK) {
-		return HACKRF_ERROR_INVALID_PARAM;
+	for (i = 7; i >= 0; i--) {
+		field = (field << 8) | block[2 + i];
 	}
+	header->frequency = field & 0xffffffffffffULL;
+	header->hop = (field >> 48) & 0xfff;
+	header->port = (int) (field >> 60) - 1;
+	header->byte_count = ((uint32_t) block[13] << 24) | ((uint32_t) block[12] << 16) |
+		((uint32_t) block[11] << 8) | block[10];
 
-	if (BYTES_PER_BLOCK > num_bytes) {
-		return HACKRF_ERROR_INVALID_PARAM;
-	}
+	return HACKRF_SUCCESS;
+}
 
-	if (1 > step_width) {
+int ADDCALL hackrf_parse_spectrum_record(
+	const uint8_t* record,
+	const int length,
+	hackrf_spectrum_record* out,
+	float* pwr)
+{
+	const int num_bins = (length - HACKRF_SPECTRUM_HEADER_LENGTH) / 2;
+	const uint8_t* bin;
+	int i;
+
+	if ((num_bins < HACKRF_SPECTRUM_MIN_FFT_SIZE) ||
+	    (num_bins > HACKRF_SPECTRUM_MAX_FFT_SIZE) || (num_bins & (num_bins - 1)) ||
+	    (hackrf_parse_sweep_header(record, &out->header) != HACKRF_SUCCESS)) {
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
-	if (INTERLEAVED < style) {
-		return HACKRF_ERROR_INVALID_PARAM;
+	out->num_ffts = record[14] | (record[15] << 8);
+	out->num_bins = num_bins;
+	if (pwr != NULL) {
+		bin = &record[HACKRF_SPECTRUM_HEADER_LENGTH];
+		for (i = 0; i < num_bins; i++, bin += 2) {
+			pwr[i] = (int16_t) (bin[0] | (bin[1] << 8)) / 100.0f;
+		}
 	}
 
-	data[0] = step_width & 0xff;
-	data[1] = (step_width >> 8) & 0xff;
-	data[2] = (step_width >> 16) & 0xff;
-	data[3] = (step_width >> 24) & 0xff;
-	data[4] = offset & 0xff;
-	data[5] = (offset >> 8) & 0xff;
-	data[6] = (offset >> 16) & 0xff;
-	data[7] = (offset >> 24) & 0xff;
-	data[8] = style;
-	for (i = 0; i < (num_ranges * 2); i++) {
-		data[9 + i * 2] = frequency_list[i] & 0xff;
-		data[10 + i * 2] = (frequency_list[i] >> 8) & 0xff;
+	return HACKRF_SUCCESS;
+}
+
+int ADDCALL hackrf_init_spectrum(hackrf_device* device, const uint32_t fft_size)
+{
+	USB_API_REQUIRED(device, 0x0116)
+	int result;
+
+	if ((fft_size < HACKRF_SPECTRUM_MIN_FFT_SIZE) ||
+	    (fft_size > HACKRF_SPECTRUM_MAX_FFT_SIZE) || (fft_size & (fft_size - 1))) {
+		return HACKRF_ERROR_INVALID_PARAM;
 	}
 
-	result = libusb_control_transfer(
-		device->usb_device,
-		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
-			LIBUSB_RECIPIENT_DEVICE,
-		HACKRF_VENDOR_REQUEST_INIT_SWEEP,
-		num_bytes & 0xffff,
-		(num_bytes >> 16) & 0xffff,
-		data,
-		size,
+	result = usb_control_transfer(
+		device,
+		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
+		HACKRF_VENDOR_REQUEST_INIT_SPECTRUM,
+		fft_size,
+		0,
+		NULL,
+		0,
 		DEFAULT_REQUEST_TIMEOUT);
 
-	if (result < size) {
+	if (result != 0) {
 		last_libusb_error = result;
 		return HACKRF_ERROR_LIBUSB;
 	} else {
@@ -2779,8 +4540,8 @@ int ADDCALL hackrf_get_operacake_boards(hackrf_device* device, uint8_t* boards)
 {
 	USB_API_REQUIRED(device, 0x0105)
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_OPERACAKE_GET_BOARDS,
 		0,
@@ -2817,8 +4578,8 @@ int ADDCALL hackrf_set_operacake_mode(
 	}
 
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_OPERACAKE_SET_MODE,
@@ -2857,8 +4618,8 @@ int ADDCALL hackrf_get_operacake_mode(
 
 	int result;
 	uint8_t buf;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_OPERACAKE_GET_MODE,
 		address,
@@ -2899,8 +4660,8 @@ int ADDCALL hackrf_set_operacake_ports(
 	    ((port_a > OPERACAKE_PA4) && (port_b > OPERACAKE_PA4))) {
 		return HACKRF_ERROR_INVALID_PARAM;
 	}
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_OPERACAKE_SET_PORTS,
@@ -2921,8 +4682,8 @@ int ADDCALL hackrf_set_operacake_ports(
 int ADDCALL hackrf_reset(hackrf_device* device)
 {
 	USB_API_REQUIRED(device, 0x0102)
-	int result = libusb_control_transfer(
-		device->usb_device,
+	int result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_RESET,
@@ -2951,8 +4712,8 @@ int ADDCALL hackrf_set_operacake_ranges(
 	USB_API_REQUIRED(device, 0x0103)
 
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_OPERACAKE_SET_RANGES,
@@ -2992,8 +4753,8 @@ int ADDCALL hackrf_set_operacake_freq_ranges(
 
 	int result;
 	int len_ranges = count * 5;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_OPERACAKE_SET_RANGES,
@@ -3011,6 +4772,46 @@ int ADDCALL hackrf_set_operacake_freq_ranges(
 	}
 }
 
+int ADDCALL hackrf_set_operacake_sweep_ports(
+	hackrf_device* device,
+	const uint8_t* ports,
+	uint8_t count)
+{
+	USB_API_REQUIRED(device, 0x0117)
+
+	if ((count < 1) || (count > HACKRF_OPERACAKE_MAX_SWEEP_PORTS)) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	uint8_t port_bytes[HACKRF_OPERACAKE_MAX_SWEEP_PORTS];
+	int i;
+	for (i = 0; i < count; i++) {
+		if (ports[i] > OPERACAKE_PB4) {
+			return HACKRF_ERROR_INVALID_PARAM;
+		}
+		port_bytes[i] = ports[i];
+	}
+
+	int result;
+	result = usb_control_transfer(
+		device,
+		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
+			LIBUSB_RECIPIENT_DEVICE,
+		HACKRF_VENDOR_REQUEST_OPERACAKE_SET_SWEEP_PORTS,
+		0,
+		0,
+		port_bytes,
+		count,
+		DEFAULT_REQUEST_TIMEOUT);
+
+	if (result < count) {
+		last_libusb_error = result;
+		return HACKRF_ERROR_LIBUSB;
+	} else {
+		return HACKRF_SUCCESS;
+	}
+}
+
 #define DWELL_TIME_SIZE 5
 static uint8_t dwell_data[DWELL_TIME_SIZE * HACKRF_OPERACAKE_MAX_DWELL_TIMES];
 
@@ -3034,8 +4835,8 @@ int ADDCALL hackrf_set_operacake_dwell_times(
 
 	int data_len = count * DWELL_TIME_SIZE;
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_OPERACAKE_SET_DWELL_TIMES,
@@ -3057,8 +4858,8 @@ int ADDCALL hackrf_set_clkout_enable(hackrf_device* device, const uint8_t value)
 {
 	USB_API_REQUIRED(device, 0x0103)
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_CLKOUT_ENABLE,
@@ -3080,8 +4881,8 @@ int ADDCALL hackrf_get_clkin_status(hackrf_device* device, uint8_t* status)
 {
 	USB_API_REQUIRED(device, 0x0106)
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_GET_CLKIN_STATUS,
 		0,
@@ -3109,8 +4910,8 @@ int ADDCALL hackrf_operacake_gpio_test(
 	}
 
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_OPERACAKE_GPIO_TEST,
 		address,
@@ -3135,8 +4936,8 @@ int ADDCALL hackrf_cpld_checksum(hackrf_device* device, uint32_t* crc)
 	int result;
 
 	length = sizeof(*crc);
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_CPLD_CHECKSUM,
 		0,
@@ -3159,8 +4960,8 @@ int ADDCALL hackrf_set_ui_enable(hackrf_device* device, const uint8_t value)
 {
 	USB_API_REQUIRED(device, 0x0104)
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_UI_ENABLE,
@@ -3186,6 +4987,10 @@ int ADDCALL hackrf_start_rx_sweep(
 	USB_API_REQUIRED(device, 0x0104)
 	int result;
 	const uint8_t endpoint_address = RX_ENDPOINT_ADDRESS;
+	// Sweep blocks must not be split across transfers.
+	if (device->transfer_buffer_size % BYTES_PER_BLOCK != 0) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
 	result = hackrf_set_transceiver_mode(device, TRANSCEIVER_MODE_RX_SWEEP);
 	if (HACKRF_SUCCESS == result) {
 		device->rx_ctx = rx_ctx;
@@ -3194,14 +4999,38 @@ int ADDCALL hackrf_start_rx_sweep(
 	return result;
 }
 
+int ADDCALL hackrf_start_rx_spectrum(
+	hackrf_device* device,
+	hackrf_sample_block_cb_fn callback,
+	void* rx_ctx)
+{
+	USB_API_REQUIRED(device, 0x0116)
+	int result;
+	const uint8_t endpoint_address = RX_ENDPOINT_ADDRESS;
+	const size_t record_length = HACKRF_SPECTRUM_HEADER_LENGTH +
+		HACKRF_SPECTRUM_MAX_FFT_SIZE * sizeof(int16_t);
+	// Records end in short packets, so each transfer receives one.
+	if (device->transfer_buffer_size < record_length) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+	result = hackrf_set_transceiver_mode(device, TRANSCEIVER_MODE_RX_SPECTRUM);
+	if (HACKRF_SUCCESS == result) {
+		device->rx_ctx = rx_ctx;
+		result = prepare_setup_transfers(device, endpoint_address, callback);
+	}
+	return result;
+}
+
 /**
  * Get USB transfer buffer size.
  * @return size in bytes
  */
 size_t ADDCALL hackrf_get_transfer_buffer_size(hackrf_device* device)
 {
-	(void) device;
-	return TRANSFER_BUFFER_SIZE;
+	if (device == NULL) {
+		return DEFAULT_TRANSFER_BUFFER_SIZE;
+	}
+	return device->transfer_buffer_size;
 }
 
 /**
@@ -3210,16 +5039,94 @@ size_t ADDCALL hackrf_get_transfer_buffer_size(hackrf_device* device)
  */
 uint32_t ADDCALL hackrf_get_transfer_queue_depth(hackrf_device* device)
 {
-	(void) device;
-	return TRANSFER_COUNT;
+	if (device == NULL) {
+		return DEFAULT_TRANSFER_COUNT;
+	}
+	return device->transfer_count;
+}
+
+int ADDCALL hackrf_get_buffer_mode(
+	hackrf_device* device,
+	enum hackrf_buffer_mode* mode)
+{
+	if ((device->buffer != NULL) && device->buffer_dev_mem &&
+	    ((device->block_pool == NULL) || device->block_pool_dev_mem)) {
+		*mode = HACKRF_BUFFER_MODE_ZERO_COPY;
+	} else {
+		*mode = HACKRF_BUFFER_MODE_HEAP;
+	}
+
+	return HACKRF_SUCCESS;
+}
+
+const char* ADDCALL hackrf_buffer_mode_name(enum hackrf_buffer_mode mode)
+{
+	switch (mode) {
+	case HACKRF_BUFFER_MODE_HEAP:
+		return "heap";
+
+	case HACKRF_BUFFER_MODE_ZERO_COPY:
+		return "zero-copy";
+
+	default:
+		return "unknown";
+	}
+}
+
+/**
+ * Set the number and size of USB transfers used for streaming.
+ *
+ * Existing transfers are freed and new buffers are allocated, so this
+ * may only be called while the device is not streaming.
+ */
+int ADDCALL hackrf_set_transfer_params(
+	hackrf_device* device,
+	const uint32_t transfer_count,
+	const uint32_t transfer_buffer_size)
+{
+	uint32_t old_count, old_size;
+	int result;
+
+	if ((transfer_count == 0) || (transfer_buffer_size == 0) ||
+	    (transfer_buffer_size % TRANSFER_BUFFER_ALIGNMENT != 0)) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	pthread_mutex_lock(&device->transfer_lock);
+	if (device->transfers_setup || (atomic_load_u32(&device->active_transfers) > 0)) {
+		pthread_mutex_unlock(&device->transfer_lock);
+		return HACKRF_ERROR_BUSY;
+	}
+
+	old_count = device->transfer_count;
+	old_size = device->transfer_buffer_size;
+
+	free_transfers(device);
+	free_block_pool(device);
+	device->transfer_count = transfer_count;
+	device->transfer_buffer_size = transfer_buffer_size;
+	result = allocate_transfers(device);
+
+	if (result != HACKRF_SUCCESS) {
+		// Fall back to the previous configuration.
+		free_transfers(device);
+		device->transfer_count = old_count;
+		device->transfer_buffer_size = old_size;
+		if (allocate_transfers(device) != HACKRF_SUCCESS) {
+			free_transfers(device);
+		}
+	}
+	pthread_mutex_unlock(&device->transfer_lock);
+
+	return result;
 }
 
 int ADDCALL hackrf_board_rev_read(hackrf_device* device, uint8_t* value)
 {
 	USB_API_REQUIRED(device, 0x0106)
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_BOARD_REV_READ,
 		0,
@@ -3302,8 +5209,8 @@ int ADDCALL hackrf_supported_platform_read(hackrf_device* device, uint32_t* valu
 	unsigned char data[4];
 	USB_API_REQUIRED(device, 0x0106)
 	int result;
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SUPPORTED_PLATFORM_READ,
 		0,
@@ -3324,8 +5231,8 @@ int ADDCALL hackrf_supported_platform_read(hackrf_device* device, uint32_t* valu
 int ADDCALL hackrf_set_leds(hackrf_device* device, const uint8_t state)
 {
 	USB_API_REQUIRED(device, 0x0107)
-	int result = libusb_control_transfer(
-		device->usb_device,
+	int result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SET_LEDS,
@@ -3370,8 +5277,8 @@ int ADDCALL hackrf_set_user_bias_t_opts(
 		}
 	}
 
-	int result = libusb_control_transfer(
-		device->usb_device,
+	int result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SET_USER_BIAS_T_OPTS,
@@ -3393,8 +5300,8 @@ int ADDCALL hackrf_set_p1_ctrl(hackrf_device* device, const enum p1_ctrl_signal
 {
 	USB_API_REQUIRED(device, 0x0109);
 
-	int result = libusb_control_transfer(
-		device->usb_device,
+	int result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_P1_CTRL,
@@ -3416,8 +5323,8 @@ int ADDCALL hackrf_set_p2_ctrl(hackrf_device* device, const enum p2_ctrl_signal
 {
 	USB_API_REQUIRED(device, 0x0109);
 
-	int result = libusb_control_transfer(
-		device->usb_device,
+	int result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_P2_CTRL,
@@ -3441,8 +5348,8 @@ int ADDCALL hackrf_set_clkin_ctrl(
 {
 	USB_API_REQUIRED(device, 0x0109);
 
-	int result = libusb_control_transfer(
-		device->usb_device,
+	int result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_CLKIN_CTRL,
@@ -3464,8 +5371,8 @@ int ADDCALL hackrf_set_narrowband_filter(hackrf_device* device, const uint8_t va
 {
 	USB_API_REQUIRED(device, 0x0109);
 
-	int result = libusb_control_transfer(
-		device->usb_device,
+	int result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SET_NARROWBAND_FILTER,
@@ -3487,8 +5394,8 @@ int ADDCALL hackrf_set_fpga_bitstream(hackrf_device* device, const uint8_t index
 {
 	USB_API_REQUIRED(device, 0x0109);
 
-	int result = libusb_control_transfer(
-		device->usb_device,
+	int result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_SET_FPGA_BITSTREAM,
@@ -3516,8 +5423,8 @@ int ADDCALL hackrf_radio_read_register(
 	int result;
 
 	const uint8_t length = sizeof(value);
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_RADIO_READ_REG,
 		register_number,
@@ -3555,8 +5462,8 @@ int ADDCALL hackrf_radio_write_register(
 	data[7] = (value >> 48) & 0xff;
 	data[8] = (value >> 56) & 0xff;
 
-	result = libusb_control_transfer(
-		device->usb_device,
+	result = usb_control_transfer(
+		device,
 		LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_RECIPIENT_DEVICE,
 		HACKRF_VENDOR_REQUEST_RADIO_WRITE_REG,
@@ -85,7 +85,7 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
  * 
  * # Library internals
  * 
- * The library uses `libusb` (version 1.0) to communicate with HackRF hardware. It uses both the synchronous and asynchronous API for communication (asynchronous for streaming data to/from the device, and synchronous for everything else). The asynchronous API requires to periodically call a variant of `libusb_handle_events`, so the library creates a new "transfer thread" for each device doing that using the `pthread` library. The library uses multiple transfers for each device (@ref hackrf_get_transfer_queue_depth).
+ * The library uses `libusb` (version 1.0) to communicate with HackRF hardware. It uses both the synchronous and asynchronous API for communication (asynchronous for streaming data to/from the device, and synchronous for everything else). The asynchronous API requires to periodically call a variant of `libusb_handle_events`, so the library creates a new "transfer thread" for each device doing that using the `pthread` library, or a shared pool of threads for all devices if set up with @ref hackrf_set_event_threads. The library uses multiple transfers for each device (@ref hackrf_get_transfer_queue_depth), the number and size of which can be changed with @ref hackrf_set_transfer_params.
  *
  * # USB API versions
  * As all functionality of HackRF devices requires cooperation between the firmware and the host, both devices can have outdated software. If host machine software is outdated, the new functions will be unavailable in `hackrf.h`, causing linking errors. If the device firmware is outdated, the functions will return @ref HACKRF_ERROR_USB_API_VERSION.
@@ -146,6 +146,22 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
  * 
  * This struct lists all devices and their serial numbers. Any one of them can be opened by @ref hackrf_device_list_open. All the fields should be treated read-only!
  * 
+ * ## Emulated device
+ * 
+ * For testing and benchmarking without hardware, the library can emulate a HackRF One. Opening the serial number @ref HACKRF_EMULATOR_SERIAL opens the emulator. If the `HACKRF_EMULATOR` environment variable is set (to anything but `0`), the emulator replaces USB devices entirely: it is the only device listed and is opened whatever serial number is asked for, and the library works without libusb being able to access USB.
+ * 
+ * The emulator keeps the state set by each request and streams generated data, paced at the sample rate. It is configured by a comma separated list of options in `HACKRF_EMULATOR`, e.g. `HACKRF_EMULATOR=signal=noise,rate=max`:
+ * - `signal=tone|noise|counter|zero`: RX data generator, by default a tone in noise
+ * - `tone=<hz>`: offset of the generated tone, by default 1 MHz
+ * - `file=<path>`: read RX data from a file of 8-bit I/Q samples, looping at its end
+ * - `tx_file=<path>`: write TX data to a file
+ * - `rate=<samples per second>|max`: stream at this rate instead of the sample rate, or as fast as possible
+ * - `overrun=<n>`: drop a transfer's worth of RX data every n transfers
+ * - `underrun=<n>`: report a TX underrun every n transfers
+ * - `stall=<n>`, `stall_us=<us>`: delay every nth transfer completion by `stall_us` microseconds (default 10000)
+ * 
+ * Data the host doesn't keep up with is lost as it would be on hardware, and counted in @ref hackrf_get_m0_state. Use @ref hackrf_is_emulated to check whether a device is emulated.
+ * 
  * # Closing devices
  * 
  * If the device is not needed anymore, then it can be closed via @ref hackrf_close. Closing a device terminates all ongoing transfers, and resets the device to IDLE mode.
@@ -294,6 +310,14 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
  * 
  * Set when starting an operation with @ref hackrf_start_tx, @ref hackrf_start_rx or @ref hackrf_start_rx_sweep. This callback supplies / receives data. This function takes a @ref hackrf_transfer struct as a parameter, and fill/read data to/from its buffer. This function runs in an async libusb context, meaning it should not interact with the libhackrf library in other ways. The callback can return a boolean value, if its return value is non-zero then it won't be called again, meaning that no future transfers will take place, and (in TX case) the flush callback will be called shortly.
  * 
+ * ### Callback thread
+ * 
+ * In RX modes, the transfer callback can optionally be run on a separate thread, decoupling it from the libusb event thread so that a slow callback doesn't delay resubmission of transfers. See @ref hackrf_enable_callback_thread.
+ * 
+ * ### Sync mode
+ * 
+ * As an alternative to the transfer callback, @ref hackrf_start_rx_sync and @ref hackrf_start_tx_sync start streaming with samples read and written by the application with @ref hackrf_read_samples and @ref hackrf_write_samples, which block with a timeout. @ref hackrf_acquire_buffer and @ref hackrf_release_buffer give direct access to the transfer buffers instead, avoiding a copy.
+ * 
  * ### Block complete callback
  * 
  * This callback is optional, and only applicable in TX mode. It gets called whenever a data transfer is finished, and can read the data. It needs to do nothing at all. This callback can be set using @ref hackrf_set_tx_block_complete_callback
@@ -473,10 +497,11 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
  * 
  * These boards are versatile RF switching boards capable of switching two primary ports (A0 and B0) to any of 8 (A1-A4 and B1-B4) secondary ports (with the only rule that A0 and B0 can not be connected to the same side/bank of secondary ports at the same time).
  * 
- * There are 3 operating modes:
+ * There are 4 operating modes:
  * - manual setup
  * - frequency-based setup
  * - time-based setup
+ * - sweep-based setup
  * 
  * ### Manual setup
  * 
@@ -490,6 +515,10 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
  * 
  * In this mode the Opera Cake board automatically switches A0 to a port for a set amount of time (specified in samples). Up to @ref HACKRF_OPERACAKE_MAX_DWELL_TIMES times can be setup via @ref hackrf_set_operacake_dwell_times. Port B0 mirrors A0 on the opposite side.
  * 
+ * ### Sweep-based setup
+ * 
+ * In this mode sweep mode captures every step of a sweep once on each of up to @ref HACKRF_OPERACAKE_MAX_SWEEP_PORTS ports, setup via @ref hackrf_set_operacake_sweep_ports. The Opera Cake board switches A0 to the next port while the device discards samples to let the radio settle, and each block is tagged with its port. Port B0 mirrors A0 on the opposite side.
+ * 
  * ## Opera Cake setup
  * 
  * Opera Cake boards can be listed with @ref hackrf_get_operacake_boards, but if only one board is connected, than using address 0 defaults to it.
@@ -504,6 +533,17 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
  * 
  */
 
+/**
+ * @defgroup conversion Sample format conversion
+ * @brief Converting samples between HackRF's format and other common formats
+ * 
+ * HackRF sends and receives samples as interleaved signed 8-bit I and Q values. The `hackrf_convert_*` functions convert blocks of samples to and from interleaved 32-bit float (complex float) and 16-bit integer I/Q, the formats most DSP code works with. @ref hackrf_convert_s8_to_cf32_window additionally applies a window function while converting, as done before an FFT, and @ref hackrf_convert_cf32_to_db turns FFT output into power in dB, as @ref hackrf_convert_f32_to_db does for power values.
+ * 
+ * Each conversion uses SIMD instructions where available (SSE2 or AVX2 on x86, NEON on AArch64), with the fastest set supported by the CPU selected at runtime the first time a conversion is done. The selection can be queried with @ref hackrf_convert_get_simd and overridden with @ref hackrf_convert_set_simd, e.g. for benchmarking. All implementations produce identical results, except for the last bit of @ref HACKRF_DB_FAST power values.
+ * 
+ * These functions don't need a device, nor @ref hackrf_init to be called first, and are safe to call from any thread.
+ */
+
 /**
  * Number of samples per tuning when sweeping
  * @ingroup streaming
@@ -522,6 +562,60 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
  */
 #define MAX_SWEEP_RANGES 10
 
+/**
+ * Smallest block size in bytes for @ref hackrf_init_sweep_timed
+ * @ingroup streaming
+ */
+#define HACKRF_SWEEP_MIN_BLOCK_SIZE 1024
+
+/**
+ * Longest settle time in samples for @ref hackrf_init_sweep_timed
+ * @ingroup streaming
+ */
+#define HACKRF_SWEEP_MAX_SETTLE_SAMPLES 16777216
+
+/**
+ * Maximum number of entries in a hop table for @ref hackrf_init_hop_sweep
+ * @ingroup streaming
+ */
+#define HACKRF_MAX_HOPS 512
+
+/**
+ * Length of the header of a sweep mode block, before its samples. See @ref hackrf_init_sweep
+ * @ingroup streaming
+ */
+#define HACKRF_SWEEP_HEADER_LENGTH 14
+
+/**
+ * Smallest FFT size for @ref hackrf_init_spectrum
+ * @ingroup streaming
+ */
+#define HACKRF_SPECTRUM_MIN_FFT_SIZE 16
+
+/**
+ * Largest FFT size for @ref hackrf_init_spectrum
+ * @ingroup streaming
+ */
+#define HACKRF_SPECTRUM_MAX_FFT_SIZE 256
+
+/**
+ * Length of the header of a spectrum record, before its bins. See @ref hackrf_init_spectrum
+ * @ingroup streaming
+ */
+#define HACKRF_SPECTRUM_HEADER_LENGTH 16
+
+/**
+ * Value of a spectrum bin that received no power at all. See @ref hackrf_init_spectrum
+ * @ingroup streaming
+ */
+#define HACKRF_SPECTRUM_NO_POWER INT16_MIN
+
+/**
+ * Serial number that opens an emulated device with @ref hackrf_open_by_serial
+ * @ingroup device
+ */
+#define HACKRF_EMULATOR_SERIAL "emulated"
+
 /**
  * Invalid Opera Cake add-on board address, placeholder in @ref hackrf_get_operacake_boards
  * @ingroup operacake
@@ -546,6 +640,12 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
  */
 #define HACKRF_OPERACAKE_MAX_FREQ_RANGES 8
 
+/**
+ * Maximum number of specifiable sweep ports for Opera Cake add-on boards
+ * @ingroup operacake
+ */
+#define HACKRF_OPERACAKE_MAX_SWEEP_PORTS 8
+
 /**
  * error enum, returned by many libhackrf functions
  * 
@@ -573,6 +673,10 @@ enum hackrf_error {
 	 * Resource is busy, possibly the device is already opened.
 	 */
 	HACKRF_ERROR_BUSY = -6,
+	/**
+	 * Operation timed out before it could complete, returned by the sync streaming functions.
+	 */
+	HACKRF_ERROR_TIMEOUT = -7,
 	/**
 	 * Memory allocation (on host side) failed
 	 */
@@ -834,6 +938,67 @@ enum hackrf_usb_board_id {
 	USB_BOARD_ID_INVALID = 0xFFFF,
 };
 
+/**
+ * Memory used for USB transfer buffers
+ *
+ * Returned by @ref hackrf_get_buffer_mode and can be converted into a human-readable string via @ref hackrf_buffer_mode_name.
+ * @ingroup library
+ */
+enum hackrf_buffer_mode {
+	/**
+	 * Buffers are allocated on the heap, and the OS copies each block between kernel and user space
+	 */
+	HACKRF_BUFFER_MODE_HEAP = 0,
+	/**
+	 * Buffers are allocated with `libusb_dev_mem_alloc`, which maps memory from the kernel that the USB controller can use directly, avoiding the copy. Currently only available on Linux
+	 */
+	HACKRF_BUFFER_MODE_ZERO_COPY = 1,
+};
+
+/**
+ * SIMD instruction set used by the sample conversion functions
+ *
+ * Returned by @ref hackrf_convert_get_simd and can be converted into a human-readable string via @ref hackrf_simd_name.
+ * @ingroup conversion
+ */
+enum hackrf_simd {
+	/**
+	 * Select the fastest implementation supported by the CPU (only for @ref hackrf_convert_set_simd)
+	 */
+	HACKRF_SIMD_AUTO = 0,
+	/**
+	 * Portable C implementation
+	 */
+	HACKRF_SIMD_GENERIC = 1,
+	/**
+	 * x86 SSE2
+	 */
+	HACKRF_SIMD_SSE2 = 2,
+	/**
+	 * x86 AVX2
+	 */
+	HACKRF_SIMD_AVX2 = 3,
+	/**
+	 * AArch64 NEON
+	 */
+	HACKRF_SIMD_NEON = 4,
+};
+
+/**
+ * Accuracy of @ref hackrf_convert_cf32_to_db
+ * @ingroup conversion
+ */
+enum hackrf_db_mode {
+	/**
+	 * Compute the logarithm with the C library, as accurately as single precision allows
+	 */
+	HACKRF_DB_EXACT = 0,
+	/**
+	 * Compute the logarithm with a vectorised approximation, within 0.001 dB of @ref HACKRF_DB_EXACT
+	 */
+	HACKRF_DB_FAST = 1,
+};
+
 /**
  * RF filter path setting enum
  * 
@@ -888,6 +1053,10 @@ enum operacake_switching_mode {
 	 * Port connections are switched automatically over time. dwell times can be set with @ref hackrf_set_operacake_dwell_times. In this mode, B0 mirrors A0
 	 */
 	OPERACAKE_MODE_TIME,
+	/**
+	 * Port connections are switched automatically at every step of a sweep. Ports can be set with @ref hackrf_set_operacake_sweep_ports. In this mode, B0 mirrors A0
+	 */
+	OPERACAKE_MODE_SWEEP,
 };
 
 /**
@@ -1023,6 +1192,63 @@ typedef struct {
 	uint8_t port;
 } hackrf_operacake_freq_range;
 
+/**
+ * Hop table entry for @ref hackrf_init_hop_sweep
+ * @ingroup streaming
+ */
+typedef struct {
+	/**
+	 * Center frequency in Hz, before the offset is added. Must be less than 2^48
+	 */
+	uint64_t frequency;
+	/**
+	 * Number of blocks to capture at this frequency, at least 1
+	 */
+	uint16_t dwell_blocks;
+} hackrf_hop;
+
+/**
+ * Header of a sweep mode block or spectrum record, decoded by @ref hackrf_parse_sweep_header
+ * @ingroup streaming
+ */
+typedef struct {
+	/**
+	 * Tuned frequency in Hz, before the offset is added, from bits 0-47 of the frequency field
+	 */
+	uint64_t frequency;
+	/**
+	 * Index of the block's entry in the hop table with @ref hackrf_init_hop_sweep, from bits 48-59 of the frequency field. 0 in other sweeps
+	 */
+	uint16_t hop;
+	/**
+	 * Opera Cake port the block was captured on with @ref hackrf_set_operacake_sweep_ports, as an @ref operacake_ports value from bits 60-63 of the frequency field, or -1 if the block has no port
+	 */
+	int port;
+	/**
+	 * Count of the bytes sampled before the block, see @ref hackrf_init_sweep. Only valid with USB API version 0x0113 or above, before which these bytes are samples
+	 */
+	uint32_t byte_count;
+} hackrf_sweep_header;
+
+/**
+ * Spectrum mode record, decoded by @ref hackrf_parse_spectrum_record
+ * @ingroup streaming
+ */
+typedef struct {
+	/**
+	 * Header of the first block of the dwell
+	 */
+	hackrf_sweep_header header;
+	/**
+	 * Number of FFTs averaged, saturating at 65535
+	 */
+	uint16_t num_ffts;
+	/**
+	 * Number of bins, the FFT size set with @ref hackrf_init_spectrum
+	 */
+	int num_bins;
+} hackrf_spectrum_record;
+
 /** 
  * Helper struct for hackrf_bias_t_user_setting.  If 'do_update' is true, then the values of 'change_on_mode_entry'
  * and 'enabled' will be used as the new default.  If 'do_update' is false, the current default will not change.
@@ -1074,6 +1300,39 @@ typedef struct {
 	uint32_t error;
 } hackrf_m0_state;
 
+/**
+ * Number of bins in the histograms of @ref hackrf_stream_stats
+ * @ingroup streaming
+ */
+#define HACKRF_STREAM_STATS_BINS 20
+
+/**
+ * Host-side streaming statistics, returned by @ref hackrf_get_stream_stats
+ *
+ * Durations are collected in histograms with power-of-two bins: bin 0 counts durations under 1 µs, and bin n counts durations from 2^(n-1) µs up to 2^n µs. The last bin also counts anything longer.
+ * @ingroup streaming
+ */
+typedef struct {
+	/** Number of USB transfers completed successfully. */
+	uint64_t transfers;
+	/** Number of bytes moved by completed transfers. */
+	uint64_t bytes;
+	/** Number of transfers that failed, not counting cancelled ones. */
+	uint64_t transfer_errors;
+	/** Number of times resubmitting a completed transfer failed, ending streaming. */
+	uint64_t resubmit_failures;
+	/** Number of blocks lost on the host, see @ref hackrf_get_host_drops. */
+	uint64_t host_drops;
+	/** Longest time spent in the transfer callback, in microseconds. */
+	uint32_t callback_max_us;
+	/** Longest transfer turnaround time, in microseconds. */
+	uint32_t turnaround_max_us;
+	/** Histogram of time spent in the transfer callback per transfer. Not collected in sync mode, which has no transfer callback. */
+	uint64_t callback_histogram[HACKRF_STREAM_STATS_BINS];
+	/** Histogram of transfer turnaround times, from a transfer completing to it being resubmitted. This includes the callback unless it runs on the callback thread. */
+	uint64_t turnaround_histogram[HACKRF_STREAM_STATS_BINS];
+} hackrf_stream_stats;
+
 /**
  * Self-test results.
  * @ingroup debug
@@ -1163,6 +1422,18 @@ extern "C" {
  */
 extern ADDAPI int ADDCALL hackrf_init();
 
+/**
+ * Set the number of threads handling USB events for all devices
+ * 
+ * By default (@p num_threads = 0), each open device has its own transfer thread handling libusb events. As libusb only lets one thread handle events at a time, with many devices open these threads mostly contend with each other. With @p num_threads set to 1 or more, a shared pool of that many threads instead handles events for all open devices, started when the first device is opened and stopped when the last one is closed. Transfer callbacks are still called for the right device, and never concurrently. A single thread is usually best; more only help if a transfer callback may block.
+ * 
+ * Must be called while no devices are open.
+ * @param num_threads number of shared event threads, up to 16, or 0 for one thread per device
+ * @return @ref HACKRF_SUCCESS on success, @ref HACKRF_ERROR_BUSY if any device is open or @ref HACKRF_ERROR_INVALID_PARAM
+ * @ingroup library
+ */
+extern ADDAPI int ADDCALL hackrf_set_event_threads(const unsigned int num_threads);
+
 /**
  * Exit libhackrf
  * 
@@ -1248,6 +1519,14 @@ extern ADDAPI int ADDCALL hackrf_open_by_serial(
 	const char* const desired_serial_number,
 	hackrf_device** device);
 
+/**
+ * Check whether a device is emulated rather than USB hardware
+ * @param[in] device device to query
+ * @return @ref HACKRF_TRUE if the device is emulated, @ref HACKRF_ERROR_INVALID_PARAM if @p device is NULL, otherwise @ref HACKRF_SUCCESS
+ * @ingroup device
+ */
+extern ADDAPI int ADDCALL hackrf_is_emulated(hackrf_device* device);
+
 /**
  * Close a previously opened device
  * @param[in] device device to close
@@ -1331,6 +1610,163 @@ extern ADDAPI int ADDCALL hackrf_enable_tx_flush(
 	hackrf_flush_cb_fn callback,
 	void* flush_ctx);
 
+/**
+ * Run the RX transfer callback on a separate thread
+ *
+ * By default the transfer callback runs on the libusb event thread, so a slow callback delays the resubmission of transfers and can cause the device to overrun. With the callback thread enabled, each completed RX transfer is queued for a dedicated thread and immediately resubmitted with a spare buffer from a pool of @p num_buffers buffers, each of @ref hackrf_get_transfer_buffer_size bytes. If the callback falls so far behind that no spare buffer is available, the completed block is dropped instead; see @ref hackrf_get_host_drops.
+ *
+ * Applies to @ref hackrf_start_rx and @ref hackrf_start_rx_sweep. TX callbacks are unaffected. Must be called while the device is not streaming.
+ *
+ * @param device device to configure
+ * @param num_buffers number of spare buffers queued between the event thread and the callback thread. Must be at least 1
+ * @return @ref HACKRF_SUCCESS on success, @ref HACKRF_ERROR_BUSY if the device is streaming or @ref hackrf_error variant
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_enable_callback_thread(
+	hackrf_device* device,
+	const uint32_t num_buffers);
+
+/**
+ * Run the RX transfer callback on the libusb event thread again (the default)
+ *
+ * Must be called while the device is not streaming.
+ *
+ * @param device device to configure
+ * @return @ref HACKRF_SUCCESS on success, @ref HACKRF_ERROR_BUSY if the device is streaming
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_disable_callback_thread(hackrf_device* device);
+
+/**
+ * Get the number of blocks lost on the host because the application fell behind
+ *
+ * Counts RX blocks dropped because the callback thread or the reader of @ref hackrf_read_samples fell behind, and TX blocks sent as zeros because nothing had been written with @ref hackrf_write_samples in time. These happen on the host and are counted separately from overruns and underruns on the device, which are reported by @ref hackrf_get_m0_state. The count is reset each time streaming starts.
+ *
+ * @param[in] device device to query
+ * @param[out] drops number of dropped blocks
+ * @return @ref HACKRF_SUCCESS on success or @ref hackrf_error variant
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_get_host_drops(hackrf_device* device, uint64_t* drops);
+
+/**
+ * Get host-side streaming statistics
+ *
+ * Counts transfers, bytes and failures, and records how long the transfer callback takes and how quickly completed transfers are resubmitted. Together with the device-side shortfall counts from @ref hackrf_get_m0_state, this helps to tell whether an overrun or underrun was caused by a slow callback or by USB scheduling.
+ *
+ * Statistics are reset each time streaming starts, and may be read at any time from any thread. The snapshot is consistent and cheap enough to take frequently.
+ *
+ * @param[in] device device to query
+ * @param[out] stats statistics since streaming last started
+ * @return @ref HACKRF_SUCCESS on success or @ref hackrf_error variant
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_get_stream_stats(
+	hackrf_device* device,
+	hackrf_stream_stats* stats);
+
+/**
+ * Start receiving in sync mode
+ *
+ * Instead of a transfer callback, samples are read by the application with @ref hackrf_read_samples, or without copying using @ref hackrf_acquire_buffer and @ref hackrf_release_buffer. Completed transfers are resubmitted straight away with a spare buffer from a pool of @p num_buffers buffers, each of @ref hackrf_get_transfer_buffer_size bytes. If the application falls so far behind that no spare buffer is available, blocks are dropped; see @ref hackrf_get_host_drops.
+ *
+ * Stop with @ref hackrf_stop_rx.
+ *
+ * @param device device to start RX on
+ * @param num_buffers number of spare buffers queued between the event thread and the application. Must be at least 1
+ * @return @ref HACKRF_SUCCESS on success or @ref hackrf_error variant
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_start_rx_sync(
+	hackrf_device* device,
+	const uint32_t num_buffers);
+
+/**
+ * Start transmitting in sync mode
+ *
+ * Instead of a transfer callback, samples are written by the application with @ref hackrf_write_samples, or without copying using @ref hackrf_acquire_buffer and @ref hackrf_release_buffer. Up to @p num_buffers blocks of @ref hackrf_get_transfer_buffer_size bytes can be queued ahead of the device. If nothing has been written by the time a transfer completes, it is resent filled with zeros; see @ref hackrf_get_host_drops.
+ *
+ * Writing zero bytes ends the stream. If TX flush is enabled, the flush callback is then called once all samples have been transmitted. Stop with @ref hackrf_stop_tx.
+ *
+ * @param device device to start TX on
+ * @param num_buffers number of buffers queued between the application and the event thread. Must be at least 1
+ * @return @ref HACKRF_SUCCESS on success or @ref hackrf_error variant
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_start_tx_sync(
+	hackrf_device* device,
+	const uint32_t num_buffers);
+
+/**
+ * Read received samples in sync mode
+ *
+ * Copies up to @p length bytes of samples into @p buffer, waiting for blocks to arrive if necessary. Blocks may be split between calls. Must only be called from one thread at a time, and not mixed with @ref hackrf_acquire_buffer.
+ *
+ * @param[in] device device started with @ref hackrf_start_rx_sync
+ * @param[out] buffer buffer to read samples into
+ * @param[in] length number of bytes to read
+ * @param[out] bytes_read number of bytes actually read, which is less than @p length on timeout or when streaming stops
+ * @param[in] timeout_ms maximum time to wait in milliseconds, or 0 to return immediately with the samples already received
+ * @return @ref HACKRF_SUCCESS if @p length bytes were read, @ref HACKRF_ERROR_TIMEOUT on timeout, @ref HACKRF_ERROR_STREAMING_STOPPED once streaming has stopped and all received samples have been read, or @ref hackrf_error variant
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_read_samples(
+	hackrf_device* device,
+	void* buffer,
+	const uint32_t length,
+	uint32_t* bytes_read,
+	const uint32_t timeout_ms);
+
+/**
+ * Write samples for transmission in sync mode
+ *
+ * Copies up to @p length bytes of samples from @p buffer, waiting for free buffers if necessary. Samples are sent once a whole block of @ref hackrf_get_transfer_buffer_size bytes has been written. Writing zero bytes sends any partly written block and ends the stream. Must only be called from one thread at a time, and not mixed with @ref hackrf_acquire_buffer.
+ *
+ * @param[in] device device started with @ref hackrf_start_tx_sync
+ * @param[in] buffer samples to write
+ * @param[in] length number of bytes to write
+ * @param[out] bytes_written number of bytes actually written, which is less than @p length on timeout or when streaming stops
+ * @param[in] timeout_ms maximum time to wait in milliseconds, or 0 to return immediately if no buffer is free
+ * @return @ref HACKRF_SUCCESS if @p length bytes were written, @ref HACKRF_ERROR_TIMEOUT on timeout, @ref HACKRF_ERROR_STREAMING_STOPPED if streaming has stopped, or @ref hackrf_error variant
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_write_samples(
+	hackrf_device* device,
+	const void* buffer,
+	const uint32_t length,
+	uint32_t* bytes_written,
+	const uint32_t timeout_ms);
+
+/**
+ * Take a block buffer in sync mode without copying
+ *
+ * In RX sync mode, returns the next received block in @p transfer. In TX sync mode, returns an empty buffer of @ref hackrf_get_transfer_buffer_size bytes to be filled with samples. Either way the buffer must be handed back with @ref hackrf_release_buffer. Must only be called from one thread at a time, and not mixed with @ref hackrf_read_samples or @ref hackrf_write_samples.
+ *
+ * @param[in] device device started with @ref hackrf_start_rx_sync or @ref hackrf_start_tx_sync
+ * @param[out] transfer filled in with the buffer and, in RX mode, its valid length
+ * @param[in] timeout_ms maximum time to wait in milliseconds, or 0 to return immediately
+ * @return @ref HACKRF_SUCCESS on success, @ref HACKRF_ERROR_TIMEOUT on timeout, @ref HACKRF_ERROR_STREAMING_STOPPED if streaming has stopped, or @ref hackrf_error variant
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_acquire_buffer(
+	hackrf_device* device,
+	hackrf_transfer* transfer,
+	const uint32_t timeout_ms);
+
+/**
+ * Hand back a block buffer taken with @ref hackrf_acquire_buffer
+ *
+ * In RX sync mode, the buffer is returned to the pool. In TX sync mode, the first @c valid_length bytes are queued for transmission, and a @c valid_length of zero ends the stream.
+ *
+ * @param device device started with @ref hackrf_start_rx_sync or @ref hackrf_start_tx_sync
+ * @param transfer transfer returned by @ref hackrf_acquire_buffer
+ * @return @ref HACKRF_SUCCESS on success or @ref hackrf_error variant
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_release_buffer(
+	hackrf_device* device,
+	hackrf_transfer* transfer);
+
 /**
  * Stop transmission
  * 
@@ -1976,7 +2412,7 @@ extern ADDAPI int ADDCALL hackrf_set_hw_sync_mode(
 /**
  * Initialize sweep mode
  * 
- * In this mode, in a single data transfer (single call to the RX transfer callback), multiple blocks of size @p num_bytes bytes are received with different center frequencies. At the beginning of each block, a 10-byte frequency header is present in `0x7F - 0x7F - uint64_t frequency (LSBFIRST, in Hz)` format, followed by the actual samples.
+ * In this mode, in a single data transfer (single call to the RX transfer callback), multiple blocks of size @p num_bytes bytes are received with different center frequencies. At the beginning of each block, a 10-byte frequency header is present in `0x7F - 0x7F - uint64_t frequency (LSBFIRST, in Hz)` format, followed by the actual samples. With USB API version 0x0113 or above, the header is followed by a `uint32_t` (LSBFIRST) count of the bytes the device had sampled before the start of the block, which wraps around every 2^32 bytes and pauses while samples are being lost. The samples then start after this 14-byte header, which @ref hackrf_parse_sweep_header decodes.
  * 
  * Requires USB API version 0x0102 or above!
  * @param device device to configure
@@ -1998,6 +2434,113 @@ extern ADDAPI int ADDCALL hackrf_init_sweep(
 	const uint32_t offset,
 	const enum sweep_style style);
 
+/**
+ * Initialize sweep mode with a block size and settle time
+ * 
+ * As @ref hackrf_init_sweep, but the device captures blocks of @p block_size bytes instead of @ref BYTES_PER_BLOCK, each with the same header, and discards @p settle_samples samples after each block to let the radio settle, instead of two whole blocks (one on Praline). Smaller blocks and shorter settle times make for faster sweeps with smaller FFTs. The settle time is rounded up to a multiple of 16 samples, the resolution of the device's sample counter.
+ * 
+ * The device retunes after the last block of each tuning, which takes up to about 760 us (300 us on Praline). If this takes longer than the settle time, the next block starts as soon as retuning is done instead. A block can also start up to one block size later than that, since blocks are kept contiguous in the device's sample buffer.
+ * 
+ * Requires USB API version 0x0114 or above!
+ * @param device device to configure
+ * @param frequency_list list of start-stop frequency pairs in MHz
+ * @param num_ranges length of array @p frequency_list (in pairs, so total array length / 2!). Must be less than @ref MAX_SWEEP_RANGES
+ * @param num_bytes number of bytes to capture per tuning, must be a multiple of @p block_size
+ * @param step_width width of each tuning step in Hz
+ * @param offset frequency offset added to tuned frequencies. sample_rate / 2 is a good value
+ * @param style sweep style
+ * @param block_size size of each block in bytes, including the header. Must be a power of two from @ref HACKRF_SWEEP_MIN_BLOCK_SIZE to @ref BYTES_PER_BLOCK
+ * @param settle_samples number of samples to discard after each block, at most @ref HACKRF_SWEEP_MAX_SETTLE_SAMPLES
+ * @return @ref HACKRF_SUCCESS on success or @ref hackrf_error variant
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_init_sweep_timed(
+	hackrf_device* device,
+	const uint16_t* frequency_list,
+	const int num_ranges,
+	const uint32_t num_bytes,
+	const uint32_t step_width,
+	const uint32_t offset,
+	const enum sweep_style style,
+	const uint32_t block_size,
+	const uint32_t settle_samples);
+
+/**
+ * Initialize sweep mode with a table of hops
+ * 
+ * As @ref hackrf_init_sweep_timed, but instead of sweeping frequency ranges, the device walks a table of arbitrary center frequencies in Hz, capturing @ref hackrf_hop.dwell_blocks blocks at each before moving on to the next, and starting over after the last. The table is uploaded in several requests and kept on the device.
+ * 
+ * Each block has the same 14-byte header as in @ref hackrf_init_sweep, except that bits 48-59 of the frequency field hold the index of the block's entry in the table. Mask the field with `0xffffffffffff` to get the frequency, or decode the header with @ref hackrf_parse_sweep_header.
+ * 
+ * Requires USB API version 0x0115 or above!
+ * @param device device to configure
+ * @param hops hop table
+ * @param num_hops number of entries in @p hops, 1 to @ref HACKRF_MAX_HOPS
+ * @param offset frequency offset added to tuned frequencies
+ * @param block_size size of each block in bytes, including the header. Must be a power of two from @ref HACKRF_SWEEP_MIN_BLOCK_SIZE to @ref BYTES_PER_BLOCK
+ * @param settle_samples number of samples to discard after each block, at most @ref HACKRF_SWEEP_MAX_SETTLE_SAMPLES
+ * @return @ref HACKRF_SUCCESS on success or @ref hackrf_error variant
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_init_hop_sweep(
+	hackrf_device* device,
+	const hackrf_hop* hops,
+	const int num_hops,
+	const uint32_t offset,
+	const uint32_t block_size,
+	const uint32_t settle_samples);
+
+/**
+ * Decode the header of a sweep mode block or spectrum record
+ * 
+ * Splits the frequency field into the frequency, hop index and Opera Cake port, see @ref hackrf_init_sweep, @ref hackrf_init_hop_sweep and @ref hackrf_set_operacake_sweep_ports. Doesn't need a device, and can be called from a transfer callback.
+ * 
+ * @param[in] block start of a block or record, at least @ref HACKRF_SWEEP_HEADER_LENGTH bytes
+ * @param[out] header decoded header
+ * @return @ref HACKRF_SUCCESS on success, or @ref HACKRF_ERROR_INVALID_PARAM if @p block doesn't start with `0x7F 0x7F`
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_parse_sweep_header(
+	const uint8_t* block,
+	hackrf_sweep_header* header);
+
+/**
+ * Decode a spectrum mode record
+ * 
+ * Decodes the header and count of a record received with @ref hackrf_start_rx_spectrum, and optionally converts its bins to dB, from the lowest frequency to the highest. A bin of @ref HACKRF_SPECTRUM_NO_POWER becomes -327.68 dB, below any power the device can measure. Doesn't need a device, and can be called from a transfer callback.
+ * 
+ * @param[in] record record, as passed to the transfer callback
+ * @param[in] length length of @p record in bytes, the transfer's valid length
+ * @param[out] out decoded record
+ * @param[out] pwr @ref hackrf_spectrum_record.num_bins values in dB, or NULL
+ * @return @ref HACKRF_SUCCESS on success, or @ref HACKRF_ERROR_INVALID_PARAM if @p record isn't a spectrum record
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_parse_spectrum_record(
+	const uint8_t* record,
+	const int length,
+	hackrf_spectrum_record* out,
+	float* pwr);
+
+/**
+ * Initialize spectrum mode
+ * 
+ * In spectrum mode, the device follows the sweep plan or hop table set up with @ref hackrf_init_sweep, @ref hackrf_init_sweep_timed or @ref hackrf_init_hop_sweep, but computes the power spectrum of each dwell itself, and sends only that. It splits each block into segments of @p fft_size samples, applies a Hann window, and averages the power of the FFTs of all the segments in the dwell. This needs far less USB bandwidth than sending the samples, at the cost of fixed FFT sizes and the resolution of 8-bit fixed-point arithmetic.
+ * 
+ * Each transfer passed to the callback of @ref hackrf_start_rx_spectrum holds one record of @ref HACKRF_SPECTRUM_HEADER_LENGTH + 2 * @p fft_size bytes. The record starts with the same 14-byte header as a block in @ref hackrf_init_sweep, for the first block of the dwell, followed by a `uint16_t` (LSBFIRST) count of the FFTs averaged, saturating at 65535. Then come @p fft_size `int16_t` (LSBFIRST) bins, from the lowest frequency to the highest, giving the power in hundredths of a dB relative to full scale, or @ref HACKRF_SPECTRUM_NO_POWER. The window puts a full-scale tone centred on a bin at about -6 dB. @ref hackrf_parse_spectrum_record decodes records.
+ * 
+ * The device computes the FFTs of each block while the M0 discards samples after it, after retuning if the block ends a dwell. This takes roughly 30 to 50 CPU cycles per sample, more for larger FFTs, so about 1.2 to 2 ms for a block of @ref BYTES_PER_BLOCK, three to five times as long as capturing it at 20 Msps. Once that is longer than the settle time, the next block starts as soon as the FFTs are done instead, so every block lengthens its dwell by the difference. Smaller blocks, see @ref hackrf_init_sweep_timed, keep the FFTs within shorter settle times.
+ * 
+ * Requires USB API version 0x0116 or above!
+ * @param device device to configure
+ * @param fft_size number of bins, a power of two from @ref HACKRF_SPECTRUM_MIN_FFT_SIZE to @ref HACKRF_SPECTRUM_MAX_FFT_SIZE
+ * @return @ref HACKRF_SUCCESS on success or @ref hackrf_error variant
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_init_spectrum(
+	hackrf_device* device,
+	const uint32_t fft_size);
+
 /**
  * Query connected Opera Cake boards
  * 
@@ -2100,6 +2643,25 @@ extern ADDAPI int ADDCALL hackrf_set_operacake_freq_ranges(
 	hackrf_operacake_freq_range* freq_ranges,
 	uint8_t count);
 
+/**
+ * Setup Opera Cake ports in @ref OPERACAKE_MODE_SWEEP mode operation
+ * 
+ * Should be called after @ref hackrf_set_operacake_mode, and before starting sweep mode. Each step of the sweep is then captured on every port in turn, in the order given, and bits 60-63 of the frequency field of each block header (see @ref hackrf_init_sweep) hold the port plus one. Mask the field with `0xffffffffffff` to get the frequency, or decode the header with @ref hackrf_parse_sweep_header. The field has no port if no board is in @ref OPERACAKE_MODE_SWEEP mode.
+ *
+ * **Note:** this configuration applies to all Opera Cake boards in @ref OPERACAKE_MODE_SWEEP mode
+ * 
+ * Requires USB API version 0x0117 or above!
+ * @param device device to configure
+ * @param ports list of ports for A0, each one of @ref operacake_ports
+ * @param count number of ports. Must be from 1 to @ref HACKRF_OPERACAKE_MAX_SWEEP_PORTS.
+ * @return @ref HACKRF_SUCCESS on success or @ref hackrf_error variant
+ * @ingroup operacake
+ */
+extern ADDAPI int ADDCALL hackrf_set_operacake_sweep_ports(
+	hackrf_device* device,
+	const uint8_t* ports,
+	uint8_t count);
+
 /**
  * Reset HackRF device
  * 
@@ -2221,10 +2783,27 @@ extern ADDAPI int ADDCALL hackrf_start_rx_sweep(
 	hackrf_sample_block_cb_fn callback,
 	void* rx_ctx);
 
+/**
+ * Start RX spectrum mode
+ * 
+ * See @ref hackrf_init_spectrum for more info
+ *
+ * Requires USB API version 0x0116 or above!
+ * @param device device to start
+ * @param callback rx callback processing the received spectrum records
+ * @param rx_ctx User provided RX context. Not used by the library, but available to @p callback as @ref hackrf_transfer.rx_ctx.
+ * @return @ref HACKRF_SUCCESS on success or @ref hackrf_error variant
+ * @ingroup streaming
+ */
+extern ADDAPI int ADDCALL hackrf_start_rx_spectrum(
+	hackrf_device* device,
+	hackrf_sample_block_cb_fn callback,
+	void* rx_ctx);
+
 // docsstring partly from hackrf.c
 /**
  * Get USB transfer buffer size.
- * @param[in] device unused
+ * @param[in] device device to query. If NULL, the library default is returned
  * @return size in bytes
  * @ingroup library
  */
@@ -2233,12 +2812,52 @@ extern ADDAPI size_t ADDCALL hackrf_get_transfer_buffer_size(hackrf_device* devi
 // docsstring partly from hackrf.c
 /**
  * Get the total number of USB transfer buffers.
- * @param[in] device unused
+ * @param[in] device device to query. If NULL, the library default is returned
  * @return number of buffers
  * @ingroup library
  */
 extern ADDAPI uint32_t ADDCALL hackrf_get_transfer_queue_depth(hackrf_device* device);
 
+/**
+ * Set the number and size of USB transfers used for streaming
+ *
+ * By default, 4 transfers of 256 KiB each are kept in flight. A deeper queue gives more tolerance of host scheduling stalls, while smaller transfers reduce the latency between samples arriving and the transfer callback being called.
+ *
+ * Must be called while the device is not streaming, i.e. before @ref hackrf_start_rx, @ref hackrf_start_tx or @ref hackrf_start_rx_sweep, or after the corresponding `hackrf_stop_*` call. The setting persists until the device is closed.
+ *
+ * @param device device to configure
+ * @param transfer_count number of transfers to keep in flight. Must be at least 1
+ * @param transfer_buffer_size size of each transfer in bytes. Must be a multiple of 512, and a multiple of @ref BYTES_PER_BLOCK for sweep mode
+ * @return @ref HACKRF_SUCCESS on success, @ref HACKRF_ERROR_BUSY if the device is streaming or @ref hackrf_error variant
+ * @ingroup library
+ */
+extern ADDAPI int ADDCALL hackrf_set_transfer_params(
+	hackrf_device* device,
+	const uint32_t transfer_count,
+	const uint32_t transfer_buffer_size);
+
+/**
+ * Get the kind of memory used for USB transfer buffers
+ *
+ * Where libusb supports it, transfer buffers are allocated with `libusb_dev_mem_alloc` so that samples are not copied between kernel and user space. If that is unavailable or fails, e.g. because the usbfs memory limit is reached, the library falls back to the heap. Buffers are reallocated by @ref hackrf_set_transfer_params, and spare buffers are allocated when streaming starts with the callback thread or in sync mode, so the mode should be checked after these.
+ *
+ * @param[in] device device to query
+ * @param[out] mode @ref HACKRF_BUFFER_MODE_ZERO_COPY if all transfer buffers are device memory, otherwise @ref HACKRF_BUFFER_MODE_HEAP
+ * @return @ref HACKRF_SUCCESS on success or @ref hackrf_error variant
+ * @ingroup library
+ */
+extern ADDAPI int ADDCALL hackrf_get_buffer_mode(
+	hackrf_device* device,
+	enum hackrf_buffer_mode* mode);
+
+/**
+ * Convert @ref hackrf_buffer_mode into human-readable string
+ * @param mode enum to convert
+ * @return human-readable name of buffer mode
+ * @ingroup library
+ */
+extern ADDAPI const char* ADDCALL hackrf_buffer_mode_name(enum hackrf_buffer_mode mode);
+
 /**
  * Read board revision of device
  * 
@@ -2385,6 +3004,154 @@ extern ADDAPI int ADDCALL hackrf_radio_write_register(
 	const uint8_t register_number,
 	const uint64_t value);
 
+/**
+ * Convert received samples to complex float
+ *
+ * Output values are `in * scale`, so a scale of `1.0f / 128.0f` gives values in the range [-1, 1).
+ *
+ * @param[in] in interleaved 8-bit I/Q samples, e.g. @ref hackrf_transfer.buffer
+ * @param[out] out interleaved float I/Q, with room for `2 * num_samples` values
+ * @param[in] num_samples number of I/Q sample pairs to convert
+ * @param[in] scale factor to multiply every value by
+ * @ingroup conversion
+ */
+extern ADDAPI void ADDCALL hackrf_convert_s8_to_cf32(
+	const int8_t* in,
+	float* out,
+	const size_t num_samples,
+	const float scale);
+
+/**
+ * Convert received samples to complex float, applying a window function
+ *
+ * Output values are `in * window * scale`, where each window value applies to both I and Q of one sample. Equivalent to windowing the output of @ref hackrf_convert_s8_to_cf32, but in a single pass.
+ *
+ * @param[in] in interleaved 8-bit I/Q samples, e.g. @ref hackrf_transfer.buffer
+ * @param[out] out interleaved float I/Q, with room for `2 * num_samples` values
+ * @param[in] window window coefficients, one per sample
+ * @param[in] num_samples number of I/Q sample pairs to convert
+ * @param[in] scale factor to multiply every value by
+ * @ingroup conversion
+ */
+extern ADDAPI void ADDCALL hackrf_convert_s8_to_cf32_window(
+	const int8_t* in,
+	float* out,
+	const float* window,
+	const size_t num_samples,
+	const float scale);
+
+/**
+ * Convert received samples to complex 16-bit integer
+ *
+ * Values are scaled by 256 to use the full 16-bit range.
+ *
+ * @param[in] in interleaved 8-bit I/Q samples, e.g. @ref hackrf_transfer.buffer
+ * @param[out] out interleaved 16-bit I/Q, with room for `2 * num_samples` values
+ * @param[in] num_samples number of I/Q sample pairs to convert
+ * @ingroup conversion
+ */
+extern ADDAPI void ADDCALL hackrf_convert_s8_to_cs16(
+	const int8_t* in,
+	int16_t* out,
+	const size_t num_samples);
+
+/**
+ * Convert complex float samples for transmission
+ *
+ * Output values are `in * scale`, rounded to the nearest integer and saturated to the range [-128, 127], so a scale of `127.0f` maps the range [-1, 1] to the full 8-bit range.
+ *
+ * @param[in] in interleaved float I/Q
+ * @param[out] out interleaved 8-bit I/Q, e.g. @ref hackrf_transfer.buffer
+ * @param[in] num_samples number of I/Q sample pairs to convert
+ * @param[in] scale factor to multiply every value by before rounding
+ * @ingroup conversion
+ */
+extern ADDAPI void ADDCALL hackrf_convert_cf32_to_s8(
+	const float* in,
+	int8_t* out,
+	const size_t num_samples,
+	const float scale);
+
+/**
+ * Convert complex 16-bit integer samples for transmission
+ *
+ * Values are divided by 256, keeping the 8 most significant bits.
+ *
+ * @param[in] in interleaved 16-bit I/Q
+ * @param[out] out interleaved 8-bit I/Q, e.g. @ref hackrf_transfer.buffer
+ * @param[in] num_samples number of I/Q sample pairs to convert
+ * @ingroup conversion
+ */
+extern ADDAPI void ADDCALL hackrf_convert_cs16_to_s8(
+	const int16_t* in,
+	int8_t* out,
+	const size_t num_samples);
+
+/**
+ * Convert complex float samples to power in dB
+ *
+ * Output values are `10 * log10(|in * scale|^2)`, e.g. for turning the output of an FFT into a power spectrum. With @ref HACKRF_DB_FAST, inputs with a power below `FLT_MIN` (including zero) give about -379.3 dB rather than negative infinity.
+ *
+ * @param[in] in interleaved float I/Q, e.g. FFT bins
+ * @param[out] out power values, with room for @p num_samples values
+ * @param[in] num_samples number of I/Q sample pairs to convert
+ * @param[in] scale factor to multiply every value by before squaring
+ * @param[in] mode whether to compute the logarithm exactly or approximately, see @ref hackrf_db_mode
+ * @ingroup conversion
+ */
+extern ADDAPI void ADDCALL hackrf_convert_cf32_to_db(
+	const float* in,
+	float* out,
+	const size_t num_samples,
+	const float scale,
+	const enum hackrf_db_mode mode);
+
+/**
+ * Convert power values to dB
+ *
+ * Output values are `10 * log10(in * scale)`, e.g. for turning power spectra that were summed or averaged in linear units into dB. With @ref HACKRF_DB_FAST, values below `FLT_MIN` (including zero) give about -379.3 dB rather than negative infinity.
+ *
+ * @param[in] in power values
+ * @param[out] out dB values, with room for @p count values
+ * @param[in] count number of values to convert
+ * @param[in] scale factor to multiply every value by
+ * @param[in] mode whether to compute the logarithm exactly or approximately, see @ref hackrf_db_mode
+ * @ingroup conversion
+ */
+extern ADDAPI void ADDCALL hackrf_convert_f32_to_db(
+	const float* in,
+	float* out,
+	const size_t count,
+	const float scale,
+	const enum hackrf_db_mode mode);
+
+/**
+ * Get the SIMD instruction set used by the sample conversion functions
+ *
+ * @return instruction set in use, never @ref HACKRF_SIMD_AUTO
+ * @ingroup conversion
+ */
+extern ADDAPI enum hackrf_simd ADDCALL hackrf_convert_get_simd(void);
+
+/**
+ * Select the SIMD instruction set used by the sample conversion functions
+ *
+ * Mainly useful for benchmarking and testing. The setting is global to the process.
+ *
+ * @param simd instruction set to use, or @ref HACKRF_SIMD_AUTO for the fastest supported by the CPU
+ * @return @ref HACKRF_SUCCESS on success or @ref HACKRF_ERROR_INVALID_PARAM if @p simd is not supported on this CPU or build
+ * @ingroup conversion
+ */
+extern ADDAPI int ADDCALL hackrf_convert_set_simd(const enum hackrf_simd simd);
+
+/**
+ * Convert @ref hackrf_simd into human-readable string
+ * @param simd enum to convert
+ * @return human-readable name of instruction set
+ * @ingroup conversion
+ */
+extern ADDAPI const char* ADDCALL hackrf_simd_name(const enum hackrf_simd simd);
+
 #ifdef __cplusplus
 } // __cplusplus defined.
 #endif
@@ -0,0 +1,1094 @@
+/*
+Copyright (c) 2026 Great Scott Gadgets <info@greatscottgadgets.com>
+
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+	documentation and/or other materials provided with the distribution.
+    Neither the name of Great Scott Gadgets nor the names of its contributors may be used to endorse or promote products derived from this software
+	without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Sample format conversion between the interleaved signed 8-bit I/Q used by
+ * HackRF and the formats commonly used by DSP code.
+ *
+ * Each conversion has a portable C implementation and, where the platform
+ * has them, SIMD implementations. The fastest set of kernels supported by
+ * the CPU is selected at runtime on first use.
+ */
+
+#include "hackrf.h"
+
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	#define HACKRF_CONVERT_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define TARGET_SSE2
+		#define TARGET_AVX2
+	#else
+		#define TARGET_SSE2 __attribute__((target("sse2")))
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	#define HACKRF_CONVERT_NEON
+	#include <arm_neon.h>
+#endif
+
+typedef struct {
+	enum hackrf_simd simd;
+	void (*s8_to_cf32)(const int8_t* in, float* out, size_t count, float scale);
+	void (*s8_to_cf32_window)(
+		const int8_t* in,
+		float* out,
+		const float* window,
+		size_t num_samples,
+		float scale);
+	void (*s8_to_cs16)(const int8_t* in, int16_t* out, size_t count);
+	void (*cf32_to_s8)(const float* in, int8_t* out, size_t count, float scale);
+	void (*cs16_to_s8)(const int16_t* in, int8_t* out, size_t count);
+	void (*cf32_to_db)(const float* in, float* out, size_t num_samples, float scale);
+	void (*f32_to_db)(const float* in, float* out, size_t count, float scale);
+} convert_kernels;
+
+/*
+ * The fast logarithm splits x into 2^e * m with m in [sqrt(1/2), sqrt(2)),
+ * then evaluates log2(m) = 2 / ln(2) * atanh(t) with t = (m - 1) / (m + 1) as
+ * a series in t. |t| < 0.172, so the first four terms are accurate to better
+ * than single precision.
+ */
+#define LOG2_C1       2.88539008f  /* 2 / ln(2) */
+#define LOG2_C3       0.961796694f /* 2 / (3 * ln(2)) */
+#define LOG2_C5       0.577078016f /* 2 / (5 * ln(2)) */
+#define LOG2_C7       0.412198583f /* 2 / (7 * ln(2)) */
+#define SQRT2         1.41421356f
+#define DB_PER_OCTAVE 3.01029996f /* 10 * log10(2) */
+
+/*
+ * Portable kernels. These also convert the remainder left over by the SIMD
+ * kernels, so they take a count of individual values rather than samples.
+ */
+
+static void generic_s8_to_cf32(const int8_t* in, float* out, size_t count, float scale)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		out[i] = in[i] * scale;
+	}
+}
+
+static void generic_s8_to_cf32_window(
+	const int8_t* in,
+	float* out,
+	const float* window,
+	size_t num_samples,
+	float scale)
+{
+	size_t i;
+
+	for (i = 0; i < num_samples; i++) {
+		out[i * 2] = in[i * 2] * (window[i] * scale);
+		out[i * 2 + 1] = in[i * 2 + 1] * (window[i] * scale);
+	}
+}
+
+static void generic_s8_to_cs16(const int8_t* in, int16_t* out, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		out[i] = (int16_t) (in[i] * 256);
+	}
+}
+
+static int8_t saturate_s8(float value)
+{
+	if (value >= 127.0f) {
+		return 127;
+	} else if (value <= -128.0f) {
+		return -128;
+	} else {
+		return (int8_t) lrintf(value);
+	}
+}
+
+static void generic_cf32_to_s8(const float* in, int8_t* out, size_t count, float scale)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		out[i] = saturate_s8(in[i] * scale);
+	}
+}
+
+static void generic_cs16_to_s8(const int16_t* in, int8_t* out, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		out[i] = (int8_t) (in[i] >> 8);
+	}
+}
+
+static void generic_cf32_to_db_exact(
+	const float* in,
+	float* out,
+	size_t num_samples,
+	float scale)
+{
+	float re, im, magsq;
+	size_t i;
+
+	for (i = 0; i < num_samples; i++) {
+		re = in[i * 2] * scale;
+		im = in[i * 2 + 1] * scale;
+		magsq = re * re + im * im;
+		out[i] = (float) (log2(magsq) * 10.0f / log2(10.0f));
+	}
+}
+
+static void generic_f32_to_db_exact(
+	const float* in,
+	float* out,
+	size_t count,
+	float scale)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		out[i] = (float) (log2(in[i] * scale) * 10.0f / log2(10.0f));
+	}
+}
+
+static float fast_log2(float x)
+{
+	uint32_t bits;
+	int32_t exponent;
+	float m, t, t2;
+
+	// Also catches NaN.
+	if (!(x >= FLT_MIN)) {
+		x = FLT_MIN;
+	}
+	memcpy(&bits, &x, sizeof(bits));
+	exponent = (int32_t) (bits >> 23) - 127;
+	bits = (bits & 0x007fffff) | 0x3f800000;
+	memcpy(&m, &bits, sizeof(m));
+	if (m > SQRT2) {
+		m *= 0.5f;
+		exponent++;
+	}
+	t = (m - 1.0f) / (m + 1.0f);
+	t2 = t * t;
+	return (float) exponent +
+		t * (LOG2_C1 + t2 * (LOG2_C3 + t2 * (LOG2_C5 + t2 * LOG2_C7)));
+}
+
+static void generic_cf32_to_db(
+	const float* in,
+	float* out,
+	size_t num_samples,
+	float scale)
+{
+	float re, im;
+	size_t i;
+
+	for (i = 0; i < num_samples; i++) {
+		re = in[i * 2] * scale;
+		im = in[i * 2 + 1] * scale;
+		out[i] = fast_log2(re * re + im * im) * DB_PER_OCTAVE;
+	}
+}
+
+static void generic_f32_to_db(const float* in, float* out, size_t count, float scale)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		out[i] = fast_log2(in[i] * scale) * DB_PER_OCTAVE;
+	}
+}
+
+static const convert_kernels generic_kernels = {
+	HACKRF_SIMD_GENERIC,
+	generic_s8_to_cf32,
+	generic_s8_to_cf32_window,
+	generic_s8_to_cs16,
+	generic_cf32_to_s8,
+	generic_cs16_to_s8,
+	generic_cf32_to_db,
+	generic_f32_to_db,
+};
+
+#ifdef HACKRF_CONVERT_X86
+
+/*
+ * SSE2 kernels
+ */
+
+TARGET_SSE2 static void sse2_s8_to_cf32(
+	const int8_t* in,
+	float* out,
+	size_t count,
+	float scale)
+{
+	const __m128 vscale = _mm_set1_ps(scale);
+	size_t i;
+
+	for (i = 0; i + 16 <= count; i += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*) &in[i]);
+		// Sign extend by unpacking each byte into the top of a wider lane.
+		__m128i lo16 = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+		__m128i hi16 = _mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8);
+		__m128i v0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo16, lo16), 16);
+		__m128i v1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo16, lo16), 16);
+		__m128i v2 = _mm_srai_epi32(_mm_unpacklo_epi16(hi16, hi16), 16);
+		__m128i v3 = _mm_srai_epi32(_mm_unpackhi_epi16(hi16, hi16), 16);
+		_mm_storeu_ps(&out[i], _mm_mul_ps(_mm_cvtepi32_ps(v0), vscale));
+		_mm_storeu_ps(&out[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(v1), vscale));
+		_mm_storeu_ps(&out[i + 8], _mm_mul_ps(_mm_cvtepi32_ps(v2), vscale));
+		_mm_storeu_ps(&out[i + 12], _mm_mul_ps(_mm_cvtepi32_ps(v3), vscale));
+	}
+
+	generic_s8_to_cf32(&in[i], &out[i], count - i, scale);
+}
+
+TARGET_SSE2 static void sse2_s8_to_cf32_window(
+	const int8_t* in,
+	float* out,
+	const float* window,
+	size_t num_samples,
+	float scale)
+{
+	const __m128 vscale = _mm_set1_ps(scale);
+	size_t i;
+
+	for (i = 0; i + 8 <= num_samples; i += 8) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*) &in[i * 2]);
+		__m128i lo16 = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+		__m128i hi16 = _mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8);
+		__m128i v0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo16, lo16), 16);
+		__m128i v1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo16, lo16), 16);
+		__m128i v2 = _mm_srai_epi32(_mm_unpacklo_epi16(hi16, hi16), 16);
+		__m128i v3 = _mm_srai_epi32(_mm_unpackhi_epi16(hi16, hi16), 16);
+		// Each window value applies to both I and Q of one sample.
+		__m128 w0 = _mm_mul_ps(_mm_loadu_ps(&window[i]), vscale);
+		__m128 w1 = _mm_mul_ps(_mm_loadu_ps(&window[i + 4]), vscale);
+		_mm_storeu_ps(
+			&out[i * 2],
+			_mm_mul_ps(_mm_cvtepi32_ps(v0), _mm_unpacklo_ps(w0, w0)));
+		_mm_storeu_ps(
+			&out[i * 2 + 4],
+			_mm_mul_ps(_mm_cvtepi32_ps(v1), _mm_unpackhi_ps(w0, w0)));
+		_mm_storeu_ps(
+			&out[i * 2 + 8],
+			_mm_mul_ps(_mm_cvtepi32_ps(v2), _mm_unpacklo_ps(w1, w1)));
+		_mm_storeu_ps(
+			&out[i * 2 + 12],
+			_mm_mul_ps(_mm_cvtepi32_ps(v3), _mm_unpackhi_ps(w1, w1)));
+	}
+
+	generic_s8_to_cf32_window(
+		&in[i * 2],
+		&out[i * 2],
+		&window[i],
+		num_samples - i,
+		scale);
+}
+
+TARGET_SSE2 static void sse2_s8_to_cs16(const int8_t* in, int16_t* out, size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i;
+
+	for (i = 0; i + 16 <= count; i += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*) &in[i]);
+		// Placing each byte in the upper half of a 16-bit lane scales by 256.
+		_mm_storeu_si128((__m128i*) &out[i], _mm_unpacklo_epi8(zero, bytes));
+		_mm_storeu_si128((__m128i*) &out[i + 8], _mm_unpackhi_epi8(zero, bytes));
+	}
+
+	generic_s8_to_cs16(&in[i], &out[i], count - i);
+}
+
+TARGET_SSE2 static void sse2_cf32_to_s8(
+	const float* in,
+	int8_t* out,
+	size_t count,
+	float scale)
+{
+	const __m128 vscale = _mm_set1_ps(scale);
+	size_t i;
+
+	for (i = 0; i + 16 <= count; i += 16) {
+		__m128i v0 = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(&in[i]), vscale));
+		__m128i v1 = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(&in[i + 4]), vscale));
+		__m128i v2 = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(&in[i + 8]), vscale));
+		__m128i v3 = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(&in[i + 12]), vscale));
+		// Saturating packs clamp to the int8 range.
+		__m128i v01 = _mm_packs_epi32(v0, v1);
+		__m128i v23 = _mm_packs_epi32(v2, v3);
+		_mm_storeu_si128((__m128i*) &out[i], _mm_packs_epi16(v01, v23));
+	}
+
+	generic_cf32_to_s8(&in[i], &out[i], count - i, scale);
+}
+
+TARGET_SSE2 static void sse2_cs16_to_s8(const int16_t* in, int8_t* out, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i + 16 <= count; i += 16) {
+		__m128i v0 = _mm_srai_epi16(_mm_loadu_si128((const __m128i*) &in[i]), 8);
+		__m128i v1 = _mm_srai_epi16(_mm_loadu_si128((const __m128i*) &in[i + 8]), 8);
+		_mm_storeu_si128((__m128i*) &out[i], _mm_packs_epi16(v0, v1));
+	}
+
+	generic_cs16_to_s8(&in[i], &out[i], count - i);
+}
+
+TARGET_SSE2 static __m128 sse2_log2(__m128 x)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128i bits, exponent;
+	__m128 m, t, t2, mask, poly;
+
+	// With a NaN operand, max returns the second one.
+	x = _mm_max_ps(x, _mm_set1_ps(FLT_MIN));
+	bits = _mm_castps_si128(x);
+	exponent = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+	bits = _mm_or_si128(
+		_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+		_mm_set1_epi32(0x3f800000));
+	m = _mm_castsi128_ps(bits);
+	mask = _mm_cmpgt_ps(m, _mm_set1_ps(SQRT2));
+	m = _mm_mul_ps(
+		m,
+		_mm_or_ps(
+			_mm_and_ps(mask, _mm_set1_ps(0.5f)),
+			_mm_andnot_ps(mask, one)));
+	// The mask is -1 where m was halved.
+	exponent = _mm_sub_epi32(exponent, _mm_castps_si128(mask));
+	t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+	t2 = _mm_mul_ps(t, t);
+	poly = _mm_add_ps(_mm_set1_ps(LOG2_C5), _mm_mul_ps(t2, _mm_set1_ps(LOG2_C7)));
+	poly = _mm_add_ps(_mm_set1_ps(LOG2_C3), _mm_mul_ps(t2, poly));
+	poly = _mm_add_ps(_mm_set1_ps(LOG2_C1), _mm_mul_ps(t2, poly));
+	return _mm_add_ps(_mm_cvtepi32_ps(exponent), _mm_mul_ps(t, poly));
+}
+
+TARGET_SSE2 static void sse2_cf32_to_db(
+	const float* in,
+	float* out,
+	size_t num_samples,
+	float scale)
+{
+	const __m128 vscale = _mm_set1_ps(scale);
+	const __m128 vdb = _mm_set1_ps(DB_PER_OCTAVE);
+	size_t i;
+
+	for (i = 0; i + 4 <= num_samples; i += 4) {
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(&in[i * 2]), vscale);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(&in[i * 2 + 4]), vscale);
+		a = _mm_mul_ps(a, a);
+		b = _mm_mul_ps(b, b);
+		// Add the squares of each I and Q pair.
+		__m128 magsq = _mm_add_ps(
+			_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)),
+			_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		_mm_storeu_ps(&out[i], _mm_mul_ps(sse2_log2(magsq), vdb));
+	}
+
+	generic_cf32_to_db(&in[i * 2], &out[i], num_samples - i, scale);
+}
+
+TARGET_SSE2 static void sse2_f32_to_db(
+	const float* in,
+	float* out,
+	size_t count,
+	float scale)
+{
+	const __m128 vscale = _mm_set1_ps(scale);
+	const __m128 vdb = _mm_set1_ps(DB_PER_OCTAVE);
+	size_t i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		__m128 power = _mm_mul_ps(_mm_loadu_ps(&in[i]), vscale);
+		_mm_storeu_ps(&out[i], _mm_mul_ps(sse2_log2(power), vdb));
+	}
+
+	generic_f32_to_db(&in[i], &out[i], count - i, scale);
+}
+
+static const convert_kernels sse2_kernels = {
+	HACKRF_SIMD_SSE2,
+	sse2_s8_to_cf32,
+	sse2_s8_to_cf32_window,
+	sse2_s8_to_cs16,
+	sse2_cf32_to_s8,
+	sse2_cs16_to_s8,
+	sse2_cf32_to_db,
+	sse2_f32_to_db,
+};
+
+/*
+ * AVX2 kernels
+ */
+
+TARGET_AVX2 static void avx2_s8_to_cf32(
+	const int8_t* in,
+	float* out,
+	size_t count,
+	float scale)
+{
+	const __m256 vscale = _mm256_set1_ps(scale);
+	size_t i, j;
+
+	for (i = 0; i + 32 <= count; i += 32) {
+		for (j = 0; j < 32; j += 8) {
+			__m256i v = _mm256_cvtepi8_epi32(
+				_mm_loadl_epi64((const __m128i*) &in[i + j]));
+			_mm256_storeu_ps(
+				&out[i + j],
+				_mm256_mul_ps(_mm256_cvtepi32_ps(v), vscale));
+		}
+	}
+
+	generic_s8_to_cf32(&in[i], &out[i], count - i, scale);
+}
+
+TARGET_AVX2 static void avx2_s8_to_cf32_window(
+	const int8_t* in,
+	float* out,
+	const float* window,
+	size_t num_samples,
+	float scale)
+{
+	const __m256 vscale = _mm256_set1_ps(scale);
+	const __m256i duplicate = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	size_t i, j;
+
+	for (i = 0; i + 16 <= num_samples; i += 16) {
+		__m256 w0 = _mm256_mul_ps(_mm256_loadu_ps(&window[i]), vscale);
+		__m256 w1 = _mm256_mul_ps(_mm256_loadu_ps(&window[i + 8]), vscale);
+		// Each window value applies to both I and Q of one sample.
+		__m256 w[4];
+		w[0] = _mm256_permutevar8x32_ps(w0, duplicate);
+		w[1] = _mm256_permutevar8x32_ps(
+			_mm256_permute2f128_ps(w0, w0, 0x11),
+			duplicate);
+		w[2] = _mm256_permutevar8x32_ps(w1, duplicate);
+		w[3] = _mm256_permutevar8x32_ps(
+			_mm256_permute2f128_ps(w1, w1, 0x11),
+			duplicate);
+		for (j = 0; j < 4; j++) {
+			__m256i v = _mm256_cvtepi8_epi32(
+				_mm_loadl_epi64((const __m128i*) &in[i * 2 + j * 8]));
+			_mm256_storeu_ps(
+				&out[i * 2 + j * 8],
+				_mm256_mul_ps(_mm256_cvtepi32_ps(v), w[j]));
+		}
+	}
+
+	generic_s8_to_cf32_window(
+		&in[i * 2],
+		&out[i * 2],
+		&window[i],
+		num_samples - i,
+		scale);
+}
+
+TARGET_AVX2 static void avx2_s8_to_cs16(const int8_t* in, int16_t* out, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i + 32 <= count; i += 32) {
+		__m256i v0 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) &in[i]));
+		__m256i v1 =
+			_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) &in[i + 16]));
+		_mm256_storeu_si256((__m256i*) &out[i], _mm256_slli_epi16(v0, 8));
+		_mm256_storeu_si256((__m256i*) &out[i + 16], _mm256_slli_epi16(v1, 8));
+	}
+
+	generic_s8_to_cs16(&in[i], &out[i], count - i);
+}
+
+TARGET_AVX2 static void avx2_cf32_to_s8(
+	const float* in,
+	int8_t* out,
+	size_t count,
+	float scale)
+{
+	const __m256 vscale = _mm256_set1_ps(scale);
+	// The packs below work within 128-bit lanes, this restores the order.
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	size_t i;
+
+	for (i = 0; i + 32 <= count; i += 32) {
+		__m256i v0 =
+			_mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(&in[i]), vscale));
+		__m256i v1 =
+			_mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(&in[i + 8]), vscale));
+		__m256i v2 = _mm256_cvtps_epi32(
+			_mm256_mul_ps(_mm256_loadu_ps(&in[i + 16]), vscale));
+		__m256i v3 = _mm256_cvtps_epi32(
+			_mm256_mul_ps(_mm256_loadu_ps(&in[i + 24]), vscale));
+		__m256i packed = _mm256_packs_epi16(
+			_mm256_packs_epi32(v0, v1),
+			_mm256_packs_epi32(v2, v3));
+		_mm256_storeu_si256(
+			(__m256i*) &out[i],
+			_mm256_permutevar8x32_epi32(packed, order));
+	}
+
+	generic_cf32_to_s8(&in[i], &out[i], count - i, scale);
+}
+
+TARGET_AVX2 static void avx2_cs16_to_s8(const int16_t* in, int8_t* out, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i + 32 <= count; i += 32) {
+		__m256i v0 =
+			_mm256_srai_epi16(_mm256_loadu_si256((const __m256i*) &in[i]), 8);
+		__m256i v1 =
+			_mm256_srai_epi16(_mm256_loadu_si256((const __m256i*) &in[i + 16]), 8);
+		// Undo the lane interleaving of the pack.
+		_mm256_storeu_si256(
+			(__m256i*) &out[i],
+			_mm256_permute4x64_epi64(_mm256_packs_epi16(v0, v1), 0xD8));
+	}
+
+	generic_cs16_to_s8(&in[i], &out[i], count - i);
+}
+
+TARGET_AVX2 static __m256 avx2_log2(__m256 x)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	__m256i bits, exponent;
+	__m256 m, t, t2, mask, poly;
+
+	// With a NaN operand, max returns the second one.
+	x = _mm256_max_ps(x, _mm256_set1_ps(FLT_MIN));
+	bits = _mm256_castps_si256(x);
+	exponent = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+	bits = _mm256_or_si256(
+		_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+		_mm256_set1_epi32(0x3f800000));
+	m = _mm256_castsi256_ps(bits);
+	mask = _mm256_cmp_ps(m, _mm256_set1_ps(SQRT2), _CMP_GT_OQ);
+	m = _mm256_mul_ps(m, _mm256_blendv_ps(one, _mm256_set1_ps(0.5f), mask));
+	// The mask is -1 where m was halved.
+	exponent = _mm256_sub_epi32(exponent, _mm256_castps_si256(mask));
+	t = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+	t2 = _mm256_mul_ps(t, t);
+	poly = _mm256_add_ps(
+		_mm256_set1_ps(LOG2_C5),
+		_mm256_mul_ps(t2, _mm256_set1_ps(LOG2_C7)));
+	poly = _mm256_add_ps(_mm256_set1_ps(LOG2_C3), _mm256_mul_ps(t2, poly));
+	poly = _mm256_add_ps(_mm256_set1_ps(LOG2_C1), _mm256_mul_ps(t2, poly));
+	return _mm256_add_ps(_mm256_cvtepi32_ps(exponent), _mm256_mul_ps(t, poly));
+}
+
+TARGET_AVX2 static void avx2_cf32_to_db(
+	const float* in,
+	float* out,
+	size_t num_samples,
+	float scale)
+{
+	const __m256 vscale = _mm256_set1_ps(scale);
+	const __m256 vdb = _mm256_set1_ps(DB_PER_OCTAVE);
+	size_t i;
+
+	for (i = 0; i + 8 <= num_samples; i += 8) {
+		__m256 a = _mm256_mul_ps(_mm256_loadu_ps(&in[i * 2]), vscale);
+		__m256 b = _mm256_mul_ps(_mm256_loadu_ps(&in[i * 2 + 8]), vscale);
+		a = _mm256_mul_ps(a, a);
+		b = _mm256_mul_ps(b, b);
+		// Add the squares of each I and Q pair. The shuffles work within
+		// 128-bit lanes, so the permute puts the results back in order.
+		__m256 magsq = _mm256_add_ps(
+			_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)),
+			_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		magsq = _mm256_castpd_ps(
+			_mm256_permute4x64_pd(_mm256_castps_pd(magsq), 0xD8));
+		_mm256_storeu_ps(&out[i], _mm256_mul_ps(avx2_log2(magsq), vdb));
+	}
+
+	generic_cf32_to_db(&in[i * 2], &out[i], num_samples - i, scale);
+}
+
+TARGET_AVX2 static void avx2_f32_to_db(
+	const float* in,
+	float* out,
+	size_t count,
+	float scale)
+{
+	const __m256 vscale = _mm256_set1_ps(scale);
+	const __m256 vdb = _mm256_set1_ps(DB_PER_OCTAVE);
+	size_t i;
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		__m256 power = _mm256_mul_ps(_mm256_loadu_ps(&in[i]), vscale);
+		_mm256_storeu_ps(&out[i], _mm256_mul_ps(avx2_log2(power), vdb));
+	}
+
+	generic_f32_to_db(&in[i], &out[i], count - i, scale);
+}
+
+static const convert_kernels avx2_kernels = {
+	HACKRF_SIMD_AVX2,
+	avx2_s8_to_cf32,
+	avx2_s8_to_cf32_window,
+	avx2_s8_to_cs16,
+	avx2_cf32_to_s8,
+	avx2_cs16_to_s8,
+	avx2_cf32_to_db,
+	avx2_f32_to_db,
+};
+
+static bool cpu_has_sse2(void)
+{
+	#if defined(__x86_64__) || defined(_M_X64)
+	return true;
+	#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+	#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse2");
+	#endif
+}
+
+static bool cpu_has_avx2(void)
+{
+	#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	// The OS must save the AVX registers (OSXSAVE and XCR0 bits 1-2).
+	__cpuid(info, 1);
+	if (((info[2] & (1 << 27)) == 0) || ((_xgetbv(0) & 6) != 6)) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+	#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+	#endif
+}
+
+#endif /* HACKRF_CONVERT_X86 */
+
+#ifdef HACKRF_CONVERT_NEON
+
+/*
+ * NEON kernels (AArch64)
+ */
+
+static void neon_s8_to_cf32(const int8_t* in, float* out, size_t count, float scale)
+{
+	size_t i;
+
+	for (i = 0; i + 16 <= count; i += 16) {
+		int8x16_t bytes = vld1q_s8(&in[i]);
+		int16x8_t lo16 = vmovl_s8(vget_low_s8(bytes));
+		int16x8_t hi16 = vmovl_s8(vget_high_s8(bytes));
+		vst1q_f32(
+			&out[i],
+			vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(lo16))), scale));
+		vst1q_f32(
+			&out[i + 4],
+			vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(lo16))), scale));
+		vst1q_f32(
+			&out[i + 8],
+			vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(hi16))), scale));
+		vst1q_f32(
+			&out[i + 12],
+			vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(hi16))), scale));
+	}
+
+	generic_s8_to_cf32(&in[i], &out[i], count - i, scale);
+}
+
+static void neon_s8_to_cf32_window(
+	const int8_t* in,
+	float* out,
+	const float* window,
+	size_t num_samples,
+	float scale)
+{
+	size_t i;
+
+	for (i = 0; i + 8 <= num_samples; i += 8) {
+		int8x16_t bytes = vld1q_s8(&in[i * 2]);
+		int16x8_t lo16 = vmovl_s8(vget_low_s8(bytes));
+		int16x8_t hi16 = vmovl_s8(vget_high_s8(bytes));
+		// Each window value applies to both I and Q of one sample.
+		float32x4_t w0 = vmulq_n_f32(vld1q_f32(&window[i]), scale);
+		float32x4_t w1 = vmulq_n_f32(vld1q_f32(&window[i + 4]), scale);
+		vst1q_f32(
+			&out[i * 2],
+			vmulq_f32(
+				vcvtq_f32_s32(vmovl_s16(vget_low_s16(lo16))),
+				vzip1q_f32(w0, w0)));
+		vst1q_f32(
+			&out[i * 2 + 4],
+			vmulq_f32(
+				vcvtq_f32_s32(vmovl_s16(vget_high_s16(lo16))),
+				vzip2q_f32(w0, w0)));
+		vst1q_f32(
+			&out[i * 2 + 8],
+			vmulq_f32(
+				vcvtq_f32_s32(vmovl_s16(vget_low_s16(hi16))),
+				vzip1q_f32(w1, w1)));
+		vst1q_f32(
+			&out[i * 2 + 12],
+			vmulq_f32(
+				vcvtq_f32_s32(vmovl_s16(vget_high_s16(hi16))),
+				vzip2q_f32(w1, w1)));
+	}
+
+	generic_s8_to_cf32_window(
+		&in[i * 2],
+		&out[i * 2],
+		&window[i],
+		num_samples - i,
+		scale);
+}
+
+static void neon_s8_to_cs16(const int8_t* in, int16_t* out, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i + 16 <= count; i += 16) {
+		int8x16_t bytes = vld1q_s8(&in[i]);
+		vst1q_s16(&out[i], vshll_n_s8(vget_low_s8(bytes), 8));
+		vst1q_s16(&out[i + 8], vshll_n_s8(vget_high_s8(bytes), 8));
+	}
+
+	generic_s8_to_cs16(&in[i], &out[i], count - i);
+}
+
+static void neon_cf32_to_s8(const float* in, int8_t* out, size_t count, float scale)
+{
+	size_t i;
+
+	for (i = 0; i + 16 <= count; i += 16) {
+		int32x4_t v0 = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(&in[i]), scale));
+		int32x4_t v1 = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(&in[i + 4]), scale));
+		int32x4_t v2 = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(&in[i + 8]), scale));
+		int32x4_t v3 = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(&in[i + 12]), scale));
+		// Saturating narrows clamp to the int8 range.
+		int16x8_t v01 = vcombine_s16(vqmovn_s32(v0), vqmovn_s32(v1));
+		int16x8_t v23 = vcombine_s16(vqmovn_s32(v2), vqmovn_s32(v3));
+		vst1q_s8(&out[i], vcombine_s8(vqmovn_s16(v01), vqmovn_s16(v23)));
+	}
+
+	generic_cf32_to_s8(&in[i], &out[i], count - i, scale);
+}
+
+static void neon_cs16_to_s8(const int16_t* in, int8_t* out, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i + 16 <= count; i += 16) {
+		int8x8_t lo = vshrn_n_s16(vld1q_s16(&in[i]), 8);
+		int8x8_t hi = vshrn_n_s16(vld1q_s16(&in[i + 8]), 8);
+		vst1q_s8(&out[i], vcombine_s8(lo, hi));
+	}
+
+	generic_cs16_to_s8(&in[i], &out[i], count - i);
+}
+
+static float32x4_t neon_log2(float32x4_t x)
+{
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const float32x4_t min = vdupq_n_f32(FLT_MIN);
+	uint32x4_t bits, mask;
+	int32x4_t exponent;
+	float32x4_t m, t, t2, poly;
+
+	// The comparison is false for NaN.
+	x = vbslq_f32(vcgeq_f32(x, min), x, min);
+	bits = vreinterpretq_u32_f32(x);
+	exponent = vsubq_s32(
+		vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)),
+		vdupq_n_s32(127));
+	bits = vorrq_u32(
+		vandq_u32(bits, vdupq_n_u32(0x007fffff)),
+		vdupq_n_u32(0x3f800000));
+	m = vreinterpretq_f32_u32(bits);
+	mask = vcgtq_f32(m, vdupq_n_f32(SQRT2));
+	m = vmulq_f32(m, vbslq_f32(mask, vdupq_n_f32(0.5f), one));
+	// The mask is -1 where m was halved.
+	exponent = vsubq_s32(exponent, vreinterpretq_s32_u32(mask));
+	t = vdivq_f32(vsubq_f32(m, one), vaddq_f32(m, one));
+	t2 = vmulq_f32(t, t);
+	// Separate multiplies and adds, matching the other implementations.
+	poly = vaddq_f32(vdupq_n_f32(LOG2_C5), vmulq_n_f32(t2, LOG2_C7));
+	poly = vaddq_f32(vdupq_n_f32(LOG2_C3), vmulq_f32(t2, poly));
+	poly = vaddq_f32(vdupq_n_f32(LOG2_C1), vmulq_f32(t2, poly));
+	return vaddq_f32(vcvtq_f32_s32(exponent), vmulq_f32(t, poly));
+}
+
+static void neon_cf32_to_db(const float* in, float* out, size_t num_samples, float scale)
+{
+	size_t i;
+
+	for (i = 0; i + 4 <= num_samples; i += 4) {
+		// Load I and Q into separate registers.
+		float32x4x2_t iq = vld2q_f32(&in[i * 2]);
+		float32x4_t re = vmulq_n_f32(iq.val[0], scale);
+		float32x4_t im = vmulq_n_f32(iq.val[1], scale);
+		float32x4_t magsq = vaddq_f32(vmulq_f32(re, re), vmulq_f32(im, im));
+		vst1q_f32(&out[i], vmulq_n_f32(neon_log2(magsq), DB_PER_OCTAVE));
+	}
+
+	generic_cf32_to_db(&in[i * 2], &out[i], num_samples - i, scale);
+}
+
+static void neon_f32_to_db(const float* in, float* out, size_t count, float scale)
+{
+	size_t i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		float32x4_t power = vmulq_n_f32(vld1q_f32(&in[i]), scale);
+		vst1q_f32(&out[i], vmulq_n_f32(neon_log2(power), DB_PER_OCTAVE));
+	}
+
+	generic_f32_to_db(&in[i], &out[i], count - i, scale);
+}
+
+static const convert_kernels neon_kernels = {
+	HACKRF_SIMD_NEON,
+	neon_s8_to_cf32,
+	neon_s8_to_cf32_window,
+	neon_s8_to_cs16,
+	neon_cf32_to_s8,
+	neon_cs16_to_s8,
+	neon_cf32_to_db,
+	neon_f32_to_db,
+};
+
+#endif /* HACKRF_CONVERT_NEON */
+
+static const convert_kernels* kernels_for(enum hackrf_simd simd)
+{
+	switch (simd) {
+	case HACKRF_SIMD_GENERIC:
+		return &generic_kernels;
+
+#ifdef HACKRF_CONVERT_X86
+	case HACKRF_SIMD_SSE2:
+		return cpu_has_sse2() ? &sse2_kernels : NULL;
+
+	case HACKRF_SIMD_AVX2:
+		return cpu_has_avx2() ? &avx2_kernels : NULL;
+#endif
+
+#ifdef HACKRF_CONVERT_NEON
+	case HACKRF_SIMD_NEON:
+		return &neon_kernels;
+#endif
+
+	default:
+		return NULL;
+	}
+}
+
+static const convert_kernels* detect_kernels(void)
+{
+	const enum hackrf_simd preference[] = {
+		HACKRF_SIMD_AVX2,
+		HACKRF_SIMD_SSE2,
+		HACKRF_SIMD_NEON,
+	};
+	const convert_kernels* kernels;
+	size_t i;
+
+	for (i = 0; i < sizeof(preference) / sizeof(preference[0]); i++) {
+		kernels = kernels_for(preference[i]);
+		if (kernels != NULL) {
+			return kernels;
+		}
+	}
+
+	return &generic_kernels;
+}
+
+/*
+ * Detection is idempotent, so threads racing to do it first simply store
+ * the same pointer.
+ */
+static const convert_kernels* active_kernels = NULL;
+
+static const convert_kernels* load_kernels(void)
+{
+#ifdef _MSC_VER
+	return *(const convert_kernels* volatile*) &active_kernels;
+#else
+	return __atomic_load_n(&active_kernels, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void store_kernels(const convert_kernels* kernels)
+{
+#ifdef _MSC_VER
+	*(const convert_kernels* volatile*) &active_kernels = kernels;
+#else
+	__atomic_store_n(&active_kernels, kernels, __ATOMIC_RELEASE);
+#endif
+}
+
+static const convert_kernels* get_kernels(void)
+{
+	const convert_kernels* kernels = load_kernels();
+
+	if (kernels == NULL) {
+		kernels = detect_kernels();
+		store_kernels(kernels);
+	}
+
+	return kernels;
+}
+
+void ADDCALL hackrf_convert_s8_to_cf32(
+	const int8_t* in,
+	float* out,
+	const size_t num_samples,
+	const float scale)
+{
+	get_kernels()->s8_to_cf32(in, out, num_samples * 2, scale);
+}
+
+void ADDCALL hackrf_convert_s8_to_cf32_window(
+	const int8_t* in,
+	float* out,
+	const float* window,
+	const size_t num_samples,
+	const float scale)
+{
+	get_kernels()->s8_to_cf32_window(in, out, window, num_samples, scale);
+}
+
+void ADDCALL hackrf_convert_s8_to_cs16(
+	const int8_t* in,
+	int16_t* out,
+	const size_t num_samples)
+{
+	get_kernels()->s8_to_cs16(in, out, num_samples * 2);
+}
+
+void ADDCALL hackrf_convert_cf32_to_s8(
+	const float* in,
+	int8_t* out,
+	const size_t num_samples,
+	const float scale)
+{
+	get_kernels()->cf32_to_s8(in, out, num_samples * 2, scale);
+}
+
+void ADDCALL hackrf_convert_cs16_to_s8(
+	const int16_t* in,
+	int8_t* out,
+	const size_t num_samples)
+{
+	get_kernels()->cs16_to_s8(in, out, num_samples * 2);
+}
+
+void ADDCALL hackrf_convert_cf32_to_db(
+	const float* in,
+	float* out,
+	const size_t num_samples,
+	const float scale,
+	const enum hackrf_db_mode mode)
+{
+	if (mode == HACKRF_DB_FAST) {
+		get_kernels()->cf32_to_db(in, out, num_samples, scale);
+	} else {
+		generic_cf32_to_db_exact(in, out, num_samples, scale);
+	}
+}
+
+void ADDCALL hackrf_convert_f32_to_db(
+	const float* in,
+	float* out,
+	const size_t count,
+	const float scale,
+	const enum hackrf_db_mode mode)
+{
+	if (mode == HACKRF_DB_FAST) {
+		get_kernels()->f32_to_db(in, out, count, scale);
+	} else {
+		generic_f32_to_db_exact(in, out, count, scale);
+	}
+}
+
+enum hackrf_simd ADDCALL hackrf_convert_get_simd(void)
+{
+	return get_kernels()->simd;
+}
+
+int ADDCALL hackrf_convert_set_simd(const enum hackrf_simd simd)
+{
+	const convert_kernels* kernels;
+
+	if (simd == HACKRF_SIMD_AUTO) {
+		kernels = detect_kernels();
+	} else {
+		kernels = kernels_for(simd);
+	}
+
+	if (kernels == NULL) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	store_kernels(kernels);
+
+	return HACKRF_SUCCESS;
+}
+
+const char* ADDCALL hackrf_simd_name(const enum hackrf_simd simd)
+{
+	switch (simd) {
+	case HACKRF_SIMD_AUTO:
+		return "auto";
+
+	case HACKRF_SIMD_GENERIC:
+		return "generic";
+
+	case HACKRF_SIMD_SSE2:
+		return "SSE2";
+
+	case HACKRF_SIMD_AVX2:
+		return "AVX2";
+
+	case HACKRF_SIMD_NEON:
+		return "NEON";
+
+	default:
+		return "unknown";
+	}
+}
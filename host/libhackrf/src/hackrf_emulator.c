@@ -0,0 +1,1621 @@
+/*
+Copyright (c) 2026 Great Scott Gadgets <info@greatscottgadgets.com>
+
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+	documentation and/or other materials provided with the distribution.
+    Neither the name of Great Scott Gadgets nor the names of its contributors may be used to endorse or promote products derived from this software
+	without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Emulated HackRF One.
+ *
+ * The emulator answers vendor requests from its own copy of the device
+ * state and completes bulk transfers from a thread of its own, paced at the
+ * configured sample rate. It is selected by opening the serial number
+ * HACKRF_EMULATOR_SERIAL, or by setting the HACKRF_EMULATOR environment
+ * variable, which also holds its options as a comma separated list:
+ *
+ *   signal=<tone|noise|counter|zero>  RX data generator (default: tone)
+ *   tone=<hz>          offset of the generated tone (default: 1000000)
+ *   file=<path>        read RX data from a file of 8-bit I/Q, looping at EOF
+ *   tx_file=<path>     write TX data to a file
+ *   rate=<sps|max>     pace streaming at this rate instead of the sample rate
+ *   overrun=<n>        drop one transfer of RX data every n transfers
+ *   underrun=<n>       report a TX underrun every n transfers
+ *   stall=<n>          hold back every nth transfer completion...
+ *   stall_us=<us>      ...by this many microseconds (default: 10000)
+ *
+ * Data that the host doesn't collect, or supply, in time is lost just as it
+ * would be by the M0 on a real device, and counted in its M0 state.
+ */
+
+#include "hackrf.h"
+#include "hackrf_usb.h"
+#include "hackrf_emulator.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+	#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+	/* Avoid redefinition of timespec from time.h (included by libusb.h) */
+	#define HAVE_STRUCT_TIMESPEC 1
+#endif
+#include <pthread.h>
+
+#ifndef M_PI
+	#define M_PI 3.14159265358979323846
+#endif
+
+#define EMULATOR_USB_API_VERSION     0x0117
+#define EMULATOR_BUFFER_SIZE         32768 /* bytes buffered by the M0 */
+#define EMULATOR_SPIFLASH_SIZE       (1024 * 1024)
+#define EMULATOR_DEFAULT_SAMPLE_RATE 10000000
+#define EMULATOR_DEFAULT_TONE_HZ     1000000
+#define EMULATOR_DEFAULT_STALL_US    10000
+#define EMULATOR_SWEEP_THROWAWAY     2 /* blocks discarded after each sweep block */
+#define EMULATOR_TONE_AMPLITUDE      64.0f
+#define EMULATOR_NOISE_AMPLITUDE     4.0f
+#define EMULATOR_RADIO_BANKS         5
+#define EMULATOR_RADIO_REGS          23
+#define EMULATOR_RADIO_BANK_ALL      255
+#define EMULATOR_HOP_ENTRY_LENGTH    10 /* LE64 frequency in Hz, LE16 dwell blocks */
+#define EMULATOR_HOP_CHUNK_ENTRIES   24
+
+/* From firmware/common/m0_state.h */
+#define M0_MODE_IDLE        0
+#define M0_MODE_RX          2
+#define M0_MODE_TX_RUN      4
+#define M0_ERROR_NONE       0
+#define M0_ERROR_RX_TIMEOUT 1
+#define M0_ERROR_TX_TIMEOUT 2
+
+typedef enum {
+	EMULATOR_SIGNAL_TONE,
+	EMULATOR_SIGNAL_NOISE,
+	EMULATOR_SIGNAL_COUNTER,
+	EMULATOR_SIGNAL_ZERO,
+	EMULATOR_SIGNAL_FILE,
+} emulator_signal;
+
+struct pending_transfer {
+	struct libusb_transfer* transfer;
+	bool cancelled;
+};
+
+struct hackrf_emulator {
+	pthread_t thread;
+	pthread_mutex_t lock; /* protects everything below */
+	pthread_cond_t cv;    /* signalled on submit, cancel, mode change and exit */
+	bool exit;
+
+	/* Transfers in submission order, completed from the front. */
+	struct pending_transfer* pending;
+	uint32_t pending_count;
+	uint32_t pending_capacity;
+
+	/* Options */
+	emulator_signal signal;
+	FILE* rx_file;
+	FILE* tx_file;
+	double tone_hz;
+	double rate;  /* samples per second, or 0 to follow the sample rate */
+	bool unpaced; /* complete transfers as fast as the host takes them */
+	uint32_t overrun_every;
+	uint32_t underrun_every;
+	uint32_t stall_every;
+	uint32_t stall_us;
+
+	/* Device state */
+	uint8_t transceiver_mode;
+	uint32_t sample_rate_hz;
+	uint32_t sample_rate_divider;
+	uint64_t freq_hz;
+	uint32_t baseband_filter_hz;
+	uint8_t lna_gain;
+	uint8_t vga_gain;
+	uint8_t txvga_gain;
+	uint8_t amp_enable;
+	uint8_t antenna_enable;
+	uint8_t hw_sync_mode;
+	uint8_t clkout_enable;
+	uint8_t ui_enable;
+	uint8_t leds;
+	uint32_t rx_overrun_limit;
+	uint32_t tx_underrun_limit;
+	uint16_t max283x[32];
+	uint8_t si5351c[256];
+	uint16_t rffc5071[31];
+	uint8_t fpga[256];
+	uint64_t radio[EMULATOR_RADIO_BANKS][EMULATOR_RADIO_REGS];
+	uint8_t operacake_mode[HACKRF_OPERACAKE_MAX_BOARDS];
+	unsigned char* spiflash;
+	hackrf_m0_state m0;
+
+	/* Sweep plan, as set by INIT_SWEEP, and progress through it */
+	uint16_t sweep_frequencies[MAX_SWEEP_RANGES * 2];
+	uint16_t sweep_num_ranges;
+	uint32_t sweep_dwell_blocks;
+	uint32_t sweep_block_size;
+	uint32_t sweep_settle_bytes;
+	uint32_t sweep_step_width;
+	uint32_t sweep_offset;
+	uint8_t sweep_style;
+	uint64_t sweep_freq;
+	uint16_t sweep_range;
+	bool sweep_odd;
+	uint32_t sweep_blocks;
+
+	/* Hop table, as set by SET_HOP_TABLE, walked instead of the plan */
+	uint64_t hop_freqs[HACKRF_MAX_HOPS];
+	uint16_t hop_dwell[HACKRF_MAX_HOPS];
+	uint16_t hops_loaded;
+	uint16_t sweep_num_hops; /* 0 to follow the sweep plan */
+	uint16_t sweep_hop;
+
+	/* Spectrum mode, averaging each dwell of the sweep */
+	uint32_t spectrum_fft_size;
+	unsigned char spectrum_block[BYTES_PER_BLOCK];
+	double spectrum_power[HACKRF_SPECTRUM_MAX_FFT_SIZE];
+
+	/* Streaming */
+	uint64_t due_us; /* when the data for the previous transfer was complete */
+	uint64_t transfers;
+	float tone_re;
+	float tone_im;
+	uint32_t noise_state;
+	uint8_t counter;
+};
+
+static uint64_t emulator_now_us(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return (uint64_t) (count.QuadPart / frequency.QuadPart) * 1000000 +
+		(uint64_t) (count.QuadPart % frequency.QuadPart) * 1000000 /
+		frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+static void emulator_sleep_us(uint32_t us)
+{
+#ifdef _WIN32
+	Sleep((us + 999) / 1000);
+#else
+	usleep(us);
+#endif
+}
+
+/* Wait on the emulator's condition variable for at most us microseconds. */
+static void emulator_wait_us(hackrf_emulator* emulator, uint64_t us)
+{
+	struct timespec deadline;
+
+#ifdef _WIN32
+	timespec_get(&deadline, TIME_UTC);
+#else
+	clock_gettime(CLOCK_REALTIME, &deadline);
+#endif
+	deadline.tv_sec += (time_t) (us / 1000000);
+	deadline.tv_nsec += (long) (us % 1000000) * 1000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+	pthread_cond_timedwait(&emulator->cv, &emulator->lock, &deadline);
+}
+
+static double sample_rate(hackrf_emulator* emulator)
+{
+	return (double) emulator->sample_rate_hz / emulator->sample_rate_divider;
+}
+
+/* Streaming rate in bytes per microsecond. */
+static double stream_rate(hackrf_emulator* emulator)
+{
+	double rate = (emulator->rate > 0) ? emulator->rate : sample_rate(emulator);
+	return rate * 2 / 1e6;
+}
+
+static void reset_state(hackrf_emulator* emulator)
+{
+	emulator->transceiver_mode = HACKRF_TRANSCEIVER_MODE_OFF;
+	emulator->sample_rate_hz = EMULATOR_DEFAULT_SAMPLE_RATE;
+	emulator->sample_rate_divider = 1;
+	emulator->freq_hz = 0;
+	emulator->baseband_filter_hz = 0;
+	emulator->lna_gain = 0;
+	emulator->vga_gain = 0;
+	emulator->txvga_gain = 0;
+	emulator->amp_enable = 0;
+	emulator->antenna_enable = 0;
+	emulator->hw_sync_mode = HACKRF_HW_SYNC_MODE_OFF;
+	emulator->clkout_enable = 0;
+	emulator->ui_enable = 1;
+	emulator->leds = 0;
+	emulator->rx_overrun_limit = 0;
+	emulator->tx_underrun_limit = 0;
+	memset(emulator->max283x, 0, sizeof(emulator->max283x));
+	memset(emulator->si5351c, 0, sizeof(emulator->si5351c));
+	memset(emulator->rffc5071, 0, sizeof(emulator->rffc5071));
+	memset(emulator->fpga, 0, sizeof(emulator->fpga));
+	/* Radio registers start out unset, as all ones. */
+	memset(emulator->radio, 0xff, sizeof(emulator->radio));
+	memset(emulator->operacake_mode, 0, sizeof(emulator->operacake_mode));
+	memset(&emulator->m0, 0, sizeof(emulator->m0));
+	emulator->sweep_num_ranges = 0;
+	emulator->hops_loaded = 0;
+	emulator->sweep_num_hops = 0;
+	emulator->spectrum_fft_size = HACKRF_SPECTRUM_MAX_FFT_SIZE;
+	emulator->sweep_block_size = BYTES_PER_BLOCK;
+	emulator->sweep_settle_bytes = BYTES_PER_BLOCK * EMULATOR_SWEEP_THROWAWAY;
+}
+
+/* Uniform pseudo-random value in [-1, 1). */
+static float noise(hackrf_emulator* emulator)
+{
+	uint32_t x = emulator->noise_state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	emulator->noise_state = x;
+
+	return (float) ((int32_t) x) / 2147483648.0f;
+}
+
+static unsigned char clip_s8(float value)
+{
+	long rounded = lrintf(value);
+
+	if (rounded > 127) {
+		rounded = 127;
+	} else if (rounded < -127) {
+		rounded = -127;
+	}
+	return (unsigned char) (int8_t) rounded;
+}
+
+static void read_file(hackrf_emulator* emulator, unsigned char* buffer, size_t length)
+{
+	size_t offset = 0;
+	size_t count;
+	bool rewound = false;
+
+	while (offset < length) {
+		count = fread(buffer + offset, 1, length - offset, emulator->rx_file);
+		if (count > 0) {
+			offset += count;
+			rewound = false;
+		} else if (!rewound) {
+			rewind(emulator->rx_file);
+			rewound = true;
+		} else {
+			// Empty or unreadable file.
+			memset(buffer + offset, 0, length - offset);
+			return;
+		}
+	}
+}
+
+/* Fill buffer with length bytes of 8-bit I/Q from the RX generator. */
+static void generate(hackrf_emulator* emulator, unsigned char* buffer, int length)
+{
+	float step, step_re, step_im, re, magnitude;
+	float noise_amplitude = EMULATOR_NOISE_AMPLITUDE;
+	int i;
+
+	switch (emulator->signal) {
+	case EMULATOR_SIGNAL_ZERO:
+		memset(buffer, 0, length);
+		return;
+	case EMULATOR_SIGNAL_COUNTER:
+		for (i = 0; i < length; i++) {
+			buffer[i] = emulator->counter++;
+		}
+		return;
+	case EMULATOR_SIGNAL_FILE:
+		read_file(emulator, buffer, length);
+		return;
+	case EMULATOR_SIGNAL_NOISE:
+		noise_amplitude = EMULATOR_TONE_AMPLITUDE;
+		for (i = 0; i < length; i++) {
+			buffer[i] = clip_s8(noise(emulator) * noise_amplitude);
+		}
+		return;
+	case EMULATOR_SIGNAL_TONE:
+		break;
+	}
+
+	step = (float) (2 * M_PI * emulator->tone_hz / sample_rate(emulator));
+	step_re = cosf(step);
+	step_im = sinf(step);
+	for (i = 0; i + 1 < length; i += 2) {
+		buffer[i] = clip_s8(
+			emulator->tone_re * EMULATOR_TONE_AMPLITUDE +
+			noise(emulator) * noise_amplitude);
+		buffer[i + 1] = clip_s8(
+			emulator->tone_im * EMULATOR_TONE_AMPLITUDE +
+			noise(emulator) * noise_amplitude);
+		re = emulator->tone_re * step_re - emulator->tone_im * step_im;
+		emulator->tone_im = emulator->tone_re * step_im + emulator->tone_im * step_re;
+		emulator->tone_re = re;
+	}
+
+	// Keep rounding errors from changing the amplitude over time.
+	magnitude = sqrtf(
+		emulator->tone_re * emulator->tone_re +
+		emulator->tone_im * emulator->tone_im);
+	emulator->tone_re /= magnitude;
+	emulator->tone_im /= magnitude;
+}
+
+/* Advance the RX generator past length bytes that were never delivered. */
+static void skip(hackrf_emulator* emulator, uint64_t length)
+{
+	double angle, re;
+
+	switch (emulator->signal) {
+	case EMULATOR_SIGNAL_COUNTER:
+		emulator->counter += (uint8_t) length;
+		break;
+	case EMULATOR_SIGNAL_FILE:
+		fseek(emulator->rx_file, (long) length, SEEK_CUR);
+		break;
+	case EMULATOR_SIGNAL_TONE:
+		angle = fmod(
+			2 * M_PI * emulator->tone_hz / sample_rate(emulator) * (length / 2),
+			2 * M_PI);
+		re = emulator->tone_re * cos(angle) - emulator->tone_im * sin(angle);
+		emulator->tone_im =
+			(float) (emulator->tone_re * sin(angle) + emulator->tone_im * cos(angle));
+		emulator->tone_re = (float) re;
+		break;
+	default:
+		break;
+	}
+}
+
+static void record_shortfall(hackrf_emulator* emulator, uint64_t length, bool rx)
+{
+	emulator->m0.num_shortfalls++;
+	if (length > emulator->m0.longest_shortfall) {
+		emulator->m0.longest_shortfall = (uint32_t) length;
+	}
+
+	// Like the M0, give up if the shortfall exceeds the configured limit.
+	if ((emulator->m0.shortfall_limit != 0) &&
+	    (length > emulator->m0.shortfall_limit)) {
+		emulator->m0.active_mode = M0_MODE_IDLE;
+		emulator->m0.error = rx ? M0_ERROR_RX_TIMEOUT : M0_ERROR_TX_TIMEOUT;
+	}
+}
+
+/* Move the sweep on to its next tuning, as the firmware does. */
+static void next_sweep_freq(hackrf_emulator* emulator)
+{
+	const uint64_t range_end =
+		(uint64_t) emulator->sweep_frequencies[1 + emulator->sweep_range * 2] *
+		1000000;
+	const uint32_t step_width = emulator->sweep_step_width;
+	bool next_range;
+
+	if (emulator->sweep_num_hops > 0) {
+		emulator->sweep_hop = (emulator->sweep_hop + 1) % emulator->sweep_num_hops;
+		emulator->sweep_freq = emulator->hop_freqs[emulator->sweep_hop];
+		return;
+	}
+	if (emulator->sweep_style == INTERLEAVED) {
+		next_range = !emulator->sweep_odd &&
+			((emulator->sweep_freq + step_width) >= range_end);
+		if (!next_range) {
+			emulator->sweep_freq +=
+				emulator->sweep_odd ? step_width / 4 : 3 * step_width / 4;
+		}
+		emulator->sweep_odd = !emulator->sweep_odd;
+	} else {
+		next_range = (emulator->sweep_freq + step_width) >= range_end;
+		if (!next_range) {
+			emulator->sweep_freq += step_width;
+		}
+	}
+
+	if (next_range) {
+		emulator->sweep_range =
+			(emulator->sweep_range + 1) % emulator->sweep_num_ranges;
+		emulator->sweep_freq =
+			(uint64_t) emulator->sweep_frequencies[emulator->sweep_range * 2] *
+			1000000;
+	}
+}
+
+/*
+ * Write the header of the next sweep block: its frequency and the M0 count at
+ * its start. With a hop table, the hop index is in the upper 16 bits of the
+ * frequency.
+ */
+static void write_sweep_header(hackrf_emulator* emulator, unsigned char* buffer)
+{
+	uint64_t header_freq = emulator->sweep_freq;
+	int i;
+
+	if (emulator->sweep_num_hops > 0) {
+		header_freq |= (uint64_t) emulator->sweep_hop << 48;
+	}
+	buffer[0] = 0x7f;
+	buffer[1] = 0x7f;
+	for (i = 0; i < 8; i++) {
+		buffer[2 + i] = (header_freq >> (8 * i)) & 0xff;
+	}
+	for (i = 0; i < 4; i++) {
+		buffer[10 + i] = (emulator->m0.m0_count >> (8 * i)) & 0xff;
+	}
+}
+
+/*
+ * Capture a sweep block, with its header if header is set. The M0 counts the
+ * discarded samples too, and like the firmware, delays blocks that would wrap
+ * around the end of its buffer.
+ */
+static void sweep_block(hackrf_emulator* emulator, unsigned char* block, bool header)
+{
+	const uint32_t block_size = emulator->sweep_block_size;
+	uint32_t settle, position;
+	uint32_t dwell_blocks = emulator->sweep_dwell_blocks;
+
+	if (emulator->sweep_num_hops > 0) {
+		dwell_blocks = emulator->hop_dwell[emulator->sweep_hop];
+	}
+	generate(emulator, block, block_size);
+	if (header) {
+		write_sweep_header(emulator, block);
+	}
+	settle = emulator->sweep_settle_bytes;
+	position = (emulator->m0.m0_count + block_size + settle) % EMULATOR_BUFFER_SIZE;
+	if (position + block_size > EMULATOR_BUFFER_SIZE) {
+		settle += EMULATOR_BUFFER_SIZE - position;
+	}
+	skip(emulator, settle);
+	emulator->m0.m0_count += block_size + settle;
+
+	if (++emulator->sweep_blocks == dwell_blocks) {
+		next_sweep_freq(emulator);
+		emulator->sweep_blocks = 0;
+	}
+}
+
+/* Fill an RX transfer with sweep blocks. */
+static void generate_sweep(hackrf_emulator* emulator, unsigned char* buffer, int length)
+{
+	const uint32_t block_size = emulator->sweep_block_size;
+	int offset;
+
+	for (offset = 0; offset + (int) block_size <= length; offset += block_size) {
+		sweep_block(emulator, buffer + offset, true);
+	}
+}
+
+/* In-place radix-2 FFT of n complex values. */
+static void fft(double* re, double* im, uint32_t n)
+{
+	uint32_t i, j, bit, half, k;
+	double angle, w_re, w_im, t_re, t_im, tmp;
+
+	for (i = 1, j = 0; i < n; i++) {
+		for (bit = n >> 1; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j ^= bit;
+		if (i < j) {
+			tmp = re[i];
+			re[i] = re[j];
+			re[j] = tmp;
+			tmp = im[i];
+			im[i] = im[j];
+			im[j] = tmp;
+		}
+	}
+	for (half = 1; half < n; half <<= 1) {
+		for (k = 0; k < half; k++) {
+			angle = -M_PI * k / half;
+			w_re = cos(angle);
+			w_im = sin(angle);
+			for (i = k; i < n; i += 2 * half) {
+				j = i + half;
+				t_re = re[j] * w_re - im[j] * w_im;
+				t_im = re[j] * w_im + im[j] * w_re;
+				re[j] = re[i] - t_re;
+				im[j] = im[i] - t_im;
+				re[i] += t_re;
+				im[i] += t_im;
+			}
+		}
+	}
+}
+
+/*
+ * Fill an RX transfer with the spectrum record of one dwell, as the firmware
+ * computes it, returning its length. The device sends each record in a short
+ * transfer of its own.
+ */
+static int generate_spectrum(hackrf_emulator* emulator, unsigned char* buffer, int length)
+{
+	const uint32_t fft_size = emulator->spectrum_fft_size;
+	const int record_length =
+		HACKRF_SPECTRUM_HEADER_LENGTH + (int) (fft_size * sizeof(int16_t));
+	const int8_t* segment;
+	const int8_t* end;
+	double re[HACKRF_SPECTRUM_MAX_FFT_SIZE];
+	double im[HACKRF_SPECTRUM_MAX_FFT_SIZE];
+	double window, level;
+	uint32_t i, bin;
+	uint32_t averaged = 0;
+	int16_t value;
+
+	if (length < record_length) {
+		return 0;
+	}
+	for (i = 0; i < fft_size; i++) {
+		emulator->spectrum_power[i] = 0;
+	}
+	write_sweep_header(emulator, buffer);
+	do {
+		sweep_block(emulator, emulator->spectrum_block, false);
+		segment = (const int8_t*) emulator->spectrum_block;
+		end = segment + emulator->sweep_block_size;
+		for (; segment + fft_size * 2 <= end; segment += fft_size * 2) {
+			// The device scales its FFT outputs by 1 / fft_size.
+			for (i = 0; i < fft_size; i++) {
+				window = 0.5 * (1 - cos(2 * M_PI * i / fft_size)) /
+					(128.0 * fft_size);
+				re[i] = segment[i * 2] * window;
+				im[i] = segment[i * 2 + 1] * window;
+			}
+			fft(re, im, fft_size);
+			for (i = 0; i < fft_size; i++) {
+				emulator->spectrum_power[i] +=
+					re[i] * re[i] + im[i] * im[i];
+			}
+			averaged++;
+		}
+	} while (emulator->sweep_blocks != 0);
+
+	buffer[14] = (averaged > UINT16_MAX) ? 0xff : averaged & 0xff;
+	buffer[15] = (averaged > UINT16_MAX) ? 0xff : averaged >> 8;
+	for (i = 0; i < fft_size; i++) {
+		bin = (i + fft_size / 2) % fft_size;
+		value = INT16_MIN;
+		if (emulator->spectrum_power[bin] > 0) {
+			level = 1000 * log10(emulator->spectrum_power[bin] / averaged);
+			if (level > INT16_MIN) {
+				value = (int16_t) lrint(level);
+			}
+		}
+		buffer[HACKRF_SPECTRUM_HEADER_LENGTH + i * 2] = value & 0xff;
+		buffer[HACKRF_SPECTRUM_HEADER_LENGTH + i * 2 + 1] = (value >> 8) & 0xff;
+	}
+	return record_length;
+}
+
+/* True in the modes that follow the sweep plan. */
+static bool sweeping(hackrf_emulator* emulator)
+{
+	return (emulator->transceiver_mode == TRANSCEIVER_MODE_RX_SWEEP) ||
+		(emulator->transceiver_mode == TRANSCEIVER_MODE_RX_SPECTRUM);
+}
+
+/* Time taken by the device to produce or consume a transfer's data. */
+static uint64_t transfer_duration_us(
+	hackrf_emulator* emulator,
+	struct libusb_transfer* transfer)
+{
+	uint64_t length = transfer->length;
+
+	if (emulator->unpaced) {
+		return 0;
+	}
+	if (emulator->transceiver_mode == TRANSCEIVER_MODE_RX_SPECTRUM) {
+		// A record takes a whole dwell.
+		length = (uint64_t) emulator->sweep_dwell_blocks *
+			emulator->sweep_block_size;
+		if (emulator->sweep_num_hops > 0) {
+			length = (uint64_t) emulator->hop_dwell[emulator->sweep_hop] *
+				emulator->sweep_block_size;
+		}
+	}
+	if (sweeping(emulator)) {
+		length = length *
+			(emulator->sweep_block_size + emulator->sweep_settle_bytes) /
+			emulator->sweep_block_size;
+	}
+	return (uint64_t) (length / stream_rate(emulator));
+}
+
+/*
+ * True if the device can make progress on a transfer: IN transfers while
+ * receiving and OUT transfers while transmitting, until the M0 gives up.
+ */
+static bool transfer_ready(hackrf_emulator* emulator, struct libusb_transfer* transfer)
+{
+	bool ready;
+
+	if (transfer->endpoint & LIBUSB_ENDPOINT_IN) {
+		ready = (emulator->transceiver_mode == HACKRF_TRANSCEIVER_MODE_RECEIVE) ||
+			sweeping(emulator);
+	} else {
+		ready = emulator->transceiver_mode == HACKRF_TRANSCEIVER_MODE_TRANSMIT;
+	}
+	return ready && (emulator->m0.active_mode != M0_MODE_IDLE);
+}
+
+/*
+ * Produce or consume the data for a transfer that is now due, returning the
+ * length transferred.
+ */
+static int run_transfer(
+	hackrf_emulator* emulator,
+	struct libusb_transfer* transfer,
+	uint64_t due_us,
+	uint64_t now_us)
+{
+	const bool rx = (transfer->endpoint & LIBUSB_ENDPOINT_IN) != 0;
+	const uint64_t buffer_us = emulator->unpaced ?
+		0 :
+		(uint64_t) (EMULATOR_BUFFER_SIZE / stream_rate(emulator));
+	uint64_t lost = 0;
+	int actual_length = transfer->length;
+
+	emulator->transfers++;
+	emulator->due_us = due_us;
+
+	// If the host came back for this transfer later than the M0 buffer
+	// could cover, the data in between was lost.
+	if (!emulator->unpaced && (now_us > due_us + buffer_us)) {
+		lost = (uint64_t) ((now_us - due_us - buffer_us) * stream_rate(emulator));
+		emulator->due_us = now_us - buffer_us;
+	}
+
+	if (rx) {
+		if ((emulator->overrun_every != 0) &&
+		    (emulator->transfers % emulator->overrun_every == 0)) {
+			lost += transfer->length;
+		}
+		if (lost > 0) {
+			skip(emulator, lost);
+			record_shortfall(emulator, lost, true);
+		}
+		if (emulator->transceiver_mode == TRANSCEIVER_MODE_RX_SWEEP) {
+			generate_sweep(emulator, transfer->buffer, transfer->length);
+		} else if (emulator->transceiver_mode == TRANSCEIVER_MODE_RX_SPECTRUM) {
+			actual_length = generate_spectrum(
+				emulator,
+				transfer->buffer,
+				transfer->length);
+		} else {
+			generate(emulator, transfer->buffer, transfer->length);
+		}
+	} else {
+		if ((emulator->underrun_every != 0) &&
+		    (emulator->transfers % emulator->underrun_every == 0)) {
+			lost += transfer->length;
+		}
+		if (lost > 0) {
+			record_shortfall(emulator, lost, false);
+		}
+		if (emulator->tx_file != NULL) {
+			fwrite(transfer->buffer, 1, transfer->length, emulator->tx_file);
+		}
+	}
+
+	if (!sweeping(emulator)) {
+		emulator->m0.m0_count += transfer->length;
+	}
+	emulator->m0.m4_count += actual_length;
+	return actual_length;
+}
+
+/* Index of the first cancelled transfer, or pending_count if there is none. */
+static uint32_t first_cancelled(hackrf_emulator* emulator)
+{
+	uint32_t i;
+
+	for (i = 0; i < emulator->pending_count; i++) {
+		if (emulator->pending[i].cancelled) {
+			break;
+		}
+	}
+	return i;
+}
+
+static void* emulator_threadproc(void* arg)
+{
+	hackrf_emulator* emulator = (hackrf_emulator*) arg;
+	struct libusb_transfer* transfer;
+	uint64_t now_us, due_us = 0;
+	uint32_t index;
+	bool cancelled, stall;
+
+	pthread_mutex_lock(&emulator->lock);
+	while (!emulator->exit) {
+		if (emulator->pending_count == 0) {
+			pthread_cond_wait(&emulator->cv, &emulator->lock);
+			continue;
+		}
+
+		// Cancelled transfers finish straight away, wherever they are
+		// in the queue. Others complete in order, when their data is due.
+		index = first_cancelled(emulator);
+		cancelled = index < emulator->pending_count;
+		now_us = emulator_now_us();
+		if (!cancelled) {
+			index = 0;
+			transfer = emulator->pending[0].transfer;
+			if (!transfer_ready(emulator, transfer)) {
+				pthread_cond_wait(&emulator->cv, &emulator->lock);
+				continue;
+			}
+			due_us = emulator->due_us + transfer_duration_us(emulator, transfer);
+			if (due_us > now_us) {
+				emulator_wait_us(emulator, due_us - now_us);
+				continue;
+			}
+		}
+
+		transfer = emulator->pending[index].transfer;
+		emulator->pending_count--;
+		memmove(&emulator->pending[index],
+			&emulator->pending[index + 1],
+			(emulator->pending_count - index) * sizeof(emulator->pending[0]));
+
+		stall = false;
+		if (cancelled) {
+			transfer->status = LIBUSB_TRANSFER_CANCELLED;
+			transfer->actual_length = 0;
+		} else {
+			transfer->actual_length =
+				run_transfer(emulator, transfer, due_us, now_us);
+			transfer->status = LIBUSB_TRANSFER_COMPLETED;
+			stall = (emulator->stall_every != 0) &&
+				(emulator->transfers % emulator->stall_every == 0);
+		}
+
+		// The callback may submit or cancel transfers, so call it unlocked.
+		pthread_mutex_unlock(&emulator->lock);
+		if (stall) {
+			emulator_sleep_us(emulator->stall_us);
+		}
+		transfer->callback(transfer);
+		pthread_mutex_lock(&emulator->lock);
+	}
+	pthread_mutex_unlock(&emulator->lock);
+
+	return NULL;
+}
+
+static void set_transceiver_mode(hackrf_emulator* emulator, uint8_t mode)
+{
+	emulator->transceiver_mode = mode;
+	emulator->due_us = emulator_now_us();
+
+	/* Counters survive a stop so that they can be read back afterwards. */
+	if (mode != HACKRF_TRANSCEIVER_MODE_OFF) {
+		memset(&emulator->m0, 0, sizeof(emulator->m0));
+	}
+	emulator->m0.requested_mode = mode;
+	switch (mode) {
+	case HACKRF_TRANSCEIVER_MODE_RECEIVE:
+	case TRANSCEIVER_MODE_RX_SWEEP:
+	case TRANSCEIVER_MODE_RX_SPECTRUM:
+		emulator->m0.active_mode = M0_MODE_RX;
+		emulator->m0.shortfall_limit = emulator->rx_overrun_limit;
+		break;
+	case HACKRF_TRANSCEIVER_MODE_TRANSMIT:
+		emulator->m0.active_mode = M0_MODE_TX_RUN;
+		emulator->m0.shortfall_limit = emulator->tx_underrun_limit;
+		break;
+	default:
+		emulator->m0.active_mode = M0_MODE_IDLE;
+		break;
+	}
+
+	if (sweeping(emulator)) {
+		emulator->sweep_range = 0;
+		emulator->sweep_odd = true;
+		emulator->sweep_blocks = 0;
+		emulator->sweep_freq = (uint64_t) emulator->sweep_frequencies[0] * 1000000;
+		emulator->sweep_hop = 0;
+		if (emulator->sweep_num_hops > 0) {
+			emulator->sweep_freq = emulator->hop_freqs[0];
+		}
+	}
+
+	pthread_cond_broadcast(&emulator->cv);
+}
+
+static uint32_t get_le32(const unsigned char* data)
+{
+	return (uint32_t) data[0] | ((uint32_t) data[1] << 8) |
+		((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+static uint64_t get_le64(const unsigned char* data)
+{
+	return ((uint64_t) get_le32(&data[4]) << 32) | get_le32(&data[0]);
+}
+
+/* Copy a reply into the IN data stage, returning its length. */
+static int reply(unsigned char* data, uint16_t length, const void* value, size_t size)
+{
+	if (size > length) {
+		size = length;
+	}
+	if (size > 0) {
+		memcpy(data, value, size);
+	}
+	return (int) size;
+}
+
+static int reply_u8(unsigned char* data, uint16_t length, uint8_t value)
+{
+	return reply(data, length, &value, 1);
+}
+
+static int reply_le16(unsigned char* data, uint16_t length, uint16_t value)
+{
+	unsigned char bytes[2] = {value & 0xff, value >> 8};
+	return reply(data, length, bytes, sizeof(bytes));
+}
+
+static int reply_le32(unsigned char* data, uint16_t length, uint32_t value)
+{
+	unsigned char bytes[4] = {
+		value & 0xff,
+		(value >> 8) & 0xff,
+		(value >> 16) & 0xff,
+		value >> 24};
+	return reply(data, length, bytes, sizeof(bytes));
+}
+
+/* With timed set, the plan is preceded by the block size and settle time. */
+static int init_sweep(
+	hackrf_emulator* emulator,
+	uint32_t num_bytes,
+	const unsigned char* data,
+	uint16_t length,
+	bool timed)
+{
+	const int timing_length = timed ? 8 : 0;
+	const uint16_t total_length = length;
+	uint32_t block_size = BYTES_PER_BLOCK;
+	uint32_t settle_bytes = BYTES_PER_BLOCK * EMULATOR_SWEEP_THROWAWAY;
+	uint16_t num_ranges;
+	int i;
+
+	if (length < timing_length + 9) {
+		return LIBUSB_ERROR_PIPE;
+	}
+	if (timed) {
+		block_size = get_le32(&data[0]);
+		settle_bytes = get_le32(&data[4]) * 2;
+		if ((block_size < HACKRF_SWEEP_MIN_BLOCK_SIZE) ||
+		    (block_size > BYTES_PER_BLOCK) || (block_size & (block_size - 1)) ||
+		    (settle_bytes > HACKRF_SWEEP_MAX_SETTLE_SAMPLES * 2) ||
+		    (settle_bytes % 32)) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		data += timing_length;
+		length -= timing_length;
+	}
+	if (num_bytes < block_size) {
+		return LIBUSB_ERROR_PIPE;
+	}
+	num_ranges = (length - 9) / (2 * sizeof(emulator->sweep_frequencies[0]));
+	if ((num_ranges < 1) || (num_ranges > MAX_SWEEP_RANGES) ||
+	    (get_le32(&data[0]) < 1) || (data[8] > INTERLEAVED)) {
+		return LIBUSB_ERROR_PIPE;
+	}
+
+	emulator->sweep_block_size = block_size;
+	emulator->sweep_settle_bytes = settle_bytes;
+	emulator->sweep_dwell_blocks = num_bytes / block_size;
+	emulator->sweep_num_ranges = num_ranges;
+	emulator->sweep_step_width = get_le32(&data[0]);
+	emulator->sweep_offset = get_le32(&data[4]);
+	emulator->sweep_style = data[8];
+	for (i = 0; i < num_ranges * 2; i++) {
+		emulator->sweep_frequencies[i] = data[9 + i * 2] | (data[10 + i * 2] << 8);
+	}
+	emulator->sweep_num_hops = 0;
+	emulator->freq_hz = (uint64_t) emulator->sweep_frequencies[0] * 1000000 +
+		emulator->sweep_offset;
+
+	return total_length;
+}
+
+/* Load hop table entries from index first, checked as the firmware does. */
+static int set_hop_table(
+	hackrf_emulator* emulator,
+	uint16_t first,
+	const unsigned char* data,
+	uint16_t length)
+{
+	const uint16_t count = length / EMULATOR_HOP_ENTRY_LENGTH;
+	const unsigned char* entry;
+	int i;
+
+	if ((count < 1) || (count > EMULATOR_HOP_CHUNK_ENTRIES) ||
+	    (length % EMULATOR_HOP_ENTRY_LENGTH) || (first > emulator->hops_loaded) ||
+	    (first + count > HACKRF_MAX_HOPS)) {
+		return LIBUSB_ERROR_PIPE;
+	}
+	for (i = 0; i < count; i++) {
+		entry = &data[i * EMULATOR_HOP_ENTRY_LENGTH];
+		if ((get_le64(&entry[0]) >> 48) || ((entry[8] | entry[9]) == 0)) {
+			return LIBUSB_ERROR_PIPE;
+		}
+	}
+	if (first == 0) {
+		emulator->hops_loaded = 0;
+	}
+	for (i = 0; i < count; i++) {
+		entry = &data[i * EMULATOR_HOP_ENTRY_LENGTH];
+		emulator->hop_freqs[first + i] = get_le64(&entry[0]);
+		emulator->hop_dwell[first + i] = entry[8] | (entry[9] << 8);
+	}
+	if (first + count > emulator->hops_loaded) {
+		emulator->hops_loaded = first + count;
+	}
+
+	return length;
+}
+
+/* Walk the first num_hops entries of the hop table instead of the plan. */
+static int init_hop_sweep(
+	hackrf_emulator* emulator,
+	uint16_t num_hops,
+	const unsigned char* data,
+	uint16_t length)
+{
+	uint32_t block_size, settle_bytes;
+
+	if ((num_hops < 1) || (num_hops > emulator->hops_loaded) || (length != 12)) {
+		return LIBUSB_ERROR_PIPE;
+	}
+	block_size = get_le32(&data[0]);
+	settle_bytes = get_le32(&data[4]) * 2;
+	if ((block_size < HACKRF_SWEEP_MIN_BLOCK_SIZE) || (block_size > BYTES_PER_BLOCK) ||
+	    (block_size & (block_size - 1)) ||
+	    (settle_bytes > HACKRF_SWEEP_MAX_SETTLE_SAMPLES * 2) || (settle_bytes % 32)) {
+		return LIBUSB_ERROR_PIPE;
+	}
+
+	emulator->sweep_block_size = block_size;
+	emulator->sweep_settle_bytes = settle_bytes;
+	emulator->sweep_offset = get_le32(&data[8]);
+	emulator->sweep_num_hops = num_hops;
+	emulator->freq_hz = emulator->hop_freqs[0] + emulator->sweep_offset;
+
+	return length;
+}
+
+static int write_radio_register(
+	hackrf_emulator* emulator,
+	uint16_t bank,
+	const unsigned char* data,
+	uint16_t length)
+{
+	uint64_t value = 0;
+	int i;
+
+	if ((length < 9) || (data[0] >= EMULATOR_RADIO_REGS)) {
+		return LIBUSB_ERROR_PIPE;
+	}
+	for (i = 0; i < 8; i++) {
+		value |= (uint64_t) data[1 + i] << (8 * i);
+	}
+
+	if (bank == EMULATOR_RADIO_BANK_ALL) {
+		// All banks except the applied one.
+		for (i = 1; i < EMULATOR_RADIO_BANKS; i++) {
+			emulator->radio[i][data[0]] = value;
+		}
+	} else if (bank < EMULATOR_RADIO_BANKS) {
+		emulator->radio[bank][data[0]] = value;
+	} else {
+		return LIBUSB_ERROR_PIPE;
+	}
+	return length;
+}
+
+static int vendor_request(
+	hackrf_emulator* emulator,
+	uint8_t request,
+	uint16_t value,
+	uint16_t index,
+	unsigned char* data,
+	uint16_t length)
+{
+	const uint32_t address = ((uint32_t) value << 16) | index;
+	read_partid_serialno_t partid_serialno = {
+		.part_id = {0xa000cb3c, 0x00004f43},
+		.serial_no = {0, 0, 0x656d756c, 0x61746564},
+	};
+	const char* version = "emulated";
+	hackrf_selftest selftest;
+	unsigned char platform[4];
+	uint8_t boards[HACKRF_OPERACAKE_MAX_BOARDS];
+	uint64_t radio_value;
+	int i;
+
+	switch (request) {
+	case HACKRF_VENDOR_REQUEST_SET_TRANSCEIVER_MODE:
+		switch (value) {
+		case HACKRF_TRANSCEIVER_MODE_OFF:
+		case HACKRF_TRANSCEIVER_MODE_RECEIVE:
+		case HACKRF_TRANSCEIVER_MODE_TRANSMIT:
+		case TRANSCEIVER_MODE_CPLD_UPDATE:
+			set_transceiver_mode(emulator, (uint8_t) value);
+			return 0;
+		case TRANSCEIVER_MODE_RX_SWEEP:
+		case TRANSCEIVER_MODE_RX_SPECTRUM:
+			/* There's nothing to sweep without a plan or hop table. */
+			if ((emulator->sweep_num_ranges == 0) &&
+			    (emulator->sweep_num_hops == 0)) {
+				return LIBUSB_ERROR_PIPE;
+			}
+			set_transceiver_mode(emulator, (uint8_t) value);
+			return 0;
+		default:
+			return LIBUSB_ERROR_PIPE;
+		}
+	case HACKRF_VENDOR_REQUEST_MAX283X_WRITE:
+		if (index >= 32) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		emulator->max283x[index] = value;
+		return 0;
+	case HACKRF_VENDOR_REQUEST_MAX283X_READ:
+		if (index >= 32) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		return reply_le16(data, length, emulator->max283x[index]);
+	case HACKRF_VENDOR_REQUEST_SI5351C_WRITE:
+		if (index >= 256) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		emulator->si5351c[index] = (uint8_t) value;
+		return 0;
+	case HACKRF_VENDOR_REQUEST_SI5351C_READ:
+		if (index >= 256) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		return reply_u8(data, length, emulator->si5351c[index]);
+	case HACKRF_VENDOR_REQUEST_SAMPLE_RATE_SET:
+		if ((length < 8) || (get_le32(&data[0]) == 0) ||
+		    (get_le32(&data[4]) == 0)) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		emulator->sample_rate_hz = get_le32(&data[0]);
+		emulator->sample_rate_divider = get_le32(&data[4]);
+		return length;
+	case HACKRF_VENDOR_REQUEST_BASEBAND_FILTER_BANDWIDTH_SET:
+		emulator->baseband_filter_hz = value | ((uint32_t) index << 16);
+		return 0;
+	case HACKRF_VENDOR_REQUEST_RFFC5071_WRITE:
+		if (index >= 31) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		emulator->rffc5071[index] = value;
+		return 0;
+	case HACKRF_VENDOR_REQUEST_RFFC5071_READ:
+		if (index >= 31) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		return reply_le16(data, length, emulator->rffc5071[index]);
+	case HACKRF_VENDOR_REQUEST_SPIFLASH_ERASE:
+		memset(emulator->spiflash, 0xff, EMULATOR_SPIFLASH_SIZE);
+		return 0;
+	case HACKRF_VENDOR_REQUEST_SPIFLASH_WRITE:
+		if (address + length > EMULATOR_SPIFLASH_SIZE) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		// Programming flash can only clear bits.
+		for (i = 0; i < length; i++) {
+			emulator->spiflash[address + i] &= data[i];
+		}
+		return length;
+	case HACKRF_VENDOR_REQUEST_SPIFLASH_READ:
+		if (address + length > EMULATOR_SPIFLASH_SIZE) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		return reply(data, length, &emulator->spiflash[address], length);
+	case HACKRF_VENDOR_REQUEST_BOARD_ID_READ:
+		return reply_u8(data, length, BOARD_ID_HACKRF1_R9);
+	case HACKRF_VENDOR_REQUEST_VERSION_STRING_READ:
+		return reply(data, length, version, strlen(version));
+	case HACKRF_VENDOR_REQUEST_SET_FREQ:
+		if (length < 8) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		emulator->freq_hz =
+			(uint64_t) get_le32(&data[0]) * 1000000 + get_le32(&data[4]);
+		return length;
+	case HACKRF_VENDOR_REQUEST_AMP_ENABLE:
+		emulator->amp_enable = (uint8_t) value;
+		return 0;
+	case HACKRF_VENDOR_REQUEST_BOARD_PARTID_SERIALNO_READ:
+		return reply(data, length, &partid_serialno, sizeof(partid_serialno));
+	case HACKRF_VENDOR_REQUEST_SET_LNA_GAIN:
+		if (index > 40) {
+			return reply_u8(data, length, 0);
+		}
+		emulator->lna_gain = (uint8_t) index;
+		return reply_u8(data, length, 1);
+	case HACKRF_VENDOR_REQUEST_SET_VGA_GAIN:
+		if (index > 62) {
+			return reply_u8(data, length, 0);
+		}
+		emulator->vga_gain = (uint8_t) index;
+		return reply_u8(data, length, 1);
+	case HACKRF_VENDOR_REQUEST_SET_TXVGA_GAIN:
+		if (index > 47) {
+			return reply_u8(data, length, 0);
+		}
+		emulator->txvga_gain = (uint8_t) index;
+		return reply_u8(data, length, 1);
+	case HACKRF_VENDOR_REQUEST_ANTENNA_ENABLE:
+		emulator->antenna_enable = (uint8_t) value;
+		return 0;
+	case HACKRF_VENDOR_REQUEST_INIT_SWEEP:
+	case HACKRF_VENDOR_REQUEST_INIT_SWEEP_TIMED:
+		return init_sweep(
+			emulator,
+			((uint32_t) index << 16) | value,
+			data,
+			length,
+			request == HACKRF_VENDOR_REQUEST_INIT_SWEEP_TIMED);
+	case HACKRF_VENDOR_REQUEST_INIT_SPECTRUM:
+		if ((value < HACKRF_SPECTRUM_MIN_FFT_SIZE) ||
+		    (value > HACKRF_SPECTRUM_MAX_FFT_SIZE) || (value & (value - 1))) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		emulator->spectrum_fft_size = value;
+		return 0;
+	case HACKRF_VENDOR_REQUEST_SET_HOP_TABLE:
+		return set_hop_table(emulator, value, data, length);
+	case HACKRF_VENDOR_REQUEST_INIT_HOP_SWEEP:
+		return init_hop_sweep(emulator, value, data, length);
+	case HACKRF_VENDOR_REQUEST_OPERACAKE_GET_BOARDS:
+		// No Opera Cakes attached.
+		memset(boards, HACKRF_OPERACAKE_ADDRESS_INVALID, sizeof(boards));
+		return reply(data, length, boards, sizeof(boards));
+	case HACKRF_VENDOR_REQUEST_SET_HW_SYNC_MODE:
+		emulator->hw_sync_mode = (uint8_t) value;
+		return 0;
+	case HACKRF_VENDOR_REQUEST_RESET:
+		reset_state(emulator);
+		pthread_cond_broadcast(&emulator->cv);
+		return 0;
+	case HACKRF_VENDOR_REQUEST_CLKOUT_ENABLE:
+		emulator->clkout_enable = (uint8_t) value;
+		return 0;
+	case HACKRF_VENDOR_REQUEST_SPIFLASH_STATUS:
+		return reply_le16(data, length, 0);
+	case HACKRF_VENDOR_REQUEST_OPERACAKE_GPIO_TEST:
+		return reply_le16(data, length, 0);
+	case HACKRF_VENDOR_REQUEST_CPLD_CHECKSUM:
+		return reply_le32(data, length, 0xa0f1b2c3);
+	case HACKRF_VENDOR_REQUEST_UI_ENABLE:
+		emulator->ui_enable = (uint8_t) value;
+		return 0;
+	case HACKRF_VENDOR_REQUEST_OPERACAKE_SET_MODE:
+		if (value >= HACKRF_OPERACAKE_MAX_BOARDS) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		emulator->operacake_mode[value] = (uint8_t) index;
+		return 0;
+	case HACKRF_VENDOR_REQUEST_OPERACAKE_GET_MODE:
+		if (value >= HACKRF_OPERACAKE_MAX_BOARDS) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		return reply_u8(data, length, emulator->operacake_mode[value]);
+	case HACKRF_VENDOR_REQUEST_GET_M0_STATE:
+		return reply(data, length, &emulator->m0, sizeof(emulator->m0));
+	case HACKRF_VENDOR_REQUEST_SET_TX_UNDERRUN_LIMIT:
+		emulator->tx_underrun_limit = value | ((uint32_t) index << 16);
+		return 0;
+	case HACKRF_VENDOR_REQUEST_SET_RX_OVERRUN_LIMIT:
+		emulator->rx_overrun_limit = value | ((uint32_t) index << 16);
+		return 0;
+	case HACKRF_VENDOR_REQUEST_GET_CLKIN_STATUS:
+		return reply_u8(data, length, 0);
+	case HACKRF_VENDOR_REQUEST_BOARD_REV_READ:
+		return reply_u8(data, length, BOARD_REV_HACKRF1_R10 | HACKRF_BOARD_REV_GSG);
+	case HACKRF_VENDOR_REQUEST_SUPPORTED_PLATFORM_READ:
+		// Sent most significant byte first.
+		platform[0] = 0;
+		platform[1] = 0;
+		platform[2] = 0;
+		platform[3] = HACKRF_PLATFORM_HACKRF1_OG | HACKRF_PLATFORM_HACKRF1_R9;
+		return reply(data, length, platform, sizeof(platform));
+	case HACKRF_VENDOR_REQUEST_SET_LEDS:
+		emulator->leds = (uint8_t) value;
+		return 0;
+	case HACKRF_VENDOR_REQUEST_FPGA_WRITE_REG:
+		if (index >= 256) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		emulator->fpga[index] = (uint8_t) value;
+		return 0;
+	case HACKRF_VENDOR_REQUEST_FPGA_READ_REG:
+		if (index >= 256) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		return reply_u8(data, length, emulator->fpga[index]);
+	case HACKRF_VENDOR_REQUEST_READ_SELFTEST:
+		memset(&selftest, 0, sizeof(selftest));
+		selftest.pass = true;
+		return reply(data, length, &selftest, sizeof(selftest));
+	case HACKRF_VENDOR_REQUEST_READ_ADC:
+		// Mid-scale reading from the 10-bit ADC.
+		return reply_le16(data, length, 512);
+	case HACKRF_VENDOR_REQUEST_TEST_RTC_OSC:
+		if (length > 0) {
+			// The frequency monitor counts one edge: the oscillator runs.
+			return reply_le16(data, length, 1);
+		}
+		return 0;
+	case HACKRF_VENDOR_REQUEST_RADIO_WRITE_REG:
+		return write_radio_register(emulator, index, data, length);
+	case HACKRF_VENDOR_REQUEST_RADIO_READ_REG:
+		if ((index >= EMULATOR_RADIO_BANKS) || (value >= EMULATOR_RADIO_REGS)) {
+			return LIBUSB_ERROR_PIPE;
+		}
+		radio_value = emulator->radio[index][value];
+		for (i = 0; (i < 8) && (i < length); i++) {
+			data[i] = (radio_value >> (8 * i)) & 0xff;
+		}
+		return i;
+	case HACKRF_VENDOR_REQUEST_GET_BUFFER_SIZE:
+		return reply_le32(data, length, EMULATOR_BUFFER_SIZE);
+	case HACKRF_VENDOR_REQUEST_SET_FREQ_EXPLICIT:
+	case HACKRF_VENDOR_REQUEST_USB_WCID_VENDOR_REQ:
+	case HACKRF_VENDOR_REQUEST_OPERACAKE_SET_PORTS:
+	case HACKRF_VENDOR_REQUEST_OPERACAKE_SET_RANGES:
+	case HACKRF_VENDOR_REQUEST_OPERACAKE_SET_DWELL_TIMES:
+	case HACKRF_VENDOR_REQUEST_OPERACAKE_SET_SWEEP_PORTS:
+	case HACKRF_VENDOR_REQUEST_SPIFLASH_CLEAR_STATUS:
+	case HACKRF_VENDOR_REQUEST_SET_USER_BIAS_T_OPTS:
+	case HACKRF_VENDOR_REQUEST_P1_CTRL:
+	case HACKRF_VENDOR_REQUEST_P2_CTRL:
+	case HACKRF_VENDOR_REQUEST_SET_NARROWBAND_FILTER:
+	case HACKRF_VENDOR_REQUEST_SET_FPGA_BITSTREAM:
+	case HACKRF_VENDOR_REQUEST_CLKIN_CTRL:
+		// Accepted, but with no effect on the emulated device.
+		return length;
+	default:
+		return LIBUSB_ERROR_PIPE;
+	}
+}
+
+static int parse_uint(const char* value, uint32_t* result)
+{
+	char* end;
+	unsigned long parsed = strtoul(value, &end, 0);
+
+	if ((end == value) || (*end != '\0')) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+	*result = (uint32_t) parsed;
+	return HACKRF_SUCCESS;
+}
+
+static int parse_double(const char* value, double* result)
+{
+	char* end;
+	double parsed = strtod(value, &end);
+
+	if ((end == value) || (*end != '\0') || (parsed < 0)) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+	*result = parsed;
+	return HACKRF_SUCCESS;
+}
+
+static int set_option(hackrf_emulator* emulator, const char* key, const char* value)
+{
+	if (strcmp(key, "signal") == 0) {
+		if (strcmp(value, "tone") == 0) {
+			emulator->signal = EMULATOR_SIGNAL_TONE;
+		} else if (strcmp(value, "noise") == 0) {
+			emulator->signal = EMULATOR_SIGNAL_NOISE;
+		} else if (strcmp(value, "counter") == 0) {
+			emulator->signal = EMULATOR_SIGNAL_COUNTER;
+		} else if (strcmp(value, "zero") == 0) {
+			emulator->signal = EMULATOR_SIGNAL_ZERO;
+		} else {
+			return HACKRF_ERROR_INVALID_PARAM;
+		}
+		return HACKRF_SUCCESS;
+	} else if (strcmp(key, "tone") == 0) {
+		return parse_double(value, &emulator->tone_hz);
+	} else if (strcmp(key, "file") == 0) {
+		emulator->rx_file = fopen(value, "rb");
+		if (emulator->rx_file == NULL) {
+			return HACKRF_ERROR_INVALID_PARAM;
+		}
+		emulator->signal = EMULATOR_SIGNAL_FILE;
+		return HACKRF_SUCCESS;
+	} else if (strcmp(key, "tx_file") == 0) {
+		emulator->tx_file = fopen(value, "wb");
+		return (emulator->tx_file != NULL) ? HACKRF_SUCCESS :
+						     HACKRF_ERROR_INVALID_PARAM;
+	} else if (strcmp(key, "rate") == 0) {
+		if (strcmp(value, "max") == 0) {
+			emulator->unpaced = true;
+			return HACKRF_SUCCESS;
+		}
+		return parse_double(value, &emulator->rate);
+	} else if (strcmp(key, "overrun") == 0) {
+		return parse_uint(value, &emulator->overrun_every);
+	} else if (strcmp(key, "underrun") == 0) {
+		return parse_uint(value, &emulator->underrun_every);
+	} else if (strcmp(key, "stall") == 0) {
+		return parse_uint(value, &emulator->stall_every);
+	} else if (strcmp(key, "stall_us") == 0) {
+		return parse_uint(value, &emulator->stall_us);
+	}
+
+	return HACKRF_ERROR_INVALID_PARAM;
+}
+
+/* Apply the options given in HACKRF_EMULATOR, if any. */
+static int parse_options(hackrf_emulator* emulator)
+{
+	const char* options = getenv("HACKRF_EMULATOR");
+	char option[256];
+	char* value;
+	size_t length;
+	int result;
+
+	while ((options != NULL) && (*options != '\0')) {
+		length = strcspn(options, ",");
+		if (length >= sizeof(option)) {
+			return HACKRF_ERROR_INVALID_PARAM;
+		}
+		memcpy(option, options, length);
+		option[length] = '\0';
+		options += length;
+		if (*options == ',') {
+			options++;
+		}
+
+		// Options without a value, such as "1", just enable the emulator.
+		value = strchr(option, '=');
+		if (value == NULL) {
+			continue;
+		}
+		*value++ = '\0';
+		result = set_option(emulator, option, value);
+		if (result != HACKRF_SUCCESS) {
+			return result;
+		}
+	}
+
+	return HACKRF_SUCCESS;
+}
+
+bool hackrf_emulator_enabled(void)
+{
+	const char* options = getenv("HACKRF_EMULATOR");
+
+	return (options != NULL) && (*options != '\0') && (strcmp(options, "0") != 0);
+}
+
+/* Free an emulator whose thread isn't running. */
+static void free_emulator(hackrf_emulator* emulator)
+{
+	if (emulator->rx_file != NULL) {
+		fclose(emulator->rx_file);
+	}
+	if (emulator->tx_file != NULL) {
+		fclose(emulator->tx_file);
+	}
+	free(emulator->pending);
+	free(emulator->spiflash);
+	free(emulator);
+}
+
+int hackrf_emulator_open(hackrf_emulator** emulator)
+{
+	hackrf_emulator* lib_emulator;
+	int result;
+
+	lib_emulator = (hackrf_emulator*) calloc(1, sizeof(*lib_emulator));
+	if (lib_emulator == NULL) {
+		return HACKRF_ERROR_NO_MEM;
+	}
+
+	lib_emulator->spiflash = (unsigned char*) malloc(EMULATOR_SPIFLASH_SIZE);
+	if (lib_emulator->spiflash == NULL) {
+		free_emulator(lib_emulator);
+		return HACKRF_ERROR_NO_MEM;
+	}
+	memset(lib_emulator->spiflash, 0xff, EMULATOR_SPIFLASH_SIZE);
+
+	lib_emulator->signal = EMULATOR_SIGNAL_TONE;
+	lib_emulator->tone_hz = EMULATOR_DEFAULT_TONE_HZ;
+	lib_emulator->stall_us = EMULATOR_DEFAULT_STALL_US;
+	lib_emulator->tone_re = 1.0f;
+	lib_emulator->tone_im = 0.0f;
+	lib_emulator->noise_state = 0x12345678;
+	reset_state(lib_emulator);
+
+	result = parse_options(lib_emulator);
+	if (result != HACKRF_SUCCESS) {
+		free_emulator(lib_emulator);
+		return result;
+	}
+
+	if (pthread_mutex_init(&lib_emulator->lock, NULL) != 0) {
+		free_emulator(lib_emulator);
+		return HACKRF_ERROR_THREAD;
+	}
+	if (pthread_cond_init(&lib_emulator->cv, NULL) != 0) {
+		pthread_mutex_destroy(&lib_emulator->lock);
+		free_emulator(lib_emulator);
+		return HACKRF_ERROR_THREAD;
+	}
+	if (pthread_create(&lib_emulator->thread, 0, emulator_threadproc, lib_emulator) !=
+	    0) {
+		pthread_cond_destroy(&lib_emulator->cv);
+		pthread_mutex_destroy(&lib_emulator->lock);
+		free_emulator(lib_emulator);
+		return HACKRF_ERROR_THREAD;
+	}
+
+	*emulator = lib_emulator;
+	return HACKRF_SUCCESS;
+}
+
+void hackrf_emulator_close(hackrf_emulator* emulator)
+{
+	void* value;
+
+	pthread_mutex_lock(&emulator->lock);
+	emulator->exit = true;
+	pthread_cond_broadcast(&emulator->cv);
+	pthread_mutex_unlock(&emulator->lock);
+
+	value = NULL;
+	pthread_join(emulator->thread, &value);
+
+	pthread_cond_destroy(&emulator->cv);
+	pthread_mutex_destroy(&emulator->lock);
+	free_emulator(emulator);
+}
+
+uint16_t hackrf_emulator_usb_api_version(void)
+{
+	return EMULATOR_USB_API_VERSION;
+}
+
+int hackrf_emulator_control_transfer(
+	hackrf_emulator* emulator,
+	uint8_t request_type,
+	uint8_t request,
+	uint16_t value,
+	uint16_t index,
+	unsigned char* data,
+	uint16_t length)
+{
+	int result;
+
+	if ((request_type & LIBUSB_REQUEST_TYPE_VENDOR) == 0) {
+		return LIBUSB_ERROR_PIPE;
+	}
+
+	pthread_mutex_lock(&emulator->lock);
+	result = vendor_request(emulator, request, value, index, data, length);
+	pthread_mutex_unlock(&emulator->lock);
+
+	return result;
+}
+
+int hackrf_emulator_bulk_transfer(
+	hackrf_emulator* emulator,
+	unsigned char endpoint,
+	unsigned char* data,
+	int length,
+	int* transferred)
+{
+	(void) emulator;
+	(void) data;
+
+	// Only used to send the CPLD bitstream, which is accepted and ignored.
+	if (endpoint & LIBUSB_ENDPOINT_IN) {
+		return LIBUSB_ERROR_NOT_SUPPORTED;
+	}
+	*transferred = length;
+	return LIBUSB_SUCCESS;
+}
+
+int hackrf_emulator_submit_transfer(
+	hackrf_emulator* emulator,
+	struct libusb_transfer* transfer)
+{
+	struct pending_transfer* pending;
+	uint32_t capacity;
+	int result = LIBUSB_SUCCESS;
+
+	pthread_mutex_lock(&emulator->lock);
+	if (emulator->pending_count == emulator->pending_capacity) {
+		capacity = (emulator->pending_capacity > 0) ?
+			emulator->pending_capacity * 2 :
+			16;
+		pending = (struct pending_transfer*) realloc(
+			emulator->pending,
+			capacity * sizeof(*pending));
+		if (pending == NULL) {
+			result = LIBUSB_ERROR_NO_MEM;
+		} else {
+			emulator->pending = pending;
+			emulator->pending_capacity = capacity;
+		}
+	}
+	if (result == LIBUSB_SUCCESS) {
+		emulator->pending[emulator->pending_count].transfer = transfer;
+		emulator->pending[emulator->pending_count].cancelled = false;
+		emulator->pending_count++;
+		pthread_cond_broadcast(&emulator->cv);
+	}
+	pthread_mutex_unlock(&emulator->lock);
+
+	return result;
+}
+
+int hackrf_emulator_cancel_transfer(
+	hackrf_emulator* emulator,
+	struct libusb_transfer* transfer)
+{
+	uint32_t i;
+	int result = LIBUSB_ERROR_NOT_FOUND;
+
+	pthread_mutex_lock(&emulator->lock);
+	for (i = 0; i < emulator->pending_count; i++) {
+		if ((emulator->pending[i].transfer == transfer) &&
+		    !emulator->pending[i].cancelled) {
+			emulator->pending[i].cancelled = true;
+			pthread_cond_broadcast(&emulator->cv);
+			result = LIBUSB_SUCCESS;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&emulator->lock);
+
+	return result;
+}
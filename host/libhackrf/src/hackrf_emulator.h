@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2026 Great Scott Gadgets <info@greatscottgadgets.com>
+
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+	documentation and/or other materials provided with the distribution.
+    Neither the name of Great Scott Gadgets nor the names of its contributors may be used to endorse or promote products derived from this software
+	without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Software stand-in for a HackRF One, used in place of the USB device when
+ * no hardware is available. Not installed.
+ *
+ * The functions mirror the libusb calls made by libhackrf and return the
+ * same values libusb would: a byte count or a LIBUSB_ERROR_* code.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <libusb.h>
+
+typedef struct hackrf_emulator hackrf_emulator;
+
+/* True if the HACKRF_EMULATOR environment variable selects the emulator. */
+bool hackrf_emulator_enabled(void);
+
+/* Create an emulated device and start its thread. Returns a hackrf_error. */
+int hackrf_emulator_open(hackrf_emulator** emulator);
+
+/* Stop the emulator thread and free the device. No transfers may be pending. */
+void hackrf_emulator_close(hackrf_emulator* emulator);
+
+/* USB API version reported as bcdDevice by the emulated device. */
+uint16_t hackrf_emulator_usb_api_version(void);
+
+int hackrf_emulator_control_transfer(
+	hackrf_emulator* emulator,
+	uint8_t request_type,
+	uint8_t request,
+	uint16_t value,
+	uint16_t index,
+	unsigned char* data,
+	uint16_t length);
+
+int hackrf_emulator_bulk_transfer(
+	hackrf_emulator* emulator,
+	unsigned char endpoint,
+	unsigned char* data,
+	int length,
+	int* transferred);
+
+/*
+ * Queue an asynchronous transfer. Its callback is called from the emulator
+ * thread, in submission order, as the emulated device completes it.
+ */
+int hackrf_emulator_submit_transfer(
+	hackrf_emulator* emulator,
+	struct libusb_transfer* transfer);
+
+int hackrf_emulator_cancel_transfer(
+	hackrf_emulator* emulator,
+	struct libusb_transfer* transfer);
@@ -0,0 +1,1116 @@
+/*
+Copyright (c) 2026 Great Scott Gadgets <info@greatscottgadgets.com>
+
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+	documentation and/or other materials provided with the distribution.
+    Neither the name of Great Scott Gadgets nor the names of its contributors may be used to endorse or promote products derived from this software
+	without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Sweep engine: the sweep mode DSP of hackrf_sweep as a library.
+ *
+ * rx_callback copies the blocks of each transfer into the next free job in a
+ * ring, a pool of FFT worker threads transforms each job's blocks as one
+ * batch, in any order, and a delivery thread passes the rows of the jobs to
+ * the application in the order they were queued.
+ */
+
+#define _USE_MATH_DEFINES
+#include "hackrf_sweep_engine.h"
+
+#include <fftw3.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/time.h>
+	#include <unistd.h>
+#endif
+
+#ifndef M_PI
+	#define M_PI 3.14159265358979323846
+#endif
+
+#define FREQ_ONE_MHZ (1000000ull)
+#define FREQ_MAX_MHZ (7250) /* 7250 MHz */
+
+#define SAMPLE_RATE_HZ (20000000)
+#define TUNE_STEP      (SAMPLE_RATE_HZ / FREQ_ONE_MHZ)
+#define OFFSET         7500000
+
+#define MIN_FFT_SIZE 4
+/*
+ * Each block consists of 16384 bytes minus up to 14 bytes for the header,
+ * leaving room for 8185 two-byte samples, and the largest odd multiple of four
+ * that fits is 8180.
+ */
+#define MAX_FFT_SIZE 8180
+
+/*
+ * Each block starts with 0x7F 0x7F and the tuned frequency. From USB API
+ * version 0x0113, the M0 byte count at the start of the block follows.
+ */
+#define BLOCK_HEADER_LENGTH     HACKRF_SWEEP_HEADER_LENGTH
+#define BLOCK_COUNT_API_VERSION 0x0113
+
+/* Samples after the header of each block. */
+#define BLOCK_PAYLOAD_SAMPLES(block_size) (((block_size) - BLOCK_HEADER_LENGTH) / 2)
+#define MAX_DWELL_BLOCKS      1024
+
+#define SWEEP_QUEUE_DEPTH 16 /* minimum number of jobs */
+
+typedef enum {
+	JOB_FREE,
+	JOB_QUEUED,
+	JOB_BUSY,
+	JOB_DONE,
+} job_state_t;
+
+typedef struct {
+	/* A sweep completed before this entry. */
+	bool end_of_sweep;
+	/* False for entries that only mark the end of a sweep. */
+	bool has_block;
+	/* Index of the entry's block within the job. */
+	int block;
+	uint64_t frequency;   /* in Hz */
+	int64_t time;         /* in us since the Unix epoch */
+	uint64_t device_time; /* in ns since the Unix epoch, 0 if unknown */
+	uint32_t num_samples; /* analyzed for the block */
+} sweep_entry_t;
+
+typedef struct {
+	job_state_t state;
+	int num_entries;
+	int num_blocks;
+	sweep_entry_t* entries;
+	int8_t* blocks;          /* blocks_per_job blocks or records */
+	float* pwr;              /* fft_size per block */
+	fftwf_complex* spectrum; /* fft_stride per block, only with config.spectrum */
+} sweep_job_t;
+
+typedef struct {
+	hackrf_sweep_engine* engine;
+	pthread_t thread;
+	bool started;
+	fftwf_complex* fftwIn;
+	fftwf_complex* fftwOut;
+	/* Transforms a whole job of blocks at once. */
+	fftwf_plan batchPlan;
+	/* Transforms one block, for jobs from partly filled transfers. */
+	fftwf_plan fftwPlan;
+} fft_worker_t;
+
+struct hackrf_sweep_engine {
+	hackrf_device* device;
+	hackrf_sweep_config config;
+	bool started;
+	bool stopped;
+	volatile bool done;
+
+	float* window;
+	int segments_per_block;
+	/* Length of each transfer with config.device_spectrum. */
+	uint32_t record_length;
+	int blocks_per_job;
+	int max_entries;
+	/* Distance between transforms in FFT buffers, padded to keep each aligned. */
+	int fft_stride;
+
+	fft_worker_t* workers;
+	pthread_t delivery;
+	bool delivery_started;
+	sweep_job_t* jobs;
+	int num_jobs;
+	uint64_t job_head; /* next job to queue */
+	uint64_t job_next; /* next job for a worker */
+	uint64_t job_tail; /* next job to deliver */
+	bool pool_stopping;
+	pthread_mutex_t pool_lock;
+	pthread_cond_t job_queued_cv;
+	pthread_cond_t job_done_cv;
+	pthread_cond_t job_free_cv;
+
+	/* rx_callback state */
+	volatile uint64_t byte_count;
+	volatile uint64_t sweep_count;
+	bool sweep_started;
+	uint64_t last_frequency;
+	int64_t transfer_time;
+	/* Blocks carry the M0 byte count. */
+	bool has_block_count;
+	bool anchored;
+	uint32_t last_block_count;
+	uint64_t device_bytes; /* sampled since the first block */
+	uint64_t anchor_time;  /* of the first block, in ns since the Unix epoch */
+	uint64_t sweep_device_time;
+
+	/* Delivery thread state */
+	uint64_t sweep;
+	/* Power of the current tuning step when averaging, in linear units. */
+	float* welch_pwr;
+	float* welch_db;
+	sweep_entry_t welch_entry;
+	uint32_t welch_blocks;
+};
+
+static int64_t time_us(void)
+{
+#ifdef _WIN32
+	FILETIME ft;
+	uint64_t t;
+
+	GetSystemTimeAsFileTime(&ft);
+	t = ((uint64_t) ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+	// 100 ns intervals since 1601.
+	return (int64_t) (t / 10) - 11644473600000000LL;
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+static int num_cpus(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (int) n : 1;
+#endif
+}
+
+static int fftw_flags(enum hackrf_sweep_plan plan)
+{
+	switch (plan) {
+	case HACKRF_SWEEP_PLAN_ESTIMATE:
+		return FFTW_ESTIMATE;
+	case HACKRF_SWEEP_PLAN_PATIENT:
+		return FFTW_PATIENT;
+	case HACKRF_SWEEP_PLAN_EXHAUSTIVE:
+		return FFTW_EXHAUSTIVE;
+	default:
+		return FFTW_MEASURE;
+	}
+}
+
+/* Combine the power spectra of the segments of one block, in linear units. */
+static void combine_segments(
+	hackrf_sweep_engine* engine,
+	const fftwf_complex* out,
+	float* pwr)
+{
+	const int n = engine->config.fft_size;
+	const float scale = 1.0f / n;
+	float re, im, magsq;
+	int i, j;
+
+	memset(pwr, 0, sizeof(float) * n);
+	for (j = 0; j < engine->segments_per_block; j++, out += engine->fft_stride) {
+		for (i = 0; i < n; i++) {
+			re = out[i][0] * scale;
+			im = out[i][1] * scale;
+			magsq = re * re + im * im;
+			if (engine->config.average == HACKRF_SWEEP_AVERAGE_MEAN) {
+				pwr[i] += magsq;
+			} else if (magsq > pwr[i]) {
+				pwr[i] = magsq;
+			}
+		}
+	}
+	if (engine->config.average == HACKRF_SWEEP_AVERAGE_MEAN) {
+		for (i = 0; i < n; i++) {
+			pwr[i] /= engine->segments_per_block;
+		}
+	}
+}
+
+/* Convert the records of a job from the device, with the bins in FFT order. */
+static void convert_records(hackrf_sweep_engine* engine, sweep_job_t* job)
+{
+	const int fft_size = engine->config.fft_size;
+	const int half = fft_size / 2;
+	hackrf_spectrum_record record;
+	float* pwr;
+	float p;
+	int k, i;
+
+	for (k = 0; k < job->num_blocks; k++) {
+		pwr = job->pwr + k * fft_size;
+		hackrf_parse_spectrum_record(
+			(const uint8_t*) job->blocks + k * engine->record_length,
+			engine->record_length,
+			&record,
+			pwr);
+		// Records start at the lowest frequency, FFT output at DC.
+		for (i = 0; i < half; i++) {
+			p = pwr[i];
+			pwr[i] = pwr[i + half];
+			pwr[i + half] = p;
+		}
+	}
+}
+
+static void transform_job(fft_worker_t* worker, sweep_job_t* job)
+{
+	hackrf_sweep_engine* engine = worker->engine;
+	const int n = job->num_blocks;
+	const int fft_size = engine->config.fft_size;
+	const int fft_stride = engine->fft_stride;
+	const int segments = engine->segments_per_block;
+	const int block_stride = fft_stride * segments;
+	const uint32_t block_size = engine->config.block_size;
+	int k, j;
+
+	if (engine->config.device_spectrum) {
+		convert_records(engine, job);
+		return;
+	}
+
+	// Segments are taken backwards from the end of each block.
+	for (k = 0; k < n; k++) {
+		for (j = 0; j < segments; j++) {
+			hackrf_convert_s8_to_cf32_window(
+				job->blocks + (k + 1) * block_size -
+					(fft_size + j * (fft_size / 2)) * 2,
+				(float*) (worker->fftwIn + k * block_stride +
+					  j * fft_stride),
+				engine->window,
+				fft_size,
+				1.0f / 128.0f);
+		}
+	}
+
+	if (n == engine->blocks_per_job) {
+		fftwf_execute(worker->batchPlan);
+	} else {
+		for (k = 0; k < n; k++) {
+			fftwf_execute_dft(
+				worker->fftwPlan,
+				worker->fftwIn + k * block_stride,
+				worker->fftwOut + k * block_stride);
+		}
+	}
+
+	if (job->spectrum != NULL) {
+		memcpy(job->spectrum,
+		       worker->fftwOut,
+		       sizeof(fftwf_complex) * fft_stride * n);
+	}
+
+	for (k = 0; k < n; k++) {
+		if (engine->config.average == HACKRF_SWEEP_AVERAGE_OFF) {
+			hackrf_convert_cf32_to_db(
+				(const float*) (worker->fftwOut + k * fft_stride),
+				job->pwr + k * fft_size,
+				fft_size,
+				1.0f / fft_size,
+				engine->config.db_mode);
+		} else {
+			combine_segments(
+				engine,
+				worker->fftwOut + k * block_stride,
+				job->pwr + k * fft_size);
+		}
+	}
+}
+
+static void* fft_worker_thread(void* arg)
+{
+	fft_worker_t* worker = (fft_worker_t*) arg;
+	hackrf_sweep_engine* engine = worker->engine;
+	sweep_job_t* job;
+
+	pthread_mutex_lock(&engine->pool_lock);
+	while (true) {
+		while ((engine->job_next == engine->job_head) && !engine->pool_stopping) {
+			pthread_cond_wait(&engine->job_queued_cv, &engine->pool_lock);
+		}
+		if (engine->job_next == engine->job_head) {
+			break;
+		}
+		job = &engine->jobs[engine->job_next++ % engine->num_jobs];
+		job->state = JOB_BUSY;
+		pthread_mutex_unlock(&engine->pool_lock);
+
+		transform_job(worker, job);
+
+		pthread_mutex_lock(&engine->pool_lock);
+		job->state = JOB_DONE;
+		pthread_cond_signal(&engine->job_done_cv);
+	}
+	pthread_mutex_unlock(&engine->pool_lock);
+
+	return NULL;
+}
+
+/* Pass one tuning step to the application, pwr and spectrum are fft_size bins. */
+static void deliver_row(
+	hackrf_sweep_engine* engine,
+	const sweep_entry_t* entry,
+	const float* pwr,
+	const fftwf_complex* spectrum,
+	uint32_t num_samples)
+{
+	const int n = engine->config.fft_size;
+	hackrf_sweep_row row;
+
+	row.sweep = engine->sweep;
+	row.time = entry->time;
+	row.device_time = entry->device_time;
+	row.frequency = entry->frequency;
+	row.num_samples = num_samples;
+	row.num_bins = n / 4;
+	// The bands are the upper and lower quarters of the spectrum, less the edges.
+	row.pwr[0] = &pwr[1 + (n * 5) / 8];
+	row.pwr[1] = &pwr[1 + n / 8];
+	if (spectrum != NULL) {
+		row.spectrum[0] = (const float*) &spectrum[1 + (n * 5) / 8];
+		row.spectrum[1] = (const float*) &spectrum[1 + n / 8];
+	} else {
+		row.spectrum[0] = NULL;
+		row.spectrum[1] = NULL;
+	}
+	engine->config.row_callback(&row, engine->config.ctx);
+}
+
+static void deliver_welch(hackrf_sweep_engine* engine)
+{
+	const int n = engine->config.fft_size;
+	float scale = 1.0f;
+
+	if (engine->config.average == HACKRF_SWEEP_AVERAGE_MEAN) {
+		scale /= engine->welch_blocks;
+	}
+	hackrf_convert_f32_to_db(
+		engine->welch_pwr,
+		engine->welch_db,
+		n,
+		scale,
+		engine->config.db_mode);
+	deliver_row(
+		engine,
+		&engine->welch_entry,
+		engine->welch_db,
+		NULL,
+		engine->welch_blocks * (n + (engine->segments_per_block - 1) * (n / 2)));
+	engine->welch_blocks = 0;
+}
+
+static void add_welch_block(
+	hackrf_sweep_engine* engine,
+	const sweep_entry_t* entry,
+	const float* pwr)
+{
+	const int n = engine->config.fft_size;
+	float* welch_pwr = engine->welch_pwr;
+	int i;
+
+	// Deliver what we have if blocks of the last step were lost.
+	if ((engine->welch_blocks > 0) &&
+	    (entry->frequency != engine->welch_entry.frequency)) {
+		deliver_welch(engine);
+	}
+
+	if (engine->welch_blocks == 0) {
+		engine->welch_entry = *entry;
+		memcpy(welch_pwr, pwr, sizeof(float) * n);
+	} else {
+		for (i = 0; i < n; i++) {
+			if (engine->config.average == HACKRF_SWEEP_AVERAGE_MEAN) {
+				welch_pwr[i] += pwr[i];
+			} else if (pwr[i] > welch_pwr[i]) {
+				welch_pwr[i] = pwr[i];
+			}
+		}
+	}
+
+	if (++engine->welch_blocks == engine->config.dwell_blocks) {
+		deliver_welch(engine);
+	}
+}
+
+static void deliver_job(hackrf_sweep_engine* engine, const sweep_job_t* job)
+{
+	const hackrf_sweep_config* config = &engine->config;
+	const sweep_entry_t* entry;
+	int i;
+
+	for (i = 0; i < job->num_entries; i++) {
+		entry = &job->entries[i];
+		if (entry->end_of_sweep) {
+			if (engine->welch_blocks > 0) {
+				deliver_welch(engine);
+			}
+			if (config->sweep_callback != NULL) {
+				config->sweep_callback(engine->sweep, config->ctx);
+			}
+			engine->sweep++;
+		}
+		if (!entry->has_block) {
+			continue;
+		}
+		if (config->average != HACKRF_SWEEP_AVERAGE_OFF) {
+			add_welch_block(
+				engine,
+				entry,
+				job->pwr + entry->block * config->fft_size);
+		} else {
+			deliver_row(
+				engine,
+				entry,
+				job->pwr + entry->block * config->fft_size,
+				job->spectrum ? job->spectrum +
+						entry->block * engine->fft_stride :
+						NULL,
+				entry->num_samples);
+		}
+	}
+	if (config->transfer_callback != NULL) {
+		config->transfer_callback(config->ctx);
+	}
+}
+
+static void* delivery_thread(void* arg)
+{
+	hackrf_sweep_engine* engine = (hackrf_sweep_engine*) arg;
+	sweep_job_t* job;
+
+	pthread_mutex_lock(&engine->pool_lock);
+	while (true) {
+		job = &engine->jobs[engine->job_tail % engine->num_jobs];
+		while (((engine->job_tail == engine->job_head) ||
+			(job->state != JOB_DONE)) &&
+		       !(engine->pool_stopping &&
+			 (engine->job_tail == engine->job_head))) {
+			pthread_cond_wait(&engine->job_done_cv, &engine->pool_lock);
+		}
+		if (engine->job_tail == engine->job_head) {
+			break;
+		}
+		pthread_mutex_unlock(&engine->pool_lock);
+
+		deliver_job(engine, job);
+
+		pthread_mutex_lock(&engine->pool_lock);
+		job->state = JOB_FREE;
+		engine->job_tail++;
+		pthread_cond_signal(&engine->job_free_cv);
+	}
+	pthread_mutex_unlock(&engine->pool_lock);
+
+	return NULL;
+}
+
+/* Wait for the next job to be free. */
+static sweep_job_t* claim_job(hackrf_sweep_engine* engine)
+{
+	sweep_job_t* job;
+
+	pthread_mutex_lock(&engine->pool_lock);
+	job = &engine->jobs[engine->job_head % engine->num_jobs];
+	while (job->state != JOB_FREE) {
+		pthread_cond_wait(&engine->job_free_cv, &engine->pool_lock);
+	}
+	pthread_mutex_unlock(&engine->pool_lock);
+
+	job->num_entries = 0;
+	job->num_blocks = 0;
+	return job;
+}
+
+static void queue_job(hackrf_sweep_engine* engine, sweep_job_t* job)
+{
+	pthread_mutex_lock(&engine->pool_lock);
+	job->state = JOB_QUEUED;
+	engine->job_head++;
+	pthread_cond_signal(&engine->job_queued_cv);
+	pthread_mutex_unlock(&engine->pool_lock);
+}
+
+/*
+ * Time of the block with the given M0 byte count, in ns since the Unix epoch.
+ * The count is unwrapped and converted with the sample rate, starting from the
+ * host time the first block was received.
+ */
+static uint64_t block_device_time(hackrf_sweep_engine* engine, uint32_t block_count)
+{
+	uint64_t samples;
+
+	if (!engine->anchored) {
+		engine->anchor_time = (uint64_t) time_us() * 1000;
+		engine->anchored = true;
+	} else {
+		// Blocks arrive well within the 2^32 bytes it takes the count to wrap.
+		engine->device_bytes +=
+			(uint32_t) (block_count - engine->last_block_count);
+	}
+	engine->last_block_count = block_count;
+
+	samples = engine->device_bytes / 2;
+	return engine->anchor_time + (samples / SAMPLE_RATE_HZ) * 1000000000 +
+		(samples % SAMPLE_RATE_HZ) * 1000000000 / SAMPLE_RATE_HZ;
+}
+
+static int rx_callback(hackrf_transfer* transfer)
+{
+	hackrf_sweep_engine* engine = (hackrf_sweep_engine*) transfer->rx_ctx;
+	const hackrf_sweep_config* config = &engine->config;
+	const uint64_t first_frequency = FREQ_ONE_MHZ * config->frequencies[0];
+	// With device_spectrum, each transfer holds one record.
+	const uint32_t block_size =
+		config->device_spectrum ? engine->record_length : config->block_size;
+	int8_t* buf;
+	hackrf_sweep_header header;
+	hackrf_spectrum_record record;
+	uint32_t num_samples = config->fft_size;
+	uint64_t frequency;       /* in Hz */
+	uint64_t device_time = 0; /* in ns */
+	sweep_job_t* job;
+	sweep_entry_t* entry;
+	int j, num_blocks;
+
+	if (engine->done) {
+		return 0;
+	}
+
+	// Only set once per sweep with normalize_timestamps.
+	if ((engine->transfer_time == 0) || !config->normalize_timestamps) {
+		engine->transfer_time = time_us();
+	}
+
+	engine->byte_count += transfer->valid_length;
+	buf = (int8_t*) transfer->buffer;
+	num_blocks = transfer->valid_length / block_size;
+	if (num_blocks > engine->blocks_per_job) {
+		num_blocks = engine->blocks_per_job;
+	}
+	job = claim_job(engine);
+	for (j = 0; j < num_blocks; j++, buf += block_size) {
+		// The upper bits of the frequency field may tag the block with
+		// an Opera Cake port, which the header decoding masks off.
+		if (config->device_spectrum) {
+			if (hackrf_parse_spectrum_record(
+				    (uint8_t*) buf,
+				    block_size,
+				    &record,
+				    NULL) != HACKRF_SUCCESS) {
+				continue;
+			}
+			header = record.header;
+			num_samples = record.num_ffts * config->fft_size;
+		} else if (
+			hackrf_parse_sweep_header((uint8_t*) buf, &header) !=
+			HACKRF_SUCCESS) {
+			continue;
+		}
+		frequency = header.frequency;
+		if (engine->has_block_count) {
+			device_time = block_device_time(engine, header.byte_count);
+		}
+		// With more than one dwell block, only the first starts a sweep.
+		if ((frequency == first_frequency) &&
+		    (frequency != engine->last_frequency)) {
+			if (engine->sweep_started) {
+				entry = &job->entries[job->num_entries++];
+				entry->end_of_sweep = true;
+				entry->has_block = false;
+				engine->sweep_count++;
+
+				if (config->normalize_timestamps) {
+					// set the timestamp of the next sweep
+					engine->transfer_time = time_us();
+				}
+
+				if ((config->num_sweeps > 0) &&
+				    (engine->sweep_count == config->num_sweeps)) {
+					engine->done = true;
+				}
+			}
+			engine->sweep_started = true;
+			engine->sweep_device_time = device_time;
+		}
+		engine->last_frequency = frequency;
+		if (engine->done) {
+			break;
+		}
+		if (!engine->sweep_started) {
+			continue;
+		}
+		if ((FREQ_MAX_MHZ * FREQ_ONE_MHZ) < frequency) {
+			continue;
+		}
+		entry = &job->entries[job->num_entries++];
+		entry->end_of_sweep = false;
+		entry->has_block = true;
+		entry->block = job->num_blocks++;
+		entry->frequency = frequency;
+		entry->num_samples = num_samples;
+		if (!config->normalize_timestamps) {
+			entry->device_time = device_time;
+		} else {
+			entry->device_time = engine->sweep_device_time;
+		}
+		if (engine->has_block_count) {
+			entry->time = (int64_t) (entry->device_time / 1000);
+		} else {
+			entry->time = engine->transfer_time;
+		}
+		memcpy(job->blocks + entry->block * block_size, buf, block_size);
+	}
+
+	// A job that isn't used is left free for the next transfer.
+	if (job->num_entries > 0) {
+		queue_job(engine, job);
+	}
+	return 0;
+}
+
+static int check_config(const hackrf_sweep_config* config)
+{
+	int i;
+
+	if ((config->row_callback == NULL) || (config->num_ranges < 1) ||
+	    (config->num_ranges > MAX_SWEEP_RANGES)) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+	for (i = 0; i < config->num_ranges; i++) {
+		if ((config->frequencies[2 * i] >= config->frequencies[2 * i + 1]) ||
+		    (config->frequencies[2 * i + 1] > FREQ_MAX_MHZ)) {
+			return HACKRF_ERROR_INVALID_PARAM;
+		}
+	}
+	/*
+	 * In interleaved mode, the FFT bin selection works best if the total
+	 * number of FFT bins is equal to an odd multiple of four.
+	 */
+	if ((config->block_size < HACKRF_SWEEP_MIN_BLOCK_SIZE) ||
+	    (config->block_size > BYTES_PER_BLOCK) ||
+	    (config->block_size & (config->block_size - 1)) ||
+	    (config->settle_samples > HACKRF_SWEEP_MAX_SETTLE_SAMPLES)) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+	if ((config->num_threads < 0) || (config->dwell_blocks > MAX_DWELL_BLOCKS)) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+	// The device averages whole dwells, with its own FFT sizes.
+	if (config->device_spectrum) {
+		if ((config->fft_size < HACKRF_SPECTRUM_MIN_FFT_SIZE) ||
+		    (config->fft_size > HACKRF_SPECTRUM_MAX_FFT_SIZE) ||
+		    (config->fft_size & (config->fft_size - 1)) ||
+		    (config->average != HACKRF_SWEEP_AVERAGE_OFF) || config->spectrum) {
+			return HACKRF_ERROR_INVALID_PARAM;
+		}
+		return HACKRF_SUCCESS;
+	}
+	if ((config->fft_size < MIN_FFT_SIZE) || (config->fft_size > MAX_FFT_SIZE) ||
+	    (config->fft_size > (int) BLOCK_PAYLOAD_SAMPLES(config->block_size)) ||
+	    ((config->fft_size + 4) % 8)) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+	if ((config->average > HACKRF_SWEEP_AVERAGE_MAX) ||
+	    ((config->average == HACKRF_SWEEP_AVERAGE_OFF) &&
+	     (config->dwell_blocks > 1))) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+	if ((config->average != HACKRF_SWEEP_AVERAGE_OFF) && config->spectrum) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+	return HACKRF_SUCCESS;
+}
+
+/* Finish processing and delivery of all queued jobs, then stop the threads. */
+static void stop_pool(hackrf_sweep_engine* engine)
+{
+	int i;
+
+	pthread_mutex_lock(&engine->pool_lock);
+	engine->pool_stopping = true;
+	pthread_cond_broadcast(&engine->job_queued_cv);
+	pthread_cond_broadcast(&engine->job_done_cv);
+	pthread_mutex_unlock(&engine->pool_lock);
+
+	for (i = 0; engine->workers && (i < engine->config.num_threads); i++) {
+		if (engine->workers[i].started) {
+			pthread_join(engine->workers[i].thread, NULL);
+			engine->workers[i].started = false;
+		}
+	}
+	if (engine->delivery_started) {
+		pthread_join(engine->delivery, NULL);
+		engine->delivery_started = false;
+	}
+}
+
+static void free_engine(hackrf_sweep_engine* engine)
+{
+	int i;
+
+	if (engine->workers != NULL) {
+		for (i = 0; i < engine->config.num_threads; i++) {
+			if (engine->workers[i].batchPlan != NULL) {
+				fftwf_destroy_plan(engine->workers[i].batchPlan);
+			}
+			if (engine->workers[i].fftwPlan != NULL) {
+				fftwf_destroy_plan(engine->workers[i].fftwPlan);
+			}
+			fftwf_free(engine->workers[i].fftwIn);
+			fftwf_free(engine->workers[i].fftwOut);
+		}
+	}
+	if (engine->jobs != NULL) {
+		for (i = 0; i < engine->num_jobs; i++) {
+			free(engine->jobs[i].entries);
+			free(engine->jobs[i].blocks);
+			fftwf_free(engine->jobs[i].pwr);
+			fftwf_free(engine->jobs[i].spectrum);
+		}
+	}
+	free(engine->jobs);
+	free(engine->workers);
+	free(engine->welch_pwr);
+	free(engine->welch_db);
+	fftwf_free(engine->window);
+	pthread_cond_destroy(&engine->job_free_cv);
+	pthread_cond_destroy(&engine->job_done_cv);
+	pthread_cond_destroy(&engine->job_queued_cv);
+	pthread_mutex_destroy(&engine->pool_lock);
+	free(engine);
+}
+
+static int start_pool(hackrf_sweep_engine* engine, size_t transfer_size)
+{
+	const int num_threads = engine->config.num_threads;
+	const int plan_flags = fftw_flags(engine->config.plan);
+	int* n = &engine->config.fft_size;
+	size_t buffer_size;
+	sweep_job_t* job;
+	fft_worker_t* worker;
+	int i, num_transforms;
+
+	/*
+	 * A job holds one transfer. Each sweep block can be preceded by the end of
+	 * a sweep, and the transfer can end with one.
+	 */
+	engine->blocks_per_job = transfer_size / engine->config.block_size;
+	engine->max_entries = 2 * engine->blocks_per_job + 1;
+	engine->fft_stride = (*n + 15) & ~15;
+	num_transforms = engine->blocks_per_job * engine->segments_per_block;
+	buffer_size = sizeof(fftwf_complex) * engine->fft_stride * num_transforms;
+	engine->num_jobs = SWEEP_QUEUE_DEPTH;
+	if (engine->num_jobs < 2 * num_threads) {
+		engine->num_jobs = 2 * num_threads;
+	}
+	if (engine->blocks_per_job == 0) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+
+	engine->jobs = (sweep_job_t*) calloc(engine->num_jobs, sizeof(sweep_job_t));
+	engine->workers = (fft_worker_t*) calloc(num_threads, sizeof(fft_worker_t));
+	engine->welch_pwr = (float*) malloc(sizeof(float) * *n);
+	engine->welch_db = (float*) malloc(sizeof(float) * *n);
+	if ((engine->jobs == NULL) || (engine->workers == NULL) ||
+	    (engine->welch_pwr == NULL) || (engine->welch_db == NULL)) {
+		return HACKRF_ERROR_NO_MEM;
+	}
+	for (i = 0; i < engine->num_jobs; i++) {
+		job = &engine->jobs[i];
+		job->entries = (sweep_entry_t*)
+			calloc(engine->max_entries, sizeof(sweep_entry_t));
+		job->blocks =
+			(int8_t*) malloc(engine->blocks_per_job * engine->config.block_size);
+		job->pwr = (float*) fftwf_malloc(
+			sizeof(float) * *n * engine->blocks_per_job);
+		if ((job->entries == NULL) || (job->blocks == NULL) ||
+		    (job->pwr == NULL)) {
+			return HACKRF_ERROR_NO_MEM;
+		}
+		if (engine->config.spectrum) {
+			job->spectrum = (fftwf_complex*) fftwf_malloc(buffer_size);
+			if (job->spectrum == NULL) {
+				return HACKRF_ERROR_NO_MEM;
+			}
+		}
+	}
+
+	/* FFTW planning isn't thread safe, so plan for every worker here. */
+	for (i = 0; i < num_threads; i++) {
+		worker = &engine->workers[i];
+		worker->engine = engine;
+		// Workers only convert the device's records.
+		if (engine->config.device_spectrum) {
+			continue;
+		}
+		worker->fftwIn = (fftwf_complex*) fftwf_malloc(buffer_size);
+		worker->fftwOut = (fftwf_complex*) fftwf_malloc(buffer_size);
+		if ((worker->fftwIn == NULL) || (worker->fftwOut == NULL)) {
+			return HACKRF_ERROR_NO_MEM;
+		}
+		memset(worker->fftwIn, 0, buffer_size);
+		worker->batchPlan = fftwf_plan_many_dft(
+			1,
+			n,
+			num_transforms,
+			worker->fftwIn,
+			NULL,
+			1,
+			engine->fft_stride,
+			worker->fftwOut,
+			NULL,
+			1,
+			engine->fft_stride,
+			FFTW_FORWARD,
+			plan_flags);
+		worker->fftwPlan = fftwf_plan_many_dft(
+			1,
+			n,
+			engine->segments_per_block,
+			worker->fftwIn,
+			NULL,
+			1,
+			engine->fft_stride,
+			worker->fftwOut,
+			NULL,
+			1,
+			engine->fft_stride,
+			FFTW_FORWARD,
+			plan_flags);
+		if ((worker->batchPlan == NULL) || (worker->fftwPlan == NULL)) {
+			return HACKRF_ERROR_NO_MEM;
+		}
+		/* Execute the plans once to make sure they're ready to go when
+		 * real data starts to flow.  See issue #1366
+		*/
+		fftwf_execute(worker->batchPlan);
+		fftwf_execute(worker->fftwPlan);
+	}
+
+	for (i = 0; i < num_threads; i++) {
+		worker = &engine->workers[i];
+		if (pthread_create(&worker->thread, NULL, fft_worker_thread, worker)) {
+			return HACKRF_ERROR_THREAD;
+		}
+		worker->started = true;
+	}
+	if (pthread_create(&engine->delivery, NULL, delivery_thread, engine) != 0) {
+		return HACKRF_ERROR_THREAD;
+	}
+	engine->delivery_started = true;
+
+	return HACKRF_SUCCESS;
+}
+
+void ADDCALL hackrf_sweep_config_init(hackrf_sweep_config* config)
+{
+	memset(config, 0, sizeof(*config));
+	config->frequencies[0] = 0;
+	config->frequencies[1] = 6000;
+	config->num_ranges = 1;
+	config->fft_size = 20;
+	config->num_threads = 0;
+	config->plan = HACKRF_SWEEP_PLAN_MEASURE;
+	config->db_mode = HACKRF_DB_FAST;
+	config->average = HACKRF_SWEEP_AVERAGE_OFF;
+	config->dwell_blocks = 1;
+	config->block_size = BYTES_PER_BLOCK;
+	config->settle_samples = 0;
+	config->settle_set = false;
+}
+
+int ADDCALL hackrf_sweep_engine_create(
+	hackrf_device* device,
+	const hackrf_sweep_config* config,
+	hackrf_sweep_engine** engine_out)
+{
+	hackrf_sweep_engine* engine;
+	uint16_t* frequencies;
+	int i, n, steps, result;
+
+	if ((device == NULL) || (config == NULL) || (engine_out == NULL)) {
+		return HACKRF_ERROR_INVALID_PARAM;
+	}
+	result = check_config(config);
+	if (result != HACKRF_SUCCESS) {
+		return result;
+	}
+
+	engine = (hackrf_sweep_engine*) calloc(1, sizeof(hackrf_sweep_engine));
+	if (engine == NULL) {
+		return HACKRF_ERROR_NO_MEM;
+	}
+	engine->device = device;
+	engine->config = *config;
+	pthread_mutex_init(&engine->pool_lock, NULL);
+	pthread_cond_init(&engine->job_queued_cv, NULL);
+	pthread_cond_init(&engine->job_done_cv, NULL);
+	pthread_cond_init(&engine->job_free_cv, NULL);
+
+	/*
+	 * For each range, plan a whole number of tuning steps of a certain
+	 * bandwidth. Increase high end of range if necessary to accommodate a
+	 * whole number of steps, minimum 1.
+	 */
+	frequencies = engine->config.frequencies;
+	for (i = 0; i < engine->config.num_ranges; i++) {
+		steps = 1 + (frequencies[2 * i + 1] - frequencies[2 * i] - 1) / TUNE_STEP;
+		frequencies[2 * i + 1] =
+			(uint16_t) (frequencies[2 * i] + steps * TUNE_STEP);
+	}
+	if (engine->config.num_threads == 0) {
+		engine->config.num_threads = num_cpus();
+	}
+	if (engine->config.dwell_blocks == 0) {
+		engine->config.dwell_blocks = 1;
+	}
+
+	n = engine->config.fft_size;
+	engine->record_length = HACKRF_SPECTRUM_HEADER_LENGTH + n * sizeof(int16_t);
+	engine->segments_per_block = 1;
+	if (engine->config.average != HACKRF_SWEEP_AVERAGE_OFF) {
+		engine->segments_per_block = 1 +
+			(BLOCK_PAYLOAD_SAMPLES(engine->config.block_size) - n) / (n / 2);
+	}
+	engine->window = (float*) fftwf_malloc(sizeof(float) * n);
+	if (engine->window == NULL) {
+		free_engine(engine);
+		return HACKRF_ERROR_NO_MEM;
+	}
+	for (i = 0; i < n; i++) {
+		engine->window[i] = (float) (0.5f * (1.0f - cos(2 * M_PI * i / (n - 1))));
+	}
+
+	result = start_pool(engine, hackrf_get_transfer_buffer_size(device));
+	if (result != HACKRF_SUCCESS) {
+		stop_pool(engine);
+		free_engine(engine);
+		return result;
+	}
+
+	*engine_out = engine;
+	return HACKRF_SUCCESS;
+}
+
+int ADDCALL hackrf_sweep_engine_start(hackrf_sweep_engine* engine)
+{
+	const hackrf_sweep_config* config = &engine->config;
+	uint16_t usb_api_version;
+	uint32_t settle_samples;
+	int result;
+
+	if (engine->started) {
+		return HACKRF_ERROR_BUSY;
+	}
+	result = hackrf_usb_api_version_read(engine->device, &usb_api_version);
+	if (result != HACKRF_SUCCESS) {
+		return result;
+	}
+	engine->has_block_count = usb_api_version >= BLOCK_COUNT_API_VERSION;
+	// Only firmware supporting it is asked for other than the default timing.
+	if ((config->block_size == BYTES_PER_BLOCK) && !config->settle_set) {
+		result = hackrf_init_sweep(
+			engine->device,
+			config->frequencies,
+			config->num_ranges,
+			config->block_size * config->dwell_blocks,
+			TUNE_STEP * FREQ_ONE_MHZ,
+			OFFSET,
+			INTERLEAVED);
+	} else {
+		// Two whole default blocks of two-byte samples, as the firmware settles.
+		settle_samples = config->settle_set ? config->settle_samples : BYTES_PER_BLOCK;
+		result = hackrf_init_sweep_timed(
+			engine->device,
+			config->frequencies,
+			config->num_ranges,
+			config->block_size * config->dwell_blocks,
+			TUNE_STEP * FREQ_ONE_MHZ,
+			OFFSET,
+			INTERLEAVED,
+			config->block_size,
+			settle_samples);
+	}
+	if ((result == HACKRF_SUCCESS) && config->device_spectrum) {
+		result = hackrf_init_spectrum(engine->device, config->fft_size);
+	}
+	if (result != HACKRF_SUCCESS) {
+		return result;
+	}
+	if (config->device_spectrum) {
+		result = hackrf_start_rx_spectrum(engine->device, rx_callback, engine);
+	} else {
+		result = hackrf_start_rx_sweep(engine->device, rx_callback, engine);
+	}
+	if (result != HACKRF_SUCCESS) {
+		return result;
+	}
+	engine->started = true;
+	return HACKRF_SUCCESS;
+}
+
+bool ADDCALL hackrf_sweep_engine_is_done(hackrf_sweep_engine* engine)
+{
+	return engine->done;
+}
+
+int ADDCALL hackrf_sweep_engine_stop(hackrf_sweep_engine* engine)
+{
+	int result = HACKRF_SUCCESS;
+
+	if (engine->stopped) {
+		return HACKRF_SUCCESS;
+	}
+	engine->done = true;
+	if (engine->started) {
+		// No more callbacks arrive once this returns.
+		result = hackrf_stop_rx(engine->device);
+	}
+	stop_pool(engine);
+	engine->stopped = true;
+	return result;
+}
+
+void ADDCALL hackrf_sweep_engine_destroy(hackrf_sweep_engine* engine)
+{
+	if (engine == NULL) {
+		return;
+	}
+	hackrf_sweep_engine_stop(engine);
+	free_engine(engine);
+}
+
+const hackrf_sweep_config* ADDCALL hackrf_sweep_engine_get_config(
+	const hackrf_sweep_engine* engine)
+{
+	return &engine->config;
+}
+
+uint64_t ADDCALL hackrf_sweep_engine_get_sweep_count(hackrf_sweep_engine* engine)
+{
+	return engine->sweep_count;
+}
+
+uint64_t ADDCALL hackrf_sweep_engine_get_byte_count(hackrf_sweep_engine* engine)
+{
+	return engine->byte_count;
+}
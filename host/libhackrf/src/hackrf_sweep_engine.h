@@ -0,0 +1,346 @@
+/*
+Copyright (c) 2026 Great Scott Gadgets <info@greatscottgadgets.com>
+
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the
+	documentation and/or other materials provided with the distribution.
+    Neither the name of Great Scott Gadgets nor the names of its contributors may be used to endorse or promote products derived from this software
+	without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "hackrf.h"
+
+/**
+ * @file hackrf_sweep_engine.h
+ * @brief Spectrum sweeps on top of libhackrf
+ */
+
+/**
+ * @defgroup sweep_engine Sweep engine
+ * @brief Turning sweep mode samples into power spectra
+ *
+ * The sweep engine is a companion library to libhackrf, built when FFTW is available, and is what `hackrf_sweep` is built on. It sets up sweep mode with @ref hackrf_init_sweep and @ref hackrf_start_rx_sweep, parses the frequency header of each block, transforms the blocks on a pool of worker threads, and delivers the power spectrum of each tuning step to @ref hackrf_sweep_config.row_callback, in the order the steps were captured.
+ *
+ * The engine always tunes in steps of 20 MHz with an offset of 7.5 MHz and interleaved mode, see @ref hackrf_init_sweep. Each step yields two bands of a quarter of the 20 MHz sample rate each, from f to f + 5 MHz and from f + 10 MHz to f + 15 MHz, where f is the tuned frequency, so that consecutive steps cover each range without gaps and without the center and edges of the baseband.
+ *
+ * Typical use:
+ * - fill a @ref hackrf_sweep_config, starting from @ref hackrf_sweep_config_init
+ * - create the engine with @ref hackrf_sweep_engine_create after configuring the device's gains
+ * - start sweeping with @ref hackrf_sweep_engine_start
+ * - wait until @ref hackrf_sweep_engine_is_done or the application wants to stop
+ * - stop with @ref hackrf_sweep_engine_stop, which delivers all remaining rows, then free the engine with @ref hackrf_sweep_engine_destroy
+ *
+ * The callbacks are all called from a single thread owned by the engine, never concurrently. They should return quickly, since the engine can only buffer a limited number of USB transfers.
+ *
+ * With @ref hackrf_sweep_config.device_spectrum, the device computes the spectra itself in spectrum mode, see @ref hackrf_init_spectrum, and the engine only turns its records into rows. This needs far less USB bandwidth and host CPU, at the cost of power-of-two FFT sizes of at most @ref HACKRF_SPECTRUM_MAX_FFT_SIZE, 8-bit fixed-point resolution and slower steps.
+ *
+ * With firmware supporting USB API version 0x0113 or above, each block also carries the device's count of the samples taken before it. The engine then timestamps rows with the device's sample clock rather than the host clock: the host time at which the first block arrived is taken once, and the time of every later block is that plus the number of samples since the first block divided by the sample rate. These timestamps are monotonic and free of USB and scheduling jitter, but share the constant latency of the first block. The device doesn't count samples it has to drop because the host doesn't keep up, so after an overrun the timestamps fall behind by the lost time.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Combining the spectra of each tuning step
+ * @ingroup sweep_engine
+ */
+enum hackrf_sweep_average {
+	/**
+	 * Transform only the last FFT size samples of each block
+	 */
+	HACKRF_SWEEP_AVERAGE_OFF = 0,
+	/**
+	 * Welch's method: split every block of a step into windowed segments overlapping by half, and average their power
+	 */
+	HACKRF_SWEEP_AVERAGE_MEAN = 1,
+	/**
+	 * Like @ref HACKRF_SWEEP_AVERAGE_MEAN, but keep the maximum power of each bin
+	 */
+	HACKRF_SWEEP_AVERAGE_MAX = 2,
+};
+
+/**
+ * FFTW planning effort, trading startup time for FFT speed
+ * @ingroup sweep_engine
+ */
+enum hackrf_sweep_plan {
+	/**
+	 * `FFTW_ESTIMATE`
+	 */
+	HACKRF_SWEEP_PLAN_ESTIMATE = 0,
+	/**
+	 * `FFTW_MEASURE`
+	 */
+	HACKRF_SWEEP_PLAN_MEASURE = 1,
+	/**
+	 * `FFTW_PATIENT`
+	 */
+	HACKRF_SWEEP_PLAN_PATIENT = 2,
+	/**
+	 * `FFTW_EXHAUSTIVE`
+	 */
+	HACKRF_SWEEP_PLAN_EXHAUSTIVE = 3,
+};
+
+/**
+ * Power spectrum of one tuning step, passed to @ref hackrf_sweep_config.row_callback
+ * @ingroup sweep_engine
+ */
+typedef struct {
+	/**
+	 * Index of the sweep, counted from 0
+	 */
+	uint64_t sweep;
+	/**
+	 * Time the step was captured, or the sweep started with @ref hackrf_sweep_config.normalize_timestamps, in microseconds since the Unix epoch. This is @ref hackrf_sweep_row.device_time if known, otherwise the host time the step was received
+	 */
+	int64_t time;
+	/**
+	 * Time by the device's sample clock the step was captured, or the sweep started with @ref hackrf_sweep_config.normalize_timestamps, in nanoseconds since the Unix epoch. 0 if the firmware doesn't provide it
+	 */
+	uint64_t device_time;
+	/**
+	 * Tuned frequency f in Hz. The bands are f to f + 5 MHz and f + 10 MHz to f + 15 MHz
+	 */
+	uint64_t frequency;
+	/**
+	 * Number of samples analyzed
+	 */
+	uint32_t num_samples;
+	/**
+	 * Number of values in each band, a quarter of the FFT size
+	 */
+	int num_bins;
+	/**
+	 * Power in dB of the bins of each band, in order of frequency
+	 */
+	const float* pwr[2];
+	/**
+	 * FFT output of each band as interleaved I and Q floats, only set with @ref hackrf_sweep_config.spectrum
+	 */
+	const float* spectrum[2];
+} hackrf_sweep_row;
+
+/**
+ * Called for each tuning step with its spectrum, which is only valid during the call
+ * @ingroup sweep_engine
+ */
+typedef void (*hackrf_sweep_row_cb_fn)(const hackrf_sweep_row* row, void* ctx);
+
+/**
+ * Called after the last row of each complete sweep
+ * @ingroup sweep_engine
+ */
+typedef void (*hackrf_sweep_done_cb_fn)(uint64_t sweep, void* ctx);
+
+/**
+ * Called after the rows of each USB transfer, e.g. to write out buffered output
+ * @ingroup sweep_engine
+ */
+typedef void (*hackrf_sweep_transfer_cb_fn)(void* ctx);
+
+/**
+ * Sweep engine configuration
+ *
+ * Initialize with @ref hackrf_sweep_config_init, then set at least the ranges and @ref row_callback.
+ * @ingroup sweep_engine
+ */
+typedef struct {
+	/**
+	 * Minimum and maximum frequency in MHz of each range. The maximum is raised to a whole number of 20 MHz steps
+	 */
+	uint16_t frequencies[MAX_SWEEP_RANGES * 2];
+	/**
+	 * Number of ranges, 1 to @ref MAX_SWEEP_RANGES
+	 */
+	int num_ranges;
+	/**
+	 * FFT size, 4 to 8180 and an odd multiple of 4, and at most (block_size - 14) / 2. The bin width is 20 MHz divided by this. With @ref device_spectrum, a power of two from @ref HACKRF_SPECTRUM_MIN_FFT_SIZE to @ref HACKRF_SPECTRUM_MAX_FFT_SIZE instead
+	 */
+	int fft_size;
+	/**
+	 * Number of FFT worker threads, or 0 for the number of CPUs
+	 */
+	int num_threads;
+	/**
+	 * FFTW planning effort
+	 */
+	enum hackrf_sweep_plan plan;
+	/**
+	 * Power calculation
+	 */
+	enum hackrf_db_mode db_mode;
+	/**
+	 * Combining of spectra within each step
+	 */
+	enum hackrf_sweep_average average;
+	/**
+	 * Blocks captured at each step. More than one requires averaging or @ref device_spectrum
+	 */
+	uint32_t dwell_blocks;
+	/**
+	 * Size of each block in bytes, including its header, see @ref hackrf_init_sweep_timed. The FFT size can be at most (block_size - 14) / 2
+	 */
+	uint32_t block_size;
+	/**
+	 * Samples discarded after each block to let the radio settle, used if @ref settle_set. Any other block size than @ref BYTES_PER_BLOCK or a settle time requires USB API version 0x0114
+	 */
+	uint32_t settle_samples;
+	/**
+	 * Use @ref settle_samples, even if 0. Otherwise the radio settles as long as the device does by default, for two whole blocks of @ref BYTES_PER_BLOCK (one on Praline)
+	 */
+	bool settle_set;
+	/**
+	 * Stop after this many sweeps, or 0 to sweep until stopped
+	 */
+	uint64_t num_sweeps;
+	/**
+	 * Also deliver the complex spectrum in @ref hackrf_sweep_row.spectrum. Not supported with averaging
+	 */
+	bool spectrum;
+	/**
+	 * Have the device compute the power spectrum of each step, averaging all its blocks, see @ref hackrf_init_spectrum. Requires no averaging and no @ref spectrum, and ignores @ref plan and @ref db_mode. Requires USB API version 0x0116
+	 */
+	bool device_spectrum;
+	/**
+	 * Give all rows of a sweep the time the sweep started
+	 */
+	bool normalize_timestamps;
+	/**
+	 * Called for each tuning step, required
+	 */
+	hackrf_sweep_row_cb_fn row_callback;
+	/**
+	 * Called at the end of each sweep, optional
+	 */
+	hackrf_sweep_done_cb_fn sweep_callback;
+	/**
+	 * Called after the rows of each transfer, optional
+	 */
+	hackrf_sweep_transfer_cb_fn transfer_callback;
+	/**
+	 * Passed to the callbacks
+	 */
+	void* ctx;
+} hackrf_sweep_config;
+
+/**
+ * Opaque sweep engine
+ * @ingroup sweep_engine
+ */
+typedef struct hackrf_sweep_engine hackrf_sweep_engine;
+
+/**
+ * Fill a configuration with the defaults used by `hackrf_sweep`
+ *
+ * The defaults are a single range from 0 to 6000 MHz, an FFT size of 20, one worker thread per CPU, @ref HACKRF_SWEEP_PLAN_MEASURE, @ref HACKRF_DB_FAST, no averaging and one dwell block of @ref BYTES_PER_BLOCK with the device's default settle time (@ref hackrf_sweep_config.settle_set false).
+ *
+ * @param[out] config configuration to fill
+ * @ingroup sweep_engine
+ */
+extern ADDAPI void ADDCALL hackrf_sweep_config_init(hackrf_sweep_config* config);
+
+/**
+ * Create a sweep engine for a device
+ *
+ * Allocates the buffers, plans the FFTs and starts the worker threads. FFTW planning isn't thread safe, so no other thread may use FFTW during this call. The configuration is copied.
+ *
+ * @param[in] device device to sweep with, which must stay open until the engine is destroyed
+ * @param[in] config configuration
+ * @param[out] engine created engine
+ * @return @ref HACKRF_SUCCESS on success, @ref HACKRF_ERROR_INVALID_PARAM if the configuration is invalid, or @ref HACKRF_ERROR_NO_MEM or @ref HACKRF_ERROR_THREAD
+ * @ingroup sweep_engine
+ */
+extern ADDAPI int ADDCALL hackrf_sweep_engine_create(
+	hackrf_device* device,
+	const hackrf_sweep_config* config,
+	hackrf_sweep_engine** engine);
+
+/**
+ * Configure sweep mode and start receiving
+ *
+ * An engine can only be started once.
+ *
+ * @param engine engine to start
+ * @return @ref HACKRF_SUCCESS on success or @ref hackrf_error variant
+ * @ingroup sweep_engine
+ */
+extern ADDAPI int ADDCALL hackrf_sweep_engine_start(hackrf_sweep_engine* engine);
+
+/**
+ * Query if @ref hackrf_sweep_config.num_sweeps sweeps have been captured
+ *
+ * @param engine engine to query
+ * @return true once all requested sweeps have been captured, they may not all have been delivered yet
+ * @ingroup sweep_engine
+ */
+extern ADDAPI bool ADDCALL hackrf_sweep_engine_is_done(hackrf_sweep_engine* engine);
+
+/**
+ * Stop receiving, and deliver the rows of all steps captured so far
+ *
+ * Returns once the last callback has returned. A sweep that wasn't complete doesn't get a sweep callback.
+ *
+ * @param engine engine to stop
+ * @return @ref HACKRF_SUCCESS on success or @ref hackrf_error variant
+ * @ingroup sweep_engine
+ */
+extern ADDAPI int ADDCALL hackrf_sweep_engine_stop(hackrf_sweep_engine* engine);
+
+/**
+ * Free an engine, stopping it first if needed
+ *
+ * @param engine engine to free, may be NULL
+ * @ingroup sweep_engine
+ */
+extern ADDAPI void ADDCALL hackrf_sweep_engine_destroy(hackrf_sweep_engine* engine);
+
+/**
+ * Get the configuration of an engine
+ *
+ * The maximum frequencies are raised to a whole number of tuning steps, and zero thread counts and dwell blocks replaced by the values in use.
+ *
+ * @param engine engine to query
+ * @return configuration in use
+ * @ingroup sweep_engine
+ */
+extern ADDAPI const hackrf_sweep_config* ADDCALL hackrf_sweep_engine_get_config(
+	const hackrf_sweep_engine* engine);
+
+/**
+ * Get the number of complete sweeps captured so far
+ *
+ * @param engine engine to query
+ * @return number of sweeps
+ * @ingroup sweep_engine
+ */
+extern ADDAPI uint64_t ADDCALL hackrf_sweep_engine_get_sweep_count(
+	hackrf_sweep_engine* engine);
+
+/**
+ * Get the number of bytes received so far
+ *
+ * @param engine engine to query
+ * @return number of bytes
+ * @ingroup sweep_engine
+ */
+extern ADDAPI uint64_t ADDCALL hackrf_sweep_engine_get_byte_count(
+	hackrf_sweep_engine* engine);
+
+#ifdef __cplusplus
+} // __cplusplus defined.
+#endif
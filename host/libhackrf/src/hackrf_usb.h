@@ -0,0 +1,120 @@
+/*
+Copyright (c) 2012-2026 Great Scott Gadgets <info@greatscottgadgets.com>
+Copyright (c) 2012, Jared Boone <jared@sharebrained.com>
+Copyright (c) 2013, Benjamin Vernoux <titanmkd@gmail.com>
+
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+    Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+    Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the 
+	documentation and/or other materials provided with the distribution.
+    Neither the name of Great Scott Gadgets nor the names of its contributors may be used to endorse or promote products derived from this software
+	without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * USB protocol between libhackrf and the HackRF firmware, shared by the
+ * library and its device emulator. Not installed.
+ */
+
+#pragma once
+
+#include <libusb.h>
+
+// TODO: Factor this into a shared #include so that firmware can use
+// the same values.
+typedef enum {
+	HACKRF_VENDOR_REQUEST_SET_TRANSCEIVER_MODE = 1,
+	HACKRF_VENDOR_REQUEST_MAX283X_WRITE = 2,
+	HACKRF_VENDOR_REQUEST_MAX283X_READ = 3,
+	HACKRF_VENDOR_REQUEST_SI5351C_WRITE = 4,
+	HACKRF_VENDOR_REQUEST_SI5351C_READ = 5,
+	HACKRF_VENDOR_REQUEST_SAMPLE_RATE_SET = 6,
+	HACKRF_VENDOR_REQUEST_BASEBAND_FILTER_BANDWIDTH_SET = 7,
+	HACKRF_VENDOR_REQUEST_RFFC5071_WRITE = 8,
+	HACKRF_VENDOR_REQUEST_RFFC5071_READ = 9,
+	HACKRF_VENDOR_REQUEST_SPIFLASH_ERASE = 10,
+	HACKRF_VENDOR_REQUEST_SPIFLASH_WRITE = 11,
+	HACKRF_VENDOR_REQUEST_SPIFLASH_READ = 12,
+	HACKRF_VENDOR_REQUEST_BOARD_ID_READ = 14,
+	HACKRF_VENDOR_REQUEST_VERSION_STRING_READ = 15,
+	HACKRF_VENDOR_REQUEST_SET_FREQ = 16,
+	HACKRF_VENDOR_REQUEST_AMP_ENABLE = 17,
+	HACKRF_VENDOR_REQUEST_BOARD_PARTID_SERIALNO_READ = 18,
+	HACKRF_VENDOR_REQUEST_SET_LNA_GAIN = 19,
+	HACKRF_VENDOR_REQUEST_SET_VGA_GAIN = 20,
+	HACKRF_VENDOR_REQUEST_SET_TXVGA_GAIN = 21,
+	HACKRF_VENDOR_REQUEST_ANTENNA_ENABLE = 23,
+	HACKRF_VENDOR_REQUEST_SET_FREQ_EXPLICIT = 24,
+	HACKRF_VENDOR_REQUEST_USB_WCID_VENDOR_REQ = 25,
+	HACKRF_VENDOR_REQUEST_INIT_SWEEP = 26,
+	HACKRF_VENDOR_REQUEST_OPERACAKE_GET_BOARDS = 27,
+	HACKRF_VENDOR_REQUEST_OPERACAKE_SET_PORTS = 28,
+	HACKRF_VENDOR_REQUEST_SET_HW_SYNC_MODE = 29,
+	HACKRF_VENDOR_REQUEST_RESET = 30,
+	HACKRF_VENDOR_REQUEST_OPERACAKE_SET_RANGES = 31,
+	HACKRF_VENDOR_REQUEST_CLKOUT_ENABLE = 32,
+	HACKRF_VENDOR_REQUEST_SPIFLASH_STATUS = 33,
+	HACKRF_VENDOR_REQUEST_SPIFLASH_CLEAR_STATUS = 34,
+	HACKRF_VENDOR_REQUEST_OPERACAKE_GPIO_TEST = 35,
+	HACKRF_VENDOR_REQUEST_CPLD_CHECKSUM = 36,
+	HACKRF_VENDOR_REQUEST_UI_ENABLE = 37,
+	HACKRF_VENDOR_REQUEST_OPERACAKE_SET_MODE = 38,
+	HACKRF_VENDOR_REQUEST_OPERACAKE_GET_MODE = 39,
+	HACKRF_VENDOR_REQUEST_OPERACAKE_SET_DWELL_TIMES = 40,
+	HACKRF_VENDOR_REQUEST_GET_M0_STATE = 41,
+	HACKRF_VENDOR_REQUEST_SET_TX_UNDERRUN_LIMIT = 42,
+	HACKRF_VENDOR_REQUEST_SET_RX_OVERRUN_LIMIT = 43,
+	HACKRF_VENDOR_REQUEST_GET_CLKIN_STATUS = 44,
+	HACKRF_VENDOR_REQUEST_BOARD_REV_READ = 45,
+	HACKRF_VENDOR_REQUEST_SUPPORTED_PLATFORM_READ = 46,
+	HACKRF_VENDOR_REQUEST_SET_LEDS = 47,
+	HACKRF_VENDOR_REQUEST_SET_USER_BIAS_T_OPTS = 48,
+	HACKRF_VENDOR_REQUEST_FPGA_WRITE_REG = 49,
+	HACKRF_VENDOR_REQUEST_FPGA_READ_REG = 50,
+	HACKRF_VENDOR_REQUEST_P2_CTRL = 51,
+	HACKRF_VENDOR_REQUEST_P1_CTRL = 52,
+	HACKRF_VENDOR_REQUEST_SET_NARROWBAND_FILTER = 53,
+	HACKRF_VENDOR_REQUEST_SET_FPGA_BITSTREAM = 54,
+	HACKRF_VENDOR_REQUEST_CLKIN_CTRL = 55,
+	HACKRF_VENDOR_REQUEST_READ_SELFTEST = 56,
+	HACKRF_VENDOR_REQUEST_READ_ADC = 57,
+	HACKRF_VENDOR_REQUEST_TEST_RTC_OSC = 58,
+	HACKRF_VENDOR_REQUEST_RADIO_WRITE_REG = 59,
+	HACKRF_VENDOR_REQUEST_RADIO_READ_REG = 60,
+	HACKRF_VENDOR_REQUEST_GET_BUFFER_SIZE = 61,
+	HACKRF_VENDOR_REQUEST_INIT_SWEEP_TIMED = 62,
+	HACKRF_VENDOR_REQUEST_SET_HOP_TABLE = 63,
+	HACKRF_VENDOR_REQUEST_INIT_HOP_SWEEP = 64,
+	HACKRF_VENDOR_REQUEST_INIT_SPECTRUM = 65,
+	HACKRF_VENDOR_REQUEST_OPERACAKE_SET_SWEEP_PORTS = 66,
+} hackrf_vendor_request;
+
+#define USB_CONFIG_STANDARD 0x1
+
+#define RX_ENDPOINT_ADDRESS (LIBUSB_ENDPOINT_IN | 1)
+#define TX_ENDPOINT_ADDRESS (LIBUSB_ENDPOINT_OUT | 2)
+
+typedef enum {
+	HACKRF_TRANSCEIVER_MODE_OFF = 0,
+	HACKRF_TRANSCEIVER_MODE_RECEIVE = 1,
+	HACKRF_TRANSCEIVER_MODE_TRANSMIT = 2,
+	HACKRF_TRANSCEIVER_MODE_SS = 3,
+	TRANSCEIVER_MODE_CPLD_UPDATE = 4,
+	TRANSCEIVER_MODE_RX_SWEEP = 5,
+	TRANSCEIVER_MODE_RX_SPECTRUM = 6,
+} hackrf_transceiver_mode;
+
+typedef enum {
+	HACKRF_HW_SYNC_MODE_OFF = 0,
+	HACKRF_HW_SYNC_MODE_ON = 1,
+} hackrf_hw_sync_mode;